@@ -20,6 +20,8 @@
 
 #include <stdio.h>
 #include "flex.h"
+#include "myriota/resource.h"
+#include "myriota/settle.h"
 
 #define APPLICATION_NAME "Analog Example"
 
@@ -43,40 +45,35 @@
 // The FlexSense board supports an output voltage given by the enum FLEX_PowerOut.
 #define ANALOG_SENSOR_POWER_IN FLEX_POWER_OUT_24V
 
-// Modify this delay to save power based on the sensor stabilisation time
+// The longest time the sensor takes to stabilise. The reading is taken as soon
+// as it has stabilised, which is usually much sooner.
 #define DELAY_SENSOR_STABILISE_MS 1500
 
-static uint32_t MeasureAnalogInput(void) {
-  uint32_t SensorReading = UINT32_MAX;
+// The reading has stabilised when it changes by less than this many uA (or mV)
+// a second, and varies by less than SENSOR_STABLE_STDDEV.
+#define SENSOR_STABLE_SLOPE 200
+#define SENSOR_STABLE_STDDEV 20
 
-  if (FLEX_PowerOutInit(ANALOG_SENSOR_POWER_IN) != 0) {
-    printf("Failed to Init Power Out.\r\n");
-    goto fail_0;
-  }
-
-  if (FLEX_AnalogInputInit(ANALOG_IN_MODE) != 0) {
-    printf("Failed to Init Analog Input.\r\n");
-    goto fail_1;
-  }
+static MYRIOTA_ResourceManager Resources;
+static MYRIOTA_Settle SensorSettle;
 
-  FLEX_DelayMs(DELAY_SENSOR_STABILISE_MS);
+static uint32_t MeasureAnalogInput(void) {
+  uint32_t SensorReading = UINT32_MAX;
 
+  // Powers the sensor and initialises the Analog Input for the reading only,
+  // for the lowest idle power consumption.
+  const int Result = MYRIOTA_SettleRead(&SensorSettle, &SensorReading);
+  if (Result == -FLEX_ERROR_ETIMEDOUT) {
+    printf("Sensor did not stabilise.\r\n");
+  } else if (Result != 0) {
+    SensorReading = UINT32_MAX;
 #if MEASURE_CURRENT
-  if (FLEX_AnalogInputReadCurrent(&SensorReading) != 0) {
     printf("Failed to Read Current.\r\n");
-  }
 #else
-  if (FLEX_AnalogInputReadVoltage(&SensorReading) != 0) {
     printf("Failed to Read Voltage.\r\n");
-  }
 #endif
+  }
 
-  // De-initialise the Analog Input for the lowest idle power consumption.
-  FLEX_AnalogInputDeinit();
-fail_1:
-  // De-initialise the Power Out interface for the lowest idle power consumption.
-  FLEX_PowerOutDeinit();
-fail_0:
   return SensorReading;
 }
 
@@ -96,6 +93,17 @@ static time_t PrintSensorReading(void) {
 
 void FLEX_AppInit() {
   printf("%s (%s mode).\r\n", APPLICATION_NAME, APPLICATION_MODE);
+  const MYRIOTA_SettleOptions SettleOptions = {
+    .power_out = ANALOG_SENSOR_POWER_IN,
+    .mode = ANALOG_IN_MODE,
+    .interval_ms = 50,
+    .window = 5,
+    .max_slope = SENSOR_STABLE_SLOPE,
+    .max_stddev = SENSOR_STABLE_STDDEV,
+    .max_ms = DELAY_SENSOR_STABILISE_MS,
+  };
+  MYRIOTA_ResourceInit(&Resources);
+  MYRIOTA_SettleInit(&SensorSettle, &SettleOptions, &Resources);
   FLEX_JobSchedule(PrintSensorReading, FLEX_ASAP());
 }
 
@@ -21,78 +21,43 @@
 #include <string.h>
 
 #include "flex.h"
+#include "myriota/bitpack.h"
+#include "myriota/location.h"
 #include "myriota/modbus.h"
+#include "myriota/serial_modbus.h"
 
 #define APPLICATION_NAME "DFRobot SEN0438 Modbus Driver Application"
 #define MESSAGES_PER_DAY 4
 #define SENSOR_READ_MAX_RETRIES 3
 #define SENSOR_POWER_STABILIZATION_MS 1500
-
-typedef struct {
-  uint8_t sequence_number;
-  uint32_t time;
-  int32_t latitude;
-  int32_t longitude;
-  int16_t temperature;
-  int16_t humidity;
-} __attribute__((packed)) Message;
-
-typedef struct {
-  FLEX_SerialProtocol protocol;
-  uint32_t baud_rate;
-  uint32_t rx_timeout_ticks;
-} SerialContext;
+#define MESSAGE_BUDGET_BYTES 16
+#define LOCATION_ANCHOR_INTERVAL 8
+
+// The fields pack into 59 bits, followed by the location at a precision of
+// 10 m, which takes 4 bits while the sensor stays put and 49 bits for the
+// anchor. The budget is checked against the largest anchor at any precision.
+// The temperature (-40 to 80 C) and humidity (0 to 100 %RH) are in units of 0.1.
+// X(type, name, bits, min, max, scale)
+#define MESSAGE_SCHEMA(X, T)                           \
+  X(T, sequence_number, 7, 0, 127, 1)                  \
+  X(T, time, 31, 0, INT32_MAX, 1)                      \
+  X(T, temperature, 11, -400, 800, 1)                  \
+  X(T, humidity, 10, 0, 1000, 1)
+
+MYRIOTA_BITPACK_DEFINE(Message, MESSAGE_SCHEMA, MESSAGE_BUDGET_BYTES);
+_Static_assert(MYRIOTA_BITPACK_SCHEMA_BITS(MESSAGE_SCHEMA) + MYRIOTA_LOCATION_MAX_BITS <=
+                 MESSAGE_BUDGET_BYTES * 8,
+  "Message and location anchor do not fit in MESSAGE_BUDGET_BYTES");
+
+static MYRIOTA_LocationEncoder location_encoder;
 
 typedef struct {
   MYRIOTA_ModbusHandle modbus_handle;
-  SerialContext serial_context;
+  MYRIOTA_SerialModbusContext serial_context;
 } ApplicationContext;
 
 static ApplicationContext application_context = {0};
 
-static int serial_init(void *const ctx) {
-  SerialContext *const serial = ctx;
-  return FLEX_SerialInit(serial->protocol, serial->baud_rate);
-}
-
-// De-initialise the Serial interface for the lowest idle power consumption.
-static void serial_deinit(void *const ctx) {
-  (void)ctx;
-  FLEX_SerialDeinit();
-}
-
-static ssize_t serial_read(void *const ctx, uint8_t *const buffer, const size_t count) {
-  SerialContext *const serial = ctx;
-
-  uint8_t *curr = buffer;
-  const uint8_t *const end = buffer + count;
-  const uint32_t end_ticks = FLEX_TickGet() + serial->rx_timeout_ticks;
-  while (FLEX_TickGet() <= end_ticks) {
-    if (curr >= end) {
-      return -1;
-    }
-
-    int num_bytes = FLEX_SerialRead(curr, 1);
-    if (num_bytes < 0) {
-      return -1;
-    }
-    if (num_bytes == 1) {
-      ++curr;
-    }
-  }
-
-  return curr - buffer;
-}
-
-static ssize_t serial_write(void *const ctx, const uint8_t *const buffer, const size_t count) {
-  (void)ctx;
-  const int result = FLEX_SerialWrite(buffer, count);
-  if (result != FLEX_SUCCESS) {
-    return result;
-  }
-  return count;
-}
-
 inline uint16_t merge_i16(const uint8_t hi, const uint8_t low) {
   return (int16_t)((uint16_t)hi << 8 | (uint16_t)low);
 }
@@ -135,30 +100,40 @@ static time_t send_message(void) {
   static uint8_t sequence_number = 0;
 
   Message message = {0};
-  message.sequence_number = sequence_number++;
+  message.sequence_number = sequence_number++ & 0x7F;
   message.time = FLEX_TimeGet();
 
-  int32_t latitude = 0;
-  int32_t longitude = 0;
-  FLEX_LastLocationAndLastFixTime(&latitude, &longitude, NULL);
-  message.latitude = latitude;
-  message.longitude = longitude;
-
   int16_t temperature = 0;
   int16_t humidity = 0;
   read_temperature_and_humidity(&temperature, &humidity);
   message.temperature = temperature;
   message.humidity = humidity;
 
+  // The location follows the packed fields without padding.
+  int32_t latitude = 0;
+  int32_t longitude = 0;
+  FLEX_LastLocationAndLastFixTime(&latitude, &longitude, NULL);
+  uint8_t payload[MESSAGE_BUDGET_BYTES];
+  MYRIOTA_BITPACK_PACK(Message, &message, payload, sizeof(payload));
+  const size_t fields_bits = MYRIOTA_BITPACK_SCHEMA_BITS(MESSAGE_SCHEMA);
+  const ssize_t location_bits = MYRIOTA_LocationEncode(&location_encoder, latitude, longitude,
+    payload, sizeof(payload), fields_bits);
+  if (location_bits < 0) {
+    // A message without the location would be mistaken for one with it, so skip it.
+    printf("Failed to encode location: %d\n", (int)location_bits);
+    return (FLEX_TimeGet() + 24 * 3600 / MESSAGES_PER_DAY);
+  }
+  const size_t payload_size = (fields_bits + location_bits + 7) / 8;
+
   // Schedule messages for satellite transmission
-  FLEX_MessageSchedule((const uint8_t *const)&message, sizeof(message));
-  printf("Scheduled message: \n");
-  printf("  sequence_number: %u\n", message.sequence_number);
-  printf("  time: %lu\n", message.time);
-  printf("  latitude: %ld\n", message.latitude);
-  printf("  longitude: %ld\n", message.longitude);
-  printf("  temperature: %d\n", message.temperature);
-  printf("  humidity: %d\n", message.humidity);
+  FLEX_MessageSchedule(payload, payload_size);
+  printf("Scheduled message of %u bytes: \n", (unsigned)payload_size);
+  printf("  sequence_number: %ld\n", message.sequence_number);
+  printf("  time: %ld\n", message.time);
+  printf("  latitude: %ld\n", latitude);
+  printf("  longitude: %ld\n", longitude);
+  printf("  temperature: %ld\n", message.temperature);
+  printf("  humidity: %ld\n", message.humidity);
 
   return (FLEX_TimeGet() + 24 * 3600 / MESSAGES_PER_DAY);
 }
@@ -167,19 +142,13 @@ void FLEX_AppInit() {
   printf("%s\n", APPLICATION_NAME);
 
   // Initialize Modbus device
-  application_context.serial_context.protocol = FLEX_SERIAL_PROTOCOL_RS485;
-  application_context.serial_context.baud_rate = 9600;
-  application_context.serial_context.rx_timeout_ticks = 2000;
+  MYRIOTA_SerialModbusContext *const serial_context = &application_context.serial_context;
+  serial_context->options.protocol = FLEX_SERIAL_PROTOCOL_RS485;
+  serial_context->options.baud_rate = 9600;
+  serial_context->response_timeout_ms = 2000;
   const MYRIOTA_ModbusInitOptions options = {
     .framing_mode = MODBUS_FRAMING_MODE_RTU,
-    .serial_interface =
-      {
-        .ctx = &application_context.serial_context,
-        .init = serial_init,
-        .deinit = serial_deinit,
-        .read = serial_read,
-        .write = serial_write,
-      },
+    .serial_interface = MYRIOTA_SerialModbusInterface(serial_context),
   };
   application_context.modbus_handle = MYRIOTA_ModbusInit(options);
   if (application_context.modbus_handle <= 0) {
@@ -188,6 +157,12 @@ void FLEX_AppInit() {
     };
   }
 
+  const MYRIOTA_LocationOptions location_options = {
+    .precision = MYRIOTA_LOCATION_PRECISION_M(10),
+    .anchor_interval = LOCATION_ANCHOR_INTERVAL,
+  };
+  MYRIOTA_LocationEncoderInit(&location_encoder, &location_options);
+
   FLEX_JobSchedule(send_message, FLEX_ASAP());
 }
 
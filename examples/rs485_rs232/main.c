@@ -27,6 +27,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "flex.h"
+#include "myriota/serial.h"
 
 #define READY_STRING "READY\n"
 #define RECEIVE_TIMEOUT_MS 2000
@@ -52,45 +53,43 @@ const FLEX_DigitalIOPin WakeupPin = FLEX_EXT_DIGITAL_IO_1;
 #error "Must supply a valid 'SERIAL_INTERFACE' to the build!"
 #endif
 
+static MYRIOTA_Serial Serial;
+
 // Read new line terminated string from the Serial interface with timeout
 // Return number of bytes read or -1 on timeout or string is too long
 int ReadStringWithTimeout(uint8_t *Rx, size_t MaxLength) {
-  const uint32_t start = FLEX_TickGet();
-  size_t count = 0;
-  while (FLEX_TickGet() - start < RECEIVE_TIMEOUT_MS) {
-    uint8_t ch;
-    if (FLEX_SerialRead(&ch, 1) == 1) {
-      if (ch == '\n')
-        return count;
-      Rx[count++] = ch;
-      if (count == MaxLength)
-        return -1;
-    }
-  }
-  return -1;
+  const MYRIOTA_SerialReadOptions Options = {
+    .timeout_ms = RECEIVE_TIMEOUT_MS,
+    .delimiter = '\n',
+  };
+  const ssize_t count = MYRIOTA_SerialRead(&Serial, Rx, MaxLength, &Options);
+  if (count <= 0 || Rx[count - 1] != '\n')
+    return -1;
+  return count - 1;
 }
 
 static void Comm() {
-  if (FLEX_SerialInit(SERIAL_PROTOCOL, BAUDRATE) != 0) {
+  const FLEX_SerialExOptions Options = {.protocol = SERIAL_PROTOCOL, .baud_rate = BAUDRATE};
+  if (MYRIOTA_SerialInit(&Serial, Options) != 0) {
     printf("Failed to initialise Serial interface\n");
     return;
   }
-  FLEX_SerialWrite((uint8_t *)READY_STRING, strlen(READY_STRING));
+  MYRIOTA_SerialWrite(&Serial, (uint8_t *)READY_STRING, strlen(READY_STRING));
 
   uint8_t Rx[RX_BUFFER_MAX] = {0};
   int len = ReadStringWithTimeout(Rx, RX_BUFFER_MAX);
   if (len <= 0) {
     printf("Failed to receive message\n");
   } else {
-    FLEX_SerialWrite((uint8_t *)Rx, len);
-    FLEX_SerialWrite((uint8_t *)ACK_STRING, strlen(ACK_STRING));
+    MYRIOTA_SerialWrite(&Serial, (uint8_t *)Rx, len);
+    MYRIOTA_SerialWrite(&Serial, (uint8_t *)ACK_STRING, strlen(ACK_STRING));
     printf("Received message: ");
     for (int i = 0; i < len; i++)
       printf("%02x", Rx[i]);
     printf("\n");
   }
 
-  FLEX_SerialDeinit();
+  MYRIOTA_SerialDeinit(&Serial);
 }
 
 void FLEX_AppInit() {
@@ -0,0 +1,172 @@
+/// \file aggregator.h Myriota Sample Aggregator
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYRIOTA_AGGREGATOR_H
+#define MYRIOTA_AGGREGATOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+/** \defgroup Aggregator Sample Aggregator
+ * @brief Batch fixed-size readings into as few messages as possible
+ *
+ * Readings are buffered in a RAM ring and packed back to back into messages
+ * of up to `message_size` bytes. A message is scheduled when it is full, or
+ * with the readings available once the oldest buffered reading reaches
+ * `max_age_s`. Messages are only scheduled when FLEX_MessageSlotsFree() and
+ * FLEX_MessageBytesFree() show that the queue can take them, so readings wait
+ * in RAM instead of replacing messages already in the queue. When the ring
+ * is full the oldest reading is dropped.
+ *
+ * \code
+ * static MYRIOTA_Aggregator aggregator;
+ * const MYRIOTA_AggregatorOptions options = {
+ *   .record_size = sizeof(Reading),
+ *   .message_size = 20,
+ *   .max_age_s = 6 * 3600,
+ * };
+ * MYRIOTA_AggregatorInit(&aggregator, &options);
+ *
+ * static time_t sample_job(void) {
+ *   const Reading reading = {...};
+ *   MYRIOTA_AggregatorAdd(&aggregator, &reading);
+ *   return FLEX_TimeGet() + SAMPLE_PERIOD_S;
+ * }
+ * \endcode
+ *
+ * Call MYRIOTA_AggregatorSave() instead of FLEX_MessageSave() so that
+ * buffered readings are scheduled before the queue is saved.
+ * \{
+ */
+
+/** The size of the reading ring buffer in bytes. */
+#ifndef MYRIOTA_AGGREGATOR_RING_SIZE
+#define MYRIOTA_AGGREGATOR_RING_SIZE 512
+#endif
+
+/** The largest message size that can be used. */
+#ifndef MYRIOTA_AGGREGATOR_MESSAGE_SIZE_MAX
+#define MYRIOTA_AGGREGATOR_MESSAGE_SIZE_MAX 64
+#endif
+
+/** Configuration of an aggregator. */
+typedef struct {
+  /** The size of each reading in bytes. */
+  size_t record_size;
+  /** The maximum size of each message in bytes, which must be at least
+   * `record_size` and at most MYRIOTA_AGGREGATOR_MESSAGE_SIZE_MAX. */
+  size_t message_size;
+  /** The age in seconds of the oldest reading at which a partial message is
+   * scheduled, where 0 only schedules full messages. If not 0, each reading
+   * also takes 4 bytes of the ring for the time it was added. */
+  uint32_t max_age_s;
+} MYRIOTA_AggregatorOptions;
+
+/** Statistics of an aggregator. */
+typedef struct {
+  /** The number of messages scheduled. */
+  uint32_t message_count;
+  /** The number of readings scheduled. */
+  uint32_t reading_count;
+  /** The number of readings dropped because the ring buffer was full. */
+  uint32_t dropped_count;
+  /** The number of times the message queue could not take a message. */
+  uint32_t deferred_count;
+} MYRIOTA_AggregatorStats;
+
+/** A sample aggregator. Treat the members as private. */
+typedef struct {
+  /** \cond INTERNAL_HIDDEN */
+  MYRIOTA_AggregatorOptions options;
+  size_t slot_size;
+  uint16_t capacity;
+  uint16_t records_per_message;
+  uint16_t first;
+  uint16_t count;
+  MYRIOTA_AggregatorStats stats;
+  uint8_t ring[MYRIOTA_AGGREGATOR_RING_SIZE];
+  /** \endcond */
+} MYRIOTA_Aggregator;
+
+/**
+ * Initializes an empty aggregator.
+ *
+ * \param[out] aggregator The aggregator to initialize.
+ * \param[in] options The configuration of the aggregator.
+ */
+void MYRIOTA_AggregatorInit(MYRIOTA_Aggregator *const aggregator,
+  const MYRIOTA_AggregatorOptions *const options);
+
+/**
+ * Add a reading and schedule any messages that are due.
+ *
+ * \param[in,out] aggregator The aggregator.
+ * \param[in] record The reading, of `record_size` bytes.
+ * \return FLEX_SUCCESS (0) if succeeded and < 0 if scheduling a message failed.
+ * The reading is buffered in either case.
+ */
+int MYRIOTA_AggregatorAdd(MYRIOTA_Aggregator *const aggregator, const void *const record);
+
+/**
+ * Schedule any messages that are due, e.g. from a job that runs at the time
+ * returned by the previous call.
+ *
+ * \param[in,out] aggregator The aggregator.
+ * \return the time a partial message is next due, or FLEX_Never() if no
+ * reading is buffered or `max_age_s` is 0.
+ */
+time_t MYRIOTA_AggregatorPoll(MYRIOTA_Aggregator *const aggregator);
+
+/**
+ * Schedule all buffered readings, including a partial message.
+ *
+ * \param[in,out] aggregator The aggregator.
+ * \return the number of readings left buffered because the message queue is
+ * full, else < 0 on error.
+ */
+int MYRIOTA_AggregatorFlush(MYRIOTA_Aggregator *const aggregator);
+
+/**
+ * Flush the aggregator and then save the message queue to persistent storage
+ * with FLEX_MessageSave(), e.g. before a planned reset.
+ *
+ * \param[in,out] aggregator The aggregator.
+ * \return the number of readings that could not be scheduled and are lost on
+ * reset, else < 0 on error.
+ */
+int MYRIOTA_AggregatorSave(MYRIOTA_Aggregator *const aggregator);
+
+/**
+ * Returns the number of buffered readings.
+ *
+ * \param[in] aggregator The aggregator.
+ */
+size_t MYRIOTA_AggregatorCount(const MYRIOTA_Aggregator *const aggregator);
+
+/**
+ * Get the statistics of an aggregator.
+ *
+ * \param[in] aggregator The aggregator.
+ * \param[out] stats The statistics.
+ */
+void MYRIOTA_AggregatorStatsGet(const MYRIOTA_Aggregator *const aggregator,
+  MYRIOTA_AggregatorStats *const stats);
+
+/**
+ * \}
+ */
+
+#endif /* MYRIOTA_AGGREGATOR_H */
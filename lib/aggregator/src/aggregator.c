@@ -0,0 +1,285 @@
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myriota/aggregator.h"
+#include <string.h>
+#include "flex.h"
+
+// NOTE: you can provide your own assert
+#ifndef AGGREGATOR_ASSERT
+#include <stdio.h>
+#define AGGREGATOR_ASSERT(cond)                      \
+  do {                                               \
+    if (!(cond)) {                                   \
+      printf("Assert @%s:%d\n", __FILE__, __LINE__); \
+      while (1) {                                    \
+      }                                              \
+    }                                                \
+  } while (0)
+#endif
+
+// A slot holds a reading, followed by the time it was added if readings are aged.
+static inline uint8_t *aggregator_slot(MYRIOTA_Aggregator *const aggregator,
+  const uint16_t index) {
+  return &aggregator->ring[(index % aggregator->capacity) * aggregator->slot_size];
+}
+
+// The time the oldest buffered reading was added.
+static time_t aggregator_oldest_time(MYRIOTA_Aggregator *const aggregator) {
+  uint32_t time;
+  memcpy(&time, aggregator_slot(aggregator, aggregator->first) + aggregator->options.record_size,
+    sizeof(time));
+  return (time_t)time;
+}
+
+static bool aggregator_is_due(MYRIOTA_Aggregator *const aggregator, const time_t now) {
+  return aggregator->count > 0 && aggregator->options.max_age_s > 0 &&
+         now - aggregator_oldest_time(aggregator) >= (time_t)aggregator->options.max_age_s;
+}
+
+// Schedules full messages, and a final partial message if `partial` is set,
+// while the message queue has room for them.
+static int aggregator_schedule(MYRIOTA_Aggregator *const aggregator, const bool partial) {
+  const size_t record_size = aggregator->options.record_size;
+  int result = FLEX_SUCCESS;
+  while (aggregator->count >= (partial ? 1 : aggregator->records_per_message)) {
+    const uint16_t count = (aggregator->count < aggregator->records_per_message) ?
+                             aggregator->count :
+                             aggregator->records_per_message;
+    const size_t size = count * record_size;
+    if (FLEX_MessageSlotsFree() <= 0 || FLEX_MessageBytesFree() < size) {
+      ++aggregator->stats.deferred_count;
+      break;
+    }
+
+    uint8_t message[MYRIOTA_AGGREGATOR_MESSAGE_SIZE_MAX];
+    for (uint16_t i = 0; i < count; ++i) {
+      memcpy(&message[i * record_size], aggregator_slot(aggregator, aggregator->first + i),
+        record_size);
+    }
+    result = FLEX_MessageSchedule(message, size);
+    if (result < 0) {
+      break;
+    }
+    result = FLEX_SUCCESS;
+
+    aggregator->first = (aggregator->first + count) % aggregator->capacity;
+    aggregator->count -= count;
+    ++aggregator->stats.message_count;
+    aggregator->stats.reading_count += count;
+  }
+  return result;
+}
+
+void MYRIOTA_AggregatorInit(MYRIOTA_Aggregator *const aggregator,
+  const MYRIOTA_AggregatorOptions *const options) {
+  AGGREGATOR_ASSERT(aggregator != NULL);
+  AGGREGATOR_ASSERT(options != NULL);
+  AGGREGATOR_ASSERT(options->record_size > 0 && options->record_size <= options->message_size);
+  AGGREGATOR_ASSERT(options->message_size <= MYRIOTA_AGGREGATOR_MESSAGE_SIZE_MAX);
+  const size_t slot_size = options->record_size + (options->max_age_s > 0 ? sizeof(uint32_t) : 0);
+  AGGREGATOR_ASSERT(slot_size <= MYRIOTA_AGGREGATOR_RING_SIZE);
+  memset(aggregator, 0, sizeof(*aggregator));
+  aggregator->options = *options;
+  aggregator->slot_size = slot_size;
+  aggregator->capacity = MYRIOTA_AGGREGATOR_RING_SIZE / slot_size;
+  aggregator->records_per_message = options->message_size / options->record_size;
+}
+
+int MYRIOTA_AggregatorAdd(MYRIOTA_Aggregator *const aggregator, const void *const record) {
+  AGGREGATOR_ASSERT(aggregator != NULL);
+  AGGREGATOR_ASSERT(record != NULL);
+  int result = FLEX_SUCCESS;
+  if (aggregator->count == aggregator->capacity) {
+    result = aggregator_schedule(aggregator, false);
+  }
+  if (aggregator->count == aggregator->capacity) {
+    aggregator->first = (aggregator->first + 1) % aggregator->capacity;
+    --aggregator->count;
+    ++aggregator->stats.dropped_count;
+  }
+
+  uint8_t *const slot = aggregator_slot(aggregator, aggregator->first + aggregator->count);
+  memcpy(slot, record, aggregator->options.record_size);
+  if (aggregator->options.max_age_s > 0) {
+    const uint32_t time = (uint32_t)FLEX_TimeGet();
+    memcpy(slot + aggregator->options.record_size, &time, sizeof(time));
+  }
+  ++aggregator->count;
+
+  const int schedule_result =
+    aggregator_schedule(aggregator, aggregator_is_due(aggregator, FLEX_TimeGet()));
+  return (result < 0) ? result : schedule_result;
+}
+
+time_t MYRIOTA_AggregatorPoll(MYRIOTA_Aggregator *const aggregator) {
+  AGGREGATOR_ASSERT(aggregator != NULL);
+  aggregator_schedule(aggregator, aggregator_is_due(aggregator, FLEX_TimeGet()));
+  if (aggregator->count == 0 || aggregator->options.max_age_s == 0) {
+    return FLEX_Never();
+  }
+  return aggregator_oldest_time(aggregator) + aggregator->options.max_age_s;
+}
+
+int MYRIOTA_AggregatorFlush(MYRIOTA_Aggregator *const aggregator) {
+  AGGREGATOR_ASSERT(aggregator != NULL);
+  const int result = aggregator_schedule(aggregator, true);
+  return (result < 0) ? result : aggregator->count;
+}
+
+int MYRIOTA_AggregatorSave(MYRIOTA_Aggregator *const aggregator) {
+  AGGREGATOR_ASSERT(aggregator != NULL);
+  const int result = MYRIOTA_AggregatorFlush(aggregator);
+  FLEX_MessageSave();
+  return result;
+}
+
+size_t MYRIOTA_AggregatorCount(const MYRIOTA_Aggregator *const aggregator) {
+  AGGREGATOR_ASSERT(aggregator != NULL);
+  return aggregator->count;
+}
+
+void MYRIOTA_AggregatorStatsGet(const MYRIOTA_Aggregator *const aggregator,
+  MYRIOTA_AggregatorStats *const stats) {
+  AGGREGATOR_ASSERT(aggregator != NULL);
+  AGGREGATOR_ASSERT(stats != NULL);
+  *stats = aggregator->stats;
+}
+
+#ifdef MYRIOTA_AGGREGATOR_UNIT_TESTS
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+/*
+ * `cmocka.h` must be included after standard the above library headers.
+ * NOTE: This comment has dual purpose:
+ * 1. Document the ordering requirement.
+ * 2. Prevent `clang-format` from reordering the headers.
+ */
+#include <cmocka.h>
+#include "myriota/flex_fake.h"
+
+static void fake_setup(MYRIOTA_Aggregator *const aggregator, const uint32_t max_age_s) {
+  MYRIOTA_FlexFakeReset();
+  flex_fake.time = 1000;
+  flex_fake.slots_free = 8;
+  flex_fake.bytes_free = 1024;
+  const MYRIOTA_AggregatorOptions options = {
+    .record_size = 3,
+    .message_size = 20,
+    .max_age_s = max_age_s,
+  };
+  MYRIOTA_AggregatorInit(aggregator, &options);
+}
+
+static void add_reading(MYRIOTA_Aggregator *const aggregator, const uint8_t value) {
+  const uint8_t record[3] = {value, value, value};
+  MYRIOTA_AggregatorAdd(aggregator, record);
+}
+
+static void test_full_messages_and_deadline(void **state) {
+  (void)state;
+  static MYRIOTA_Aggregator aggregator;
+  fake_setup(&aggregator, 3600);
+
+  // Six 3 byte readings fit in a 20 byte message.
+  for (uint8_t i = 0; i < 8; ++i) {
+    flex_fake.time += 60;
+    add_reading(&aggregator, i);
+  }
+  assert_int_equal(flex_fake.message_count, 1);
+  assert_int_equal(flex_fake.message_sizes[0], 18);
+  assert_int_equal(flex_fake.messages[0][15], 5);
+  assert_int_equal(MYRIOTA_AggregatorCount(&aggregator), 2);
+
+  // The partial message is due an hour after its oldest reading.
+  const time_t due = MYRIOTA_AggregatorPoll(&aggregator);
+  assert_int_equal(due, flex_fake.time - 60 + 3600);
+  flex_fake.time = due;
+  assert_int_equal(MYRIOTA_AggregatorPoll(&aggregator), FLEX_Never());
+  assert_int_equal(flex_fake.message_count, 2);
+  assert_int_equal(flex_fake.message_sizes[1], 6);
+  assert_int_equal(flex_fake.messages[1][0], 6);
+}
+
+static void test_full_queue_defers_and_drops(void **state) {
+  (void)state;
+  static MYRIOTA_Aggregator aggregator;
+  fake_setup(&aggregator, 0);
+  flex_fake.slots_free = 0;
+
+  const int capacity = MYRIOTA_AGGREGATOR_RING_SIZE / 3;
+  for (int i = 0; i < capacity + 2; ++i) {
+    add_reading(&aggregator, i);
+  }
+  MYRIOTA_AggregatorStats stats;
+  MYRIOTA_AggregatorStatsGet(&aggregator, &stats);
+  assert_int_equal(flex_fake.message_count, 0);
+  assert_int_equal(stats.dropped_count, 2);
+  assert_true(stats.deferred_count > 0);
+  assert_int_equal(MYRIOTA_AggregatorCount(&aggregator), capacity);
+  assert_int_equal(MYRIOTA_AggregatorPoll(&aggregator), FLEX_Never());
+
+  // Once slots are free the oldest readings are sent first.
+  flex_fake.slots_free = 2;
+  MYRIOTA_AggregatorPoll(&aggregator);
+  assert_int_equal(flex_fake.message_count, 2);
+  assert_int_equal(flex_fake.messages[0][0], 2);
+  assert_int_equal(MYRIOTA_AggregatorCount(&aggregator), capacity - 12);
+
+  flex_fake.slots_free = 6;
+  const int left = MYRIOTA_AggregatorSave(&aggregator);
+  assert_int_equal(flex_fake.save_count, 1);
+  assert_int_equal(left, (capacity - 12) - 6 * 6);
+}
+
+static void test_deadline_after_deferred_send(void **state) {
+  (void)state;
+  static MYRIOTA_Aggregator aggregator;
+  fake_setup(&aggregator, 3600);
+  flex_fake.slots_free = 0;
+
+  // A full message and one more reading wait for the queue.
+  for (uint8_t i = 0; i < 7; ++i) {
+    flex_fake.time += 60;
+    add_reading(&aggregator, i);
+  }
+  assert_int_equal(flex_fake.message_count, 0);
+  assert_int_equal(MYRIOTA_AggregatorPoll(&aggregator), 1000 + 60 + 3600);
+
+  // Sending the full message leaves the seventh reading, which is aged from
+  // when it was added rather than from the send.
+  flex_fake.slots_free = 1;
+  flex_fake.time += 600;
+  assert_int_equal(MYRIOTA_AggregatorPoll(&aggregator), 1000 + 7 * 60 + 3600);
+  assert_int_equal(flex_fake.message_count, 1);
+  assert_int_equal(MYRIOTA_AggregatorCount(&aggregator), 1);
+
+  flex_fake.slots_free = 1;
+  flex_fake.time = 1000 + 7 * 60 + 3600;
+  assert_int_equal(MYRIOTA_AggregatorPoll(&aggregator), FLEX_Never());
+  assert_int_equal(flex_fake.message_count, 2);
+  assert_int_equal(flex_fake.messages[1][0], 6);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_full_messages_and_deadline),
+    cmocka_unit_test(test_full_queue_defers_and_drops),
+    cmocka_unit_test(test_deadline_after_deferred_send),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+#endif /** MYRIOTA_AGGREGATOR_UNIT_TESTS */
@@ -0,0 +1,155 @@
+/// \file bitpack.h Myriota Bit-Packing Serializer
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYRIOTA_BITPACK_H
+#define MYRIOTA_BITPACK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/** \defgroup Bitpack Bit-Packing Serializer
+ * @brief Pack message fields into exactly as many bits as their range needs
+ *
+ * A message schema is an X-macro that lists each field with its bit width,
+ * range and scaling:
+ *
+ * \code
+ * // X(type, name, bits, min, max, scale)
+ * #define WEATHER_SCHEMA(X, T)                                 \
+ *   X(T, sequence_number, 7, 0, 127, 1)                        \
+ *   X(T, latitude, 25, -900000000, 900000000, 100)             \
+ *   X(T, temperature, 11, -400, 800, 1)
+ *
+ * MYRIOTA_BITPACK_DEFINE(WeatherMessage, WEATHER_SCHEMA, 20);
+ * \endcode
+ *
+ * MYRIOTA_BITPACK_DEFINE() declares a struct with an int32_t member per
+ * field, the field table used by the packer and WeatherMessage_SIZE, the
+ * packed size in bytes. It fails to compile if a field's range does not fit
+ * in its bit width, or if the packed size exceeds the payload budget given.
+ *
+ * Each field is encoded as `round((value - min) / scale)`, so values are
+ * quantised to a multiple of `scale` from `min` and values outside
+ * `[min, max]` are saturated. Fields are packed in order, least significant
+ * bit first, with no padding between them.
+ *
+ * \code
+ * WeatherMessage message = {.sequence_number = 5, .latitude = -349284000, .temperature = 231};
+ * uint8_t payload[WeatherMessage_SIZE];
+ * MYRIOTA_BITPACK_PACK(WeatherMessage, &message, payload, sizeof(payload));
+ * FLEX_MessageSchedule(payload, sizeof(payload));
+ * \endcode
+ * \{
+ */
+
+/** Description of a field, generated from the schema by MYRIOTA_BITPACK_DEFINE(). */
+typedef struct {
+  /** The width of the field in bits, from 1 to 32. */
+  uint8_t bits;
+  /** The offset of the int32_t value in the message struct. */
+  uint16_t offset;
+  /** The smallest value of the field. */
+  int32_t min;
+  /** The largest value of the field. */
+  int32_t max;
+  /** The resolution of the field. */
+  uint32_t scale;
+} MYRIOTA_BitpackField;
+
+/** \cond INTERNAL_HIDDEN */
+#define MYRIOTA_BITPACK_MEMBER_(type, name, bits, min, max, scale) int32_t name;
+#define MYRIOTA_BITPACK_BITS_(type, name, bits, min, max, scale) +(bits)
+#define MYRIOTA_BITPACK_FIELD_(type, name, bits, min, max, scale) \
+  {(bits), offsetof(type, name), (min), (max), (scale)},
+#define MYRIOTA_BITPACK_CHECK_(type, name, bits, min, max, scale)                             \
+  _Static_assert((bits) >= 1 && (bits) <= 32 && (min) <= (max) && (scale) > 0 &&             \
+                   ((int64_t)(max) - (min) + (scale) / 2) / (scale) <= (INT64_C(1) << (bits)) - 1, \
+    #type "." #name " does not fit in " #bits " bits");
+/** \endcond */
+
+/** The total number of bits of a schema. */
+#define MYRIOTA_BITPACK_SCHEMA_BITS(SCHEMA) (0 SCHEMA(MYRIOTA_BITPACK_BITS_, _))
+
+/** The packed size of a schema in bytes. */
+#define MYRIOTA_BITPACK_SCHEMA_SIZE(SCHEMA) ((MYRIOTA_BITPACK_SCHEMA_BITS(SCHEMA) + 7) / 8)
+
+/**
+ * Define a message type from a schema, checking at build time that each field
+ * fits in its bit width and that the packed message fits in `budget` bytes.
+ *
+ * Defines the struct `type`, the field table `type##_fields` and the packed
+ * size in bytes `type##_SIZE`.
+ */
+#define MYRIOTA_BITPACK_DEFINE(type, SCHEMA, budget)                                     \
+  typedef struct {                                                                     \
+    SCHEMA(MYRIOTA_BITPACK_MEMBER_, type)                                              \
+  } type;                                                                              \
+  SCHEMA(MYRIOTA_BITPACK_CHECK_, type)                                                 \
+  _Static_assert(MYRIOTA_BITPACK_SCHEMA_SIZE(SCHEMA) <= (budget),                      \
+    #type " does not fit in " #budget " bytes");                                       \
+  enum { type##_SIZE = MYRIOTA_BITPACK_SCHEMA_SIZE(SCHEMA) };                          \
+  static const MYRIOTA_BitpackField type##_fields[] = {SCHEMA(MYRIOTA_BITPACK_FIELD_, type)}
+
+/** Pack a message of a type defined by MYRIOTA_BITPACK_DEFINE(), see MYRIOTA_BitpackPack(). */
+#define MYRIOTA_BITPACK_PACK(type, message, buffer, size)                                  \
+  MYRIOTA_BitpackPack(type##_fields, sizeof(type##_fields) / sizeof(type##_fields[0]), \
+    (const type *)(message), (buffer), (size))
+
+/** Unpack a message of a type defined by MYRIOTA_BITPACK_DEFINE(), see MYRIOTA_BitpackUnpack(). */
+#define MYRIOTA_BITPACK_UNPACK(type, buffer, size, message)                                  \
+  MYRIOTA_BitpackUnpack(type##_fields, sizeof(type##_fields) / sizeof(type##_fields[0]), \
+    (buffer), (size), (type *)(message))
+
+/**
+ * Pack the fields of a message.
+ *
+ * \param[in] fields The fields of the message.
+ * \param[in] count The number of fields.
+ * \param[in] message The message struct to pack the int32_t values of.
+ * \param[out] buffer The buffer to pack the message into.
+ * \param[in] size The size of the buffer in bytes.
+ * \return the packed size in bytes on success, else < 0 on error.
+ * \retval -FLEX_ERROR_ENOBUFS: the buffer is too small.
+ */
+ssize_t MYRIOTA_BitpackPack(const MYRIOTA_BitpackField *const fields, const size_t count,
+  const void *const message, uint8_t *const buffer, const size_t size);
+
+/**
+ * Unpack the fields of a message.
+ *
+ * \param[in] fields The fields of the message.
+ * \param[in] count The number of fields.
+ * \param[in] buffer The packed message.
+ * \param[in] size The size of the packed message in bytes.
+ * \param[out] message The message struct to unpack the int32_t values into.
+ * \return the packed size in bytes on success, else < 0 on error.
+ * \retval -FLEX_ERROR_EBADMSG: the packed message is too short.
+ */
+ssize_t MYRIOTA_BitpackUnpack(const MYRIOTA_BitpackField *const fields, const size_t count,
+  const uint8_t *const buffer, const size_t size, void *const message);
+
+/**
+ * Returns the packed size of a list of fields in bytes.
+ *
+ * \param[in] fields The fields.
+ * \param[in] count The number of fields.
+ */
+size_t MYRIOTA_BitpackSize(const MYRIOTA_BitpackField *const fields, const size_t count);
+
+/**
+ * \}
+ */
+
+#endif /* MYRIOTA_BITPACK_H */
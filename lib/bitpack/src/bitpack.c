@@ -0,0 +1,216 @@
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myriota/bitpack.h"
+#include <string.h>
+#include "flex_errors.h"
+
+// NOTE: you can provide your own assert
+#ifndef BITPACK_ASSERT
+#include <stdio.h>
+#define BITPACK_ASSERT(cond)                         \
+  do {                                               \
+    if (!(cond)) {                                   \
+      printf("Assert @%s:%d\n", __FILE__, __LINE__); \
+      while (1) {                                    \
+      }                                              \
+    }                                                \
+  } while (0)
+#endif
+
+static inline int32_t bitpack_value_get(const void *const message,
+  const MYRIOTA_BitpackField *const field) {
+  int32_t value;
+  memcpy(&value, (const uint8_t *)message + field->offset, sizeof(value));
+  return value;
+}
+
+static inline void bitpack_value_set(void *const message, const MYRIOTA_BitpackField *const field,
+  const int32_t value) {
+  memcpy((uint8_t *)message + field->offset, &value, sizeof(value));
+}
+
+static inline uint32_t bitpack_encode(const MYRIOTA_BitpackField *const field, int32_t value) {
+  value = (value < field->min) ? field->min : value;
+  value = (value > field->max) ? field->max : value;
+  // The difference always fits in a uint32_t, even when it overflows an int32_t.
+  const uint32_t offset = (uint32_t)value - (uint32_t)field->min;
+  // Round half up without overflowing when the range spans most of a uint32_t.
+  return offset / field->scale + (offset % field->scale >= (field->scale + 1) / 2);
+}
+
+static inline int32_t bitpack_decode(const MYRIOTA_BitpackField *const field,
+  const uint32_t code) {
+  return (int32_t)((uint32_t)field->min + code * field->scale);
+}
+
+size_t MYRIOTA_BitpackSize(const MYRIOTA_BitpackField *const fields, const size_t count) {
+  BITPACK_ASSERT(fields != NULL || count == 0);
+  size_t bits = 0;
+  for (size_t i = 0; i < count; ++i) {
+    bits += fields[i].bits;
+  }
+  return (bits + 7) / 8;
+}
+
+ssize_t MYRIOTA_BitpackPack(const MYRIOTA_BitpackField *const fields, const size_t count,
+  const void *const message, uint8_t *const buffer, const size_t size) {
+  BITPACK_ASSERT(message != NULL);
+  BITPACK_ASSERT(buffer != NULL);
+  const size_t packed_size = MYRIOTA_BitpackSize(fields, count);
+  if (size < packed_size) {
+    return -FLEX_ERROR_ENOBUFS;
+  }
+
+  // Whole bytes are flushed after each field, so at most 7 + 32 bits are pending.
+  uint64_t pending = 0;
+  unsigned pending_bits = 0;
+  size_t position = 0;
+  for (size_t i = 0; i < count; ++i) {
+    const MYRIOTA_BitpackField *const field = &fields[i];
+    BITPACK_ASSERT(field->bits >= 1 && field->bits <= 32);
+    pending |= (uint64_t)bitpack_encode(field, bitpack_value_get(message, field)) << pending_bits;
+    pending_bits += field->bits;
+    while (pending_bits >= 8) {
+      buffer[position++] = pending;
+      pending >>= 8;
+      pending_bits -= 8;
+    }
+  }
+  if (pending_bits > 0) {
+    buffer[position++] = pending;
+  }
+  return position;
+}
+
+ssize_t MYRIOTA_BitpackUnpack(const MYRIOTA_BitpackField *const fields, const size_t count,
+  const uint8_t *const buffer, const size_t size, void *const message) {
+  BITPACK_ASSERT(buffer != NULL);
+  BITPACK_ASSERT(message != NULL);
+  const size_t packed_size = MYRIOTA_BitpackSize(fields, count);
+  if (size < packed_size) {
+    return -FLEX_ERROR_EBADMSG;
+  }
+
+  uint64_t pending = 0;
+  unsigned pending_bits = 0;
+  size_t position = 0;
+  for (size_t i = 0; i < count; ++i) {
+    const MYRIOTA_BitpackField *const field = &fields[i];
+    BITPACK_ASSERT(field->bits >= 1 && field->bits <= 32);
+    while (pending_bits < field->bits) {
+      pending |= (uint64_t)buffer[position++] << pending_bits;
+      pending_bits += 8;
+    }
+    const uint32_t code = pending & ((UINT64_C(1) << field->bits) - 1);
+    pending >>= field->bits;
+    pending_bits -= field->bits;
+    bitpack_value_set(message, field, bitpack_decode(field, code));
+  }
+  return packed_size;
+}
+
+#ifdef MYRIOTA_BITPACK_UNIT_TESTS
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+/*
+ * `cmocka.h` must be included after standard the above library headers.
+ * NOTE: This comment has dual purpose:
+ * 1. Document the ordering requirement.
+ * 2. Prevent `clang-format` from reordering the headers.
+ */
+#include <cmocka.h>
+
+#define TEST_SCHEMA(X, T)                                \
+  X(T, sequence_number, 7, 0, 127, 1)                    \
+  X(T, time, 31, 0, INT32_MAX, 1)                        \
+  X(T, latitude, 25, -900000000, 900000000, 100)         \
+  X(T, longitude, 26, -1800000000, 1800000000, 100)      \
+  X(T, temperature, 11, -400, 800, 1)                    \
+  X(T, humidity, 10, 0, 1000, 1)                         \
+  X(T, full, 32, INT32_MIN, INT32_MAX, 1)
+
+MYRIOTA_BITPACK_DEFINE(TestMessage, TEST_SCHEMA, 20);
+
+static void test_round_trip(void **state) {
+  (void)state;
+  assert_int_equal(TestMessage_SIZE, 18);
+  assert_int_equal(MYRIOTA_BitpackSize(TestMessage_fields, 7), TestMessage_SIZE);
+
+  const TestMessage message = {
+    .sequence_number = 99,
+    .time = 1718000000,
+    .latitude = -349284049,
+    .longitude = 1386007251,
+    .temperature = -123,
+    .humidity = 1000,
+    .full = INT32_MIN,
+  };
+  uint8_t payload[TestMessage_SIZE + 1];
+  memset(payload, 0xA5, sizeof(payload));
+  assert_int_equal(MYRIOTA_BITPACK_PACK(TestMessage, &message, payload, sizeof(payload)),
+    TestMessage_SIZE);
+  assert_int_equal(payload[TestMessage_SIZE], 0xA5);
+  // The first byte holds the 7 bit sequence number and the lowest bit of the time.
+  assert_int_equal(payload[0], 99 | ((1718000000 & 1) << 7));
+
+  TestMessage unpacked;
+  assert_int_equal(MYRIOTA_BITPACK_UNPACK(TestMessage, payload, TestMessage_SIZE, &unpacked),
+    TestMessage_SIZE);
+  assert_int_equal(unpacked.sequence_number, 99);
+  assert_int_equal(unpacked.time, 1718000000);
+  assert_int_equal(unpacked.latitude, -349284000);
+  assert_int_equal(unpacked.longitude, 1386007300);
+  assert_int_equal(unpacked.temperature, -123);
+  assert_int_equal(unpacked.humidity, 1000);
+  assert_int_equal(unpacked.full, INT32_MIN);
+
+  assert_int_equal(MYRIOTA_BITPACK_PACK(TestMessage, &message, payload, TestMessage_SIZE - 1),
+    -FLEX_ERROR_ENOBUFS);
+  assert_int_equal(MYRIOTA_BITPACK_UNPACK(TestMessage, payload, TestMessage_SIZE - 1, &unpacked),
+    -FLEX_ERROR_EBADMSG);
+}
+
+static void test_out_of_range_values_saturate(void **state) {
+  (void)state;
+  const TestMessage message = {
+    .sequence_number = 200,
+    .latitude = -900000001,
+    .longitude = 1800000000,
+    .temperature = 900,
+    .humidity = -5,
+    .full = INT32_MAX,
+  };
+  uint8_t payload[TestMessage_SIZE];
+  MYRIOTA_BITPACK_PACK(TestMessage, &message, payload, sizeof(payload));
+  TestMessage unpacked;
+  MYRIOTA_BITPACK_UNPACK(TestMessage, payload, sizeof(payload), &unpacked);
+  assert_int_equal(unpacked.sequence_number, 127);
+  assert_int_equal(unpacked.latitude, -900000000);
+  assert_int_equal(unpacked.longitude, 1800000000);
+  assert_int_equal(unpacked.temperature, 800);
+  assert_int_equal(unpacked.humidity, 0);
+  assert_int_equal(unpacked.full, INT32_MAX);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_round_trip),
+    cmocka_unit_test(test_out_of_range_values_saturate),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+#endif /** MYRIOTA_BITPACK_UNIT_TESTS */
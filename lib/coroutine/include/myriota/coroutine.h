@@ -0,0 +1,272 @@
+/// \file coroutine.h Myriota Coroutines
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYRIOTA_COROUTINE_H
+#define MYRIOTA_COROUTINE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include "flex.h"
+#include "myriota/serial.h"
+
+/** \defgroup Coroutine Coroutines
+ * @brief Run long sensor flows as stackless coroutines from a FlexSense job
+ *
+ * A FlexSense job runs to completion, so a job that waits for a sensor to
+ * warm up with FLEX_DelayMs() or spins on a serial read holds up every other
+ * job. Coroutines are functions that can wait part way through, by returning
+ * to the scheduler and resuming at the same point when the wait is over, so
+ * several sensor flows make progress together and the device sleeps while
+ * they all wait.
+ *
+ * The coroutines of a scheduler are run by one FlexSense job, which never
+ * delays. It runs the coroutines that can continue and is scheduled for the
+ * second the earliest wait ends, or as soon as possible if that is within the
+ * current second, so the other jobs run while the coroutines wait.
+ *
+ * \code
+ * static MYRIOTA_CoroutineScheduler scheduler;
+ * static MYRIOTA_Coroutine level_coroutine;
+ *
+ * static time_t coroutine_job(void) {
+ *   return MYRIOTA_CoroutinePoll(&scheduler);
+ * }
+ *
+ * static MYRIOTA_CoroutineState level_flow(MYRIOTA_Coroutine *const co, void *const context) {
+ *   Level *const level = context;
+ *   MYRIOTA_COROUTINE_BEGIN(co);
+ *   while (true) {
+ *     FLEX_PowerOutInit(FLEX_POWER_OUT_24V);
+ *     MYRIOTA_COROUTINE_AWAIT_MS(co, 1500);
+ *     FLEX_AnalogInputReadCurrent(&level->reading);
+ *     FLEX_PowerOutDeinit();
+ *     MYRIOTA_COROUTINE_AWAIT_MS(co, 3600 * 1000);
+ *   }
+ *   MYRIOTA_COROUTINE_END(co);
+ * }
+ *
+ * void FLEX_AppInit() {
+ *   MYRIOTA_CoroutineSchedulerInit(&scheduler, coroutine_job);
+ *   MYRIOTA_CoroutineStart(&scheduler, &level_coroutine, level_flow, &level);
+ * }
+ * \endcode
+ *
+ * A coroutine resumes with a `switch` on the line it waited at, so its local
+ * variables are not kept across waits, which must be in the function itself
+ * and not inside another `switch`. State that must last across a wait goes in
+ * the context.
+ * \{
+ */
+
+/** The timeout of a wait that never times out. */
+#define MYRIOTA_COROUTINE_FOREVER UINT32_MAX
+
+/** The state returned by a coroutine function. */
+typedef enum {
+  /** The coroutine is waiting. */
+  MYRIOTA_COROUTINE_WAITING,
+  /** The coroutine has finished. */
+  MYRIOTA_COROUTINE_DONE,
+} MYRIOTA_CoroutineState;
+
+typedef struct MYRIOTA_Coroutine MYRIOTA_Coroutine;
+typedef struct MYRIOTA_CoroutineScheduler MYRIOTA_CoroutineScheduler;
+
+/**
+ * A coroutine function, which starts with MYRIOTA_COROUTINE_BEGIN() and ends
+ * with MYRIOTA_COROUTINE_END().
+ *
+ * \param[in,out] co The coroutine.
+ * \param[in] context The context given to MYRIOTA_CoroutineStart().
+ * \return the state of the coroutine, which the macros return.
+ */
+typedef MYRIOTA_CoroutineState (*MYRIOTA_CoroutineFunction)(MYRIOTA_Coroutine *const co,
+  void *const context);
+
+/** \cond INTERNAL_HIDDEN */
+typedef enum {
+  MYRIOTA_COROUTINE_HAS_WAKE = 1 << 0,
+  MYRIOTA_COROUTINE_HAS_DEADLINE = 1 << 1,
+  MYRIOTA_COROUTINE_IS_POLLED = 1 << 2,
+  MYRIOTA_COROUTINE_IS_TIMED_OUT = 1 << 3,
+  MYRIOTA_COROUTINE_IS_RUNNING = 1 << 4,
+} MYRIOTA_CoroutineFlag;
+/** \endcond */
+
+/** A coroutine. Treat the members as private. */
+struct MYRIOTA_Coroutine {
+  /** \cond INTERNAL_HIDDEN */
+  MYRIOTA_Coroutine *next;
+  MYRIOTA_CoroutineScheduler *scheduler;
+  MYRIOTA_CoroutineFunction function;
+  void *context;
+  uint32_t wake;
+  uint32_t deadline;
+  uint32_t events;
+  uint16_t line;
+  uint8_t flags;
+  /** \endcond */
+};
+
+/** A coroutine scheduler. Treat the members as private. */
+struct MYRIOTA_CoroutineScheduler {
+  /** \cond INTERNAL_HIDDEN */
+  FLEX_ScheduledJob job;
+  MYRIOTA_Coroutine *coroutines;
+  volatile uint32_t events;
+  bool is_polling;
+  /** \endcond */
+};
+
+/** \cond INTERNAL_HIDDEN */
+#define MYRIOTA_COROUTINE_RESUME_(co) \
+  (co)->line = __LINE__;              \
+  __attribute__((fallthrough));       \
+  case __LINE__:
+/** \endcond */
+
+/** Starts the body of a coroutine function, resuming it where it last waited. */
+#define MYRIOTA_COROUTINE_BEGIN(co) \
+  switch ((co)->line) {             \
+    case 0:
+
+/** Ends the body of a coroutine function, which finishes the coroutine. */
+#define MYRIOTA_COROUTINE_END(co) \
+  }                               \
+  (co)->line = 0;                 \
+  return MYRIOTA_COROUTINE_DONE
+
+/**
+ * Wait until a condition is true, one of the events is signalled or the
+ * timeout expires.
+ *
+ * \param[in,out] co The coroutine.
+ * \param[in] condition The condition, which is checked first without waiting.
+ * \param[in] timeout_ms The timeout in milliseconds, or MYRIOTA_COROUTINE_FOREVER.
+ * \param[in] is_polled If true, the condition is checked every time the job of
+ * the scheduler runs, which then runs as soon as possible. If false, it is
+ * only checked when the coroutine is otherwise resumed.
+ * \param[in] events The events to wait for, see MYRIOTA_CoroutineSignal().
+ */
+#define MYRIOTA_COROUTINE_AWAIT(co, condition, timeout_ms, is_polled, events) \
+  do {                                                                        \
+    MYRIOTA_CoroutineWaitStart((co), (timeout_ms), (is_polled), (events));    \
+    MYRIOTA_COROUTINE_RESUME_(co)                                             \
+    if (!MYRIOTA_CoroutineWaitDone((co), (condition))) {                      \
+      return MYRIOTA_COROUTINE_WAITING;                                       \
+    }                                                                         \
+  } while (0)
+
+/** Wait for a number of milliseconds. */
+#define MYRIOTA_COROUTINE_AWAIT_MS(co, ms) MYRIOTA_COROUTINE_AWAIT((co), false, (ms), false, 0)
+
+/** Wait until any of the events is signalled, or the timeout expires. The
+ * events that ended the wait are returned by MYRIOTA_CoroutineEvents(). */
+#define MYRIOTA_COROUTINE_AWAIT_EVENT(co, events, timeout_ms) \
+  MYRIOTA_COROUTINE_AWAIT((co), false, (timeout_ms), false, (events))
+
+/** Wait until at least `count` bytes are buffered by a MYRIOTA_Serial, or the
+ * timeout expires, polling the serial interface every time the job runs. */
+#define MYRIOTA_COROUTINE_AWAIT_SERIAL(co, serial, count, timeout_ms)                \
+  MYRIOTA_COROUTINE_AWAIT((co), MYRIOTA_SerialPoll(serial) >= (int)(count), (timeout_ms), \
+    true, 0)
+
+/** Let the other coroutines run before continuing. */
+#define MYRIOTA_COROUTINE_YIELD(co)   \
+  do {                                \
+    (co)->line = __LINE__;            \
+    MYRIOTA_CoroutineYield(co);       \
+    return MYRIOTA_COROUTINE_WAITING; \
+    case __LINE__:;                   \
+  } while (0)
+
+/**
+ * Initializes a coroutine scheduler without coroutines.
+ *
+ * \param[out] scheduler The scheduler to initialize.
+ * \param[in] job The FlexSense job that returns MYRIOTA_CoroutinePoll() of this
+ * scheduler, which the scheduler schedules with FLEX_JobSchedule().
+ */
+void MYRIOTA_CoroutineSchedulerInit(MYRIOTA_CoroutineScheduler *const scheduler,
+  const FLEX_ScheduledJob job);
+
+/**
+ * Start a coroutine, which first runs the next time the scheduler is polled.
+ *
+ * \param[in,out] scheduler The scheduler.
+ * \param[out] co The coroutine, which must stay valid until it finishes.
+ * \param[in] function The coroutine function.
+ * \param[in] context The argument of the function.
+ * \return FLEX_SUCCESS (0) if succeeded and < 0 if failed.
+ * \retval -FLEX_ERROR_EALREADY: the coroutine is running.
+ * Errors of FLEX_JobSchedule() are returned, in which case the coroutine runs
+ * the next time the scheduler is polled.
+ */
+int MYRIOTA_CoroutineStart(MYRIOTA_CoroutineScheduler *const scheduler,
+  MYRIOTA_Coroutine *const co, const MYRIOTA_CoroutineFunction function, void *const context);
+
+/**
+ * Returns true if a coroutine has been started and has not finished.
+ *
+ * \param[in] co The coroutine.
+ */
+bool MYRIOTA_CoroutineIsRunning(const MYRIOTA_Coroutine *const co);
+
+/**
+ * Signal events to the coroutines that await them, e.g. from a pulse counter
+ * or digital I/O wakeup handler. Events stay pending until awaited.
+ *
+ * \param[in,out] scheduler The scheduler.
+ * \param[in] events The bitmask of events defined by the application.
+ * \return FLEX_SUCCESS (0) if succeeded and < 0 if FLEX_JobSchedule() failed.
+ */
+int MYRIOTA_CoroutineSignal(MYRIOTA_CoroutineScheduler *const scheduler, const uint32_t events);
+
+/**
+ * Returns true if the last wait of a coroutine ended because it timed out.
+ *
+ * \param[in] co The coroutine.
+ */
+bool MYRIOTA_CoroutineIsTimedOut(const MYRIOTA_Coroutine *const co);
+
+/**
+ * Returns the events that ended the last wait of a coroutine, or 0 if none did.
+ *
+ * \param[in] co The coroutine.
+ */
+uint32_t MYRIOTA_CoroutineEvents(const MYRIOTA_Coroutine *const co);
+
+/**
+ * Run the coroutines that can continue, from the FlexSense job of the scheduler.
+ *
+ * \param[in,out] scheduler The scheduler.
+ * \return the second the earliest wait ends, FLEX_ASAP() if that is within the
+ * current second or a coroutine is polled, or FLEX_Never() if the coroutines
+ * only wait for events or have all finished.
+ */
+time_t MYRIOTA_CoroutinePoll(MYRIOTA_CoroutineScheduler *const scheduler);
+
+/** \cond INTERNAL_HIDDEN */
+void MYRIOTA_CoroutineWaitStart(MYRIOTA_Coroutine *const co, const uint32_t timeout_ms,
+  const bool is_polled, const uint32_t events);
+bool MYRIOTA_CoroutineWaitDone(MYRIOTA_Coroutine *const co, const bool condition);
+void MYRIOTA_CoroutineYield(MYRIOTA_Coroutine *const co);
+/** \endcond */
+
+/**
+ * \}
+ */
+
+#endif /* MYRIOTA_COROUTINE_H */
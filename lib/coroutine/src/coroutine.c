@@ -0,0 +1,377 @@
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myriota/coroutine.h"
+#include <string.h>
+#include "flex_errors.h"
+
+// NOTE: you can provide your own assert
+#ifndef COROUTINE_ASSERT
+#include <stdio.h>
+#define COROUTINE_ASSERT(cond)                       \
+  do {                                               \
+    if (!(cond)) {                                   \
+      printf("Assert @%s:%d\n", __FILE__, __LINE__); \
+      while (1) {                                    \
+      }                                              \
+    }                                                \
+  } while (0)
+#endif
+
+// Ticks wrap after about 49 days, so they are compared by their difference.
+static inline bool coroutine_tick_reached(const uint32_t now, const uint32_t tick) {
+  return (int32_t)(now - tick) >= 0;
+}
+
+static bool coroutine_is_ready(const MYRIOTA_Coroutine *const co, const uint32_t now) {
+  return (co->flags & MYRIOTA_COROUTINE_IS_POLLED) ||
+         ((co->flags & MYRIOTA_COROUTINE_HAS_WAKE) && coroutine_tick_reached(now, co->wake)) ||
+         (co->events & co->scheduler->events) != 0;
+}
+
+// The time in milliseconds until a coroutine is ready, or UINT32_MAX if it
+// only waits for events.
+static uint32_t coroutine_wait_ms(const MYRIOTA_Coroutine *const co, const uint32_t now) {
+  if (coroutine_is_ready(co, now)) {
+    return 0;
+  }
+  return (co->flags & MYRIOTA_COROUTINE_HAS_WAKE) ? co->wake - now : UINT32_MAX;
+}
+
+void MYRIOTA_CoroutineSchedulerInit(MYRIOTA_CoroutineScheduler *const scheduler,
+  const FLEX_ScheduledJob job) {
+  COROUTINE_ASSERT(scheduler != NULL);
+  COROUTINE_ASSERT(job != NULL);
+  memset(scheduler, 0, sizeof(*scheduler));
+  scheduler->job = job;
+}
+
+int MYRIOTA_CoroutineStart(MYRIOTA_CoroutineScheduler *const scheduler,
+  MYRIOTA_Coroutine *const co, const MYRIOTA_CoroutineFunction function, void *const context) {
+  COROUTINE_ASSERT(scheduler != NULL);
+  COROUTINE_ASSERT(co != NULL);
+  COROUTINE_ASSERT(function != NULL);
+  if (co->flags & MYRIOTA_COROUTINE_IS_RUNNING) {
+    return -FLEX_ERROR_EALREADY;
+  }
+  memset(co, 0, sizeof(*co));
+  co->scheduler = scheduler;
+  co->function = function;
+  co->context = context;
+  co->wake = FLEX_TickGet();
+  co->flags = MYRIOTA_COROUTINE_HAS_WAKE | MYRIOTA_COROUTINE_IS_RUNNING;
+
+  // Coroutines are appended, so that one started by a running coroutine is
+  // safely visited by the poll loop.
+  MYRIOTA_Coroutine **link = &scheduler->coroutines;
+  while (*link != NULL) {
+    link = &(*link)->next;
+  }
+  *link = co;
+
+  if (scheduler->is_polling) {
+    return FLEX_SUCCESS;
+  }
+  return FLEX_JobSchedule(scheduler->job, FLEX_ASAP());
+}
+
+bool MYRIOTA_CoroutineIsRunning(const MYRIOTA_Coroutine *const co) {
+  COROUTINE_ASSERT(co != NULL);
+  return (co->flags & MYRIOTA_COROUTINE_IS_RUNNING) != 0;
+}
+
+int MYRIOTA_CoroutineSignal(MYRIOTA_CoroutineScheduler *const scheduler, const uint32_t events) {
+  COROUTINE_ASSERT(scheduler != NULL);
+  scheduler->events |= events;
+  if (scheduler->is_polling) {
+    return FLEX_SUCCESS;
+  }
+  return FLEX_JobSchedule(scheduler->job, FLEX_ASAP());
+}
+
+bool MYRIOTA_CoroutineIsTimedOut(const MYRIOTA_Coroutine *const co) {
+  COROUTINE_ASSERT(co != NULL);
+  return (co->flags & MYRIOTA_COROUTINE_IS_TIMED_OUT) != 0;
+}
+
+uint32_t MYRIOTA_CoroutineEvents(const MYRIOTA_Coroutine *const co) {
+  COROUTINE_ASSERT(co != NULL);
+  return co->events;
+}
+
+void MYRIOTA_CoroutineWaitStart(MYRIOTA_Coroutine *const co, const uint32_t timeout_ms,
+  const bool is_polled, const uint32_t events) {
+  COROUTINE_ASSERT(co != NULL);
+  co->flags &= MYRIOTA_COROUTINE_IS_RUNNING;
+  if (timeout_ms != MYRIOTA_COROUTINE_FOREVER) {
+    co->flags |= MYRIOTA_COROUTINE_HAS_DEADLINE;
+  }
+  if (is_polled) {
+    co->flags |= MYRIOTA_COROUTINE_IS_POLLED;
+  }
+  co->deadline = FLEX_TickGet() + timeout_ms;
+  co->events = events;
+}
+
+bool MYRIOTA_CoroutineWaitDone(MYRIOTA_Coroutine *const co, const bool condition) {
+  COROUTINE_ASSERT(co != NULL);
+  MYRIOTA_CoroutineScheduler *const scheduler = co->scheduler;
+  co->flags &= ~MYRIOTA_COROUTINE_HAS_WAKE;
+  if (condition) {
+    co->flags &= ~MYRIOTA_COROUTINE_IS_POLLED;
+    co->events = 0;
+    return true;
+  }
+  const uint32_t events = co->events & scheduler->events;
+  if (events != 0) {
+    co->flags &= ~MYRIOTA_COROUTINE_IS_POLLED;
+    scheduler->events &= ~events;
+    co->events = events;
+    return true;
+  }
+  const uint32_t now = FLEX_TickGet();
+  if ((co->flags & MYRIOTA_COROUTINE_HAS_DEADLINE) && coroutine_tick_reached(now, co->deadline)) {
+    co->flags = (co->flags & ~MYRIOTA_COROUTINE_IS_POLLED) | MYRIOTA_COROUTINE_IS_TIMED_OUT;
+    co->events = 0;
+    return true;
+  }
+  if (co->flags & MYRIOTA_COROUTINE_HAS_DEADLINE) {
+    co->flags |= MYRIOTA_COROUTINE_HAS_WAKE;
+    co->wake = co->deadline;
+  }
+  return false;
+}
+
+void MYRIOTA_CoroutineYield(MYRIOTA_Coroutine *const co) {
+  COROUTINE_ASSERT(co != NULL);
+  co->flags &= MYRIOTA_COROUTINE_IS_RUNNING | MYRIOTA_COROUTINE_IS_TIMED_OUT;
+  co->flags |= MYRIOTA_COROUTINE_HAS_WAKE;
+  co->wake = FLEX_TickGet();
+  co->events = 0;
+}
+
+time_t MYRIOTA_CoroutinePoll(MYRIOTA_CoroutineScheduler *const scheduler) {
+  COROUTINE_ASSERT(scheduler != NULL);
+  scheduler->is_polling = true;
+  MYRIOTA_Coroutine **link = &scheduler->coroutines;
+  while (*link != NULL) {
+    MYRIOTA_Coroutine *const co = *link;
+    if (coroutine_is_ready(co, FLEX_TickGet()) &&
+        co->function(co, co->context) == MYRIOTA_COROUTINE_DONE) {
+      *link = co->next;
+      co->next = NULL;
+      co->flags = 0;
+      continue;
+    }
+    link = &co->next;
+  }
+  scheduler->is_polling = false;
+
+  // The waits are measured after every coroutine has run, as one may have
+  // signalled the events of another.
+  uint32_t wait_ms = UINT32_MAX;
+  for (const MYRIOTA_Coroutine *co = scheduler->coroutines; co != NULL; co = co->next) {
+    const uint32_t co_wait_ms = coroutine_wait_ms(co, FLEX_TickGet());
+    wait_ms = (co_wait_ms < wait_ms) ? co_wait_ms : wait_ms;
+  }
+  if (wait_ms == UINT32_MAX) {
+    return FLEX_Never();
+  }
+  // Jobs are scheduled to the second, so a wait that ends within the current
+  // second runs the job again after the other jobs that are due, rather than
+  // delaying inside it.
+  if (wait_ms < 1000) {
+    return FLEX_ASAP();
+  }
+  return FLEX_TimeGet() + (time_t)(wait_ms / 1000);
+}
+
+#ifdef MYRIOTA_COROUTINE_UNIT_TESTS
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+/*
+ * `cmocka.h` must be included after standard the above library headers.
+ * NOTE: This comment has dual purpose:
+ * 1. Document the ordering requirement.
+ * 2. Prevent `clang-format` from reordering the headers.
+ */
+#include <cmocka.h>
+#include "myriota/flex_fake.h"
+
+// The tick the first byte is received at, after which a byte arrives every 10 ms.
+static uint32_t test_serial_tick;
+
+int MYRIOTA_SerialPoll(MYRIOTA_Serial *const serial) {
+  (void)serial;
+  return coroutine_tick_reached(flex_fake.tick, test_serial_tick)
+           ? (int)((flex_fake.tick - test_serial_tick) / 10)
+           : 0;
+}
+
+static MYRIOTA_CoroutineScheduler scheduler;
+
+static time_t coroutine_job(void) {
+  return MYRIOTA_CoroutinePoll(&scheduler);
+}
+
+// Starts the fake at a tick, where the time counts the seconds of the tick.
+static void coroutine_setup(const uint32_t tick) {
+  MYRIOTA_FlexFakeReset();
+  flex_fake.tick = tick;
+  flex_fake.is_time_from_tick = true;
+  test_serial_tick = UINT32_MAX;
+  MYRIOTA_CoroutineSchedulerInit(&scheduler, coroutine_job);
+}
+
+// The time in milliseconds the other jobs take before a job scheduled as soon
+// as possible runs again.
+#define TEST_ASAP_MS 5
+
+// Runs the FlexSense job at the start of the seconds it returns, or after the
+// other jobs if it returns FLEX_ASAP(), returning the number of runs.
+static int run_until_never(time_t next) {
+  int runs = 0;
+  while (next != FLEX_Never()) {
+    if (next == FLEX_ASAP()) {
+      flex_fake.tick += TEST_ASAP_MS;
+    } else {
+      assert_true(next * 1000 > flex_fake.tick);
+      flex_fake.tick = next * 1000;
+    }
+    next = coroutine_job();
+    ++runs;
+  }
+  return runs;
+}
+
+typedef struct {
+  uint32_t warm_up_ms;
+  uint32_t period_ms;
+  int count;
+  uint32_t read_ticks[4];
+} TestSensor;
+
+static MYRIOTA_CoroutineState test_sensor_flow(MYRIOTA_Coroutine *const co, void *const context) {
+  TestSensor *const sensor = context;
+  MYRIOTA_COROUTINE_BEGIN(co);
+  while (sensor->count < 4) {
+    MYRIOTA_COROUTINE_AWAIT_MS(co, sensor->warm_up_ms);
+    sensor->read_ticks[sensor->count++] = flex_fake.tick;
+    MYRIOTA_COROUTINE_AWAIT_MS(co, sensor->period_ms);
+  }
+  MYRIOTA_COROUTINE_END(co);
+}
+
+static void test_await_ms(void **state) {
+  (void)state;
+  coroutine_setup(1000000);
+
+  // Two sensors warm up in parallel, and the device sleeps between readings.
+  static TestSensor level = {.warm_up_ms = 1500, .period_ms = 60000};
+  static TestSensor flow = {.warm_up_ms = 200, .period_ms = 30000};
+  static MYRIOTA_Coroutine level_co, flow_co;
+  assert_int_equal(MYRIOTA_CoroutineStart(&scheduler, &level_co, test_sensor_flow, &level), 0);
+  assert_int_equal(MYRIOTA_CoroutineStart(&scheduler, &flow_co, test_sensor_flow, &flow), 0);
+  assert_int_equal(MYRIOTA_CoroutineStart(&scheduler, &flow_co, test_sensor_flow, &flow),
+    -FLEX_ERROR_EALREADY);
+  assert_ptr_equal(flex_fake.job, coroutine_job);
+  assert_int_equal(flex_fake.job_time, FLEX_ASAP());
+
+  // The warm-ups end within the second, so the job runs again as soon as possible.
+  assert_int_equal(coroutine_job(), FLEX_ASAP());
+  const int runs = run_until_never(FLEX_ASAP());
+  for (int i = 0; i < 4; ++i) {
+    assert_int_equal(level.read_ticks[i], 1000000 + 1500 + i * (60000 + 1500));
+    assert_int_equal(flow.read_ticks[i], 1000000 + 200 + i * (30000 + 200));
+  }
+  assert_false(MYRIOTA_CoroutineIsRunning(&level_co));
+  assert_false(MYRIOTA_CoroutineIsRunning(&flow_co));
+  // The job never delays, and sleeps for whole seconds between readings.
+  assert_int_equal(flex_fake.delay_count, 0);
+  assert_true(runs < 4 * 2 * (1000 / TEST_ASAP_MS));
+}
+
+static MYRIOTA_Serial serial;
+
+typedef struct {
+  uint32_t events;
+  bool is_timed_out;
+  int serial_count;
+  int step;
+} TestWaiter;
+
+static MYRIOTA_CoroutineState test_waiter_flow(MYRIOTA_Coroutine *const co, void *const context) {
+  TestWaiter *const waiter = context;
+  MYRIOTA_COROUTINE_BEGIN(co);
+  MYRIOTA_COROUTINE_AWAIT_EVENT(co, 0x3, 10000);
+  waiter->events = MYRIOTA_CoroutineEvents(co);
+  waiter->step = 1;
+  MYRIOTA_COROUTINE_AWAIT_EVENT(co, 0x1, 5000);
+  waiter->is_timed_out = MYRIOTA_CoroutineIsTimedOut(co);
+  waiter->step = 2;
+  MYRIOTA_COROUTINE_AWAIT_SERIAL(co, &serial, 20, 1000);
+  waiter->serial_count = MYRIOTA_SerialPoll(&serial);
+  waiter->step = 3;
+  MYRIOTA_COROUTINE_YIELD(co);
+  waiter->step = 4;
+  MYRIOTA_COROUTINE_END(co);
+}
+
+static void test_await_events(void **state) {
+  (void)state;
+  coroutine_setup(5000);
+
+  static TestWaiter waiter;
+  static MYRIOTA_Coroutine co;
+  MYRIOTA_CoroutineStart(&scheduler, &co, test_waiter_flow, &waiter);
+  assert_int_equal(coroutine_job(), 5 + 10);
+
+  // A wakeup handler signals an event, which schedules the job.
+  flex_fake.tick = 7000;
+  flex_fake.schedule_count = 0;
+  assert_int_equal(MYRIOTA_CoroutineSignal(&scheduler, 0x6), 0);
+  assert_int_equal(flex_fake.schedule_count, 1);
+  assert_int_equal(flex_fake.job_time, FLEX_ASAP());
+  assert_int_equal(coroutine_job(), 7 + 5);
+  assert_int_equal(waiter.step, 1);
+  assert_int_equal(waiter.events, 0x2);
+
+  // The second wait times out, and the serial wait polls the interface every
+  // time the job runs, without delaying inside it.
+  flex_fake.tick = 12000;
+  test_serial_tick = 12000;
+  assert_int_equal(coroutine_job(), FLEX_ASAP());
+  assert_true(waiter.is_timed_out);
+  assert_int_equal(waiter.step, 2);
+  run_until_never(FLEX_ASAP());
+  assert_int_equal(waiter.step, 4);
+  assert_int_equal(waiter.serial_count, 20);
+  assert_int_equal(flex_fake.tick, 12200 + TEST_ASAP_MS);
+  assert_int_equal(flex_fake.delay_count, 0);
+  assert_false(MYRIOTA_CoroutineIsRunning(&co));
+
+  // Events that were not awaited stay pending.
+  assert_int_equal(scheduler.events, 0x4);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_await_ms),
+    cmocka_unit_test(test_await_events),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+#endif /** MYRIOTA_COROUTINE_UNIT_TESTS */
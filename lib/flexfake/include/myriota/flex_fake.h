@@ -0,0 +1,163 @@
+/// \file flex_fake.h Myriota FlexSense Test Fake
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYRIOTA_FLEX_FAKE_H
+#define MYRIOTA_FLEX_FAKE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "flex.h"
+
+/** \defgroup FlexFake FlexSense Test Fake
+ * @brief A fake of the FlexSense API for the native unit tests of the libraries
+ *
+ * The fake implements the FlexSense functions the libraries call, recording
+ * the calls in #flex_fake for the tests to check and returning the time,
+ * readings and results the tests set there. Tests call MYRIOTA_FlexFakeReset()
+ * before each test case, then set the fields they need.
+ *
+ * Interfaces are checked for balanced use: initialising an interface that is
+ * already initialised, or de-initialising one that is not, fails the test.
+ * \{
+ */
+
+/** The number of scheduled messages the fake keeps. */
+#define MYRIOTA_FLEX_FAKE_MESSAGES 32
+
+/** The maximum size of a scheduled message the fake keeps. */
+#define MYRIOTA_FLEX_FAKE_MESSAGE_SIZE_MAX 64
+
+/** The number of bytes written to the serial interface the fake keeps. */
+#define MYRIOTA_FLEX_FAKE_TX_SIZE 256
+
+/** The maximum length of a diagnostics string the fake keeps. */
+#define MYRIOTA_FLEX_FAKE_DIAG_LEN 256
+
+/** The number of characters printed to the debug console the fake keeps. */
+#define MYRIOTA_FLEX_FAKE_CONSOLE_SIZE 4096
+
+/** The state of the fake. */
+typedef struct {
+  /** The time returned by FLEX_TimeGet(), unless is_time_from_tick is set. */
+  time_t time;
+  /** The tick returned by FLEX_TickGet(), which FLEX_DelayMs() advances. */
+  uint32_t tick;
+  /** If set, FLEX_TimeGet() returns the seconds of the tick. */
+  bool is_time_from_tick;
+  /** The total delay and the number of calls to FLEX_DelayMs(). */
+  uint32_t delay_ms;
+  int delay_count;
+  /** If set, called by FLEX_DelayMs() after the tick has advanced. */
+  void (*on_delay)(uint32_t ms);
+
+  /** The last job scheduled by FLEX_JobSchedule(), and the number of calls. */
+  FLEX_ScheduledJob job;
+  time_t job_time;
+  int schedule_count;
+  /** If < 0, returned by FLEX_JobSchedule() instead of scheduling the job. */
+  int schedule_result;
+
+  /** The message queue, where each scheduled message takes a slot and its size in bytes. */
+  int slots_free;
+  size_t bytes_free;
+  uint8_t messages[MYRIOTA_FLEX_FAKE_MESSAGES][MYRIOTA_FLEX_FAKE_MESSAGE_SIZE_MAX];
+  size_t message_sizes[MYRIOTA_FLEX_FAKE_MESSAGES];
+  int message_count;
+  /** If < 0, returned by FLEX_MessageSchedule() instead of scheduling the message. */
+  int message_result;
+  /** The number of calls to FLEX_MessageSave(). */
+  int save_count;
+
+  /** The power output, where power_out_result < 0 is returned by FLEX_PowerOutInit(). */
+  bool is_power_out;
+  FLEX_PowerOut power_out;
+  int power_out_count;
+  int power_out_result;
+
+  /** The analog input, and the number of times it was initialised. */
+  bool is_analog_in;
+  FLEX_AnalogInputMode analog_in_mode;
+  int analog_in_count;
+  /** If set, returns the value of each analog reading, else readings are 0. */
+  uint32_t (*analog_read)(void);
+  /** If < 0, returned by the analog reads instead of a reading. */
+  int analog_read_result;
+  /** The number of current and voltage readings. */
+  int current_count;
+  int voltage_count;
+
+  /** The serial interface, and the number of times it was initialised. */
+  bool is_serial;
+  FLEX_SerialExOptions serial;
+  int serial_count;
+  /**
+   * The bytes read from the serial interface, where byte i can be read once
+   * the tick reaches rx_tick[i], or at once if rx_tick is NULL. A read returns
+   * at most rx_read_max bytes if it is not 0.
+   */
+  const uint8_t *rx;
+  const uint32_t *rx_tick;
+  size_t rx_size;
+  size_t rx_pos;
+  size_t rx_read_max;
+  int read_count;
+  /** The bytes written to the serial interface. */
+  uint8_t tx[MYRIOTA_FLEX_FAKE_TX_SIZE];
+  size_t tx_size;
+
+  /** The pulse counter and its limit. */
+  bool is_pulse_counter;
+  uint32_t pulse_limit;
+
+  /** The battery voltage, which reads 0 on external power. */
+  int32_t battery_mv;
+  bool is_on_external_power;
+
+  /** The module ID returned by FLEX_ModuleIDGet(). */
+  const char *module_id;
+
+  /** The last diagnostics value written as a string, and its ID. */
+  FLEX_DiagConfID diag_id;
+  char diag[MYRIOTA_FLEX_FAKE_DIAG_LEN];
+
+  /** What was printed to the debug console by the last capture, as a string. */
+  char console[MYRIOTA_FLEX_FAKE_CONSOLE_SIZE];
+} MYRIOTA_FlexFake;
+
+/** The state of the fake, which tests set and check directly. */
+extern MYRIOTA_FlexFake flex_fake;
+
+/**
+ * Resets the fake to a time and tick of 0, no initialised interfaces and an
+ * empty message queue with MYRIOTA_FLEX_FAKE_MESSAGES free slots.
+ */
+void MYRIOTA_FlexFakeReset(void);
+
+/**
+ * Start capturing what is printed to the debug console, which is stdout on
+ * the host, instead of printing it.
+ */
+void MYRIOTA_FlexFakeConsoleBegin(void);
+
+/**
+ * Stop capturing the debug console, leaving what was printed in
+ * flex_fake.console, cut off at MYRIOTA_FLEX_FAKE_CONSOLE_SIZE - 1 characters.
+ */
+void MYRIOTA_FlexFakeConsoleEnd(void);
+
+/** \} */
+
+#endif  // MYRIOTA_FLEX_FAKE_H
@@ -0,0 +1,245 @@
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myriota/flex_fake.h"
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+/*
+ * `cmocka.h` must be included after standard the above library headers.
+ * NOTE: This comment has dual purpose:
+ * 1. Document the ordering requirement.
+ * 2. Prevent `clang-format` from reordering the headers.
+ */
+#include <cmocka.h>
+
+MYRIOTA_FlexFake flex_fake;
+
+// The file stdout is redirected to while the console is captured, and the
+// descriptor of the original stdout.
+static FILE *console_file;
+static int console_stdout = -1;
+
+void MYRIOTA_FlexFakeReset(void) {
+  if (console_file != NULL) {
+    MYRIOTA_FlexFakeConsoleEnd();
+  }
+  memset(&flex_fake, 0, sizeof(flex_fake));
+  flex_fake.slots_free = MYRIOTA_FLEX_FAKE_MESSAGES;
+  flex_fake.bytes_free = MYRIOTA_FLEX_FAKE_MESSAGES * MYRIOTA_FLEX_FAKE_MESSAGE_SIZE_MAX;
+  flex_fake.module_id = "";
+}
+
+void MYRIOTA_FlexFakeConsoleBegin(void) {
+  assert_null(console_file);
+  fflush(stdout);
+  console_file = tmpfile();
+  assert_non_null(console_file);
+  console_stdout = dup(STDOUT_FILENO);
+  assert_true(console_stdout >= 0);
+  assert_true(dup2(fileno(console_file), STDOUT_FILENO) >= 0);
+}
+
+void MYRIOTA_FlexFakeConsoleEnd(void) {
+  assert_non_null(console_file);
+  fflush(stdout);
+  dup2(console_stdout, STDOUT_FILENO);
+  close(console_stdout);
+  console_stdout = -1;
+  rewind(console_file);
+  const size_t length = fread(flex_fake.console, 1, sizeof(flex_fake.console) - 1, console_file);
+  flex_fake.console[length] = '\0';
+  fclose(console_file);
+  console_file = NULL;
+}
+
+time_t FLEX_TimeGet(void) {
+  return flex_fake.is_time_from_tick ? (time_t)(flex_fake.tick / 1000) : flex_fake.time;
+}
+
+uint32_t FLEX_TickGet(void) {
+  return flex_fake.tick;
+}
+
+time_t FLEX_ASAP(void) {
+  return 0;
+}
+
+time_t FLEX_Never(void) {
+  return (time_t)-1;
+}
+
+void FLEX_DelayMs(const uint32_t mSec) {
+  flex_fake.tick += mSec;
+  flex_fake.delay_ms += mSec;
+  ++flex_fake.delay_count;
+  if (flex_fake.on_delay != NULL) {
+    flex_fake.on_delay(mSec);
+  }
+}
+
+int FLEX_JobSchedule(const FLEX_ScheduledJob Job, const time_t Time) {
+  if (flex_fake.schedule_result < 0) {
+    return flex_fake.schedule_result;
+  }
+  flex_fake.job = Job;
+  flex_fake.job_time = Time;
+  ++flex_fake.schedule_count;
+  return 0;
+}
+
+int FLEX_MessageSchedule(const uint8_t *const Message, const size_t MessageSize) {
+  if (flex_fake.message_result < 0) {
+    return flex_fake.message_result;
+  }
+  assert_true(flex_fake.slots_free > 0 && flex_fake.bytes_free >= MessageSize);
+  assert_true(flex_fake.message_count < MYRIOTA_FLEX_FAKE_MESSAGES);
+  assert_true(MessageSize <= MYRIOTA_FLEX_FAKE_MESSAGE_SIZE_MAX);
+  memcpy(flex_fake.messages[flex_fake.message_count], Message, MessageSize);
+  flex_fake.message_sizes[flex_fake.message_count++] = MessageSize;
+  --flex_fake.slots_free;
+  flex_fake.bytes_free -= MessageSize;
+  return 0;
+}
+
+int FLEX_MessageSlotsFree(void) {
+  return flex_fake.slots_free;
+}
+
+size_t FLEX_MessageBytesFree(void) {
+  return flex_fake.bytes_free;
+}
+
+void FLEX_MessageSave(void) {
+  ++flex_fake.save_count;
+}
+
+int FLEX_PowerOutInit(const FLEX_PowerOut Voltage) {
+  if (flex_fake.power_out_result < 0) {
+    return flex_fake.power_out_result;
+  }
+  assert_false(flex_fake.is_power_out);
+  flex_fake.is_power_out = true;
+  flex_fake.power_out = Voltage;
+  ++flex_fake.power_out_count;
+  return 0;
+}
+
+int FLEX_PowerOutDeinit(void) {
+  assert_true(flex_fake.is_power_out);
+  flex_fake.is_power_out = false;
+  return 0;
+}
+
+int FLEX_AnalogInputInit(const FLEX_AnalogInputMode InputMode) {
+  assert_false(flex_fake.is_analog_in);
+  flex_fake.is_analog_in = true;
+  flex_fake.analog_in_mode = InputMode;
+  ++flex_fake.analog_in_count;
+  return 0;
+}
+
+int FLEX_AnalogInputDeinit(void) {
+  assert_true(flex_fake.is_analog_in);
+  flex_fake.is_analog_in = false;
+  return 0;
+}
+
+int FLEX_AnalogInputReadCurrent(uint32_t *const pMicroAmps) {
+  if (flex_fake.analog_read_result < 0) {
+    return flex_fake.analog_read_result;
+  }
+  ++flex_fake.current_count;
+  *pMicroAmps = (flex_fake.analog_read != NULL) ? flex_fake.analog_read() : 0;
+  return 0;
+}
+
+int FLEX_AnalogInputReadVoltage(uint32_t *const pMilliVolts) {
+  if (flex_fake.analog_read_result < 0) {
+    return flex_fake.analog_read_result;
+  }
+  ++flex_fake.voltage_count;
+  *pMilliVolts = (flex_fake.analog_read != NULL) ? flex_fake.analog_read() : 0;
+  return 0;
+}
+
+int FLEX_SerialInitEx(const FLEX_SerialExOptions Options) {
+  assert_false(flex_fake.is_serial);
+  flex_fake.is_serial = true;
+  flex_fake.serial = Options;
+  ++flex_fake.serial_count;
+  return 0;
+}
+
+int FLEX_SerialDeinit(void) {
+  assert_true(flex_fake.is_serial);
+  flex_fake.is_serial = false;
+  return 0;
+}
+
+int FLEX_SerialWrite(const uint8_t *Tx, size_t Length) {
+  assert_true(flex_fake.tx_size + Length <= sizeof(flex_fake.tx));
+  memcpy(&flex_fake.tx[flex_fake.tx_size], Tx, Length);
+  flex_fake.tx_size += Length;
+  return 0;
+}
+
+int FLEX_SerialRead(uint8_t *Rx, size_t Length) {
+  ++flex_fake.read_count;
+  if (flex_fake.rx_read_max != 0 && Length > flex_fake.rx_read_max) {
+    Length = flex_fake.rx_read_max;
+  }
+  size_t count = 0;
+  while (count < Length && flex_fake.rx_pos < flex_fake.rx_size &&
+         (flex_fake.rx_tick == NULL || flex_fake.rx_tick[flex_fake.rx_pos] <= flex_fake.tick)) {
+    Rx[count++] = flex_fake.rx[flex_fake.rx_pos++];
+  }
+  return count;
+}
+
+int FLEX_PulseCounterInit(const uint32_t Limit, const uint32_t Options) {
+  (void)Options;
+  assert_false(flex_fake.is_pulse_counter);
+  flex_fake.is_pulse_counter = true;
+  flex_fake.pulse_limit = Limit;
+  return 0;
+}
+
+void FLEX_PulseCounterDeinit(void) {
+  assert_true(flex_fake.is_pulse_counter);
+  flex_fake.is_pulse_counter = false;
+}
+
+int FLEX_GetBatteryVoltage(int32_t *const VoltageMilliVolts) {
+  *VoltageMilliVolts = flex_fake.is_on_external_power ? 0 : flex_fake.battery_mv;
+  return 0;
+}
+
+int FLEX_IsOnExternalPower(bool *const IsOnExternalPower) {
+  *IsOnExternalPower = flex_fake.is_on_external_power;
+  return 0;
+}
+
+const char *FLEX_ModuleIDGet(void) {
+  return flex_fake.module_id;
+}
+
+int FLEX_DiagConfValueWrite(const FLEX_DiagConfID id, const void *const value) {
+  flex_fake.diag_id = id;
+  strncpy(flex_fake.diag, value, sizeof(flex_fake.diag) - 1);
+  return 0;
+}
@@ -0,0 +1,196 @@
+/// \file governor.h Myriota Battery Governor
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYRIOTA_GOVERNOR_H
+#define MYRIOTA_GOVERNOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include "flex.h"
+
+/** \defgroup Governor Battery Governor
+ * @brief Adapt the periods of jobs to the battery and external power
+ *
+ * Jobs register a nominal period, the energy of a run and a priority. On
+ * external power, e.g. mains or solar, jobs run at their fastest period. On
+ * battery, the governor estimates the energy the battery has left from its
+ * voltage, and spreads it over the rest of the target lifetime. If the jobs
+ * at their nominal periods would use more than that budget, their periods are
+ * stretched, lower priorities first, until they fit the budget or reach
+ * their longest period.
+ *
+ * Periods change without resetting the phase of a job, which keeps running
+ * at the times of its previous runs plus its period.
+ *
+ * \code
+ * static MYRIOTA_Governor governor;
+ * static MYRIOTA_GovernorJob level_job;
+ *
+ * static time_t read_level(void) {
+ *   ...
+ *   return MYRIOTA_GovernorNext(&governor, &level_job);
+ * }
+ *
+ * static void on_external_power(const bool *const is_on_external_power) {
+ *   MYRIOTA_GovernorExternalPowerSet(&governor, *is_on_external_power);
+ * }
+ *
+ * void FLEX_AppInit() {
+ *   const MYRIOTA_GovernorOptions options = {
+ *     .empty_mv = 6000,
+ *     .full_mv = 7200,
+ *     .capacity_j = 250000,
+ *     .idle_uw = 150,
+ *     .lifetime_days = 5 * 365,
+ *     .update_period_s = 3600,
+ *   };
+ *   MYRIOTA_GovernorInit(&governor, &options);
+ *   const MYRIOTA_GovernorJobOptions level_options = {
+ *     .job = read_level,
+ *     .period_s = 3600,
+ *     .min_period_s = 600,
+ *     .max_period_s = 6 * 3600,
+ *     .energy_mj = 900,
+ *     .priority = 1,
+ *   };
+ *   MYRIOTA_GovernorRegister(&governor, &level_job, &level_options);
+ *   FLEX_OnExternalPowerHandlerSet(on_external_power);
+ * }
+ * \endcode
+ * \{
+ */
+
+/** Configuration of a governor. */
+typedef struct {
+  /** The battery voltage in millivolts when the battery is empty. */
+  int32_t empty_mv;
+  /** The battery voltage in millivolts when the battery is full. */
+  int32_t full_mv;
+  /** The energy of a full battery in joules. */
+  uint32_t capacity_j;
+  /** The power in microwatts the device uses apart from the jobs. */
+  uint32_t idle_uw;
+  /** The target lifetime of the battery in days from MYRIOTA_GovernorInit(). */
+  uint32_t lifetime_days;
+  /** The interval in seconds of reading the battery, or 0 to read it only
+   * with MYRIOTA_GovernorUpdate(). */
+  uint32_t update_period_s;
+} MYRIOTA_GovernorOptions;
+
+/** Configuration of a job run by a governor. */
+typedef struct {
+  /** The FlexSense job, which returns MYRIOTA_GovernorNext(). */
+  FLEX_ScheduledJob job;
+  /** The nominal period in seconds, used on battery while within the budget. */
+  uint32_t period_s;
+  /** The period in seconds on external power, or 0 for the nominal period. */
+  uint32_t min_period_s;
+  /** The longest period in seconds on battery, or 0 to never stretch the period. */
+  uint32_t max_period_s;
+  /** The energy of a run of the job in millijoules. */
+  uint32_t energy_mj;
+  /** The priority, where the periods of jobs with higher priorities are
+   * stretched less. */
+  uint8_t priority;
+} MYRIOTA_GovernorJobOptions;
+
+/** A job run by a governor. Treat the members as private. */
+typedef struct MYRIOTA_GovernorJob {
+  /** \cond INTERNAL_HIDDEN */
+  struct MYRIOTA_GovernorJob *next;
+  MYRIOTA_GovernorJobOptions options;
+  uint32_t period_s;
+  time_t previous;
+  time_t scheduled;
+  /** \endcond */
+} MYRIOTA_GovernorJob;
+
+/** A governor. Treat the members as private. */
+typedef struct {
+  /** \cond INTERNAL_HIDDEN */
+  MYRIOTA_GovernorOptions options;
+  time_t end_time;
+  time_t update_time;
+  int32_t battery_mv;
+  bool is_on_external_power;
+  MYRIOTA_GovernorJob *jobs;
+  /** \endcond */
+} MYRIOTA_Governor;
+
+/**
+ * Initializes a governor without jobs, and reads the battery.
+ *
+ * \param[out] governor The governor to initialize.
+ * \param[in] options The configuration of the governor.
+ */
+void MYRIOTA_GovernorInit(MYRIOTA_Governor *const governor,
+  const MYRIOTA_GovernorOptions *const options);
+
+/**
+ * Register a job with a governor and schedule it to run as soon as possible.
+ *
+ * \param[in,out] governor The governor.
+ * \param[out] job The governed job, which must stay valid while the governor is used.
+ * \param[in] options The configuration of the job, which is copied.
+ * \return FLEX_SUCCESS (0) if succeeded and < 0 if FLEX_JobSchedule() failed.
+ */
+int MYRIOTA_GovernorRegister(MYRIOTA_Governor *const governor, MYRIOTA_GovernorJob *const job,
+  const MYRIOTA_GovernorJobOptions *const options);
+
+/**
+ * Returns the time a job should next run, which is its return value. Reads the
+ * battery if `update_period_s` has passed since it was last read.
+ *
+ * \param[in,out] governor The governor.
+ * \param[in,out] job The governed job that is running.
+ * \return the time of the previous run of the job plus its current period,
+ * skipping any runs that were missed.
+ */
+time_t MYRIOTA_GovernorNext(MYRIOTA_Governor *const governor, MYRIOTA_GovernorJob *const job);
+
+/**
+ * Read the battery voltage and external power state and update the periods of
+ * the jobs, which take effect from their next run.
+ *
+ * \param[in,out] governor The governor.
+ * \return FLEX_SUCCESS (0) if succeeded and < 0 if reading the battery failed,
+ * in which case the last reading is kept.
+ */
+int MYRIOTA_GovernorUpdate(MYRIOTA_Governor *const governor);
+
+/**
+ * Set the external power state, e.g. from the handler set with
+ * FLEX_OnExternalPowerHandlerSet(), and reschedule the jobs for the times of
+ * their previous runs plus their new periods.
+ *
+ * \param[in,out] governor The governor.
+ * \param[in] is_on_external_power Whether the device is on external power.
+ * \return FLEX_SUCCESS (0) if succeeded and < 0 if FLEX_JobSchedule() failed.
+ */
+int MYRIOTA_GovernorExternalPowerSet(MYRIOTA_Governor *const governor,
+  const bool is_on_external_power);
+
+/**
+ * Returns the current period of a job in seconds.
+ *
+ * \param[in] job The governed job.
+ */
+uint32_t MYRIOTA_GovernorPeriodGet(const MYRIOTA_GovernorJob *const job);
+
+/**
+ * \}
+ */
+
+#endif /* MYRIOTA_GOVERNOR_H */
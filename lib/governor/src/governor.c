@@ -0,0 +1,359 @@
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myriota/governor.h"
+#include <string.h>
+#include "flex_errors.h"
+
+// NOTE: you can provide your own assert
+#ifndef GOVERNOR_ASSERT
+#include <stdio.h>
+#define GOVERNOR_ASSERT(cond)                        \
+  do {                                               \
+    if (!(cond)) {                                   \
+      printf("Assert @%s:%d\n", __FILE__, __LINE__); \
+      while (1) {                                    \
+      }                                              \
+    }                                                \
+  } while (0)
+#endif
+
+#define GOVERNOR_DAY_S (24 * 3600)
+// The number of bisections of the stretch, which is then within 2^-20 of the budget.
+#define GOVERNOR_BISECTIONS 20
+
+// The stretch of the period of a job for the stretch level `k`, where
+// higher priorities stretch more slowly, up to the longest period.
+static float governor_stretch(const MYRIOTA_GovernorJob *const job, const float k) {
+  const MYRIOTA_GovernorJobOptions *const options = &job->options;
+  if (options->max_period_s <= options->period_s) {
+    return 1.0f;
+  }
+  const float stretch = 1.0f + k / (1.0f + options->priority);
+  const float max = (float)options->max_period_s / options->period_s;
+  return (stretch < max) ? stretch : max;
+}
+
+// The power in milliwatts the jobs use for the stretch level `k`.
+static float governor_demand_mw(const MYRIOTA_Governor *const governor, const float k) {
+  float demand_mw = 0.0f;
+  for (const MYRIOTA_GovernorJob *job = governor->jobs; job != NULL; job = job->next) {
+    demand_mw += job->options.energy_mj / (job->options.period_s * governor_stretch(job, k));
+  }
+  return demand_mw;
+}
+
+// The power in milliwatts the jobs may use, which spreads the energy left in
+// the battery over the rest of the lifetime.
+static float governor_budget_mw(const MYRIOTA_Governor *const governor) {
+  const MYRIOTA_GovernorOptions *const options = &governor->options;
+  float charge = 1.0f;
+  if (options->full_mv > options->empty_mv) {
+    charge = (float)(governor->battery_mv - options->empty_mv) /
+             (float)(options->full_mv - options->empty_mv);
+    charge = (charge < 0.0f) ? 0.0f : (charge > 1.0f) ? 1.0f : charge;
+  }
+  const time_t remaining = governor->end_time - FLEX_TimeGet();
+  const float remaining_s = (remaining > GOVERNOR_DAY_S) ? (float)remaining : GOVERNOR_DAY_S;
+  return options->capacity_j * 1000.0f * charge / remaining_s - options->idle_uw / 1000.0f;
+}
+
+// Sets the periods of the jobs for the current battery and external power.
+static void governor_periods(MYRIOTA_Governor *const governor) {
+  float k = 0.0f;
+  if (!governor->is_on_external_power) {
+    const float budget_mw = governor_budget_mw(governor);
+    if (governor_demand_mw(governor, 0.0f) > budget_mw) {
+      // The stretch level at which every job is at its longest period.
+      float high = 0.0f;
+      for (const MYRIOTA_GovernorJob *job = governor->jobs; job != NULL; job = job->next) {
+        const MYRIOTA_GovernorJobOptions *const options = &job->options;
+        if (options->max_period_s > options->period_s) {
+          const float level = ((float)options->max_period_s / options->period_s - 1.0f) *
+                              (1.0f + options->priority);
+          high = (level > high) ? level : high;
+        }
+      }
+      float low = 0.0f;
+      for (int i = 0; i < GOVERNOR_BISECTIONS; ++i) {
+        const float middle = (low + high) / 2;
+        if (governor_demand_mw(governor, middle) > budget_mw) {
+          low = middle;
+        } else {
+          high = middle;
+        }
+      }
+      k = high;
+    }
+  }
+
+  for (MYRIOTA_GovernorJob *job = governor->jobs; job != NULL; job = job->next) {
+    const MYRIOTA_GovernorJobOptions *const options = &job->options;
+    if (governor->is_on_external_power) {
+      job->period_s = (options->min_period_s != 0) ? options->min_period_s : options->period_s;
+    } else {
+      job->period_s = (uint32_t)(options->period_s * governor_stretch(job, k) + 0.5f);
+    }
+  }
+}
+
+// Reschedules the jobs that are waiting for their next run for the time of
+// their previous run plus their period, or the last such time that has passed.
+static int governor_reschedule(MYRIOTA_Governor *const governor) {
+  const time_t now = FLEX_TimeGet();
+  int result = FLEX_SUCCESS;
+  for (MYRIOTA_GovernorJob *job = governor->jobs; job != NULL; job = job->next) {
+    if (job->scheduled <= now) {
+      continue;
+    }
+    time_t time = job->previous + job->period_s;
+    if (time <= now) {
+      time = job->previous + (now - job->previous) / job->period_s * job->period_s;
+    }
+    const int schedule_result = FLEX_JobSchedule(job->options.job, time);
+    if (schedule_result < 0) {
+      result = schedule_result;
+      continue;
+    }
+    job->scheduled = time;
+  }
+  return result;
+}
+
+void MYRIOTA_GovernorInit(MYRIOTA_Governor *const governor,
+  const MYRIOTA_GovernorOptions *const options) {
+  GOVERNOR_ASSERT(governor != NULL);
+  GOVERNOR_ASSERT(options != NULL);
+  memset(governor, 0, sizeof(*governor));
+  governor->options = *options;
+  governor->end_time = FLEX_TimeGet() + (time_t)options->lifetime_days * GOVERNOR_DAY_S;
+  governor->battery_mv = options->full_mv;
+  MYRIOTA_GovernorUpdate(governor);
+}
+
+int MYRIOTA_GovernorRegister(MYRIOTA_Governor *const governor, MYRIOTA_GovernorJob *const job,
+  const MYRIOTA_GovernorJobOptions *const options) {
+  GOVERNOR_ASSERT(governor != NULL);
+  GOVERNOR_ASSERT(job != NULL);
+  GOVERNOR_ASSERT(options != NULL);
+  GOVERNOR_ASSERT(options->job != NULL);
+  GOVERNOR_ASSERT(options->period_s > 0);
+  memset(job, 0, sizeof(*job));
+  job->options = *options;
+  job->previous = FLEX_TimeGet();
+  job->scheduled = job->previous;
+  job->next = governor->jobs;
+  governor->jobs = job;
+  governor_periods(governor);
+  return FLEX_JobSchedule(options->job, FLEX_ASAP());
+}
+
+time_t MYRIOTA_GovernorNext(MYRIOTA_Governor *const governor, MYRIOTA_GovernorJob *const job) {
+  GOVERNOR_ASSERT(governor != NULL);
+  GOVERNOR_ASSERT(job != NULL);
+  const time_t now = FLEX_TimeGet();
+  const uint32_t update_period_s = governor->options.update_period_s;
+  if (update_period_s != 0 && now - governor->update_time >= (time_t)update_period_s) {
+    MYRIOTA_GovernorUpdate(governor);
+  }
+
+  // The phase is kept by counting periods from the time the job was scheduled for.
+  job->previous = job->scheduled;
+  time_t time = job->previous + job->period_s;
+  if (time <= now) {
+    time += ((now - time) / job->period_s + 1) * job->period_s;
+  }
+  job->scheduled = time;
+  return time;
+}
+
+int MYRIOTA_GovernorUpdate(MYRIOTA_Governor *const governor) {
+  GOVERNOR_ASSERT(governor != NULL);
+  governor->update_time = FLEX_TimeGet();
+  bool is_on_external_power = false;
+  int result = FLEX_IsOnExternalPower(&is_on_external_power);
+  if (result < 0) {
+    return result;
+  }
+  // The battery voltage reads 0 on external power.
+  if (!is_on_external_power) {
+    int32_t battery_mv = 0;
+    result = FLEX_GetBatteryVoltage(&battery_mv);
+    if (result < 0) {
+      return result;
+    }
+    governor->battery_mv = battery_mv;
+  }
+  if (is_on_external_power != governor->is_on_external_power) {
+    return MYRIOTA_GovernorExternalPowerSet(governor, is_on_external_power);
+  }
+  governor_periods(governor);
+  return FLEX_SUCCESS;
+}
+
+int MYRIOTA_GovernorExternalPowerSet(MYRIOTA_Governor *const governor,
+  const bool is_on_external_power) {
+  GOVERNOR_ASSERT(governor != NULL);
+  governor->is_on_external_power = is_on_external_power;
+  governor_periods(governor);
+  return governor_reschedule(governor);
+}
+
+uint32_t MYRIOTA_GovernorPeriodGet(const MYRIOTA_GovernorJob *const job) {
+  GOVERNOR_ASSERT(job != NULL);
+  return job->period_s;
+}
+
+#ifdef MYRIOTA_GOVERNOR_UNIT_TESTS
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+/*
+ * `cmocka.h` must be included after standard the above library headers.
+ * NOTE: This comment has dual purpose:
+ * 1. Document the ordering requirement.
+ * 2. Prevent `clang-format` from reordering the headers.
+ */
+#include <cmocka.h>
+#include "myriota/flex_fake.h"
+
+static MYRIOTA_Governor governor;
+static MYRIOTA_GovernorJob level_job, flow_job;
+
+static time_t level_run(void) {
+  return MYRIOTA_GovernorNext(&governor, &level_job);
+}
+
+static time_t flow_run(void) {
+  return MYRIOTA_GovernorNext(&governor, &flow_job);
+}
+
+// A battery of 1000 J, which lasts its target lifetime of 10 days at 1.16 mW.
+static const MYRIOTA_GovernorOptions options = {
+  .empty_mv = 6000,
+  .full_mv = 7000,
+  .capacity_j = 1000,
+  .idle_uw = 0,
+  .lifetime_days = 10,
+  .update_period_s = 3600,
+};
+
+// Jobs that use 0.5 mW each at their nominal periods.
+static const MYRIOTA_GovernorJobOptions level_options = {
+  .job = level_run,
+  .period_s = 600,
+  .min_period_s = 60,
+  .max_period_s = 3600,
+  .energy_mj = 300,
+  .priority = 0,
+};
+
+static const MYRIOTA_GovernorJobOptions flow_options = {
+  .job = flow_run,
+  .period_s = 600,
+  .max_period_s = 3600,
+  .energy_mj = 300,
+  .priority = 3,
+};
+
+static void governor_setup(const int32_t battery_mv) {
+  MYRIOTA_FlexFakeReset();
+  flex_fake.time = 100000;
+  flex_fake.battery_mv = battery_mv;
+  MYRIOTA_GovernorInit(&governor, &options);
+  assert_int_equal(MYRIOTA_GovernorRegister(&governor, &level_job, &level_options), 0);
+  assert_int_equal(MYRIOTA_GovernorRegister(&governor, &flow_job, &flow_options), 0);
+  assert_ptr_equal(flex_fake.job, flow_run);
+  assert_int_equal(flex_fake.job_time, FLEX_ASAP());
+}
+
+static void test_within_budget(void **state) {
+  (void)state;
+  governor_setup(7000);
+  assert_int_equal(MYRIOTA_GovernorPeriodGet(&level_job), 600);
+  assert_int_equal(MYRIOTA_GovernorPeriodGet(&flow_job), 600);
+
+  // The job keeps its phase, skipping runs that were missed.
+  assert_int_equal(level_run(), 100000 + 600);
+  flex_fake.time = 100000 + 600 + 5;
+  assert_int_equal(level_run(), 100000 + 1200);
+  flex_fake.time = 100000 + 3000;
+  assert_int_equal(level_run(), 100000 + 3600);
+}
+
+static void test_low_battery(void **state) {
+  (void)state;
+  // Half the charge for the whole lifetime, so the jobs must use 0.58 mW in place of 1 mW.
+  governor_setup(6500);
+  const float budget_mw = 1000 * 1000.0f * 0.5f / (10 * 86400);
+  const uint32_t level_period = MYRIOTA_GovernorPeriodGet(&level_job);
+  const uint32_t flow_period = MYRIOTA_GovernorPeriodGet(&flow_job);
+  assert_true(level_period > flow_period);
+  assert_true(flow_period > 600);
+  const float demand_mw = 300.0f / level_period + 300.0f / flow_period;
+  assert_true(demand_mw <= budget_mw * 1.01f);
+  assert_true(demand_mw >= budget_mw * 0.99f);
+
+  // An empty battery stretches every job to its longest period.
+  flex_fake.battery_mv = 5900;
+  assert_int_equal(MYRIOTA_GovernorUpdate(&governor), 0);
+  assert_int_equal(MYRIOTA_GovernorPeriodGet(&level_job), 3600);
+  assert_int_equal(MYRIOTA_GovernorPeriodGet(&flow_job), 3600);
+
+  // The battery is read again by a job after the update period.
+  flex_fake.battery_mv = 7000;
+  flex_fake.time += 1800;
+  level_run();
+  assert_int_equal(MYRIOTA_GovernorPeriodGet(&flow_job), 3600);
+  flex_fake.time += 1800;
+  level_run();
+  assert_int_equal(MYRIOTA_GovernorPeriodGet(&flow_job), 600);
+}
+
+static void test_external_power(void **state) {
+  (void)state;
+  governor_setup(7000);
+  assert_int_equal(level_run(), 100000 + 600);
+  assert_int_equal(flow_run(), 100000 + 600);
+
+  // Jobs waiting for their next run are rescheduled keeping their phase.
+  flex_fake.time = 100000 + 150;
+  flex_fake.schedule_count = 0;
+  flex_fake.is_on_external_power = true;
+  assert_int_equal(MYRIOTA_GovernorExternalPowerSet(&governor, true), 0);
+  assert_int_equal(MYRIOTA_GovernorPeriodGet(&level_job), 60);
+  assert_int_equal(MYRIOTA_GovernorPeriodGet(&flow_job), 600);
+  assert_int_equal(flex_fake.schedule_count, 2);
+  assert_ptr_equal(flex_fake.job, level_run);
+  assert_int_equal(flex_fake.job_time, 100000 + 120);
+  assert_int_equal(level_run(), 100000 + 180);
+
+  // Back on battery.
+  flex_fake.is_on_external_power = false;
+  assert_int_equal(MYRIOTA_GovernorUpdate(&governor), 0);
+  assert_int_equal(MYRIOTA_GovernorPeriodGet(&level_job), 600);
+  assert_ptr_equal(flex_fake.job, level_run);
+  assert_int_equal(flex_fake.job_time, 100000 + 120 + 600);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_within_budget),
+    cmocka_unit_test(test_low_battery),
+    cmocka_unit_test(test_external_power),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+#endif /** MYRIOTA_GOVERNOR_UNIT_TESTS */
@@ -0,0 +1,175 @@
+/// \file location.h Myriota Relative Location Codec
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYRIOTA_LOCATION_H
+#define MYRIOTA_LOCATION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/** \defgroup Location Relative Location Codec
+ * @brief Encode a location in a few bits relative to an anchor
+ *
+ * Locations from FLEX_LastLocationAndLastFixTime() or FLEX_GNSSFix() take 8
+ * bytes as two int32_t values, although most assets are stationary or only
+ * move a few kilometres. This codec quantises a location to a chosen precision
+ * and encodes it relative to an anchor location that is sent in full from
+ * time to time:
+ *
+ * | Encoding | Bits | Used when |
+ * | -------- | ---- | --------- |
+ * | unchanged | 4 | the location is the anchor at the chosen precision |
+ * | near | 21 | within 127 units of the anchor |
+ * | far | 30 | within 2047 units of the anchor |
+ * | anchor | 6 + 43 at 10 m | else, and every `anchor_interval` locations |
+ *
+ * Every encoding carries a 3 bit tag of its anchor, which counts the anchors
+ * sent, so a location is decoded against its own anchor even when messages
+ * are lost or arrive out of order.
+ *
+ * Locations are written into a message at a bit offset, so they can follow
+ * other fields without padding, e.g. the fields packed by MYRIOTA_BITPACK_PACK():
+ *
+ * \code
+ * static MYRIOTA_LocationEncoder encoder;
+ * const MYRIOTA_LocationOptions options = {
+ *   .precision = MYRIOTA_LOCATION_PRECISION_M(10),
+ *   .anchor_interval = 16,
+ * };
+ * MYRIOTA_LocationEncoderInit(&encoder, &options);
+ *
+ * int32_t latitude, longitude;
+ * FLEX_LastLocationAndLastFixTime(&latitude, &longitude, NULL);
+ * const ssize_t bits = MYRIOTA_LocationEncode(&encoder, latitude, longitude, payload,
+ *   sizeof(payload), MYRIOTA_BITPACK_SCHEMA_BITS(MESSAGE_SCHEMA));
+ * \endcode
+ *
+ * The decoder keeps the anchors of the latest tag and the three before it. A
+ * location relative to an anchor that was lost, or has not arrived yet, is
+ * not decoded, and `anchor_interval` bounds how many locations one lost anchor
+ * costs. An anchor that arrives up to three anchors late is still used. Only
+ * if four or more anchors in a row are lost can a location be decoded against
+ * an older anchor with the same tag.
+ * \{
+ */
+
+/** The precision, in units of 1e-7 degrees, that is about the given number of metres. */
+#define MYRIOTA_LOCATION_PRECISION_M(metres) ((uint32_t)(metres) * 90)
+
+/** The number of bits of the anchor tag of every encoded location. */
+#define MYRIOTA_LOCATION_TAG_BITS 3
+
+/** The number of anchor tags, which count the anchors sent. */
+#define MYRIOTA_LOCATION_ANCHORS (1 << MYRIOTA_LOCATION_TAG_BITS)
+
+/** The largest number of bits of an encoded location, which is an anchor at a
+ * precision of 1. */
+#define MYRIOTA_LOCATION_MAX_BITS (3 + MYRIOTA_LOCATION_TAG_BITS + 31 + 32)
+
+/** Configuration of a location encoder or decoder, which must match. */
+typedef struct {
+  /** The precision in units of 1e-7 degrees, see MYRIOTA_LOCATION_PRECISION_M(). */
+  uint32_t precision;
+  /** Send the anchor every `anchor_interval` locations, or 0 to only send it
+   * when the location moves too far from the anchor. */
+  uint16_t anchor_interval;
+} MYRIOTA_LocationOptions;
+
+/** \cond INTERNAL_HIDDEN */
+typedef struct {
+  bool is_valid;
+  int32_t latitude;
+  int32_t longitude;
+} MYRIOTA_LocationAnchor;
+/** \endcond */
+
+/** A location encoder or decoder. Treat the members as private. */
+typedef struct {
+  /** \cond INTERNAL_HIDDEN */
+  MYRIOTA_LocationOptions options;
+  uint8_t latitude_bits;
+  uint8_t longitude_bits;
+  uint8_t tag;
+  uint16_t since_anchor;
+  MYRIOTA_LocationAnchor anchors[MYRIOTA_LOCATION_ANCHORS];
+  /** \endcond */
+} MYRIOTA_LocationCodec;
+
+/** A location encoder. Treat the members as private. */
+typedef MYRIOTA_LocationCodec MYRIOTA_LocationEncoder;
+
+/** A location decoder. Treat the members as private. */
+typedef MYRIOTA_LocationCodec MYRIOTA_LocationDecoder;
+
+/**
+ * Initializes an encoder, which sends an anchor first.
+ *
+ * \param[out] encoder The encoder to initialize.
+ * \param[in] options The configuration, where `precision` must be at least 1.
+ */
+void MYRIOTA_LocationEncoderInit(MYRIOTA_LocationEncoder *const encoder,
+  const MYRIOTA_LocationOptions *const options);
+
+/**
+ * Encode a location into a buffer at a bit offset, filling each byte from the
+ * least significant bit. Bits of the buffer before the offset are unchanged.
+ *
+ * \param[in,out] encoder The encoder.
+ * \param[in] latitude The latitude in degrees multiplied by 1e7.
+ * \param[in] longitude The longitude in degrees multiplied by 1e7.
+ * \param[out] buffer The buffer to encode the location into.
+ * \param[in] size The size of the buffer in bytes.
+ * \param[in] bit_offset The bit to encode the location from.
+ * \return the number of bits written on success, else < 0 on error.
+ * \retval -FLEX_ERROR_ENOBUFS: the buffer is too small, the encoder is unchanged.
+ */
+ssize_t MYRIOTA_LocationEncode(MYRIOTA_LocationEncoder *const encoder, const int32_t latitude,
+  const int32_t longitude, uint8_t *const buffer, const size_t size, const size_t bit_offset);
+
+/**
+ * Initializes a decoder, which needs the anchor of a location before it can
+ * decode the location.
+ *
+ * \param[out] decoder The decoder to initialize.
+ * \param[in] options The configuration of the encoder.
+ */
+void MYRIOTA_LocationDecoderInit(MYRIOTA_LocationDecoder *const decoder,
+  const MYRIOTA_LocationOptions *const options);
+
+/**
+ * Decode a location from a buffer at a bit offset.
+ *
+ * \param[in,out] decoder The decoder.
+ * \param[in] buffer The encoded message.
+ * \param[in] size The size of the encoded message in bytes.
+ * \param[in] bit_offset The bit the location was encoded from.
+ * \param[out] latitude The latitude in degrees multiplied by 1e7.
+ * \param[out] longitude The longitude in degrees multiplied by 1e7.
+ * \return the number of bits read on success, else < 0 on error.
+ * \retval -FLEX_ERROR_EBADMSG: the message is truncated.
+ * \retval -FLEX_ERROR_ENODATA: the location is relative to an anchor that was not
+ * decoded, which a decoder that receives messages out of order can retry after
+ * the anchor.
+ */
+ssize_t MYRIOTA_LocationDecode(MYRIOTA_LocationDecoder *const decoder,
+  const uint8_t *const buffer, const size_t size, const size_t bit_offset,
+  int32_t *const latitude, int32_t *const longitude);
+
+/**
+ * \}
+ */
+
+#endif /* MYRIOTA_LOCATION_H */
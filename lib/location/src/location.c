@@ -0,0 +1,449 @@
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myriota/location.h"
+#include <string.h>
+#include "flex_errors.h"
+
+// NOTE: you can provide your own assert
+#ifndef LOCATION_ASSERT
+#include <stdio.h>
+#define LOCATION_ASSERT(cond)                        \
+  do {                                               \
+    if (!(cond)) {                                   \
+      printf("Assert @%s:%d\n", __FILE__, __LINE__); \
+      while (1) {                                    \
+      }                                              \
+    }                                                \
+  } while (0)
+#endif
+
+#define LOCATION_LATITUDE_MAX 900000000
+#define LOCATION_LONGITUDE_MAX 1800000000
+#define LOCATION_NEAR_BITS 8
+#define LOCATION_FAR_BITS 12
+
+typedef enum {
+  LOCATION_UNCHANGED,
+  LOCATION_NEAR,
+  LOCATION_FAR,
+  LOCATION_ANCHOR,
+} LocationEncoding;
+
+// The prefix of each encoding, written from the least significant bit.
+static const struct {
+  uint8_t code;
+  uint8_t bits;
+} location_prefixes[] = {
+  [LOCATION_UNCHANGED] = {0x0, 1},
+  [LOCATION_NEAR] = {0x1, 2},
+  [LOCATION_FAR] = {0x3, 3},
+  [LOCATION_ANCHOR] = {0x7, 3},
+};
+
+static inline uint8_t location_width(const uint32_t max_code) {
+  return 32 - __builtin_clz(max_code | 1);
+}
+
+static inline uint32_t zigzag_encode(const int32_t value) {
+  return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static inline int32_t zigzag_decode(const uint32_t value) {
+  return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+// Rounds to the nearest multiple of the precision, half away from zero.
+static int32_t location_quantize(const int32_t value, const uint32_t precision) {
+  const int64_t magnitude = ((value < 0 ? -(int64_t)value : value) + precision / 2) / precision;
+  return (value < 0) ? -magnitude : magnitude;
+}
+
+static inline int32_t location_longitude_max(const MYRIOTA_LocationCodec *const codec) {
+  return location_quantize(LOCATION_LONGITUDE_MAX, codec->options.precision);
+}
+
+// Wraps a quantised longitude or longitude difference into (-max, max].
+static int32_t location_wrap(const MYRIOTA_LocationCodec *const codec, int64_t longitude) {
+  const int64_t max = location_longitude_max(codec);
+  while (longitude > max) {
+    longitude -= 2 * max;
+  }
+  while (longitude <= -max) {
+    longitude += 2 * max;
+  }
+  return longitude;
+}
+
+static void location_write(uint8_t *const buffer, size_t *const position, const uint32_t value,
+  const uint8_t bits) {
+  for (uint8_t i = 0; i < bits; ++i, ++*position) {
+    const uint8_t mask = 1U << (*position % 8);
+    if ((value >> i) & 1) {
+      buffer[*position / 8] |= mask;
+    } else {
+      buffer[*position / 8] &= ~mask;
+    }
+  }
+}
+
+static bool location_read(const uint8_t *const buffer, const size_t size, size_t *const position,
+  const uint8_t bits, uint32_t *const value) {
+  if (*position + bits > size * 8) {
+    return false;
+  }
+  *value = 0;
+  for (uint8_t i = 0; i < bits; ++i, ++*position) {
+    *value |= (uint32_t)((buffer[*position / 8] >> (*position % 8)) & 1) << i;
+  }
+  return true;
+}
+
+static void location_codec_init(MYRIOTA_LocationCodec *const codec,
+  const MYRIOTA_LocationOptions *const options) {
+  LOCATION_ASSERT(codec != NULL);
+  LOCATION_ASSERT(options != NULL);
+  LOCATION_ASSERT(options->precision > 0);
+  memset(codec, 0, sizeof(*codec));
+  codec->options = *options;
+  codec->latitude_bits =
+    location_width(2 * location_quantize(LOCATION_LATITUDE_MAX, options->precision));
+  codec->longitude_bits = location_width(2 * (uint32_t)location_longitude_max(codec) - 1);
+}
+
+static inline MYRIOTA_LocationAnchor *location_anchor(MYRIOTA_LocationCodec *const codec,
+  const uint32_t tag) {
+  return &codec->anchors[tag % MYRIOTA_LOCATION_ANCHORS];
+}
+
+void MYRIOTA_LocationEncoderInit(MYRIOTA_LocationEncoder *const encoder,
+  const MYRIOTA_LocationOptions *const options) {
+  location_codec_init(encoder, options);
+}
+
+void MYRIOTA_LocationDecoderInit(MYRIOTA_LocationDecoder *const decoder,
+  const MYRIOTA_LocationOptions *const options) {
+  location_codec_init(decoder, options);
+}
+
+ssize_t MYRIOTA_LocationEncode(MYRIOTA_LocationEncoder *const encoder, const int32_t latitude,
+  const int32_t longitude, uint8_t *const buffer, const size_t size, const size_t bit_offset) {
+  LOCATION_ASSERT(encoder != NULL);
+  LOCATION_ASSERT(buffer != NULL);
+  const uint32_t precision = encoder->options.precision;
+  const int32_t quantized_latitude = location_quantize(latitude, precision);
+  const int32_t quantized_longitude =
+    location_wrap(encoder, location_quantize(longitude, precision));
+
+  const MYRIOTA_LocationAnchor *const anchor = location_anchor(encoder, encoder->tag);
+  const uint32_t latitude_delta = zigzag_encode(quantized_latitude - anchor->latitude);
+  const uint32_t longitude_delta =
+    zigzag_encode(location_wrap(encoder, (int64_t)quantized_longitude - anchor->longitude));
+  const uint32_t largest_delta = (latitude_delta > longitude_delta) ? latitude_delta :
+                                                                      longitude_delta;
+
+  LocationEncoding encoding = LOCATION_ANCHOR;
+  uint8_t delta_bits = 0;
+  if (anchor->is_valid && (encoder->options.anchor_interval == 0 ||
+                             encoder->since_anchor + 1 < encoder->options.anchor_interval)) {
+    if (largest_delta == 0) {
+      encoding = LOCATION_UNCHANGED;
+    } else if (largest_delta < (1U << LOCATION_NEAR_BITS)) {
+      encoding = LOCATION_NEAR;
+      delta_bits = LOCATION_NEAR_BITS;
+    } else if (largest_delta < (1U << LOCATION_FAR_BITS)) {
+      encoding = LOCATION_FAR;
+      delta_bits = LOCATION_FAR_BITS;
+    }
+  }
+
+  const size_t bits = location_prefixes[encoding].bits + MYRIOTA_LOCATION_TAG_BITS +
+                      ((encoding == LOCATION_ANCHOR) ?
+                          encoder->latitude_bits + encoder->longitude_bits :
+                          2 * delta_bits);
+  if (bit_offset + bits > size * 8) {
+    return -FLEX_ERROR_ENOBUFS;
+  }
+
+  // A new anchor takes the next tag, so relative locations name their anchor.
+  const uint8_t tag = (encoding == LOCATION_ANCHOR) ? (encoder->tag + 1) % MYRIOTA_LOCATION_ANCHORS
+                                                    : encoder->tag;
+  size_t position = bit_offset;
+  location_write(buffer, &position, location_prefixes[encoding].code,
+    location_prefixes[encoding].bits);
+  location_write(buffer, &position, tag, MYRIOTA_LOCATION_TAG_BITS);
+  if (encoding == LOCATION_ANCHOR) {
+    const int32_t latitude_max = location_quantize(LOCATION_LATITUDE_MAX, precision);
+    location_write(buffer, &position, quantized_latitude + latitude_max, encoder->latitude_bits);
+    location_write(buffer, &position,
+      (uint32_t)quantized_longitude + (uint32_t)location_longitude_max(encoder) - 1,
+      encoder->longitude_bits);
+    MYRIOTA_LocationAnchor *const new_anchor = location_anchor(encoder, tag);
+    new_anchor->is_valid = true;
+    new_anchor->latitude = quantized_latitude;
+    new_anchor->longitude = quantized_longitude;
+    encoder->tag = tag;
+    encoder->since_anchor = 0;
+  } else {
+    location_write(buffer, &position, latitude_delta, delta_bits);
+    location_write(buffer, &position, longitude_delta, delta_bits);
+    ++encoder->since_anchor;
+  }
+  return bits;
+}
+
+// The decoder keeps the anchors of the latest tag and the three before it. A
+// newer anchor moves the window and drops the anchors that fall out of it,
+// which are older anchors of the tags about to be reused. An anchor that
+// arrives late, or again, leaves the window as it is.
+static void location_decoder_window(MYRIOTA_LocationDecoder *const decoder, const uint32_t tag) {
+  bool has_anchor = false;
+  for (uint32_t i = 0; i < MYRIOTA_LOCATION_ANCHORS; ++i) {
+    has_anchor |= decoder->anchors[i].is_valid;
+  }
+  const uint32_t ahead = (tag - decoder->tag) % MYRIOTA_LOCATION_ANCHORS;
+  if (has_anchor && (ahead == 0 || ahead > MYRIOTA_LOCATION_ANCHORS / 2)) {
+    return;
+  }
+  for (uint32_t i = 1; i <= MYRIOTA_LOCATION_ANCHORS / 2; ++i) {
+    location_anchor(decoder, tag + i)->is_valid = false;
+  }
+  decoder->tag = tag;
+}
+
+ssize_t MYRIOTA_LocationDecode(MYRIOTA_LocationDecoder *const decoder,
+  const uint8_t *const buffer, const size_t size, const size_t bit_offset,
+  int32_t *const latitude, int32_t *const longitude) {
+  LOCATION_ASSERT(decoder != NULL);
+  LOCATION_ASSERT(buffer != NULL);
+  LOCATION_ASSERT(latitude != NULL);
+  LOCATION_ASSERT(longitude != NULL);
+  size_t position = bit_offset;
+  uint32_t bit = 0;
+  uint8_t ones = 0;
+  // The prefix is up to three one bits terminated by a zero bit.
+  while (ones < 3) {
+    if (!location_read(buffer, size, &position, 1, &bit)) {
+      return -FLEX_ERROR_EBADMSG;
+    }
+    if (bit == 0) {
+      break;
+    }
+    ++ones;
+  }
+
+  uint32_t tag;
+  if (!location_read(buffer, size, &position, MYRIOTA_LOCATION_TAG_BITS, &tag)) {
+    return -FLEX_ERROR_EBADMSG;
+  }
+  MYRIOTA_LocationAnchor *const anchor = location_anchor(decoder, tag);
+
+  const uint32_t precision = decoder->options.precision;
+  if (ones == LOCATION_ANCHOR) {
+    uint32_t latitude_code, longitude_code;
+    if (!location_read(buffer, size, &position, decoder->latitude_bits, &latitude_code) ||
+        !location_read(buffer, size, &position, decoder->longitude_bits, &longitude_code)) {
+      return -FLEX_ERROR_EBADMSG;
+    }
+    location_decoder_window(decoder, tag);
+    anchor->is_valid = true;
+    anchor->latitude = (int32_t)latitude_code - location_quantize(LOCATION_LATITUDE_MAX, precision);
+    anchor->longitude = (int32_t)(longitude_code - (uint32_t)location_longitude_max(decoder) + 1);
+  }
+
+  int32_t quantized_latitude = anchor->latitude;
+  int32_t quantized_longitude = anchor->longitude;
+  if (ones == LOCATION_NEAR || ones == LOCATION_FAR) {
+    const uint8_t delta_bits = (ones == LOCATION_NEAR) ? LOCATION_NEAR_BITS : LOCATION_FAR_BITS;
+    uint32_t latitude_delta, longitude_delta;
+    if (!location_read(buffer, size, &position, delta_bits, &latitude_delta) ||
+        !location_read(buffer, size, &position, delta_bits, &longitude_delta)) {
+      return -FLEX_ERROR_EBADMSG;
+    }
+    quantized_latitude += zigzag_decode(latitude_delta);
+    quantized_longitude =
+      location_wrap(decoder, (int64_t)quantized_longitude + zigzag_decode(longitude_delta));
+  }
+  if (!anchor->is_valid) {
+    return -FLEX_ERROR_ENODATA;
+  }
+
+  *latitude = (int64_t)quantized_latitude * precision;
+  *longitude = (int64_t)quantized_longitude * precision;
+  return position - bit_offset;
+}
+
+#ifdef MYRIOTA_LOCATION_UNIT_TESTS
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+/*
+ * `cmocka.h` must be included after standard the above library headers.
+ * NOTE: This comment has dual purpose:
+ * 1. Document the ordering requirement.
+ * 2. Prevent `clang-format` from reordering the headers.
+ */
+#include <cmocka.h>
+
+static const MYRIOTA_LocationOptions test_options = {
+  .precision = MYRIOTA_LOCATION_PRECISION_M(10),
+  .anchor_interval = 4,
+};
+
+// Encodes then decodes a location after a 5 bit field, returning the encoded bits.
+static ssize_t round_trip(MYRIOTA_LocationEncoder *const encoder,
+  MYRIOTA_LocationDecoder *const decoder, const int32_t latitude, const int32_t longitude) {
+  uint8_t buffer[10];
+  memset(buffer, 0xFF, sizeof(buffer));
+  const ssize_t bits =
+    MYRIOTA_LocationEncode(encoder, latitude, longitude, buffer, sizeof(buffer), 5);
+  assert_true(bits > 0);
+  assert_int_equal(buffer[0] & 0x1F, 0x1F);
+
+  int32_t decoded_latitude, decoded_longitude;
+  assert_int_equal(MYRIOTA_LocationDecode(decoder, buffer, (5 + bits + 7) / 8, 5,
+                     &decoded_latitude, &decoded_longitude),
+    bits);
+  assert_in_range(decoded_latitude, latitude - 450, latitude + 450);
+  assert_in_range((int64_t)decoded_longitude, (int64_t)longitude - 450, (int64_t)longitude + 450);
+  return bits;
+}
+
+static void test_encodings(void **state) {
+  (void)state;
+  MYRIOTA_LocationEncoder encoder;
+  MYRIOTA_LocationDecoder decoder;
+  MYRIOTA_LocationEncoderInit(&encoder, &test_options);
+  MYRIOTA_LocationDecoderInit(&decoder, &test_options);
+
+  // Adelaide, then within 10 m, about 1 km and about 15 km away.
+  assert_int_equal(round_trip(&encoder, &decoder, -349284000, 1386007000), 6 + 21 + 22);
+  assert_int_equal(round_trip(&encoder, &decoder, -349284100, 1386007200), 1 + 3);
+  assert_int_equal(round_trip(&encoder, &decoder, -349374000, 1386007000), 5 + 2 * 8);
+  assert_int_equal(round_trip(&encoder, &decoder, -349284000, 1387357000), 6 + 2 * 12);
+
+  // The anchor is sent again after the interval, and when too far away.
+  assert_int_equal(round_trip(&encoder, &decoder, -349284000, 1386007000), 6 + 21 + 22);
+  assert_int_equal(round_trip(&encoder, &decoder, -339284000, 1386007000), 6 + 21 + 22);
+  assert_int_equal(round_trip(&encoder, &decoder, -339284000, 1386007000), 1 + 3);
+}
+
+static void test_extremes(void **state) {
+  (void)state;
+  MYRIOTA_LocationEncoder encoder;
+  MYRIOTA_LocationDecoder decoder;
+  MYRIOTA_LocationEncoderInit(&encoder, &test_options);
+  MYRIOTA_LocationDecoderInit(&decoder, &test_options);
+
+  // Crossing the antimeridian is a small difference.
+  round_trip(&encoder, &decoder, 900000000, 1799999000);
+  assert_int_equal(round_trip(&encoder, &decoder, 900000000, -1799999000), 5 + 2 * 8);
+  round_trip(&encoder, &decoder, -900000000, 0);
+
+  // The finest precision uses every bit.
+  const MYRIOTA_LocationOptions options = {.precision = 1};
+  MYRIOTA_LocationEncoderInit(&encoder, &options);
+  MYRIOTA_LocationDecoderInit(&decoder, &options);
+  assert_int_equal(round_trip(&encoder, &decoder, 900000000, 1800000000),
+    MYRIOTA_LOCATION_MAX_BITS);
+  assert_int_equal(round_trip(&encoder, &decoder, 899999999, 1799999999), 5 + 2 * 8);
+}
+
+static void test_errors(void **state) {
+  (void)state;
+  MYRIOTA_LocationEncoder encoder;
+  MYRIOTA_LocationDecoder decoder;
+  MYRIOTA_LocationEncoderInit(&encoder, &test_options);
+  MYRIOTA_LocationDecoderInit(&decoder, &test_options);
+
+  uint8_t buffer[7] = {0};
+  int32_t latitude, longitude;
+  assert_int_equal(MYRIOTA_LocationEncode(&encoder, 0, 0, buffer, 7, 8), -FLEX_ERROR_ENOBUFS);
+  assert_int_equal(MYRIOTA_LocationEncode(&encoder, 0, 0, buffer, 7, 0), 49);
+  assert_int_equal(MYRIOTA_LocationDecode(&decoder, buffer, 6, 0, &latitude, &longitude),
+    -FLEX_ERROR_EBADMSG);
+}
+
+static void test_lost_and_reordered(void **state) {
+  (void)state;
+  MYRIOTA_LocationEncoder encoder;
+  MYRIOTA_LocationDecoder decoder;
+  MYRIOTA_LocationEncoderInit(&encoder, &test_options);
+  MYRIOTA_LocationDecoderInit(&decoder, &test_options);
+
+  // Two anchors, each followed by a location 1 km away.
+  uint8_t messages[4][8] = {{0}};
+  const int32_t latitudes[4] = {-349284000, -349374000, -339284000, -339374000};
+  for (int i = 0; i < 4; ++i) {
+    assert_true(MYRIOTA_LocationEncode(&encoder, latitudes[i], 1386007000, messages[i],
+                  sizeof(messages[i]), 0) > 0);
+  }
+
+  // The first anchor is lost, so its location cannot be decoded, rather than
+  // being decoded against the other anchor.
+  int32_t latitude, longitude;
+  assert_true(MYRIOTA_LocationDecode(&decoder, messages[2], 8, 0, &latitude, &longitude) > 0);
+  assert_int_equal(MYRIOTA_LocationDecode(&decoder, messages[1], 8, 0, &latitude, &longitude),
+    -FLEX_ERROR_ENODATA);
+
+  // A location that arrives before its anchor is decoded once the anchor arrives.
+  assert_true(MYRIOTA_LocationDecode(&decoder, messages[3], 8, 0, &latitude, &longitude) > 0);
+  assert_in_range(latitude, latitudes[3] - 450, latitudes[3] + 450);
+  assert_true(MYRIOTA_LocationDecode(&decoder, messages[0], 8, 0, &latitude, &longitude) > 0);
+  assert_true(MYRIOTA_LocationDecode(&decoder, messages[1], 8, 0, &latitude, &longitude) > 0);
+  assert_in_range(latitude, latitudes[1] - 450, latitudes[1] + 450);
+
+  // Once newer anchors move past its tag, the anchor is dropped so that the
+  // locations of a later anchor with the same tag are not decoded against it.
+  uint8_t message[8];
+  for (int i = 0; i < 3; ++i) {
+    assert_true(MYRIOTA_LocationEncode(&encoder, i * 100000000, 0, message, 8, 0) > 0);
+  }
+  assert_true(MYRIOTA_LocationDecode(&decoder, message, 8, 0, &latitude, &longitude) > 0);
+  assert_int_equal(MYRIOTA_LocationDecode(&decoder, messages[1], 8, 0, &latitude, &longitude),
+    -FLEX_ERROR_ENODATA);
+}
+
+// The bytes of an anchor and a near location, to check host decoders against.
+static void test_host_vector(void **state) {
+  (void)state;
+  MYRIOTA_LocationEncoder encoder;
+  MYRIOTA_LocationEncoderInit(&encoder, &test_options);
+  uint8_t buffer[7] = {0};
+  assert_int_equal(MYRIOTA_LocationEncode(&encoder, -349284000, 1386007000, buffer,
+                     sizeof(buffer), 0),
+    49);
+  const uint8_t anchor[7] = {0xCF, 0x90, 0x55, 0x3A, 0x21, 0xB0, 0x01};
+  assert_memory_equal(buffer, anchor, sizeof(anchor));
+
+  memset(buffer, 0, sizeof(buffer));
+  assert_int_equal(MYRIOTA_LocationEncode(&encoder, -349374000, 1386007000, buffer,
+                     sizeof(buffer), 0),
+    21);
+  const uint8_t near[3] = {0xE5, 0x18, 0x00};
+  assert_memory_equal(buffer, near, sizeof(near));
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_encodings),
+    cmocka_unit_test(test_extremes),
+    cmocka_unit_test(test_errors),
+    cmocka_unit_test(test_lost_and_reordered),
+    cmocka_unit_test(test_host_vector),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+#endif /** MYRIOTA_LOCATION_UNIT_TESTS */
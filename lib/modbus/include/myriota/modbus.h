@@ -169,12 +169,14 @@ int MYRIOTA_ModbusDisable(const MYRIOTA_ModbusHandle handle);
  * (coil_address - coil_start_address) where coil_start_address is bit_index
  * zero.
  *
+ * \see modbus_bitset.h for range, counting and comparison operations.
+ *
  * \param[out] bytes A buffer of bytes using Modbus's byte packing format.
  * \param[in] count The size of the buffer must be at least 1
- * \param[in] bit_index The index of the bit you would like to set, where 0 =< index < (count / 8).
+ * \param[in] bit_index The index of the bit you would like to set, where 0 =< index < (count * 8).
  * \param[in] value The boolean value of the bit where 1 = true and 0 = false.
  */
-void MYRIOTA_ModbusBytesSetBit(uint8_t *const bytes, const size_t count, const uint8_t bit_index,
+void MYRIOTA_ModbusBytesSetBit(uint8_t *const bytes, const size_t count, const size_t bit_index,
   const bool value);
 
 /**
@@ -187,11 +189,11 @@ void MYRIOTA_ModbusBytesSetBit(uint8_t *const bytes, const size_t count, const u
  *
  * \param[in] bytes A buffer of bytes using Modbus's byte packing format.
  * \param[in] count The size of the buffer must be at least 1
- * \param[in] bit_index The index of the bit you would like to set, where 0 =< index < (count / 8).
+ * \param[in] bit_index The index of the bit you would like to get, where 0 =< index < (count * 8).
  * \param[out] value The boolean value of the bit where 1 = true and 0 = false.
  */
 void MYRIOTA_ModbusBytesGetBit(const uint8_t *const bytes, const size_t count,
-  const uint8_t bit_index, bool *const value);
+  const size_t bit_index, bool *const value);
 
 /**
  * Read the values of a list of consecutive coils.
@@ -0,0 +1,149 @@
+/// \file modbus_bitset.h Myriota Modbus Bitset Utilities
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYRIOTA_MODBUS_BITSET_H
+#define MYRIOTA_MODBUS_BITSET_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** \defgroup Modbus_Bitset Modbus Bitset Utilities
+ * @brief Word-at-a-time operations on Modbus bit packed coil/discrete input buffers
+ *
+ * Coil and discrete input values are packed by Modbus with the first bit in
+ * the least significant bit of the first byte. All functions in this module
+ * operate on buffers in that format, addressing bits with a `bit_index` that
+ * can be interpreted as (coil_address - coil_start_address). Internally the
+ * buffers are processed 32 bits at a time, so large blocks (up to the 2000
+ * bits allowed by a single read) can be compared and counted cheaply.
+ *
+ * In all functions `count` is the size of the buffer in bytes, and every bit
+ * accessed must satisfy `bit_index < (count * 8)`.
+ * \{
+ */
+
+/**
+ * Set the value of the bit at the given index.
+ *
+ * \param[out] bytes A buffer of bytes using Modbus's byte packing format.
+ * \param[in] count The size of the buffer in bytes.
+ * \param[in] bit_index The index of the bit to set.
+ * \param[in] value The boolean value of the bit where 1 = true and 0 = false.
+ */
+void MYRIOTA_ModbusBitsetSet(uint8_t *const bytes, const size_t count, const size_t bit_index,
+  const bool value);
+
+/**
+ * Get the value of the bit at the given index.
+ *
+ * \param[in] bytes A buffer of bytes using Modbus's byte packing format.
+ * \param[in] count The size of the buffer in bytes.
+ * \param[in] bit_index The index of the bit to get.
+ * \return the value of the bit.
+ */
+bool MYRIOTA_ModbusBitsetGet(const uint8_t *const bytes, const size_t count,
+  const size_t bit_index);
+
+/**
+ * Extract a range of up to 32 consecutive bits.
+ *
+ * \param[in] bytes A buffer of bytes using Modbus's byte packing format.
+ * \param[in] count The size of the buffer in bytes.
+ * \param[in] bit_index The index of the first bit in the range.
+ * \param[in] nbits The number of bits in the range, where 0 < nbits <= 32.
+ * \return the bits in the range, where the bit at `bit_index` is the least
+ * significant bit of the result.
+ */
+uint32_t MYRIOTA_ModbusBitsetExtract(const uint8_t *const bytes, const size_t count,
+  const size_t bit_index, const uint8_t nbits);
+
+/**
+ * Insert a range of up to 32 consecutive bits, leaving all other bits unchanged.
+ *
+ * \param[out] bytes A buffer of bytes using Modbus's byte packing format.
+ * \param[in] count The size of the buffer in bytes.
+ * \param[in] bit_index The index of the first bit in the range.
+ * \param[in] nbits The number of bits in the range, where 0 < nbits <= 32.
+ * \param[in] value The bits to insert, where the least significant bit of
+ * `value` is written to `bit_index`.
+ */
+void MYRIOTA_ModbusBitsetInsert(uint8_t *const bytes, const size_t count, const size_t bit_index,
+  const uint8_t nbits, const uint32_t value);
+
+/**
+ * Copy an arbitrary length range of bits from one buffer to another.
+ *
+ * \note The source and destination ranges must not overlap.
+ *
+ * \param[out] dst The buffer to copy the bits to.
+ * \param[in] dst_count The size of the destination buffer in bytes.
+ * \param[in] dst_index The index of the first bit to write in the destination buffer.
+ * \param[in] src The buffer to copy the bits from.
+ * \param[in] src_count The size of the source buffer in bytes.
+ * \param[in] src_index The index of the first bit to read in the source buffer.
+ * \param[in] nbits The number of bits to copy.
+ */
+void MYRIOTA_ModbusBitsetCopy(uint8_t *const dst, const size_t dst_count, const size_t dst_index,
+  const uint8_t *const src, const size_t src_count, const size_t src_index, const size_t nbits);
+
+/**
+ * Count the number of set bits in the first `nbits` bits of a buffer.
+ *
+ * \param[in] bytes A buffer of bytes using Modbus's byte packing format.
+ * \param[in] count The size of the buffer in bytes.
+ * \param[in] nbits The number of bits to count over, where nbits <= (count * 8).
+ * \return the number of bits set.
+ */
+size_t MYRIOTA_ModbusBitsetCount(const uint8_t *const bytes, const size_t count,
+  const size_t nbits);
+
+/**
+ * Find the next bit that differs between two snapshots of the same block.
+ *
+ * Changed bits can be enumerated with:
+ * \code
+ * for (size_t i = MYRIOTA_ModbusBitsetNextChange(prev, curr, count, nbits, 0); i < nbits;
+ *      i = MYRIOTA_ModbusBitsetNextChange(prev, curr, count, nbits, i + 1)) {
+ *   // Bit i has changed.
+ * }
+ * \endcode
+ *
+ * \param[in] a The first buffer to compare.
+ * \param[in] b The second buffer to compare.
+ * \param[in] count The size of both buffers in bytes.
+ * \param[in] nbits The number of bits to compare, where nbits <= (count * 8).
+ * \param[in] start The index of the first bit to consider.
+ * \return the index of the first differing bit >= `start`, or `nbits` if there are none.
+ */
+size_t MYRIOTA_ModbusBitsetNextChange(const uint8_t *const a, const uint8_t *const b,
+  const size_t count, const size_t nbits, const size_t start);
+
+/**
+ * Count the number of bits that differ between two snapshots of the same block.
+ *
+ * \param[in] a The first buffer to compare.
+ * \param[in] b The second buffer to compare.
+ * \param[in] count The size of both buffers in bytes.
+ * \param[in] nbits The number of bits to compare, where nbits <= (count * 8).
+ * \return the number of bits that differ.
+ */
+size_t MYRIOTA_ModbusBitsetCountChanges(const uint8_t *const a, const uint8_t *const b,
+  const size_t count, const size_t nbits);
+
+/**
+ * \}
+ */
+
+#endif /* MYRIOTA_MODBUS_BITSET_H */
@@ -0,0 +1,149 @@
+/// \file modbus_session.h Myriota Modbus Bus Sessions
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYRIOTA_MODBUS_SESSION_H
+#define MYRIOTA_MODBUS_SESSION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "myriota/modbus.h"
+#include "myriota/modbus_write_queue.h"
+
+/** \defgroup Modbus_Session Modbus Bus Sessions
+ * @brief Reference counted enabling of a Modbus driver with idle power down
+ *
+ * MYRIOTA_ModbusEnable() and MYRIOTA_ModbusDisable() initialise and
+ * de-initialise the serial interface on every call. A session instead keeps
+ * a count of its users: the first MYRIOTA_ModbusSessionAcquire() enables the
+ * driver, nested acquires share the enabled bus, and after the last
+ * MYRIOTA_ModbusSessionRelease() the driver stays enabled for `idle_timeout_ms`
+ * so a burst of polls only pays the serial initialisation once. Call
+ * MYRIOTA_ModbusSessionPoll() to power the bus down once the idle period has
+ * expired.
+ *
+ * A write-combining queue attached with MYRIOTA_ModbusSessionWriteQueueAttach()
+ * is flushed when the last user releases the session, while the bus is still
+ * enabled, so writes queued during a session are sent at its end.
+ * \{
+ */
+
+/** Millisecond tick source used to measure idle and enabled time, e.g. `FLEX_TickGet`. */
+typedef uint32_t (*MYRIOTA_ModbusSessionTickFn_t)(void);
+
+/** Usage counters for a session. */
+typedef struct {
+  /** The number of times the driver was enabled by the session. */
+  uint32_t enable_count;
+  /** The total time in milliseconds the driver has been enabled by the session. */
+  uint32_t enabled_ms;
+} MYRIOTA_ModbusSessionStats;
+
+/** A Modbus bus session. Treat the members as private. */
+typedef struct {
+  /** \cond INTERNAL_HIDDEN */
+  MYRIOTA_ModbusHandle handle;
+  MYRIOTA_ModbusSessionTickFn_t tick_get;
+  uint32_t idle_timeout_ms;
+  uint16_t users;
+  bool enabled;
+  uint32_t enabled_tick;
+  uint32_t idle_tick;
+  MYRIOTA_ModbusWriteQueue *write_queue;
+  MYRIOTA_ModbusSessionStats stats;
+  /** \endcond */
+} MYRIOTA_ModbusSession;
+
+/**
+ * Initializes a session for a Modbus driver. The driver must be disabled.
+ *
+ * \param[out] session The session to initialize.
+ * \param[in] handle The handle for the Modbus driver the session manages.
+ * \param[in] idle_timeout_ms The time in milliseconds the driver stays enabled
+ * after the last user releases it, where 0 disables it immediately.
+ * \param[in] tick_get The millisecond tick source, e.g. `FLEX_TickGet`.
+ */
+void MYRIOTA_ModbusSessionInit(MYRIOTA_ModbusSession *const session,
+  const MYRIOTA_ModbusHandle handle, const uint32_t idle_timeout_ms,
+  const MYRIOTA_ModbusSessionTickFn_t tick_get);
+
+/**
+ * Acquire the bus, enabling the Modbus driver if it is not already enabled.
+ *
+ * \param[in,out] session The session to acquire.
+ * \return 0 on success else < 0 on error.
+ */
+int MYRIOTA_ModbusSessionAcquire(MYRIOTA_ModbusSession *const session);
+
+/**
+ * Attach a write-combining queue to a session, which flushes it at the end of
+ * each session. A session has at most one queue.
+ *
+ * \param[in,out] session The session.
+ * \param[in] queue The queue, which must use the Modbus driver of the session
+ * and stay valid while attached, or NULL to detach the queue.
+ */
+void MYRIOTA_ModbusSessionWriteQueueAttach(MYRIOTA_ModbusSession *const session,
+  MYRIOTA_ModbusWriteQueue *const queue);
+
+/**
+ * Release the bus. When the last user releases the bus, the attached write
+ * queue is flushed and the idle timeout starts.
+ *
+ * \param[in,out] session The session to release.
+ * \return 0 on success else < 0 on error. The error of flushing the write
+ * queue is returned, in which case the bus is still released and the results
+ * of the writes are given by MYRIOTA_ModbusWriteQueueResult().
+ */
+int MYRIOTA_ModbusSessionRelease(MYRIOTA_ModbusSession *const session);
+
+/**
+ * Disable the Modbus driver if the bus has been idle for the idle timeout.
+ *
+ * \param[in,out] session The session to poll.
+ * \return the number of milliseconds until the bus will be powered down, or 0
+ * if no power down is pending (the bus is disabled or in use).
+ */
+uint32_t MYRIOTA_ModbusSessionPoll(MYRIOTA_ModbusSession *const session);
+
+/**
+ * Disable the Modbus driver now if the bus is not in use, without waiting for
+ * the idle timeout, e.g. before a long sleep.
+ *
+ * \param[in,out] session The session to power down.
+ * \return 0 on success else < 0 on error.
+ */
+int MYRIOTA_ModbusSessionPowerDown(MYRIOTA_ModbusSession *const session);
+
+/**
+ * Returns true if the session currently has the Modbus driver enabled.
+ *
+ * \param[in] session The session to check.
+ */
+bool MYRIOTA_ModbusSessionIsEnabled(const MYRIOTA_ModbusSession *const session);
+
+/**
+ * Get the usage counters of a session, including the current enabled period.
+ *
+ * \param[in] session The session to get the counters of.
+ * \param[out] stats The usage counters.
+ */
+void MYRIOTA_ModbusSessionStatsGet(const MYRIOTA_ModbusSession *const session,
+  MYRIOTA_ModbusSessionStats *const stats);
+
+/**
+ * \}
+ */
+
+#endif /* MYRIOTA_MODBUS_SESSION_H */
@@ -0,0 +1,151 @@
+/// \file modbus_write_queue.h Myriota Modbus Write-Combining Queue
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYRIOTA_MODBUS_WRITE_QUEUE_H
+#define MYRIOTA_MODBUS_WRITE_QUEUE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "myriota/modbus.h"
+
+/** \defgroup Modbus_Write_Queue Modbus Write-Combining Queue
+ * @brief Buffer single coil/register writes and send them as multiple write frames
+ *
+ * Writes queued with MYRIOTA_ModbusWriteQueueHoldingRegister() and
+ * MYRIOTA_ModbusWriteQueueCoil() are held until MYRIOTA_ModbusWriteQueueFlush()
+ * is called. On flush, pending writes are grouped per slave and merged into
+ * "Write multiple registers" (0x10) and "Write multiple coils" (0x0F) frames up
+ * to the PDU limit, so a configuration push of N consecutive registers costs a
+ * single transaction instead of N.
+ *
+ * \note Queuing a write to an address that already has a pending write
+ * replaces the pending value (last write wins). Writes to different addresses
+ * are sent in address order, not in the order they were queued. Flush the
+ * queue between writes if the slave requires a specific ordering.
+ * \{
+ */
+
+/** The maximum number of pending writes a queue can hold. */
+#ifndef MYRIOTA_MODBUS_WRITE_QUEUE_SIZE
+#define MYRIOTA_MODBUS_WRITE_QUEUE_SIZE 32
+#endif
+
+/** \cond INTERNAL_HIDDEN */
+typedef struct {
+  MYRIOTA_ModbusDeviceAddress slave;
+  bool is_coil;
+  MYRIOTA_ModbusDataAddress addr;
+  uint16_t value;
+  int result;
+} MYRIOTA_ModbusWriteQueueEntry;
+/** \endcond */
+
+/** A write-combining queue. Treat the members as private. */
+typedef struct {
+  /** \cond INTERNAL_HIDDEN */
+  MYRIOTA_ModbusHandle handle;
+  uint16_t max_gap;
+  bool flushed;
+  size_t count;
+  MYRIOTA_ModbusWriteQueueEntry entries[MYRIOTA_MODBUS_WRITE_QUEUE_SIZE];
+  /** \endcond */
+} MYRIOTA_ModbusWriteQueue;
+
+/**
+ * Initializes a write-combining queue.
+ *
+ * \note When `max_gap` is greater than zero, runs of pending writes separated
+ * by up to `max_gap` unwritten addresses are merged into a single frame. The
+ * current values of the unwritten addresses are first read back from the
+ * slave, so the merged frame writes them unchanged. This is not atomic; only
+ * use it with slaves whose gap values do not change between the read and the
+ * write.
+ *
+ * \param[out] queue The queue to initialize.
+ * \param[in] handle The handle for the Modbus driver the writes are sent with.
+ * \param[in] max_gap The maximum number of unwritten addresses that may be
+ * bridged when merging writes, where 0 only merges contiguous addresses.
+ */
+void MYRIOTA_ModbusWriteQueueInit(MYRIOTA_ModbusWriteQueue *const queue,
+  const MYRIOTA_ModbusHandle handle, const uint16_t max_gap);
+
+/**
+ * Queue a write to a holding register.
+ *
+ * \note Queuing a write after the queue has been flushed discards the results
+ * of the previous flush.
+ *
+ * \param[in,out] queue The queue to add the write to.
+ * \param[in] slave The address of the slave device to write to.
+ * \param[in] addr The address of the holding register to write to.
+ * \param[in] value The value to write to the holding register.
+ * \return a ticket >= 0 for MYRIOTA_ModbusWriteQueueResult() on success,
+ * else < 0 on error.
+ */
+int MYRIOTA_ModbusWriteQueueHoldingRegister(MYRIOTA_ModbusWriteQueue *const queue,
+  const MYRIOTA_ModbusDeviceAddress slave, const MYRIOTA_ModbusDataAddress addr,
+  const uint16_t value);
+
+/**
+ * Queue a write to a coil.
+ *
+ * \note Queuing a write after the queue has been flushed discards the results
+ * of the previous flush.
+ *
+ * \param[in,out] queue The queue to add the write to.
+ * \param[in] slave The address of the slave device to write to.
+ * \param[in] addr The address of the coil to write to.
+ * \param[in] value The value to write to the coil.
+ * \return a ticket >= 0 for MYRIOTA_ModbusWriteQueueResult() on success,
+ * else < 0 on error.
+ */
+int MYRIOTA_ModbusWriteQueueCoil(MYRIOTA_ModbusWriteQueue *const queue,
+  const MYRIOTA_ModbusDeviceAddress slave, const MYRIOTA_ModbusDataAddress addr,
+  const bool value);
+
+/**
+ * Returns the number of writes waiting to be flushed.
+ *
+ * \param[in] queue The queue to check.
+ * \return the number of pending writes.
+ */
+size_t MYRIOTA_ModbusWriteQueuePending(const MYRIOTA_ModbusWriteQueue *const queue);
+
+/**
+ * Send all pending writes to the slave devices.
+ *
+ * \note The Modbus driver must be enabled. A queue attached to a session with
+ * MYRIOTA_ModbusSessionWriteQueueAttach() is also flushed when the session ends.
+ *
+ * \param[in,out] queue The queue to flush.
+ * \return 0 if every write succeeded, else the first error (< 0) encountered.
+ */
+int MYRIOTA_ModbusWriteQueueFlush(MYRIOTA_ModbusWriteQueue *const queue);
+
+/**
+ * Get the result of a queued write after the queue has been flushed.
+ *
+ * \param[in] queue The queue the write was added to.
+ * \param[in] ticket The ticket returned when the write was queued.
+ * \return 0 if the write succeeded, else < 0 on error. Returns
+ * -MODBUS_ERROR_BAD_STATE if the queue has not been flushed.
+ */
+int MYRIOTA_ModbusWriteQueueResult(const MYRIOTA_ModbusWriteQueue *const queue, const int ticket);
+
+/**
+ * \}
+ */
+
+#endif /* MYRIOTA_MODBUS_WRITE_QUEUE_H */
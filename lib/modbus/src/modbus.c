@@ -12,6 +12,7 @@
 // limitations under the License.
 
 #include "myriota/modbus.h"
+#include "myriota/modbus_bitset.h"
 #include <string.h>
 
 // NOTE: you can provide your own assert
@@ -463,28 +464,14 @@ int MYRIOTA_ModbusDisable(const MYRIOTA_ModbusHandle handle) {
   return MODBUS_SUCCESS;
 }
 
-void MYRIOTA_ModbusBytesSetBit(uint8_t *const bytes, const size_t count, const uint8_t bit_index,
+void MYRIOTA_ModbusBytesSetBit(uint8_t *const bytes, const size_t count, const size_t bit_index,
   const bool value) {
-  const uint8_t byte_index = bit_index / 8;
-  MODBUS_ASSERT(byte_index < count);
-
-  const uint8_t bit_offset = bit_index % 8;
-  const uint8_t mask = (0x1 << bit_offset);
-  if (value) {
-    bytes[byte_index] |= mask;
-  } else {
-    bytes[byte_index] &= ~mask;
-  }
+  MYRIOTA_ModbusBitsetSet(bytes, count, bit_index, value);
 }
 
 void MYRIOTA_ModbusBytesGetBit(const uint8_t *const bytes, const size_t count,
-  const uint8_t bit_index, bool *const value) {
-  const uint8_t byte_index = bit_index / 8;
-  MODBUS_ASSERT(byte_index < count);
-
-  const uint8_t bit_offset = bit_index % 8;
-  const uint8_t mask = (0x1 << bit_offset);
-  *value = ((bytes[byte_index] & mask) > 0);
+  const size_t bit_index, bool *const value) {
+  *value = MYRIOTA_ModbusBitsetGet(bytes, count, bit_index);
 }
 
 int MYRIOTA_ModbusReadCoils(const MYRIOTA_ModbusHandle handle,
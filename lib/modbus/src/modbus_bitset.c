@@ -0,0 +1,299 @@
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myriota/modbus_bitset.h"
+#include <string.h>
+
+// NOTE: you can provide your own assert
+#ifndef MODBUS_ASSERT
+#include <stdio.h>
+#define MODBUS_ASSERT(cond)                          \
+  do {                                               \
+    if (!(cond)) {                                   \
+      printf("Assert @%s:%d\n", __FILE__, __LINE__); \
+      while (1) {                                    \
+      }                                              \
+    }                                                \
+  } while (0)
+#endif
+
+#define BITSET_WORD_BITS 32
+#define BITSET_WORD_BYTES 4
+
+// Modbus packs the first bit into the least significant bit of the first byte,
+// so a little endian load of 4 bytes gives a word where bit N of the word is
+// bit (word_index * 32 + N) of the block.
+static inline uint32_t bitset_load_word(const uint8_t *const bytes, const size_t count,
+  const size_t word_index) {
+  const size_t offset = word_index * BITSET_WORD_BYTES;
+  if (offset + BITSET_WORD_BYTES <= count) {
+    const uint8_t *const p = &bytes[offset];
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) |
+           ((uint32_t)p[3] << 24);
+  }
+
+  // Partial trailing word, bytes past the end of the buffer read as zero.
+  uint32_t word = 0;
+  for (size_t i = 0; offset + i < count; ++i) {
+    word |= (uint32_t)bytes[offset + i] << (8 * i);
+  }
+  return word;
+}
+
+static inline void bitset_store_word(uint8_t *const bytes, const size_t count,
+  const size_t word_index, const uint32_t word) {
+  const size_t offset = word_index * BITSET_WORD_BYTES;
+  for (size_t i = 0; i < BITSET_WORD_BYTES && offset + i < count; ++i) {
+    bytes[offset + i] = (uint8_t)(word >> (8 * i));
+  }
+}
+
+// Mask of the lowest `nbits` bits, where 0 < nbits <= 32.
+static inline uint32_t bitset_low_mask(const uint8_t nbits) {
+  return (nbits >= BITSET_WORD_BITS) ? UINT32_MAX : ((UINT32_C(1) << nbits) - 1);
+}
+
+static inline size_t bitset_popcount(uint32_t word) {
+  word = word - ((word >> 1) & 0x55555555);
+  word = (word & 0x33333333) + ((word >> 2) & 0x33333333);
+  word = (word + (word >> 4)) & 0x0F0F0F0F;
+  return (word * 0x01010101) >> 24;
+}
+
+void MYRIOTA_ModbusBitsetSet(uint8_t *const bytes, const size_t count, const size_t bit_index,
+  const bool value) {
+  const size_t byte_index = bit_index / 8;
+  MODBUS_ASSERT(byte_index < count);
+
+  const uint8_t mask = (0x1 << (bit_index % 8));
+  if (value) {
+    bytes[byte_index] |= mask;
+  } else {
+    bytes[byte_index] &= ~mask;
+  }
+}
+
+bool MYRIOTA_ModbusBitsetGet(const uint8_t *const bytes, const size_t count,
+  const size_t bit_index) {
+  const size_t byte_index = bit_index / 8;
+  MODBUS_ASSERT(byte_index < count);
+
+  const uint8_t mask = (0x1 << (bit_index % 8));
+  return (bytes[byte_index] & mask) > 0;
+}
+
+uint32_t MYRIOTA_ModbusBitsetExtract(const uint8_t *const bytes, const size_t count,
+  const size_t bit_index, const uint8_t nbits) {
+  MODBUS_ASSERT(nbits > 0 && nbits <= BITSET_WORD_BITS);
+  MODBUS_ASSERT(bit_index + nbits <= count * 8);
+
+  const size_t word_index = bit_index / BITSET_WORD_BITS;
+  const uint8_t offset = bit_index % BITSET_WORD_BITS;
+  uint32_t value = bitset_load_word(bytes, count, word_index) >> offset;
+  if (offset + nbits > BITSET_WORD_BITS) {
+    value |= bitset_load_word(bytes, count, word_index + 1) << (BITSET_WORD_BITS - offset);
+  }
+  return value & bitset_low_mask(nbits);
+}
+
+void MYRIOTA_ModbusBitsetInsert(uint8_t *const bytes, const size_t count, const size_t bit_index,
+  const uint8_t nbits, const uint32_t value) {
+  MODBUS_ASSERT(nbits > 0 && nbits <= BITSET_WORD_BITS);
+  MODBUS_ASSERT(bit_index + nbits <= count * 8);
+
+  const uint32_t mask = bitset_low_mask(nbits);
+  const uint32_t bits = value & mask;
+  const size_t word_index = bit_index / BITSET_WORD_BITS;
+  const uint8_t offset = bit_index % BITSET_WORD_BITS;
+
+  uint32_t word = bitset_load_word(bytes, count, word_index);
+  word = (word & ~(mask << offset)) | (bits << offset);
+  bitset_store_word(bytes, count, word_index, word);
+
+  if (offset + nbits > BITSET_WORD_BITS) {
+    const uint8_t shift = BITSET_WORD_BITS - offset;
+    word = bitset_load_word(bytes, count, word_index + 1);
+    word = (word & ~(mask >> shift)) | (bits >> shift);
+    bitset_store_word(bytes, count, word_index + 1, word);
+  }
+}
+
+void MYRIOTA_ModbusBitsetCopy(uint8_t *const dst, const size_t dst_count, const size_t dst_index,
+  const uint8_t *const src, const size_t src_count, const size_t src_index, const size_t nbits) {
+  MODBUS_ASSERT(dst_index + nbits <= dst_count * 8);
+  MODBUS_ASSERT(src_index + nbits <= src_count * 8);
+
+  for (size_t copied = 0; copied < nbits;) {
+    const size_t remaining = nbits - copied;
+    const uint8_t chunk = (remaining > BITSET_WORD_BITS) ? BITSET_WORD_BITS : remaining;
+    const uint32_t value = MYRIOTA_ModbusBitsetExtract(src, src_count, src_index + copied, chunk);
+    MYRIOTA_ModbusBitsetInsert(dst, dst_count, dst_index + copied, chunk, value);
+    copied += chunk;
+  }
+}
+
+size_t MYRIOTA_ModbusBitsetCount(const uint8_t *const bytes, const size_t count,
+  const size_t nbits) {
+  MODBUS_ASSERT(nbits <= count * 8);
+
+  const size_t full_words = nbits / BITSET_WORD_BITS;
+  const uint8_t tail_bits = nbits % BITSET_WORD_BITS;
+  size_t total = 0;
+  for (size_t i = 0; i < full_words; ++i) {
+    total += bitset_popcount(bitset_load_word(bytes, count, i));
+  }
+  if (tail_bits > 0) {
+    total += bitset_popcount(bitset_load_word(bytes, count, full_words) & bitset_low_mask(tail_bits));
+  }
+  return total;
+}
+
+size_t MYRIOTA_ModbusBitsetNextChange(const uint8_t *const a, const uint8_t *const b,
+  const size_t count, const size_t nbits, const size_t start) {
+  MODBUS_ASSERT(nbits <= count * 8);
+  if (start >= nbits) {
+    return nbits;
+  }
+
+  const size_t last_word = (nbits - 1) / BITSET_WORD_BITS;
+  size_t word_index = start / BITSET_WORD_BITS;
+  // Ignore bits before the start index in the first word.
+  uint32_t diff = (bitset_load_word(a, count, word_index) ^ bitset_load_word(b, count, word_index)) &
+                  (UINT32_MAX << (start % BITSET_WORD_BITS));
+  while (diff == 0) {
+    if (++word_index > last_word) {
+      return nbits;
+    }
+    diff = bitset_load_word(a, count, word_index) ^ bitset_load_word(b, count, word_index);
+  }
+
+  const size_t index = word_index * BITSET_WORD_BITS + __builtin_ctz(diff);
+  return (index < nbits) ? index : nbits;
+}
+
+size_t MYRIOTA_ModbusBitsetCountChanges(const uint8_t *const a, const uint8_t *const b,
+  const size_t count, const size_t nbits) {
+  MODBUS_ASSERT(nbits <= count * 8);
+
+  const size_t full_words = nbits / BITSET_WORD_BITS;
+  const uint8_t tail_bits = nbits % BITSET_WORD_BITS;
+  size_t total = 0;
+  for (size_t i = 0; i < full_words; ++i) {
+    total += bitset_popcount(bitset_load_word(a, count, i) ^ bitset_load_word(b, count, i));
+  }
+  if (tail_bits > 0) {
+    const uint32_t diff =
+      bitset_load_word(a, count, full_words) ^ bitset_load_word(b, count, full_words);
+    total += bitset_popcount(diff & bitset_low_mask(tail_bits));
+  }
+  return total;
+}
+
+#ifdef MYRIOTA_MODBUS_BITSET_UNIT_TESTS
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+/*
+ * `cmocka.h` must be included after standard the above library headers.
+ * NOTE: This comment has dual purpose:
+ * 1. Document the ordering requirement.
+ * 2. Prevent `clang-format` from reordering the headers.
+ */
+#include <cmocka.h>
+
+static void test_set_get_beyond_256_bits(void **state) {
+  (void)state;
+  uint8_t bytes[250] = {0};  // 2000 bits, the maximum for a single coil read.
+  MYRIOTA_ModbusBitsetSet(bytes, sizeof(bytes), 1999, true);
+  MYRIOTA_ModbusBitsetSet(bytes, sizeof(bytes), 300, true);
+  assert_int_equal(bytes[249], 0x80);
+  assert_int_equal(bytes[37], 0x10);
+  assert_true(MYRIOTA_ModbusBitsetGet(bytes, sizeof(bytes), 1999));
+  assert_false(MYRIOTA_ModbusBitsetGet(bytes, sizeof(bytes), 1998));
+  MYRIOTA_ModbusBitsetSet(bytes, sizeof(bytes), 1999, false);
+  assert_int_equal(bytes[249], 0x00);
+}
+
+static void test_extract_insert_across_words(void **state) {
+  (void)state;
+  uint8_t bytes[9] = {0};
+  MYRIOTA_ModbusBitsetInsert(bytes, sizeof(bytes), 28, 12, 0xABC);
+  assert_int_equal(MYRIOTA_ModbusBitsetExtract(bytes, sizeof(bytes), 28, 12), 0xABC);
+  assert_int_equal(bytes[3], 0xC0);
+  assert_int_equal(bytes[4], 0xAB);
+
+  // Bits outside of the range are preserved.
+  memset(bytes, 0xFF, sizeof(bytes));
+  MYRIOTA_ModbusBitsetInsert(bytes, sizeof(bytes), 40, 32, 0);
+  assert_int_equal(bytes[4], 0xFF);
+  assert_int_equal(bytes[5], 0x00);
+  assert_int_equal(bytes[8], 0x00);
+  assert_int_equal(MYRIOTA_ModbusBitsetExtract(bytes, sizeof(bytes), 36, 8), 0x0F);
+}
+
+static void test_copy(void **state) {
+  (void)state;
+  uint8_t src[16] = {0};
+  uint8_t dst[16] = {0};
+  for (size_t i = 0; i < sizeof(src); ++i) {
+    src[i] = (uint8_t)(i * 37 + 11);
+  }
+  MYRIOTA_ModbusBitsetCopy(dst, sizeof(dst), 3, src, sizeof(src), 5, 100);
+  for (size_t i = 0; i < 100; ++i) {
+    assert_int_equal(MYRIOTA_ModbusBitsetGet(dst, sizeof(dst), 3 + i),
+      MYRIOTA_ModbusBitsetGet(src, sizeof(src), 5 + i));
+  }
+  assert_int_equal(MYRIOTA_ModbusBitsetExtract(dst, sizeof(dst), 0, 3), 0);
+}
+
+static void test_count_and_changes(void **state) {
+  (void)state;
+  uint8_t a[250] = {0};
+  uint8_t b[250] = {0};
+  memset(a, 0xFF, sizeof(a));
+  assert_int_equal(MYRIOTA_ModbusBitsetCount(a, sizeof(a), 2000), 2000);
+  assert_int_equal(MYRIOTA_ModbusBitsetCount(a, sizeof(a), 45), 45);
+
+  memcpy(b, a, sizeof(b));
+  MYRIOTA_ModbusBitsetSet(b, sizeof(b), 7, false);
+  MYRIOTA_ModbusBitsetSet(b, sizeof(b), 1024, false);
+  MYRIOTA_ModbusBitsetSet(b, sizeof(b), 1999, false);
+  assert_int_equal(MYRIOTA_ModbusBitsetCountChanges(a, b, sizeof(a), 2000), 3);
+  assert_int_equal(MYRIOTA_ModbusBitsetCountChanges(a, b, sizeof(a), 1999), 2);
+
+  size_t changed[3] = {0};
+  size_t n = 0;
+  for (size_t i = MYRIOTA_ModbusBitsetNextChange(a, b, sizeof(a), 2000, 0); i < 2000;
+       i = MYRIOTA_ModbusBitsetNextChange(a, b, sizeof(a), 2000, i + 1)) {
+    assert_true(n < 3);
+    changed[n++] = i;
+  }
+  assert_int_equal(n, 3);
+  assert_int_equal(changed[0], 7);
+  assert_int_equal(changed[1], 1024);
+  assert_int_equal(changed[2], 1999);
+  assert_int_equal(MYRIOTA_ModbusBitsetNextChange(a, b, sizeof(a), 1999, 1025), 1999);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_set_get_beyond_256_bits),
+    cmocka_unit_test(test_extract_insert_across_words),
+    cmocka_unit_test(test_copy),
+    cmocka_unit_test(test_count_and_changes),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+#endif /** MYRIOTA_MODBUS_BITSET_UNIT_TESTS */
@@ -0,0 +1,322 @@
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myriota/modbus_session.h"
+#include <string.h>
+
+// NOTE: you can provide your own assert
+#ifndef MODBUS_ASSERT
+#include <stdio.h>
+#define MODBUS_ASSERT(cond)                          \
+  do {                                               \
+    if (!(cond)) {                                   \
+      printf("Assert @%s:%d\n", __FILE__, __LINE__); \
+      while (1) {                                    \
+      }                                              \
+    }                                                \
+  } while (0)
+#endif
+
+static int session_disable(MYRIOTA_ModbusSession *const session) {
+  const int result = MYRIOTA_ModbusDisable(session->handle);
+  if (result != MODBUS_SUCCESS) {
+    return result;
+  }
+  session->enabled = false;
+  session->stats.enabled_ms += session->tick_get() - session->enabled_tick;
+  return MODBUS_SUCCESS;
+}
+
+void MYRIOTA_ModbusSessionInit(MYRIOTA_ModbusSession *const session,
+  const MYRIOTA_ModbusHandle handle, const uint32_t idle_timeout_ms,
+  const MYRIOTA_ModbusSessionTickFn_t tick_get) {
+  MODBUS_ASSERT(session != NULL);
+  MODBUS_ASSERT(tick_get != NULL);
+  memset(session, 0, sizeof(*session));
+  session->handle = handle;
+  session->idle_timeout_ms = idle_timeout_ms;
+  session->tick_get = tick_get;
+}
+
+int MYRIOTA_ModbusSessionAcquire(MYRIOTA_ModbusSession *const session) {
+  MODBUS_ASSERT(session != NULL);
+  if (session->users == UINT16_MAX) {
+    return -MODBUS_ERROR_OVERFLOW;
+  }
+
+  if (!session->enabled) {
+    const int result = MYRIOTA_ModbusEnable(session->handle);
+    if (result != MODBUS_SUCCESS) {
+      return result;
+    }
+    session->enabled = true;
+    session->enabled_tick = session->tick_get();
+    ++session->stats.enable_count;
+  }
+
+  ++session->users;
+  return MODBUS_SUCCESS;
+}
+
+void MYRIOTA_ModbusSessionWriteQueueAttach(MYRIOTA_ModbusSession *const session,
+  MYRIOTA_ModbusWriteQueue *const queue) {
+  MODBUS_ASSERT(session != NULL);
+  MODBUS_ASSERT(queue == NULL || queue->handle == session->handle);
+  session->write_queue = queue;
+}
+
+int MYRIOTA_ModbusSessionRelease(MYRIOTA_ModbusSession *const session) {
+  MODBUS_ASSERT(session != NULL);
+  if (session->users == 0) {
+    return -MODBUS_ERROR_BAD_STATE;
+  }
+
+  if (session->users > 1) {
+    --session->users;
+    return MODBUS_SUCCESS;
+  }
+
+  // Flush while the session is still held, so the bus is enabled.
+  int result = MODBUS_SUCCESS;
+  if (session->write_queue != NULL && MYRIOTA_ModbusWriteQueuePending(session->write_queue) > 0) {
+    result = MYRIOTA_ModbusWriteQueueFlush(session->write_queue);
+  }
+  session->users = 0;
+
+  if (session->idle_timeout_ms == 0) {
+    const int disable_result = session_disable(session);
+    return (result != MODBUS_SUCCESS) ? result : disable_result;
+  }
+
+  session->idle_tick = session->tick_get();
+  return result;
+}
+
+uint32_t MYRIOTA_ModbusSessionPoll(MYRIOTA_ModbusSession *const session) {
+  MODBUS_ASSERT(session != NULL);
+  if (!session->enabled || session->users > 0) {
+    return 0;
+  }
+
+  const uint32_t idle_ms = session->tick_get() - session->idle_tick;
+  if (idle_ms < session->idle_timeout_ms) {
+    return session->idle_timeout_ms - idle_ms;
+  }
+
+  session_disable(session);
+  return 0;
+}
+
+int MYRIOTA_ModbusSessionPowerDown(MYRIOTA_ModbusSession *const session) {
+  MODBUS_ASSERT(session != NULL);
+  if (session->users > 0) {
+    return -MODBUS_ERROR_BAD_STATE;
+  }
+
+  if (!session->enabled) {
+    return MODBUS_SUCCESS;
+  }
+
+  return session_disable(session);
+}
+
+bool MYRIOTA_ModbusSessionIsEnabled(const MYRIOTA_ModbusSession *const session) {
+  MODBUS_ASSERT(session != NULL);
+  return session->enabled;
+}
+
+void MYRIOTA_ModbusSessionStatsGet(const MYRIOTA_ModbusSession *const session,
+  MYRIOTA_ModbusSessionStats *const stats) {
+  MODBUS_ASSERT(session != NULL);
+  MODBUS_ASSERT(stats != NULL);
+  *stats = session->stats;
+  if (session->enabled) {
+    stats->enabled_ms += session->tick_get() - session->enabled_tick;
+  }
+}
+
+#ifdef MYRIOTA_MODBUS_SESSION_UNIT_TESTS
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+/*
+ * `cmocka.h` must be included after standard the above library headers.
+ * NOTE: This comment has dual purpose:
+ * 1. Document the ordering requirement.
+ * 2. Prevent `clang-format` from reordering the headers.
+ */
+#include <cmocka.h>
+
+static uint32_t fake_tick;
+static int fake_init_count;
+static int fake_deinit_count;
+static int fake_write_count;
+static uint8_t fake_response[8];
+
+static uint32_t fake_tick_get(void) {
+  return fake_tick;
+}
+
+static int fake_init(void *const ctx) {
+  (void)ctx;
+  ++fake_init_count;
+  return 0;
+}
+
+static void fake_deinit(void *const ctx) {
+  (void)ctx;
+  ++fake_deinit_count;
+}
+
+// Acknowledges write requests, which echo the first 6 bytes of the request.
+static ssize_t fake_write(void *const ctx, const uint8_t *const buffer, const size_t count) {
+  (void)ctx;
+  assert_int_equal(fake_init_count, fake_deinit_count + 1);
+  ++fake_write_count;
+  memcpy(fake_response, buffer, 6);
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < 6; ++i) {
+    crc ^= fake_response[i];
+    for (int bit = 0; bit < 8; ++bit) {
+      crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+    }
+  }
+  fake_response[6] = crc & 0xFF;
+  fake_response[7] = crc >> 8;
+  return count;
+}
+
+static ssize_t fake_read(void *const ctx, uint8_t *const buffer, const size_t count) {
+  (void)ctx;
+  assert_true(sizeof(fake_response) <= count);
+  memcpy(buffer, fake_response, sizeof(fake_response));
+  return sizeof(fake_response);
+}
+
+static MYRIOTA_ModbusHandle fake_setup(void) {
+  fake_tick = UINT32_MAX - 100;  // Exercise tick wrap around.
+  fake_init_count = 0;
+  fake_deinit_count = 0;
+  fake_write_count = 0;
+  const MYRIOTA_ModbusInitOptions options = {
+    .framing_mode = MODBUS_FRAMING_MODE_RTU,
+    .serial_interface =
+      {
+        .init = fake_init,
+        .deinit = fake_deinit,
+        .read = fake_read,
+        .write = fake_write,
+      },
+  };
+  return MYRIOTA_ModbusInit(options);
+}
+
+static void test_nested_users_share_bus(void **state) {
+  (void)state;
+  const MYRIOTA_ModbusHandle handle = fake_setup();
+  MYRIOTA_ModbusSession session;
+  MYRIOTA_ModbusSessionInit(&session, handle, 1000, fake_tick_get);
+
+  assert_int_equal(MYRIOTA_ModbusSessionAcquire(&session), MODBUS_SUCCESS);
+  assert_int_equal(MYRIOTA_ModbusSessionAcquire(&session), MODBUS_SUCCESS);
+  assert_int_equal(MYRIOTA_ModbusSessionRelease(&session), MODBUS_SUCCESS);
+  assert_int_equal(MYRIOTA_ModbusSessionRelease(&session), MODBUS_SUCCESS);
+  assert_int_equal(MYRIOTA_ModbusSessionRelease(&session), -MODBUS_ERROR_BAD_STATE);
+
+  // Re-acquiring within the idle timeout reuses the enabled bus.
+  fake_tick += 500;
+  assert_int_equal(MYRIOTA_ModbusSessionPoll(&session), 500);
+  assert_int_equal(MYRIOTA_ModbusSessionAcquire(&session), MODBUS_SUCCESS);
+  assert_int_equal(MYRIOTA_ModbusSessionPoll(&session), 0);
+  assert_int_equal(MYRIOTA_ModbusSessionRelease(&session), MODBUS_SUCCESS);
+  assert_int_equal(fake_init_count, 1);
+
+  fake_tick += 1000;
+  assert_int_equal(MYRIOTA_ModbusSessionPoll(&session), 0);
+  assert_false(MYRIOTA_ModbusSessionIsEnabled(&session));
+  assert_int_equal(fake_deinit_count, 1);
+
+  MYRIOTA_ModbusSessionStats stats;
+  MYRIOTA_ModbusSessionStatsGet(&session, &stats);
+  assert_int_equal(stats.enable_count, 1);
+  assert_int_equal(stats.enabled_ms, 1500);
+
+  MYRIOTA_ModbusDeinit(handle);
+}
+
+static void test_zero_timeout_and_power_down(void **state) {
+  (void)state;
+  const MYRIOTA_ModbusHandle handle = fake_setup();
+  MYRIOTA_ModbusSession session;
+  MYRIOTA_ModbusSessionInit(&session, handle, 0, fake_tick_get);
+
+  assert_int_equal(MYRIOTA_ModbusSessionAcquire(&session), MODBUS_SUCCESS);
+  assert_int_equal(MYRIOTA_ModbusSessionPowerDown(&session), -MODBUS_ERROR_BAD_STATE);
+  assert_int_equal(MYRIOTA_ModbusSessionRelease(&session), MODBUS_SUCCESS);
+  assert_false(MYRIOTA_ModbusSessionIsEnabled(&session));
+  assert_int_equal(fake_deinit_count, 1);
+  assert_int_equal(MYRIOTA_ModbusSessionPowerDown(&session), MODBUS_SUCCESS);
+
+  MYRIOTA_ModbusDeinit(handle);
+}
+
+static void test_release_flushes_write_queue(void **state) {
+  (void)state;
+  const MYRIOTA_ModbusHandle handle = fake_setup();
+  MYRIOTA_ModbusSession session;
+  MYRIOTA_ModbusSessionInit(&session, handle, 0, fake_tick_get);
+  MYRIOTA_ModbusWriteQueue queue;
+  MYRIOTA_ModbusWriteQueueInit(&queue, handle, 0);
+  MYRIOTA_ModbusSessionWriteQueueAttach(&session, &queue);
+
+  assert_int_equal(MYRIOTA_ModbusSessionAcquire(&session), MODBUS_SUCCESS);
+  assert_int_equal(MYRIOTA_ModbusSessionAcquire(&session), MODBUS_SUCCESS);
+  const int ticket = MYRIOTA_ModbusWriteQueueHoldingRegister(&queue, 0x01, 10, 1);
+  assert_true(ticket >= 0);
+  assert_true(MYRIOTA_ModbusWriteQueueHoldingRegister(&queue, 0x01, 11, 2) >= 0);
+
+  // Only the last user ends the session, with the bus still enabled.
+  assert_int_equal(MYRIOTA_ModbusSessionRelease(&session), MODBUS_SUCCESS);
+  assert_int_equal(fake_write_count, 0);
+  assert_int_equal(MYRIOTA_ModbusSessionRelease(&session), MODBUS_SUCCESS);
+  assert_int_equal(fake_write_count, 1);
+  assert_int_equal(MYRIOTA_ModbusWriteQueueResult(&queue, ticket), MODBUS_SUCCESS);
+  assert_int_equal(MYRIOTA_ModbusWriteQueuePending(&queue), 0);
+  assert_false(MYRIOTA_ModbusSessionIsEnabled(&session));
+
+  // A session without pending writes sends nothing.
+  assert_int_equal(MYRIOTA_ModbusSessionAcquire(&session), MODBUS_SUCCESS);
+  assert_int_equal(MYRIOTA_ModbusSessionRelease(&session), MODBUS_SUCCESS);
+  assert_int_equal(fake_write_count, 1);
+
+  MYRIOTA_ModbusSessionWriteQueueAttach(&session, NULL);
+  assert_true(MYRIOTA_ModbusWriteQueueHoldingRegister(&queue, 0x01, 12, 3) >= 0);
+  assert_int_equal(MYRIOTA_ModbusSessionAcquire(&session), MODBUS_SUCCESS);
+  assert_int_equal(MYRIOTA_ModbusSessionRelease(&session), MODBUS_SUCCESS);
+  assert_int_equal(fake_write_count, 1);
+  assert_int_equal(MYRIOTA_ModbusWriteQueuePending(&queue), 1);
+
+  MYRIOTA_ModbusDeinit(handle);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_nested_users_share_bus),
+    cmocka_unit_test(test_zero_timeout_and_power_down),
+    cmocka_unit_test(test_release_flushes_write_queue),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+#endif /** MYRIOTA_MODBUS_SESSION_UNIT_TESTS */
@@ -0,0 +1,436 @@
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myriota/modbus_write_queue.h"
+#include <string.h>
+#include "myriota/modbus_bitset.h"
+
+// NOTE: you can provide your own assert
+#ifndef MODBUS_ASSERT
+#include <stdio.h>
+#define MODBUS_ASSERT(cond)                          \
+  do {                                               \
+    if (!(cond)) {                                   \
+      printf("Assert @%s:%d\n", __FILE__, __LINE__); \
+      while (1) {                                    \
+      }                                              \
+    }                                                \
+  } while (0)
+#endif
+
+// Quantity limits for the "Write multiple coils" and "Write multiple registers"
+// requests, see section 6.11 and 6.12 of
+// https://modbus.org/docs/Modbus_Application_Protocol_V1_1b.pdf.
+#define WRITE_QUEUE_MAX_COILS 1968
+#define WRITE_QUEUE_MAX_REGISTERS 123
+#define WRITE_QUEUE_SPAN_BUFFER_SIZE (WRITE_QUEUE_MAX_REGISTERS * 2)
+
+// Single coil writes encode ON as 0xFF00 and OFF as 0x0000.
+#define WRITE_QUEUE_COIL_ON 0xFF00
+
+static int write_queue_add(MYRIOTA_ModbusWriteQueue *const queue,
+  const MYRIOTA_ModbusDeviceAddress slave, const bool is_coil,
+  const MYRIOTA_ModbusDataAddress addr, const uint16_t value) {
+  MODBUS_ASSERT(queue != NULL);
+
+  // The first write after a flush starts a new batch.
+  if (queue->flushed) {
+    queue->flushed = false;
+    queue->count = 0;
+  }
+
+  for (size_t i = 0; i < queue->count; ++i) {
+    MYRIOTA_ModbusWriteQueueEntry *const entry = &queue->entries[i];
+    if (entry->slave == slave && entry->is_coil == is_coil && entry->addr == addr) {
+      entry->value = value;
+      return i;
+    }
+  }
+
+  if (queue->count >= MYRIOTA_MODBUS_WRITE_QUEUE_SIZE) {
+    return -MODBUS_ERROR_OVERFLOW;
+  }
+
+  MYRIOTA_ModbusWriteQueueEntry *const entry = &queue->entries[queue->count];
+  entry->slave = slave;
+  entry->is_coil = is_coil;
+  entry->addr = addr;
+  entry->value = value;
+  entry->result = -MODBUS_ERROR_BAD_STATE;
+  return queue->count++;
+}
+
+static bool write_queue_entry_less(const MYRIOTA_ModbusWriteQueueEntry *const a,
+  const MYRIOTA_ModbusWriteQueueEntry *const b) {
+  if (a->slave != b->slave) {
+    return a->slave < b->slave;
+  }
+  if (a->is_coil != b->is_coil) {
+    return !a->is_coil;
+  }
+  return a->addr < b->addr;
+}
+
+// Sorts the entries by (slave, type, address) without moving them, so tickets
+// remain valid. The queue is small so an insertion sort is sufficient.
+static void write_queue_sort(const MYRIOTA_ModbusWriteQueue *const queue, uint8_t *const order) {
+  for (size_t i = 0; i < queue->count; ++i) {
+    size_t j = i;
+    while (j > 0 && write_queue_entry_less(&queue->entries[i], &queue->entries[order[j - 1]])) {
+      order[j] = order[j - 1];
+      --j;
+    }
+    order[j] = i;
+  }
+}
+
+// Sends the entries order[first, last) as a single request.
+static int write_queue_send_span(const MYRIOTA_ModbusWriteQueue *const queue,
+  const uint8_t *const order, const size_t first, const size_t last, const bool has_gaps) {
+  const MYRIOTA_ModbusWriteQueueEntry *const head = &queue->entries[order[first]];
+  const MYRIOTA_ModbusWriteQueueEntry *const tail = &queue->entries[order[last - 1]];
+  const MYRIOTA_ModbusDataAddress start = head->addr;
+  const size_t span = tail->addr - start + 1;
+
+  // A lone write uses the smaller single write request. The driver sends the
+  // bytes of `word` as is, so they must already be in Modbus byte order.
+  if (span == 1) {
+    const uint16_t value = head->is_coil ? (head->value ? WRITE_QUEUE_COIL_ON : 0) : head->value;
+    const uint8_t bytes[2] = {value >> 8, value & 0xFF};
+    uint16_t word = 0;
+    memcpy(&word, bytes, sizeof(word));
+    return head->is_coil ? MYRIOTA_ModbusWriteCoil(queue->handle, head->slave, start, word)
+                         : MYRIOTA_ModbusWriteHoldingRegister(queue->handle, head->slave, start,
+                             word);
+  }
+
+  uint8_t bytes[WRITE_QUEUE_SPAN_BUFFER_SIZE] = {0};
+  const size_t nbytes = head->is_coil ? (span + 8 - 1) / 8 : span * 2;
+  MODBUS_ASSERT(nbytes <= sizeof(bytes));
+
+  // Read back the addresses that are not being written so they are rewritten
+  // with their current values.
+  if (has_gaps) {
+    const int result =
+      head->is_coil ? MYRIOTA_ModbusReadCoils(queue->handle, head->slave, start, span, bytes)
+                    : MYRIOTA_ModbusReadHoldingRegisters(queue->handle, head->slave, start, span,
+                        bytes);
+    if (result != MODBUS_SUCCESS) {
+      return result;
+    }
+  }
+
+  for (size_t i = first; i < last; ++i) {
+    const MYRIOTA_ModbusWriteQueueEntry *const entry = &queue->entries[order[i]];
+    const size_t offset = entry->addr - start;
+    if (entry->is_coil) {
+      MYRIOTA_ModbusBitsetSet(bytes, nbytes, offset, entry->value != 0);
+    } else {
+      bytes[offset * 2] = entry->value >> 8;
+      bytes[offset * 2 + 1] = entry->value & 0xFF;
+    }
+  }
+
+  return head->is_coil
+           ? MYRIOTA_ModbusWriteCoils(queue->handle, head->slave, start, span, bytes)
+           : MYRIOTA_ModbusWriteHoldingRegisters(queue->handle, head->slave, start, span, bytes);
+}
+
+void MYRIOTA_ModbusWriteQueueInit(MYRIOTA_ModbusWriteQueue *const queue,
+  const MYRIOTA_ModbusHandle handle, const uint16_t max_gap) {
+  MODBUS_ASSERT(queue != NULL);
+  memset(queue, 0, sizeof(*queue));
+  queue->handle = handle;
+  queue->max_gap = max_gap;
+}
+
+int MYRIOTA_ModbusWriteQueueHoldingRegister(MYRIOTA_ModbusWriteQueue *const queue,
+  const MYRIOTA_ModbusDeviceAddress slave, const MYRIOTA_ModbusDataAddress addr,
+  const uint16_t value) {
+  return write_queue_add(queue, slave, false, addr, value);
+}
+
+int MYRIOTA_ModbusWriteQueueCoil(MYRIOTA_ModbusWriteQueue *const queue,
+  const MYRIOTA_ModbusDeviceAddress slave, const MYRIOTA_ModbusDataAddress addr,
+  const bool value) {
+  return write_queue_add(queue, slave, true, addr, value);
+}
+
+size_t MYRIOTA_ModbusWriteQueuePending(const MYRIOTA_ModbusWriteQueue *const queue) {
+  MODBUS_ASSERT(queue != NULL);
+  return queue->flushed ? 0 : queue->count;
+}
+
+int MYRIOTA_ModbusWriteQueueFlush(MYRIOTA_ModbusWriteQueue *const queue) {
+  MODBUS_ASSERT(queue != NULL);
+  if (queue->flushed) {
+    return MODBUS_SUCCESS;
+  }
+
+  uint8_t order[MYRIOTA_MODBUS_WRITE_QUEUE_SIZE];
+  write_queue_sort(queue, order);
+
+  int first_error = MODBUS_SUCCESS;
+  size_t first = 0;
+  while (first < queue->count) {
+    const MYRIOTA_ModbusWriteQueueEntry *const head = &queue->entries[order[first]];
+    const size_t limit = head->is_coil ? WRITE_QUEUE_MAX_COILS : WRITE_QUEUE_MAX_REGISTERS;
+
+    // Grow the span while the next write is for the same slave and type, is
+    // within the allowed gap and still fits in a single request.
+    bool has_gaps = false;
+    size_t last = first + 1;
+    while (last < queue->count) {
+      const MYRIOTA_ModbusWriteQueueEntry *const prev = &queue->entries[order[last - 1]];
+      const MYRIOTA_ModbusWriteQueueEntry *const next = &queue->entries[order[last]];
+      if (next->slave != head->slave || next->is_coil != head->is_coil) {
+        break;
+      }
+      const size_t gap = next->addr - prev->addr - 1;
+      if (gap > queue->max_gap || (size_t)(next->addr - head->addr) >= limit) {
+        break;
+      }
+      has_gaps = has_gaps || (gap > 0);
+      ++last;
+    }
+
+    const int result = write_queue_send_span(queue, order, first, last, has_gaps);
+    for (size_t i = first; i < last; ++i) {
+      queue->entries[order[i]].result = result;
+    }
+    if (result != MODBUS_SUCCESS && first_error == MODBUS_SUCCESS) {
+      first_error = result;
+    }
+    first = last;
+  }
+
+  queue->flushed = true;
+  return first_error;
+}
+
+int MYRIOTA_ModbusWriteQueueResult(const MYRIOTA_ModbusWriteQueue *const queue, const int ticket) {
+  MODBUS_ASSERT(queue != NULL);
+  if (!queue->flushed || ticket < 0 || (size_t)ticket >= queue->count) {
+    return -MODBUS_ERROR_BAD_STATE;
+  }
+  return queue->entries[ticket].result;
+}
+
+#ifdef MYRIOTA_MODBUS_WRITE_QUEUE_UNIT_TESTS
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+/*
+ * `cmocka.h` must be included after standard the above library headers.
+ * NOTE: This comment has dual purpose:
+ * 1. Document the ordering requirement.
+ * 2. Prevent `clang-format` from reordering the headers.
+ */
+#include <cmocka.h>
+
+#define FAKE_SLAVE 0x01
+
+// A minimal RTU slave that answers each request written to it.
+static struct {
+  uint16_t registers[256];
+  uint8_t coils[32];
+  uint8_t request_count[0x11];
+  uint8_t response[256];
+  size_t response_size;
+} fake;
+
+static uint16_t fake_crc16(const uint8_t *const buffer, const size_t size) {
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < size; ++i) {
+    crc ^= buffer[i];
+    for (int bit = 0; bit < 8; ++bit) {
+      crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+    }
+  }
+  return crc;
+}
+
+static int fake_init(void *const ctx) {
+  (void)ctx;
+  return 0;
+}
+
+static void fake_deinit(void *const ctx) {
+  (void)ctx;
+}
+
+static ssize_t fake_write(void *const ctx, const uint8_t *const buffer, const size_t count) {
+  (void)ctx;
+  const uint8_t function_code = buffer[1];
+  const uint16_t addr = (buffer[2] << 8) | buffer[3];
+  const uint16_t quantity = (buffer[4] << 8) | buffer[5];
+  ++fake.request_count[function_code];
+
+  uint8_t *const rsp = fake.response;
+  size_t size = 0;
+  rsp[size++] = FAKE_SLAVE;
+  rsp[size++] = function_code;
+  switch (function_code) {
+    case 0x01:
+      rsp[size++] = (quantity + 7) / 8;
+      memset(&rsp[size], 0, (quantity + 7) / 8);
+      MYRIOTA_ModbusBitsetCopy(&rsp[size], (quantity + 7) / 8, 0, fake.coils, sizeof(fake.coils),
+        addr, quantity);
+      size += (quantity + 7) / 8;
+      break;
+    case 0x03:
+      rsp[size++] = quantity * 2;
+      for (size_t i = 0; i < quantity; ++i) {
+        rsp[size++] = fake.registers[addr + i] >> 8;
+        rsp[size++] = fake.registers[addr + i] & 0xFF;
+      }
+      break;
+    case 0x05:
+      MYRIOTA_ModbusBitsetSet(fake.coils, sizeof(fake.coils), addr, buffer[4] == 0xFF);
+      memcpy(rsp, buffer, 6);
+      size = 6;
+      break;
+    case 0x06:
+      fake.registers[addr] = quantity;
+      memcpy(rsp, buffer, 6);
+      size = 6;
+      break;
+    case 0x0F:
+      MYRIOTA_ModbusBitsetCopy(fake.coils, sizeof(fake.coils), addr, &buffer[7], buffer[6], 0,
+        quantity);
+      memcpy(rsp, buffer, 6);
+      size = 6;
+      break;
+    case 0x10:
+      for (size_t i = 0; i < quantity; ++i) {
+        fake.registers[addr + i] = (buffer[7 + i * 2] << 8) | buffer[8 + i * 2];
+      }
+      memcpy(rsp, buffer, 6);
+      size = 6;
+      break;
+    default:
+      fail();
+  }
+  const uint16_t crc = fake_crc16(rsp, size);
+  rsp[size++] = crc & 0xFF;
+  rsp[size++] = crc >> 8;
+  fake.response_size = size;
+  return count;
+}
+
+static ssize_t fake_read(void *const ctx, uint8_t *const buffer, const size_t count) {
+  (void)ctx;
+  assert_true(fake.response_size <= count);
+  memcpy(buffer, fake.response, fake.response_size);
+  return fake.response_size;
+}
+
+static MYRIOTA_ModbusHandle fake_setup(void) {
+  memset(&fake, 0, sizeof(fake));
+  const MYRIOTA_ModbusInitOptions options = {
+    .framing_mode = MODBUS_FRAMING_MODE_RTU,
+    .serial_interface =
+      {
+        .init = fake_init,
+        .deinit = fake_deinit,
+        .read = fake_read,
+        .write = fake_write,
+      },
+  };
+  const MYRIOTA_ModbusHandle handle = MYRIOTA_ModbusInit(options);
+  assert_int_equal(MYRIOTA_ModbusEnable(handle), MODBUS_SUCCESS);
+  return handle;
+}
+
+static void test_contiguous_registers_merge(void **state) {
+  (void)state;
+  const MYRIOTA_ModbusHandle handle = fake_setup();
+  MYRIOTA_ModbusWriteQueue queue;
+  MYRIOTA_ModbusWriteQueueInit(&queue, handle, 0);
+
+  for (uint16_t i = 0; i < 30; ++i) {
+    assert_int_equal(MYRIOTA_ModbusWriteQueueHoldingRegister(&queue, FAKE_SLAVE, 29 - i, i), i);
+  }
+  // Last write wins and reuses the ticket.
+  assert_int_equal(MYRIOTA_ModbusWriteQueueHoldingRegister(&queue, FAKE_SLAVE, 29, 0xBEEF), 0);
+  assert_int_equal(MYRIOTA_ModbusWriteQueuePending(&queue), 30);
+
+  assert_int_equal(MYRIOTA_ModbusWriteQueueFlush(&queue), MODBUS_SUCCESS);
+  assert_int_equal(fake.request_count[0x10], 1);
+  assert_int_equal(fake.request_count[0x06], 0);
+  assert_int_equal(fake.registers[29], 0xBEEF);
+  assert_int_equal(fake.registers[0], 29);
+  assert_int_equal(MYRIOTA_ModbusWriteQueueResult(&queue, 5), MODBUS_SUCCESS);
+  assert_int_equal(MYRIOTA_ModbusWriteQueuePending(&queue), 0);
+
+  MYRIOTA_ModbusDeinit(handle);
+}
+
+static void test_gaps_and_singles(void **state) {
+  (void)state;
+  const MYRIOTA_ModbusHandle handle = fake_setup();
+  fake.registers[11] = 0x1111;
+  MYRIOTA_ModbusWriteQueue queue;
+  MYRIOTA_ModbusWriteQueueInit(&queue, handle, 1);
+
+  MYRIOTA_ModbusWriteQueueHoldingRegister(&queue, FAKE_SLAVE, 10, 0x0A0A);
+  MYRIOTA_ModbusWriteQueueHoldingRegister(&queue, FAKE_SLAVE, 12, 0x0C0C);
+  MYRIOTA_ModbusWriteQueueHoldingRegister(&queue, FAKE_SLAVE, 100, 0x6464);
+  assert_int_equal(MYRIOTA_ModbusWriteQueueResult(&queue, 0), -MODBUS_ERROR_BAD_STATE);
+
+  assert_int_equal(MYRIOTA_ModbusWriteQueueFlush(&queue), MODBUS_SUCCESS);
+  assert_int_equal(fake.request_count[0x03], 1);
+  assert_int_equal(fake.request_count[0x10], 1);
+  assert_int_equal(fake.request_count[0x06], 1);
+  assert_int_equal(fake.registers[10], 0x0A0A);
+  assert_int_equal(fake.registers[11], 0x1111);
+  assert_int_equal(fake.registers[12], 0x0C0C);
+  assert_int_equal(fake.registers[100], 0x6464);
+
+  MYRIOTA_ModbusDeinit(handle);
+}
+
+static void test_coils_merge(void **state) {
+  (void)state;
+  const MYRIOTA_ModbusHandle handle = fake_setup();
+  MYRIOTA_ModbusWriteQueue queue;
+  MYRIOTA_ModbusWriteQueueInit(&queue, handle, 0);
+
+  for (uint16_t i = 0; i < 20; ++i) {
+    MYRIOTA_ModbusWriteQueueCoil(&queue, FAKE_SLAVE, 40 + i, (i % 3) == 0);
+  }
+  MYRIOTA_ModbusWriteQueueCoil(&queue, FAKE_SLAVE, 3, true);
+
+  assert_int_equal(MYRIOTA_ModbusWriteQueueFlush(&queue), MODBUS_SUCCESS);
+  assert_int_equal(fake.request_count[0x0F], 1);
+  assert_int_equal(fake.request_count[0x05], 1);
+  assert_true(MYRIOTA_ModbusBitsetGet(fake.coils, sizeof(fake.coils), 3));
+  for (uint16_t i = 0; i < 20; ++i) {
+    assert_int_equal(MYRIOTA_ModbusBitsetGet(fake.coils, sizeof(fake.coils), 40 + i),
+      (i % 3) == 0);
+  }
+
+  MYRIOTA_ModbusDeinit(handle);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_contiguous_registers_merge),
+    cmocka_unit_test(test_gaps_and_singles),
+    cmocka_unit_test(test_coils_merge),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+#endif /** MYRIOTA_MODBUS_WRITE_QUEUE_UNIT_TESTS */
@@ -0,0 +1,188 @@
+/// \file msgqueue.h Myriota Priority Message Queue
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYRIOTA_MSGQUEUE_H
+#define MYRIOTA_MSGQUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+/** \defgroup MessageQueue Priority Message Queue
+ * @brief Choose which messages are kept when the message queue is full
+ *
+ * FLEX_MessageSchedule() replaces an existing message when the FlexSense
+ * message queue has no free slots, and the application cannot choose which.
+ * This library keeps a shadow queue of messages tagged with a priority and a
+ * lifetime, and only hands them to FLEX_MessageSchedule() while slots are
+ * free, highest priority first and oldest first within a priority.
+ *
+ * When the shadow queue is full, the oldest message of the lowest priority is
+ * evicted, or the new message is rejected if every queued message has a higher
+ * priority. Messages are kept in one FIFO per priority with a bitmap of the
+ * non-empty priorities, so adding, evicting and scheduling a message take
+ * constant time.
+ *
+ * Messages below MYRIOTA_MESSAGE_PRIORITY_ALARM leave `reserved_slots` slots
+ * of the FlexSense queue free, so an alarm never waits behind routine messages
+ * that are already in the FlexSense queue.
+ *
+ * \code
+ * static MYRIOTA_MessageQueue queue;
+ *
+ * static time_t queue_job(void) {
+ *   return MYRIOTA_MessageQueuePoll(&queue);
+ * }
+ *
+ * void FLEX_AppInit() {
+ *   const MYRIOTA_MessageQueueOptions options = {.reserved_slots = 1, .retry_interval_s = 600};
+ *   MYRIOTA_MessageQueueInit(&queue, &options);
+ *   FLEX_JobSchedule(queue_job, FLEX_ASAP());
+ * }
+ *
+ * MYRIOTA_MessageQueuePush(&queue, alarm, sizeof(alarm), MYRIOTA_MESSAGE_PRIORITY_ALARM, 0);
+ * \endcode
+ * \{
+ */
+
+/** The number of messages the queue can hold. */
+#ifndef MYRIOTA_MSGQUEUE_CAPACITY
+#define MYRIOTA_MSGQUEUE_CAPACITY 16
+#endif
+
+/** The largest message size that can be queued. */
+#ifndef MYRIOTA_MSGQUEUE_MESSAGE_SIZE_MAX
+#define MYRIOTA_MSGQUEUE_MESSAGE_SIZE_MAX 20
+#endif
+
+/** The priority of a message. Higher priorities are scheduled first and evicted last. */
+typedef enum {
+  MYRIOTA_MESSAGE_PRIORITY_LOW = 0,
+  MYRIOTA_MESSAGE_PRIORITY_NORMAL = 1,
+  MYRIOTA_MESSAGE_PRIORITY_HIGH = 2,
+  /** May use the slots reserved by `reserved_slots`. */
+  MYRIOTA_MESSAGE_PRIORITY_ALARM = 3,
+  MYRIOTA_MESSAGE_PRIORITY_COUNT,
+} MYRIOTA_MessagePriority;
+
+/** Configuration of a message queue. */
+typedef struct {
+  /** The number of FlexSense queue slots only MYRIOTA_MESSAGE_PRIORITY_ALARM
+   * messages may use. */
+  uint8_t reserved_slots;
+  /** The interval in seconds at which MYRIOTA_MessageQueuePoll() asks to be
+   * called again while messages wait for free slots. */
+  uint32_t retry_interval_s;
+} MYRIOTA_MessageQueueOptions;
+
+/** Statistics of a message queue. */
+typedef struct {
+  /** The number of messages handed to FLEX_MessageSchedule(). */
+  uint32_t scheduled_count;
+  /** The number of queued messages evicted for a message of equal or higher priority. */
+  uint32_t evicted_count;
+  /** The number of new messages rejected because the queue held higher priorities. */
+  uint32_t rejected_count;
+  /** The number of messages dropped because their lifetime expired. */
+  uint32_t expired_count;
+} MYRIOTA_MessageQueueStats;
+
+/** \cond INTERNAL_HIDDEN */
+typedef struct {
+  time_t expiry;
+  uint8_t next;
+  uint8_t size;
+  uint8_t data[MYRIOTA_MSGQUEUE_MESSAGE_SIZE_MAX];
+} MYRIOTA_MessageQueueEntry;
+/** \endcond */
+
+/** A priority message queue. Treat the members as private. */
+typedef struct {
+  /** \cond INTERNAL_HIDDEN */
+  MYRIOTA_MessageQueueOptions options;
+  uint8_t head[MYRIOTA_MESSAGE_PRIORITY_COUNT];
+  uint8_t tail[MYRIOTA_MESSAGE_PRIORITY_COUNT];
+  uint8_t non_empty;
+  uint8_t free;
+  uint8_t count;
+  MYRIOTA_MessageQueueStats stats;
+  MYRIOTA_MessageQueueEntry entries[MYRIOTA_MSGQUEUE_CAPACITY];
+  /** \endcond */
+} MYRIOTA_MessageQueue;
+
+/**
+ * Initializes an empty message queue.
+ *
+ * \param[out] queue The queue to initialize.
+ * \param[in] options The configuration of the queue.
+ */
+void MYRIOTA_MessageQueueInit(MYRIOTA_MessageQueue *const queue,
+  const MYRIOTA_MessageQueueOptions *const options);
+
+/**
+ * Add a message to the queue and schedule any messages the FlexSense queue can take.
+ *
+ * \param[in,out] queue The queue.
+ * \param[in] message The message.
+ * \param[in] size The size of the message in bytes.
+ * \param[in] priority The priority of the message.
+ * \param[in] lifetime_s The number of seconds after which the message is dropped
+ * if it has not been scheduled, or 0 if it never expires.
+ * \return FLEX_SUCCESS (0) if the message was queued and < 0 if failed.
+ * \retval -FLEX_ERROR_EINVAL: the size or priority is invalid.
+ * \retval -FLEX_ERROR_ENOBUFS: the queue is full of messages of higher priority.
+ */
+int MYRIOTA_MessageQueuePush(MYRIOTA_MessageQueue *const queue, const void *const message,
+  const size_t size, const MYRIOTA_MessagePriority priority, const uint32_t lifetime_s);
+
+/**
+ * Drop expired messages and schedule any messages the FlexSense queue can
+ * take, e.g. from a job that runs at the time returned by the previous call.
+ *
+ * \param[in,out] queue The queue.
+ * \return the time to poll again, or FLEX_Never() if the queue is empty.
+ */
+time_t MYRIOTA_MessageQueuePoll(MYRIOTA_MessageQueue *const queue);
+
+/**
+ * Schedule as many messages as the FlexSense queue can take, including the
+ * reserved slots, and then save the FlexSense queue to persistent storage with
+ * FLEX_MessageSave(), e.g. before a planned reset.
+ *
+ * \param[in,out] queue The queue.
+ * \return the number of messages left in the queue, which are lost on reset.
+ */
+int MYRIOTA_MessageQueueSave(MYRIOTA_MessageQueue *const queue);
+
+/**
+ * Returns the number of messages in the queue.
+ *
+ * \param[in] queue The queue.
+ */
+size_t MYRIOTA_MessageQueueCount(const MYRIOTA_MessageQueue *const queue);
+
+/**
+ * Get the statistics of a message queue.
+ *
+ * \param[in] queue The queue.
+ * \param[out] stats The statistics.
+ */
+void MYRIOTA_MessageQueueStatsGet(const MYRIOTA_MessageQueue *const queue,
+  MYRIOTA_MessageQueueStats *const stats);
+
+/**
+ * \}
+ */
+
+#endif /* MYRIOTA_MSGQUEUE_H */
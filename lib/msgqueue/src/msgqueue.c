@@ -0,0 +1,340 @@
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myriota/msgqueue.h"
+#include <stdbool.h>
+#include <string.h>
+#include "flex.h"
+#include "flex_errors.h"
+
+// NOTE: you can provide your own assert
+#ifndef MSGQUEUE_ASSERT
+#include <stdio.h>
+#define MSGQUEUE_ASSERT(cond)                        \
+  do {                                               \
+    if (!(cond)) {                                   \
+      printf("Assert @%s:%d\n", __FILE__, __LINE__); \
+      while (1) {                                    \
+      }                                              \
+    }                                                \
+  } while (0)
+#endif
+
+#define MSGQUEUE_NONE 0xFF
+
+_Static_assert(MYRIOTA_MSGQUEUE_CAPACITY > 0 && MYRIOTA_MSGQUEUE_CAPACITY < MSGQUEUE_NONE,
+  "MYRIOTA_MSGQUEUE_CAPACITY must be between 1 and 254");
+_Static_assert(MYRIOTA_MSGQUEUE_MESSAGE_SIZE_MAX <= UINT8_MAX,
+  "MYRIOTA_MSGQUEUE_MESSAGE_SIZE_MAX must fit in a byte");
+
+static inline bool msgqueue_is_expired(const MYRIOTA_MessageQueueEntry *const entry,
+  const time_t now) {
+  return entry->expiry != 0 && now >= entry->expiry;
+}
+
+// Removes the oldest message of a priority and returns its entry to the free list.
+static void msgqueue_pop(MYRIOTA_MessageQueue *const queue, const uint8_t priority) {
+  const uint8_t index = queue->head[priority];
+  queue->head[priority] = queue->entries[index].next;
+  if (queue->head[priority] == MSGQUEUE_NONE) {
+    queue->tail[priority] = MSGQUEUE_NONE;
+    queue->non_empty &= ~(1U << priority);
+  }
+  queue->entries[index].next = queue->free;
+  queue->free = index;
+  --queue->count;
+}
+
+// Drops the expired messages of every priority.
+static void msgqueue_purge(MYRIOTA_MessageQueue *const queue, const time_t now) {
+  for (uint8_t priority = 0; priority < MYRIOTA_MESSAGE_PRIORITY_COUNT; ++priority) {
+    uint8_t previous = MSGQUEUE_NONE;
+    uint8_t index = queue->head[priority];
+    while (index != MSGQUEUE_NONE) {
+      MYRIOTA_MessageQueueEntry *const entry = &queue->entries[index];
+      const uint8_t next = entry->next;
+      if (!msgqueue_is_expired(entry, now)) {
+        previous = index;
+      } else {
+        if (previous == MSGQUEUE_NONE) {
+          queue->head[priority] = next;
+        } else {
+          queue->entries[previous].next = next;
+        }
+        if (queue->tail[priority] == index) {
+          queue->tail[priority] = previous;
+        }
+        entry->next = queue->free;
+        queue->free = index;
+        --queue->count;
+        ++queue->stats.expired_count;
+      }
+      index = next;
+    }
+    if (queue->head[priority] == MSGQUEUE_NONE) {
+      queue->non_empty &= ~(1U << priority);
+    }
+  }
+}
+
+// Hands messages to the FlexSense queue, highest priority first, while it has
+// room for them. Unless `use_reserved` is set, messages below the alarm
+// priority leave the reserved slots free.
+static int msgqueue_schedule(MYRIOTA_MessageQueue *const queue, const bool use_reserved) {
+  const time_t now = FLEX_TimeGet();
+  while (queue->non_empty != 0) {
+    const uint8_t priority = 31 - __builtin_clz(queue->non_empty);
+    const MYRIOTA_MessageQueueEntry *const entry = &queue->entries[queue->head[priority]];
+    if (msgqueue_is_expired(entry, now)) {
+      msgqueue_pop(queue, priority);
+      ++queue->stats.expired_count;
+      continue;
+    }
+
+    const int reserved = (use_reserved || priority == MYRIOTA_MESSAGE_PRIORITY_ALARM) ?
+                           0 :
+                           queue->options.reserved_slots;
+    const size_t needed = entry->size + (size_t)reserved * MYRIOTA_MSGQUEUE_MESSAGE_SIZE_MAX;
+    if (FLEX_MessageSlotsFree() <= reserved || FLEX_MessageBytesFree() < needed) {
+      break;
+    }
+    const int result = FLEX_MessageSchedule(entry->data, entry->size);
+    if (result < 0) {
+      return result;
+    }
+    msgqueue_pop(queue, priority);
+    ++queue->stats.scheduled_count;
+  }
+  return FLEX_SUCCESS;
+}
+
+void MYRIOTA_MessageQueueInit(MYRIOTA_MessageQueue *const queue,
+  const MYRIOTA_MessageQueueOptions *const options) {
+  MSGQUEUE_ASSERT(queue != NULL);
+  MSGQUEUE_ASSERT(options != NULL);
+  MSGQUEUE_ASSERT(options->retry_interval_s > 0);
+  memset(queue, 0, sizeof(*queue));
+  queue->options = *options;
+  memset(queue->head, MSGQUEUE_NONE, sizeof(queue->head));
+  memset(queue->tail, MSGQUEUE_NONE, sizeof(queue->tail));
+  for (uint8_t i = 0; i < MYRIOTA_MSGQUEUE_CAPACITY; ++i) {
+    queue->entries[i].next = (i + 1 < MYRIOTA_MSGQUEUE_CAPACITY) ? i + 1 : MSGQUEUE_NONE;
+  }
+  queue->free = 0;
+}
+
+int MYRIOTA_MessageQueuePush(MYRIOTA_MessageQueue *const queue, const void *const message,
+  const size_t size, const MYRIOTA_MessagePriority priority, const uint32_t lifetime_s) {
+  MSGQUEUE_ASSERT(queue != NULL);
+  MSGQUEUE_ASSERT(message != NULL);
+  if (size == 0 || size > MYRIOTA_MSGQUEUE_MESSAGE_SIZE_MAX ||
+      (unsigned)priority >= MYRIOTA_MESSAGE_PRIORITY_COUNT) {
+    return -FLEX_ERROR_EINVAL;
+  }
+
+  if (queue->count == MYRIOTA_MSGQUEUE_CAPACITY) {
+    // Evict the oldest message of the lowest priority, unless it outranks this one.
+    const uint8_t lowest = __builtin_ctz(queue->non_empty);
+    if (lowest > priority) {
+      ++queue->stats.rejected_count;
+      return -FLEX_ERROR_ENOBUFS;
+    }
+    msgqueue_pop(queue, lowest);
+    ++queue->stats.evicted_count;
+  }
+
+  const uint8_t index = queue->free;
+  MYRIOTA_MessageQueueEntry *const entry = &queue->entries[index];
+  queue->free = entry->next;
+  entry->expiry = (lifetime_s > 0) ? FLEX_TimeGet() + lifetime_s : 0;
+  entry->next = MSGQUEUE_NONE;
+  entry->size = size;
+  memcpy(entry->data, message, size);
+
+  if (queue->tail[priority] == MSGQUEUE_NONE) {
+    queue->head[priority] = index;
+  } else {
+    queue->entries[queue->tail[priority]].next = index;
+  }
+  queue->tail[priority] = index;
+  queue->non_empty |= 1U << priority;
+  ++queue->count;
+
+  return msgqueue_schedule(queue, false);
+}
+
+time_t MYRIOTA_MessageQueuePoll(MYRIOTA_MessageQueue *const queue) {
+  MSGQUEUE_ASSERT(queue != NULL);
+  const time_t now = FLEX_TimeGet();
+  msgqueue_purge(queue, now);
+  msgqueue_schedule(queue, false);
+  if (queue->count == 0) {
+    return FLEX_Never();
+  }
+
+  time_t next = now + queue->options.retry_interval_s;
+  for (uint8_t priority = 0; priority < MYRIOTA_MESSAGE_PRIORITY_COUNT; ++priority) {
+    for (uint8_t i = queue->head[priority]; i != MSGQUEUE_NONE; i = queue->entries[i].next) {
+      const time_t expiry = queue->entries[i].expiry;
+      if (expiry != 0 && expiry < next) {
+        next = expiry;
+      }
+    }
+  }
+  return next;
+}
+
+int MYRIOTA_MessageQueueSave(MYRIOTA_MessageQueue *const queue) {
+  MSGQUEUE_ASSERT(queue != NULL);
+  msgqueue_schedule(queue, true);
+  FLEX_MessageSave();
+  return queue->count;
+}
+
+size_t MYRIOTA_MessageQueueCount(const MYRIOTA_MessageQueue *const queue) {
+  MSGQUEUE_ASSERT(queue != NULL);
+  return queue->count;
+}
+
+void MYRIOTA_MessageQueueStatsGet(const MYRIOTA_MessageQueue *const queue,
+  MYRIOTA_MessageQueueStats *const stats) {
+  MSGQUEUE_ASSERT(queue != NULL);
+  MSGQUEUE_ASSERT(stats != NULL);
+  *stats = queue->stats;
+}
+
+#ifdef MYRIOTA_MSGQUEUE_UNIT_TESTS
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+/*
+ * `cmocka.h` must be included after standard the above library headers.
+ * NOTE: This comment has dual purpose:
+ * 1. Document the ordering requirement.
+ * 2. Prevent `clang-format` from reordering the headers.
+ */
+#include <cmocka.h>
+#include "myriota/flex_fake.h"
+
+static void fake_setup(MYRIOTA_MessageQueue *const queue, const uint8_t reserved_slots) {
+  MYRIOTA_FlexFakeReset();
+  flex_fake.time = 1000;
+  flex_fake.slots_free = 0;
+  flex_fake.bytes_free = 1024;
+  const MYRIOTA_MessageQueueOptions options = {
+    .reserved_slots = reserved_slots,
+    .retry_interval_s = 600,
+  };
+  MYRIOTA_MessageQueueInit(queue, &options);
+}
+
+static int push(MYRIOTA_MessageQueue *const queue, const uint8_t id,
+  const MYRIOTA_MessagePriority priority, const uint32_t lifetime_s) {
+  const uint8_t message[10] = {id};
+  return MYRIOTA_MessageQueuePush(queue, message, sizeof(message), priority, lifetime_s);
+}
+
+static void test_evicts_lowest_priority_oldest_first(void **state) {
+  (void)state;
+  static MYRIOTA_MessageQueue queue;
+  fake_setup(&queue, 0);
+
+  for (uint8_t i = 0; i < MYRIOTA_MSGQUEUE_CAPACITY; ++i) {
+    assert_int_equal(push(&queue, i, (i < 2) ? MYRIOTA_MESSAGE_PRIORITY_LOW :
+                                               MYRIOTA_MESSAGE_PRIORITY_HIGH, 0),
+      FLEX_SUCCESS);
+  }
+  assert_int_equal(push(&queue, 100, MYRIOTA_MESSAGE_PRIORITY_NORMAL, 0), FLEX_SUCCESS);
+  assert_int_equal(push(&queue, 101, MYRIOTA_MESSAGE_PRIORITY_NORMAL, 0), FLEX_SUCCESS);
+  assert_int_equal(push(&queue, 102, MYRIOTA_MESSAGE_PRIORITY_NORMAL, 0), FLEX_SUCCESS);
+  assert_int_equal(push(&queue, 103, MYRIOTA_MESSAGE_PRIORITY_LOW, 0), -FLEX_ERROR_ENOBUFS);
+  assert_int_equal(push(&queue, 104, MYRIOTA_MESSAGE_PRIORITY_COUNT, 0), -FLEX_ERROR_EINVAL);
+
+  MYRIOTA_MessageQueueStats stats;
+  MYRIOTA_MessageQueueStatsGet(&queue, &stats);
+  assert_int_equal(stats.evicted_count, 3);
+  assert_int_equal(stats.rejected_count, 1);
+  assert_int_equal(MYRIOTA_MessageQueueCount(&queue), MYRIOTA_MSGQUEUE_CAPACITY);
+
+  // Higher priorities are scheduled first, oldest first within a priority.
+  flex_fake.slots_free = MYRIOTA_MSGQUEUE_CAPACITY;
+  assert_int_equal(MYRIOTA_MessageQueuePoll(&queue), FLEX_Never());
+  assert_int_equal(flex_fake.message_count, MYRIOTA_MSGQUEUE_CAPACITY);
+  assert_int_equal(flex_fake.messages[0][0], 2);
+  assert_int_equal(flex_fake.messages[MYRIOTA_MSGQUEUE_CAPACITY - 2][0], 101);
+  assert_int_equal(flex_fake.messages[MYRIOTA_MSGQUEUE_CAPACITY - 1][0], 102);
+}
+
+static void test_reserved_slots_for_alarms(void **state) {
+  (void)state;
+  static MYRIOTA_MessageQueue queue;
+  fake_setup(&queue, 1);
+  flex_fake.slots_free = 3;
+
+  for (uint8_t i = 0; i < 5; ++i) {
+    push(&queue, i, MYRIOTA_MESSAGE_PRIORITY_NORMAL, 0);
+  }
+  assert_int_equal(flex_fake.message_count, 2);
+  assert_int_equal(MYRIOTA_MessageQueuePoll(&queue), flex_fake.time + 600);
+
+  // The alarm takes the reserved slot straight away.
+  push(&queue, 50, MYRIOTA_MESSAGE_PRIORITY_ALARM, 0);
+  assert_int_equal(flex_fake.message_count, 3);
+  assert_int_equal(flex_fake.messages[2][0], 50);
+
+  flex_fake.slots_free = 2;
+  MYRIOTA_MessageQueuePoll(&queue);
+  assert_int_equal(flex_fake.message_count, 4);
+  assert_int_equal(MYRIOTA_MessageQueueSave(&queue), 1);
+  assert_int_equal(flex_fake.message_count, 5);
+  assert_int_equal(flex_fake.save_count, 1);
+}
+
+static void test_expired_messages_are_dropped(void **state) {
+  (void)state;
+  static MYRIOTA_MessageQueue queue;
+  fake_setup(&queue, 0);
+
+  push(&queue, 1, MYRIOTA_MESSAGE_PRIORITY_NORMAL, 0);
+  push(&queue, 2, MYRIOTA_MESSAGE_PRIORITY_NORMAL, 100);
+  push(&queue, 3, MYRIOTA_MESSAGE_PRIORITY_HIGH, 300);
+  assert_int_equal(MYRIOTA_MessageQueuePoll(&queue), flex_fake.time + 100);
+
+  flex_fake.time += 100;
+  assert_int_equal(MYRIOTA_MessageQueuePoll(&queue), flex_fake.time + 200);
+  assert_int_equal(MYRIOTA_MessageQueueCount(&queue), 2);
+
+  // The expired high priority message is dropped rather than scheduled.
+  flex_fake.time += 200;
+  flex_fake.slots_free = 1;
+  MYRIOTA_MessageQueuePoll(&queue);
+  assert_int_equal(flex_fake.message_count, 1);
+  assert_int_equal(flex_fake.messages[0][0], 1);
+
+  MYRIOTA_MessageQueueStats stats;
+  MYRIOTA_MessageQueueStatsGet(&queue, &stats);
+  assert_int_equal(stats.expired_count, 2);
+  assert_int_equal(MYRIOTA_MessageQueueCount(&queue), 0);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_evicts_lowest_priority_oldest_first),
+    cmocka_unit_test(test_reserved_slots_for_alarms),
+    cmocka_unit_test(test_expired_messages_are_dropped),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+#endif /** MYRIOTA_MSGQUEUE_UNIT_TESTS */
@@ -0,0 +1,120 @@
+/// \file parity.h Myriota Message Parity Coding
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYRIOTA_PARITY_H
+#define MYRIOTA_PARITY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** \defgroup Parity Message Parity Coding
+ * @brief Recover lost messages from parity messages
+ *
+ * Groups the messages scheduled with MYRIOTA_ParitySchedule() and, after every
+ * `data_count` messages, schedules `parity_count` parity messages for the
+ * group. With one parity message the parity is the XOR of the group, which
+ * recovers any single lost message. With more, the parity messages are a
+ * Reed-Solomon style code over GF(256), which recovers up to `parity_count`
+ * lost data messages when the parity messages are received.
+ *
+ * Every message starts with a one byte header of the group sequence number in
+ * the high nibble and the index in the group in the low nibble, where parity
+ * messages count down from index 15. Messages are decoded, and lost messages
+ * recovered, with `scripts/parity_decode.py`.
+ *
+ * \code
+ * static MYRIOTA_Parity parity;
+ * const MYRIOTA_ParityOptions options = {.data_count = 4, .parity_count = 1};
+ * MYRIOTA_ParityInit(&parity, &options);
+ *
+ * MYRIOTA_ParitySchedule(&parity, payload, sizeof(payload));
+ * \endcode
+ * \{
+ */
+
+/** The largest message size, including the header, that can be scheduled. */
+#ifndef MYRIOTA_PARITY_MESSAGE_SIZE_MAX
+#define MYRIOTA_PARITY_MESSAGE_SIZE_MAX 64
+#endif
+
+/** The largest number of parity messages per group. */
+#ifndef MYRIOTA_PARITY_COUNT_MAX
+#define MYRIOTA_PARITY_COUNT_MAX 2
+#endif
+
+/** The number of bytes a data message grows by. */
+#define MYRIOTA_PARITY_HEADER_SIZE 1
+
+/** The largest data message, which leaves room for the header, group size
+ * and length bytes of the parity messages. */
+#define MYRIOTA_PARITY_DATA_SIZE_MAX (MYRIOTA_PARITY_MESSAGE_SIZE_MAX - 3)
+
+/** Configuration of parity coding. */
+typedef struct {
+  /** The number of data messages per group, at least 1. */
+  uint8_t data_count;
+  /** The number of parity messages per group, from 1 to
+   * MYRIOTA_PARITY_COUNT_MAX. `data_count + parity_count` must be at most 16. */
+  uint8_t parity_count;
+} MYRIOTA_ParityOptions;
+
+/** A parity encoder. Treat the members as private. */
+typedef struct {
+  /** \cond INTERNAL_HIDDEN */
+  MYRIOTA_ParityOptions options;
+  uint8_t group;
+  uint8_t index;
+  uint8_t size;
+  uint8_t parity[MYRIOTA_PARITY_COUNT_MAX][MYRIOTA_PARITY_DATA_SIZE_MAX + 1];
+  /** \endcond */
+} MYRIOTA_Parity;
+
+/**
+ * Initializes a parity encoder.
+ *
+ * \param[out] parity The encoder to initialize.
+ * \param[in] options The configuration of the encoder.
+ */
+void MYRIOTA_ParityInit(MYRIOTA_Parity *const parity, const MYRIOTA_ParityOptions *const options);
+
+/**
+ * Schedule a data message with FLEX_MessageSchedule(), followed by the parity
+ * messages of its group if it completes the group.
+ *
+ * \param[in,out] parity The encoder.
+ * \param[in] message The message.
+ * \param[in] size The size of the message, at most MYRIOTA_PARITY_DATA_SIZE_MAX.
+ * \return FLEX_SUCCESS (0) if succeeded and < 0 if failed.
+ * \retval -FLEX_ERROR_EINVAL: the message is empty or too large.
+ * Errors of FLEX_MessageSchedule() are returned, in which case the data
+ * message is not part of the group if it was not scheduled.
+ */
+int MYRIOTA_ParitySchedule(MYRIOTA_Parity *const parity, const uint8_t *const message,
+  const size_t size);
+
+/**
+ * Schedule the parity messages of a partial group, e.g. before a planned reset
+ * or at the end of a batch, and start a new group.
+ *
+ * \param[in,out] parity The encoder.
+ * \return FLEX_SUCCESS (0) if succeeded, or there are no data messages to
+ * protect, and < 0 if FLEX_MessageSchedule() failed.
+ */
+int MYRIOTA_ParityFlush(MYRIOTA_Parity *const parity);
+
+/**
+ * \}
+ */
+
+#endif /* MYRIOTA_PARITY_H */
@@ -0,0 +1,228 @@
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myriota/parity.h"
+#include <string.h>
+#include "flex.h"
+#include "flex_errors.h"
+
+// NOTE: you can provide your own assert
+#ifndef PARITY_ASSERT
+#include <stdio.h>
+#define PARITY_ASSERT(cond)                          \
+  do {                                               \
+    if (!(cond)) {                                   \
+      printf("Assert @%s:%d\n", __FILE__, __LINE__); \
+      while (1) {                                    \
+      }                                              \
+    }                                                \
+  } while (0)
+#endif
+
+#define PARITY_INDEX_COUNT 16
+// The reduction polynomial of GF(256), x^8 + x^4 + x^3 + x^2 + 1.
+#define PARITY_GF_POLYNOMIAL 0x11D
+
+_Static_assert(MYRIOTA_PARITY_MESSAGE_SIZE_MAX > 3 && MYRIOTA_PARITY_MESSAGE_SIZE_MAX <= 256,
+  "MYRIOTA_PARITY_MESSAGE_SIZE_MAX must be between 4 and 256");
+
+static inline uint8_t parity_header(const uint8_t group, const uint8_t index) {
+  return (uint8_t)((group % 16) << 4 | index);
+}
+
+static uint8_t gf_multiply(uint8_t a, uint8_t b) {
+  uint8_t product = 0;
+  while (b != 0) {
+    if (b & 1) {
+      product ^= a;
+    }
+    a = (a & 0x80) ? (uint8_t)((a << 1) ^ PARITY_GF_POLYNOMIAL) : (uint8_t)(a << 1);
+    b >>= 1;
+  }
+  return product;
+}
+
+// The coefficient of data message `index` in parity message `row`, 2^(index * row).
+static uint8_t parity_coefficient(const uint8_t index, const uint8_t row) {
+  uint8_t coefficient = 1;
+  for (unsigned i = 0; i < (unsigned)index * row; ++i) {
+    coefficient = gf_multiply(coefficient, 2);
+  }
+  return coefficient;
+}
+
+static int parity_schedule_parity(MYRIOTA_Parity *const parity) {
+  int result = FLEX_SUCCESS;
+  if (parity->index > 0) {
+    for (uint8_t row = 0; row < parity->options.parity_count && result >= 0; ++row) {
+      uint8_t message[MYRIOTA_PARITY_MESSAGE_SIZE_MAX];
+      message[0] = parity_header(parity->group, PARITY_INDEX_COUNT - 1 - row);
+      message[1] = parity->index;
+      memcpy(&message[2], parity->parity[row], parity->size);
+      result = FLEX_MessageSchedule(message, 2 + parity->size);
+    }
+  }
+
+  ++parity->group;
+  parity->index = 0;
+  parity->size = 0;
+  memset(parity->parity, 0, sizeof(parity->parity));
+  return (result < 0) ? result : FLEX_SUCCESS;
+}
+
+void MYRIOTA_ParityInit(MYRIOTA_Parity *const parity, const MYRIOTA_ParityOptions *const options) {
+  PARITY_ASSERT(parity != NULL);
+  PARITY_ASSERT(options != NULL);
+  PARITY_ASSERT(options->data_count >= 1);
+  PARITY_ASSERT(options->parity_count >= 1 && options->parity_count <= MYRIOTA_PARITY_COUNT_MAX);
+  PARITY_ASSERT(options->data_count + options->parity_count <= PARITY_INDEX_COUNT);
+  memset(parity, 0, sizeof(*parity));
+  parity->options = *options;
+}
+
+int MYRIOTA_ParitySchedule(MYRIOTA_Parity *const parity, const uint8_t *const message,
+  const size_t size) {
+  PARITY_ASSERT(parity != NULL);
+  PARITY_ASSERT(message != NULL);
+  if (size == 0 || size > MYRIOTA_PARITY_DATA_SIZE_MAX) {
+    return -FLEX_ERROR_EINVAL;
+  }
+
+  uint8_t data[MYRIOTA_PARITY_MESSAGE_SIZE_MAX];
+  data[0] = parity_header(parity->group, parity->index);
+  memcpy(&data[1], message, size);
+  const int result = FLEX_MessageSchedule(data, MYRIOTA_PARITY_HEADER_SIZE + size);
+  if (result < 0) {
+    return result;
+  }
+
+  // The parity covers the length of each message followed by its bytes, so
+  // that the decoder can recover messages of different sizes.
+  data[0] = size;
+  for (uint8_t row = 0; row < parity->options.parity_count; ++row) {
+    const uint8_t coefficient = parity_coefficient(parity->index, row);
+    for (size_t i = 0; i <= size; ++i) {
+      parity->parity[row][i] ^= gf_multiply(coefficient, data[i]);
+    }
+  }
+  parity->size = (size + 1 > parity->size) ? size + 1 : parity->size;
+
+  if (++parity->index == parity->options.data_count) {
+    return parity_schedule_parity(parity);
+  }
+  return FLEX_SUCCESS;
+}
+
+int MYRIOTA_ParityFlush(MYRIOTA_Parity *const parity) {
+  PARITY_ASSERT(parity != NULL);
+  if (parity->index == 0) {
+    return FLEX_SUCCESS;
+  }
+  return parity_schedule_parity(parity);
+}
+
+#ifdef MYRIOTA_PARITY_UNIT_TESTS
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+/*
+ * `cmocka.h` must be included after standard the above library headers.
+ * NOTE: This comment has dual purpose:
+ * 1. Document the ordering requirement.
+ * 2. Prevent `clang-format` from reordering the headers.
+ */
+#include <cmocka.h>
+#include "myriota/flex_fake.h"
+
+static void test_xor_parity(void **state) {
+  (void)state;
+  MYRIOTA_FlexFakeReset();
+  MYRIOTA_Parity parity;
+  const MYRIOTA_ParityOptions options = {.data_count = 3, .parity_count = 1};
+  MYRIOTA_ParityInit(&parity, &options);
+
+  const uint8_t messages[3][3] = {{0x01, 0x02, 0x03}, {0x10, 0x20}, {0xAA}};
+  assert_int_equal(MYRIOTA_ParitySchedule(&parity, messages[0], 3), FLEX_SUCCESS);
+  assert_int_equal(MYRIOTA_ParitySchedule(&parity, messages[1], 2), FLEX_SUCCESS);
+  assert_int_equal(flex_fake.message_count, 2);
+  assert_int_equal(MYRIOTA_ParitySchedule(&parity, messages[2], 1), FLEX_SUCCESS);
+  assert_int_equal(flex_fake.message_count, 4);
+
+  assert_int_equal(flex_fake.message_sizes[1], 3);
+  assert_int_equal(flex_fake.messages[1][0], 0x01);
+  assert_memory_equal(&flex_fake.messages[1][1], messages[1], 2);
+
+  // Group 0 parity: count, then the XOR of the lengths and padded messages.
+  const uint8_t expected[] = {0x0F, 3, 3 ^ 2 ^ 1, 0x01 ^ 0x10 ^ 0xAA, 0x02 ^ 0x20, 0x03};
+  assert_int_equal(flex_fake.message_sizes[3], sizeof(expected));
+  assert_memory_equal(flex_fake.messages[3], expected, sizeof(expected));
+
+  // The next group has the next sequence number.
+  MYRIOTA_ParitySchedule(&parity, messages[2], 1);
+  assert_int_equal(flex_fake.messages[4][0], 0x10);
+}
+
+static void test_reed_solomon_parity(void **state) {
+  (void)state;
+  MYRIOTA_FlexFakeReset();
+  MYRIOTA_Parity parity;
+  const MYRIOTA_ParityOptions options = {.data_count = 4, .parity_count = 2};
+  MYRIOTA_ParityInit(&parity, &options);
+
+  const uint8_t message[] = {0x80};
+  MYRIOTA_ParitySchedule(&parity, message, 1);
+  MYRIOTA_ParitySchedule(&parity, message, 1);
+  assert_int_equal(MYRIOTA_ParityFlush(&parity), FLEX_SUCCESS);
+  assert_int_equal(flex_fake.message_count, 4);
+
+  // Row 1 weights message i by 2^i: 0x80 ^ 2 * 0x80 = 0x80 ^ 0x1D.
+  const uint8_t expected[] = {0x0E, 2, 1 ^ 2, 0x80 ^ 0x1D};
+  assert_memory_equal(flex_fake.messages[3], expected, sizeof(expected));
+  assert_int_equal(MYRIOTA_ParityFlush(&parity), FLEX_SUCCESS);
+  assert_int_equal(flex_fake.message_count, 4);
+}
+
+static void test_errors(void **state) {
+  (void)state;
+  MYRIOTA_FlexFakeReset();
+  MYRIOTA_Parity parity;
+  const MYRIOTA_ParityOptions options = {.data_count = 2, .parity_count = 1};
+  MYRIOTA_ParityInit(&parity, &options);
+
+  uint8_t message[MYRIOTA_PARITY_DATA_SIZE_MAX + 1] = {0};
+  assert_int_equal(MYRIOTA_ParitySchedule(&parity, message, 0), -FLEX_ERROR_EINVAL);
+  assert_int_equal(MYRIOTA_ParitySchedule(&parity, message, sizeof(message)),
+    -FLEX_ERROR_EINVAL);
+
+  // A message that was not scheduled is not part of the group.
+  flex_fake.message_result = -FLEX_ERROR_EIO;
+  assert_int_equal(MYRIOTA_ParitySchedule(&parity, message, 1), -FLEX_ERROR_EIO);
+  flex_fake.message_result = 0;
+  MYRIOTA_ParitySchedule(&parity, message, MYRIOTA_PARITY_DATA_SIZE_MAX);
+  assert_int_equal(flex_fake.messages[0][0], 0x00);
+  MYRIOTA_ParitySchedule(&parity, message, 1);
+  assert_int_equal(flex_fake.message_count, 3);
+  assert_int_equal(flex_fake.message_sizes[2], MYRIOTA_PARITY_MESSAGE_SIZE_MAX);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_xor_parity),
+    cmocka_unit_test(test_reed_solomon_parity),
+    cmocka_unit_test(test_errors),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+#endif /** MYRIOTA_PARITY_UNIT_TESTS */
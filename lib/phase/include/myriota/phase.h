@@ -0,0 +1,102 @@
+/// \file phase.h Myriota Phase Spreading
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYRIOTA_PHASE_H
+#define MYRIOTA_PHASE_H
+
+#include <stdint.h>
+#include <time.h>
+
+/** \defgroup Phase Phase Spreading
+ * @brief Spread the runs of periodic jobs evenly across a fleet of devices
+ *
+ * A job that returns FLEX_TimeGet() plus its period runs in lockstep on all
+ * devices that started at the same time, which concentrates the load on
+ * shared buses, gateways and the backend. A phase places the runs of a job at
+ * a fixed offset within each period, counted from the Unix epoch, where the
+ * offset is a hash of the module ID from FLEX_ModuleIDGet() and a per-job
+ * salt. The offsets of a fleet are spread evenly without any coordination,
+ * and as they only depend on the time, a device keeps its phase across resets
+ * and clock corrections.
+ *
+ * \code
+ * static MYRIOTA_Phase phase;
+ *
+ * static time_t send_message(void) {
+ *   ...
+ *   return MYRIOTA_PhaseNext(&phase);
+ * }
+ *
+ * void FLEX_AppInit() {
+ *   MYRIOTA_PhaseInit(&phase, 24 * 3600 / MESSAGES_PER_DAY, 0);
+ *   FLEX_JobSchedule(send_message, MYRIOTA_PhaseFirst(&phase));
+ * }
+ * \endcode
+ * \{
+ */
+
+/** The phase of a periodic job. */
+typedef struct {
+  /** The period in seconds. */
+  uint32_t period_s;
+  /** The offset in seconds of the runs within each period. */
+  uint32_t offset_s;
+} MYRIOTA_Phase;
+
+/**
+ * Initializes the phase of a job from the module ID of the device.
+ *
+ * \param[out] phase The phase to initialize.
+ * \param[in] period_s The period of the job in seconds, which is best a
+ * divisor of a day so that the runs are at the same times each day.
+ * \param[in] salt A value that differs between the jobs of a device, so that
+ * they do not all run at the same offset.
+ */
+void MYRIOTA_PhaseInit(MYRIOTA_Phase *const phase, const uint32_t period_s, const uint32_t salt);
+
+/**
+ * Returns the offset in seconds within a period for a module ID and salt,
+ * which is the offset used by MYRIOTA_PhaseInit().
+ *
+ * \param[in] module_id The module ID, or NULL if it is not available, in
+ * which case every device has the same offset for a salt.
+ * \param[in] period_s The period in seconds.
+ * \param[in] salt The salt of the job.
+ * \return the offset, less than the period.
+ */
+uint32_t MYRIOTA_PhaseOffset(const char *const module_id, const uint32_t period_s,
+  const uint32_t salt);
+
+/**
+ * Returns the time of the first run of a job, which is the first time of the
+ * phase after now.
+ *
+ * \param[in] phase The phase of the job.
+ */
+time_t MYRIOTA_PhaseFirst(const MYRIOTA_Phase *const phase);
+
+/**
+ * Returns the time of the next run of a job, which is its return value. This
+ * is the first time of the phase at least half a period after now, so a job
+ * that runs early or late by less than half a period runs once per period.
+ *
+ * \param[in] phase The phase of the job.
+ */
+time_t MYRIOTA_PhaseNext(const MYRIOTA_Phase *const phase);
+
+/**
+ * \}
+ */
+
+#endif /* MYRIOTA_PHASE_H */
@@ -0,0 +1,156 @@
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myriota/phase.h"
+#include "flex.h"
+
+// NOTE: you can provide your own assert
+#ifndef PHASE_ASSERT
+#include <stdio.h>
+#define PHASE_ASSERT(cond)                           \
+  do {                                               \
+    if (!(cond)) {                                   \
+      printf("Assert @%s:%d\n", __FILE__, __LINE__); \
+      while (1) {                                    \
+      }                                              \
+    }                                                \
+  } while (0)
+#endif
+
+#define PHASE_FNV_OFFSET 2166136261U
+#define PHASE_FNV_PRIME 16777619U
+
+// FNV-1a hash of the salt and the module ID, with the finalizer of MurmurHash3
+// so that module IDs differing in a single digit have unrelated offsets.
+static uint32_t phase_hash(const char *module_id, const uint32_t salt) {
+  uint32_t hash = PHASE_FNV_OFFSET;
+  for (int i = 0; i < 4; ++i) {
+    hash = (hash ^ ((salt >> (8 * i)) & 0xFF)) * PHASE_FNV_PRIME;
+  }
+  if (module_id != NULL) {
+    for (; *module_id != '\0'; ++module_id) {
+      hash = (hash ^ (uint8_t)*module_id) * PHASE_FNV_PRIME;
+    }
+  }
+  hash ^= hash >> 16;
+  hash *= 0x85EBCA6BU;
+  hash ^= hash >> 13;
+  hash *= 0xC2B2AE35U;
+  hash ^= hash >> 16;
+  return hash;
+}
+
+// The first time of the phase after `time`.
+static time_t phase_after(const MYRIOTA_Phase *const phase, const time_t time) {
+  const time_t period = phase->period_s;
+  time_t offset = (time - (time_t)phase->offset_s) % period;
+  offset = (offset < 0) ? offset + period : offset;
+  return time - offset + period;
+}
+
+void MYRIOTA_PhaseInit(MYRIOTA_Phase *const phase, const uint32_t period_s, const uint32_t salt) {
+  PHASE_ASSERT(phase != NULL);
+  PHASE_ASSERT(period_s > 0);
+  phase->period_s = period_s;
+  phase->offset_s = MYRIOTA_PhaseOffset(FLEX_ModuleIDGet(), period_s, salt);
+}
+
+uint32_t MYRIOTA_PhaseOffset(const char *const module_id, const uint32_t period_s,
+  const uint32_t salt) {
+  PHASE_ASSERT(period_s > 0);
+  return phase_hash(module_id, salt) % period_s;
+}
+
+time_t MYRIOTA_PhaseFirst(const MYRIOTA_Phase *const phase) {
+  PHASE_ASSERT(phase != NULL);
+  return phase_after(phase, FLEX_TimeGet());
+}
+
+time_t MYRIOTA_PhaseNext(const MYRIOTA_Phase *const phase) {
+  PHASE_ASSERT(phase != NULL);
+  return phase_after(phase, FLEX_TimeGet() + phase->period_s / 2);
+}
+
+#ifdef MYRIOTA_PHASE_UNIT_TESTS
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+/*
+ * `cmocka.h` must be included after standard the above library headers.
+ * NOTE: This comment has dual purpose:
+ * 1. Document the ordering requirement.
+ * 2. Prevent `clang-format` from reordering the headers.
+ */
+#include <cmocka.h>
+#include "myriota/flex_fake.h"
+
+static void test_spread(void **state) {
+  (void)state;
+  // The offsets of consecutive module IDs fill the bins of a period evenly.
+  enum { DEVICES = 4000, BINS = 8, PERIOD = 6 * 3600 };
+  int bins[BINS] = {0};
+  char module_id[32];
+  for (int i = 0; i < DEVICES; ++i) {
+    snprintf(module_id, sizeof(module_id), "00%08x M1-24", 0x1a2b00 + i);
+    const uint32_t offset = MYRIOTA_PhaseOffset(module_id, PERIOD, 0);
+    assert_true(offset < PERIOD);
+    ++bins[offset * BINS / PERIOD];
+  }
+  for (int i = 0; i < BINS; ++i) {
+    assert_in_range(bins[i], DEVICES / BINS * 9 / 10, DEVICES / BINS * 11 / 10);
+  }
+
+  // The salt moves the jobs of a device apart, and the offset is stable.
+  assert_int_not_equal(MYRIOTA_PhaseOffset(module_id, PERIOD, 0),
+    MYRIOTA_PhaseOffset(module_id, PERIOD, 1));
+  assert_int_equal(MYRIOTA_PhaseOffset(module_id, PERIOD, 1),
+    MYRIOTA_PhaseOffset(module_id, PERIOD, 1));
+  assert_true(MYRIOTA_PhaseOffset(NULL, PERIOD, 0) < PERIOD);
+}
+
+static void test_next(void **state) {
+  (void)state;
+  MYRIOTA_FlexFakeReset();
+  flex_fake.module_id = "001a2b3c4d M1-24";
+  flex_fake.time = 1700000000;
+  MYRIOTA_Phase phase;
+  MYRIOTA_PhaseInit(&phase, 3600, 7);
+  assert_int_equal(phase.offset_s, MYRIOTA_PhaseOffset(flex_fake.module_id, 3600, 7));
+
+  const time_t first = MYRIOTA_PhaseFirst(&phase);
+  assert_true(first > flex_fake.time && first <= flex_fake.time + 3600);
+  assert_int_equal(first % 3600, phase.offset_s);
+
+  // Runs a little early or late keep to the phase.
+  flex_fake.time = first + 30;
+  assert_int_equal(MYRIOTA_PhaseNext(&phase), first + 3600);
+  flex_fake.time = first + 3600 - 40;
+  assert_int_equal(MYRIOTA_PhaseNext(&phase), first + 7200);
+
+  // A reset or clock correction keeps the phase.
+  flex_fake.time = first + 10 * 3600 + 1234;
+  assert_int_equal(MYRIOTA_PhaseFirst(&phase), first + 11 * 3600);
+  flex_fake.time = first - 1;
+  assert_int_equal(MYRIOTA_PhaseFirst(&phase), first);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_spread),
+    cmocka_unit_test(test_next),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+#endif /** MYRIOTA_PHASE_UNIT_TESTS */
@@ -0,0 +1,222 @@
+/// \file powerwindow.h Myriota Power Window
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYRIOTA_POWERWINDOW_H
+#define MYRIOTA_POWERWINDOW_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include "flex.h"
+#include "myriota/resource.h"
+
+/** \defgroup PowerWindow Power Window
+ * @brief Share one power-up between sensor jobs that are due close together
+ *
+ * A sensor job typically powers the output rail, waits for the sensor to
+ * stabilise and powers the rail down again. Two sensors on slightly different
+ * schedules power the rail twice and pay the warm-up twice.
+ *
+ * Power window jobs declare the interfaces they need and a window of seconds
+ * by which they may run early. When a job is due, every job whose window has
+ * opened and whose interfaces are compatible runs in the same session, which
+ * acquires the interfaces once, waits for the longest warm-up of its jobs
+ * once, runs the jobs and releases the interfaces.
+ *
+ * Sessions acquire the interfaces from a resource manager, so they share the
+ * interfaces with the other drivers of the application. An interface that
+ * another user already has on is not initialised again, and the warm-up only
+ * waits for the part that has not passed since it was initialised.
+ *
+ * \code
+ * static MYRIOTA_ResourceManager resources;
+ * static MYRIOTA_PowerWindow power_window;
+ * static MYRIOTA_PowerWindowJob level_job, flow_job;
+ *
+ * static time_t power_window_job(void) {
+ *   return MYRIOTA_PowerWindowPoll(&power_window);
+ * }
+ *
+ * static time_t read_level(void *const context, const int status) {
+ *   if (status == FLEX_SUCCESS) {
+ *     FLEX_AnalogInputReadCurrent(&level);
+ *     ...
+ *   }
+ *   return FLEX_SecondsFromNow(LEVEL_PERIOD_S);
+ * }
+ *
+ * void FLEX_AppInit() {
+ *   const MYRIOTA_PowerWindowNeeds level_needs = {
+ *     .interfaces = MYRIOTA_POWERWINDOW_POWER_OUT | MYRIOTA_POWERWINDOW_ANALOG_IN,
+ *     .power_out = FLEX_POWER_OUT_24V,
+ *     .analog_in = FLEX_ANALOG_IN_CURRENT,
+ *     .warm_up_ms = 1500,
+ *     .window_s = 600,
+ *   };
+ *   MYRIOTA_ResourceInit(&resources);
+ *   MYRIOTA_PowerWindowInit(&power_window, power_window_job, &resources);
+ *   MYRIOTA_PowerWindowJobInit(&level_job, &level_needs, read_level, NULL);
+ *   MYRIOTA_PowerWindowSchedule(&power_window, &level_job, FLEX_ASAP());
+ *   ...
+ * }
+ * \endcode
+ * \{
+ */
+
+/** The interfaces acquired for a job. */
+typedef enum {
+  /** The power output, at the `power_out` voltage. */
+  MYRIOTA_POWERWINDOW_POWER_OUT = 1 << 0,
+  /** The analog input, in the `analog_in` mode. */
+  MYRIOTA_POWERWINDOW_ANALOG_IN = 1 << 1,
+  /** The serial interface, with the `serial` options. */
+  MYRIOTA_POWERWINDOW_SERIAL = 1 << 2,
+} MYRIOTA_PowerWindowInterface;
+
+/** The interfaces needed by a job. Jobs can share a session if the interfaces
+ * they both need have the same configuration. */
+typedef struct {
+  /** The MYRIOTA_PowerWindowInterface flags of the interfaces to acquire.
+   * Jobs that use a library that initialises an interface itself, such as
+   * Modbus, must not include it. */
+  uint8_t interfaces;
+  /** The voltage of the power output. */
+  FLEX_PowerOut power_out;
+  /** The mode of the analog input. */
+  FLEX_AnalogInputMode analog_in;
+  /** The options of the serial interface. */
+  FLEX_SerialExOptions serial;
+  /** The time in milliseconds the sensor takes to stabilise after the
+   * interfaces are on. */
+  uint32_t warm_up_ms;
+  /** The number of seconds by which the job may run before the time it is
+   * scheduled for, to share a session with another job. */
+  uint32_t window_s;
+} MYRIOTA_PowerWindowNeeds;
+
+/**
+ * A power window job function, called by MYRIOTA_PowerWindowPoll() with its
+ * interfaces acquired.
+ *
+ * \param[in] context The context given to MYRIOTA_PowerWindowJobInit().
+ * \param[in] status FLEX_SUCCESS (0), or the error of acquiring an interface
+ * of the session, in which case none of its interfaces are acquired. The
+ * error is -FLEX_ERROR_EBUSY if another user has the interface on with
+ * another configuration.
+ * \return the time at which the job should next run, or FLEX_Never() to stop it,
+ * which replaces any time the function scheduled its own job for.
+ */
+typedef time_t (*MYRIOTA_PowerWindowHandler)(void *const context, const int status);
+
+/** A power window job. Treat the members as private. */
+typedef struct MYRIOTA_PowerWindowJob {
+  /** \cond INTERNAL_HIDDEN */
+  struct MYRIOTA_PowerWindowJob *next;
+  MYRIOTA_PowerWindowNeeds needs;
+  MYRIOTA_PowerWindowHandler handler;
+  void *context;
+  time_t time;
+  uint32_t last_poll;
+  bool is_scheduled;
+  bool in_session;
+  /** \endcond */
+} MYRIOTA_PowerWindowJob;
+
+/** Statistics of a power window. */
+typedef struct {
+  /** The number of sessions. */
+  uint32_t session_count;
+  /** The number of jobs run. */
+  uint32_t run_count;
+  /** The total warm-up time in milliseconds that jobs did not wait for
+   * because they shared a session. */
+  uint32_t saved_ms;
+} MYRIOTA_PowerWindowStats;
+
+/** A power window. Treat the members as private. */
+typedef struct {
+  /** \cond INTERNAL_HIDDEN */
+  FLEX_ScheduledJob job;
+  MYRIOTA_ResourceManager *resources;
+  bool is_polling;
+  bool is_scheduled;
+  time_t scheduled;
+  uint32_t poll_count;
+  MYRIOTA_PowerWindowJob *jobs;
+  MYRIOTA_PowerWindowStats stats;
+  /** \endcond */
+} MYRIOTA_PowerWindow;
+
+/**
+ * Initializes a power window without jobs.
+ *
+ * \param[out] window The power window to initialize.
+ * \param[in] job The FlexSense job that returns MYRIOTA_PowerWindowPoll() of
+ * this power window, which it schedules with FLEX_JobSchedule().
+ * \param[in,out] resources The resource manager the sessions acquire their
+ * interfaces from, which must stay valid while the power window is used.
+ */
+void MYRIOTA_PowerWindowInit(MYRIOTA_PowerWindow *const window, const FLEX_ScheduledJob job,
+  MYRIOTA_ResourceManager *const resources);
+
+/**
+ * Initializes a power window job, which is not scheduled.
+ *
+ * \param[out] job The job to initialize.
+ * \param[in] needs The interfaces needed by the job, which are copied.
+ * \param[in] handler The function to run.
+ * \param[in] context The argument of the function.
+ */
+void MYRIOTA_PowerWindowJobInit(MYRIOTA_PowerWindowJob *const job,
+  const MYRIOTA_PowerWindowNeeds *const needs, const MYRIOTA_PowerWindowHandler handler,
+  void *const context);
+
+/**
+ * Schedule or reschedule a job, and the FlexSense job of the power window if
+ * the job is due before it.
+ *
+ * \param[in,out] window The power window.
+ * \param[in,out] job The job, which must stay valid while scheduled.
+ * \param[in] time The time the job is due, where a time that has passed runs it
+ * as soon as possible, or FLEX_Never() to cancel it.
+ * \return FLEX_SUCCESS (0) if succeeded and < 0 if FLEX_JobSchedule() failed,
+ * in which case the job is still scheduled and runs the next time the power
+ * window is polled.
+ */
+int MYRIOTA_PowerWindowSchedule(MYRIOTA_PowerWindow *const window,
+  MYRIOTA_PowerWindowJob *const job, const time_t time);
+
+/**
+ * Run the sessions of the jobs that are due, from the FlexSense job of the
+ * power window.
+ *
+ * \param[in,out] window The power window.
+ * \return the time the earliest job is due, or FLEX_Never() if there are none.
+ */
+time_t MYRIOTA_PowerWindowPoll(MYRIOTA_PowerWindow *const window);
+
+/**
+ * Get the statistics of a power window.
+ *
+ * \param[in] window The power window.
+ * \param[out] stats The statistics.
+ */
+void MYRIOTA_PowerWindowStatsGet(const MYRIOTA_PowerWindow *const window,
+  MYRIOTA_PowerWindowStats *const stats);
+
+/**
+ * \}
+ */
+
+#endif /* MYRIOTA_POWERWINDOW_H */
@@ -0,0 +1,486 @@
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myriota/powerwindow.h"
+#include <string.h>
+#include "flex_errors.h"
+
+// NOTE: you can provide your own assert
+#ifndef POWERWINDOW_ASSERT
+#include <stdio.h>
+#define POWERWINDOW_ASSERT(cond)                     \
+  do {                                               \
+    if (!(cond)) {                                   \
+      printf("Assert @%s:%d\n", __FILE__, __LINE__); \
+      while (1) {                                    \
+      }                                              \
+    }                                                \
+  } while (0)
+#endif
+
+// The number of MYRIOTA_PowerWindowInterface flags.
+#define POWERWINDOW_INTERFACES 3
+
+// Jobs can share a session if the interfaces they both need are configured the same.
+static bool powerwindow_compatible(const MYRIOTA_PowerWindowNeeds *const a,
+  const MYRIOTA_PowerWindowNeeds *const b) {
+  const uint8_t shared = a->interfaces & b->interfaces;
+  if ((shared & MYRIOTA_POWERWINDOW_POWER_OUT) && a->power_out != b->power_out) {
+    return false;
+  }
+  if ((shared & MYRIOTA_POWERWINDOW_ANALOG_IN) && a->analog_in != b->analog_in) {
+    return false;
+  }
+  if ((shared & MYRIOTA_POWERWINDOW_SERIAL) &&
+      !MYRIOTA_ResourceSerialEqual(&a->serial, &b->serial)) {
+    return false;
+  }
+  return true;
+}
+
+// Adds the interfaces of a job to those of a session.
+static void powerwindow_merge(MYRIOTA_PowerWindowNeeds *const session,
+  const MYRIOTA_PowerWindowNeeds *const needs) {
+  if (needs->interfaces & MYRIOTA_POWERWINDOW_POWER_OUT) {
+    session->power_out = needs->power_out;
+  }
+  if (needs->interfaces & MYRIOTA_POWERWINDOW_ANALOG_IN) {
+    session->analog_in = needs->analog_in;
+  }
+  if (needs->interfaces & MYRIOTA_POWERWINDOW_SERIAL) {
+    session->serial = needs->serial;
+  }
+  session->interfaces |= needs->interfaces;
+  if (needs->warm_up_ms > session->warm_up_ms) {
+    session->warm_up_ms = needs->warm_up_ms;
+  }
+}
+
+static void powerwindow_release(MYRIOTA_ResourceHandle *const handles) {
+  // The power output is released last.
+  for (int i = POWERWINDOW_INTERFACES - 1; i >= 0; --i) {
+    MYRIOTA_ResourceRelease(&handles[i]);
+  }
+}
+
+// Acquires the interfaces of a session, or none of them if one fails, where
+// the handle of each interface is at the index of its flag.
+static int powerwindow_acquire(MYRIOTA_ResourceManager *const resources,
+  const MYRIOTA_PowerWindowNeeds *const session, MYRIOTA_ResourceHandle *const handles) {
+  int result = FLEX_SUCCESS;
+  if (session->interfaces & MYRIOTA_POWERWINDOW_POWER_OUT) {
+    result = MYRIOTA_ResourcePowerOutAcquire(resources, &handles[0], session->power_out);
+  }
+  if (result == FLEX_SUCCESS && (session->interfaces & MYRIOTA_POWERWINDOW_ANALOG_IN)) {
+    result = MYRIOTA_ResourceAnalogInAcquire(resources, &handles[1], session->analog_in);
+  }
+  if (result == FLEX_SUCCESS && (session->interfaces & MYRIOTA_POWERWINDOW_SERIAL)) {
+    result = MYRIOTA_ResourceSerialAcquire(resources, &handles[2], session->serial);
+  }
+  if (result < 0) {
+    powerwindow_release(handles);
+  }
+  return result;
+}
+
+static void powerwindow_unlink(MYRIOTA_PowerWindow *const window,
+  MYRIOTA_PowerWindowJob *const job) {
+  MYRIOTA_PowerWindowJob **link = &window->jobs;
+  while (*link != job) {
+    link = &(*link)->next;
+  }
+  *link = job->next;
+  job->next = NULL;
+  job->is_scheduled = false;
+  job->in_session = false;
+}
+
+// The earliest job that is due and has not run in this poll, which leads a session.
+static MYRIOTA_PowerWindowJob *powerwindow_lead(const MYRIOTA_PowerWindow *const window,
+  const time_t now) {
+  MYRIOTA_PowerWindowJob *lead = NULL;
+  for (MYRIOTA_PowerWindowJob *job = window->jobs; job != NULL; job = job->next) {
+    if (job->time <= now && job->last_poll != window->poll_count &&
+        (lead == NULL || job->time < lead->time)) {
+      lead = job;
+    }
+  }
+  return lead;
+}
+
+// Adds the jobs that may run now and are compatible with the session, returning
+// the sum of their warm-up times.
+static uint32_t powerwindow_gather(MYRIOTA_PowerWindow *const window,
+  MYRIOTA_PowerWindowNeeds *const session, const time_t now, const bool is_due) {
+  uint32_t warm_up_ms = 0;
+  for (MYRIOTA_PowerWindowJob *job = window->jobs; job != NULL; job = job->next) {
+    const bool may_run = is_due ? job->time <= now : job->time - (time_t)job->needs.window_s <= now;
+    if (job->in_session || job->last_poll == window->poll_count || !may_run ||
+        !powerwindow_compatible(session, &job->needs)) {
+      continue;
+    }
+    job->in_session = true;
+    powerwindow_merge(session, &job->needs);
+    warm_up_ms += job->needs.warm_up_ms;
+  }
+  return warm_up_ms;
+}
+
+static MYRIOTA_PowerWindowJob *powerwindow_next_in_session(
+  const MYRIOTA_PowerWindow *const window) {
+  for (MYRIOTA_PowerWindowJob *job = window->jobs; job != NULL; job = job->next) {
+    if (job->in_session) {
+      return job;
+    }
+  }
+  return NULL;
+}
+
+static void powerwindow_session(MYRIOTA_PowerWindow *const window,
+  MYRIOTA_PowerWindowJob *const lead, const time_t now) {
+  MYRIOTA_PowerWindowNeeds session = {0};
+  lead->in_session = true;
+  powerwindow_merge(&session, &lead->needs);
+  // Jobs that are due join first, so that jobs that are only early do not keep them out.
+  uint32_t warm_up_ms = lead->needs.warm_up_ms;
+  warm_up_ms += powerwindow_gather(window, &session, now, true);
+  warm_up_ms += powerwindow_gather(window, &session, now, false);
+
+  MYRIOTA_ResourceHandle handles[POWERWINDOW_INTERFACES] = {{0}};
+  const int status = powerwindow_acquire(window->resources, &session, handles);
+  if (status == FLEX_SUCCESS) {
+    // Sensors stabilise from when the rail came on, which may have been before
+    // this session if another user had it on already.
+    const bool is_powered = session.interfaces & MYRIOTA_POWERWINDOW_POWER_OUT;
+    const int last = is_powered ? 0 : POWERWINDOW_INTERFACES - 1;
+    for (int i = 0; i <= last; ++i) {
+      if (session.interfaces & (1 << i)) {
+        MYRIOTA_ResourceWarmUp(&handles[i], session.warm_up_ms);
+      }
+    }
+  }
+  ++window->stats.session_count;
+  window->stats.saved_ms += warm_up_ms - session.warm_up_ms;
+
+  // Jobs may schedule or cancel the other jobs of the session.
+  MYRIOTA_PowerWindowJob *job;
+  while ((job = powerwindow_next_in_session(window)) != NULL) {
+    powerwindow_unlink(window, job);
+    job->last_poll = window->poll_count;
+    ++window->stats.run_count;
+    const time_t time = job->handler(job->context, status);
+    MYRIOTA_PowerWindowSchedule(window, job, time);
+  }
+
+  if (status == FLEX_SUCCESS) {
+    powerwindow_release(handles);
+  }
+}
+
+void MYRIOTA_PowerWindowInit(MYRIOTA_PowerWindow *const window, const FLEX_ScheduledJob job,
+  MYRIOTA_ResourceManager *const resources) {
+  POWERWINDOW_ASSERT(window != NULL);
+  POWERWINDOW_ASSERT(job != NULL);
+  POWERWINDOW_ASSERT(resources != NULL);
+  memset(window, 0, sizeof(*window));
+  window->job = job;
+  window->resources = resources;
+}
+
+void MYRIOTA_PowerWindowJobInit(MYRIOTA_PowerWindowJob *const job,
+  const MYRIOTA_PowerWindowNeeds *const needs, const MYRIOTA_PowerWindowHandler handler,
+  void *const context) {
+  POWERWINDOW_ASSERT(job != NULL);
+  POWERWINDOW_ASSERT(needs != NULL);
+  POWERWINDOW_ASSERT(handler != NULL);
+  memset(job, 0, sizeof(*job));
+  job->needs = *needs;
+  job->handler = handler;
+  job->context = context;
+}
+
+int MYRIOTA_PowerWindowSchedule(MYRIOTA_PowerWindow *const window,
+  MYRIOTA_PowerWindowJob *const job, const time_t time) {
+  POWERWINDOW_ASSERT(window != NULL);
+  POWERWINDOW_ASSERT(job != NULL);
+  if (job->is_scheduled) {
+    powerwindow_unlink(window, job);
+  }
+  if (time == FLEX_Never()) {
+    return FLEX_SUCCESS;
+  }
+  job->time = time;
+  job->is_scheduled = true;
+  job->next = window->jobs;
+  window->jobs = job;
+
+  // MYRIOTA_PowerWindowPoll() returns the earliest time when it finishes.
+  if (window->is_polling || (window->is_scheduled && window->scheduled <= time)) {
+    return FLEX_SUCCESS;
+  }
+  const int result = FLEX_JobSchedule(window->job, time);
+  if (result < 0) {
+    return result;
+  }
+  window->is_scheduled = true;
+  window->scheduled = time;
+  return FLEX_SUCCESS;
+}
+
+time_t MYRIOTA_PowerWindowPoll(MYRIOTA_PowerWindow *const window) {
+  POWERWINDOW_ASSERT(window != NULL);
+  const time_t now = FLEX_TimeGet();
+  window->is_polling = true;
+  // Jobs run at most once per poll, so jobs scheduled again for a time that
+  // has passed run in the next poll.
+  ++window->poll_count;
+  MYRIOTA_PowerWindowJob *lead;
+  while ((lead = powerwindow_lead(window, now)) != NULL) {
+    powerwindow_session(window, lead, now);
+  }
+  window->is_polling = false;
+
+  window->is_scheduled = window->jobs != NULL;
+  if (!window->is_scheduled) {
+    return FLEX_Never();
+  }
+  window->scheduled = window->jobs->time;
+  for (const MYRIOTA_PowerWindowJob *job = window->jobs->next; job != NULL; job = job->next) {
+    window->scheduled = (job->time < window->scheduled) ? job->time : window->scheduled;
+  }
+  return window->scheduled;
+}
+
+void MYRIOTA_PowerWindowStatsGet(const MYRIOTA_PowerWindow *const window,
+  MYRIOTA_PowerWindowStats *const stats) {
+  POWERWINDOW_ASSERT(window != NULL);
+  POWERWINDOW_ASSERT(stats != NULL);
+  *stats = window->stats;
+}
+
+#ifdef MYRIOTA_POWERWINDOW_UNIT_TESTS
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+/*
+ * `cmocka.h` must be included after standard the above library headers.
+ * NOTE: This comment has dual purpose:
+ * 1. Document the ordering requirement.
+ * 2. Prevent `clang-format` from reordering the headers.
+ */
+#include <cmocka.h>
+#include "myriota/flex_fake.h"
+
+static MYRIOTA_ResourceManager resources;
+static MYRIOTA_PowerWindow window;
+
+static time_t power_window_job(void) {
+  return MYRIOTA_PowerWindowPoll(&window);
+}
+
+static void powerwindow_setup(void) {
+  MYRIOTA_FlexFakeReset();
+  flex_fake.time = 1000;
+  MYRIOTA_ResourceInit(&resources);
+  MYRIOTA_PowerWindowInit(&window, power_window_job, &resources);
+}
+
+typedef struct {
+  MYRIOTA_PowerWindowJob job;
+  time_t period;
+  int status;
+  int run_count;
+  time_t run_time;
+} TestSensor;
+
+static time_t test_sensor_run(void *const context, const int status) {
+  TestSensor *const sensor = context;
+  if (status == FLEX_SUCCESS) {
+    assert_true(flex_fake.is_power_out);
+  }
+  sensor->status = status;
+  sensor->run_time = flex_fake.time;
+  ++sensor->run_count;
+  return (sensor->period == 0) ? FLEX_Never() : flex_fake.time + sensor->period;
+}
+
+static const MYRIOTA_PowerWindowNeeds analog_24v = {
+  .interfaces = MYRIOTA_POWERWINDOW_POWER_OUT | MYRIOTA_POWERWINDOW_ANALOG_IN,
+  .power_out = FLEX_POWER_OUT_24V,
+  .analog_in = FLEX_ANALOG_IN_CURRENT,
+  .warm_up_ms = 1500,
+  .window_s = 600,
+};
+
+static const MYRIOTA_PowerWindowNeeds serial_24v = {
+  .interfaces = MYRIOTA_POWERWINDOW_POWER_OUT | MYRIOTA_POWERWINDOW_SERIAL,
+  .power_out = FLEX_POWER_OUT_24V,
+  .serial = {.protocol = FLEX_SERIAL_PROTOCOL_RS485, .baud_rate = 9600},
+  .warm_up_ms = 1000,
+  .window_s = 600,
+};
+
+static const MYRIOTA_PowerWindowNeeds serial_12v = {
+  .interfaces = MYRIOTA_POWERWINDOW_POWER_OUT | MYRIOTA_POWERWINDOW_SERIAL,
+  .power_out = FLEX_POWER_OUT_12V,
+  .serial = {.protocol = FLEX_SERIAL_PROTOCOL_RS485, .baud_rate = 9600},
+  .warm_up_ms = 1000,
+  .window_s = 0,
+};
+
+static void test_shared_session(void **state) {
+  (void)state;
+  powerwindow_setup();
+
+  TestSensor level = {.period = 3600};
+  TestSensor flow = {.period = 3600};
+  MYRIOTA_PowerWindowJobInit(&level.job, &analog_24v, test_sensor_run, &level);
+  MYRIOTA_PowerWindowJobInit(&flow.job, &serial_24v, test_sensor_run, &flow);
+  assert_int_equal(MYRIOTA_PowerWindowSchedule(&window, &flow.job, 1300), 0);
+  assert_int_equal(MYRIOTA_PowerWindowSchedule(&window, &level.job, 1100), 0);
+  assert_ptr_equal(flex_fake.job, power_window_job);
+  assert_int_equal(flex_fake.job_time, 1100);
+
+  // The flow sensor runs 200 seconds early in the session of the level sensor.
+  flex_fake.time = 1100;
+  assert_int_equal(power_window_job(), 1100 + 3600);
+  assert_int_equal(level.run_count, 1);
+  assert_int_equal(flow.run_count, 1);
+  assert_int_equal(flex_fake.power_out_count, 1);
+  assert_int_equal(flex_fake.analog_in_count, 1);
+  assert_int_equal(flex_fake.serial_count, 1);
+  assert_int_equal(flex_fake.delay_ms, 1500);
+  assert_false(flex_fake.is_power_out || flex_fake.is_analog_in || flex_fake.is_serial);
+
+  MYRIOTA_PowerWindowStats stats;
+  MYRIOTA_PowerWindowStatsGet(&window, &stats);
+  assert_int_equal(stats.session_count, 1);
+  assert_int_equal(stats.run_count, 2);
+  assert_int_equal(stats.saved_ms, 1000);
+
+  // Both now run together every hour.
+  for (int i = 1; i <= 24; ++i) {
+    flex_fake.time = 1100 + i * 3600;
+    assert_int_equal(power_window_job(), flex_fake.time + 3600);
+  }
+  assert_int_equal(level.run_count, 25);
+  assert_int_equal(flow.run_count, 25);
+  assert_int_equal(flex_fake.power_out_count, 25);
+}
+
+static void test_separate_sessions(void **state) {
+  (void)state;
+  powerwindow_setup();
+
+  // Different voltages cannot share the rail, and a job is not run before its window.
+  TestSensor level = {0};
+  TestSensor pump = {0};
+  TestSensor later = {0};
+  MYRIOTA_PowerWindowJobInit(&level.job, &analog_24v, test_sensor_run, &level);
+  MYRIOTA_PowerWindowJobInit(&pump.job, &serial_12v, test_sensor_run, &pump);
+  MYRIOTA_PowerWindowJobInit(&later.job, &serial_24v, test_sensor_run, &later);
+  MYRIOTA_PowerWindowSchedule(&window, &level.job, 1000);
+  MYRIOTA_PowerWindowSchedule(&window, &pump.job, 1000);
+  MYRIOTA_PowerWindowSchedule(&window, &later.job, 1601);
+
+  assert_int_equal(power_window_job(), 1601);
+  assert_int_equal(level.run_count, 1);
+  assert_int_equal(pump.run_count, 1);
+  assert_int_equal(later.run_count, 0);
+  assert_int_equal(flex_fake.power_out_count, 2);
+  assert_int_equal(flex_fake.delay_ms, 1500 + 1000);
+
+  flex_fake.time = 1601;
+  assert_int_equal(power_window_job(), FLEX_Never());
+  assert_int_equal(later.run_count, 1);
+  assert_int_equal(flex_fake.power_out, FLEX_POWER_OUT_24V);
+
+  MYRIOTA_PowerWindowStats stats;
+  MYRIOTA_PowerWindowStatsGet(&window, &stats);
+  assert_int_equal(stats.session_count, 3);
+  assert_int_equal(stats.saved_ms, 0);
+}
+
+static void test_errors(void **state) {
+  (void)state;
+  powerwindow_setup();
+
+  // A job that fails to power up is told the error, and does not wait.
+  TestSensor level = {.period = 10};
+  MYRIOTA_PowerWindowJobInit(&level.job, &analog_24v, test_sensor_run, &level);
+  MYRIOTA_PowerWindowSchedule(&window, &level.job, 1000);
+  flex_fake.power_out_result = -FLEX_ERROR_IO_EXPANDER;
+  assert_int_equal(power_window_job(), 1010);
+  assert_int_equal(level.status, -FLEX_ERROR_IO_EXPANDER);
+  assert_int_equal(flex_fake.analog_in_count, 0);
+  assert_int_equal(flex_fake.delay_ms, 0);
+
+  // A job scheduled again for a time that has passed runs in the next poll.
+  flex_fake.power_out_result = 0;
+  level.period = -1;
+  flex_fake.time = 1010;
+  assert_int_equal(power_window_job(), 1009);
+  assert_int_equal(level.run_count, 2);
+  assert_int_equal(level.status, FLEX_SUCCESS);
+
+  // A cancelled job does not run.
+  MYRIOTA_PowerWindowSchedule(&window, &level.job, FLEX_Never());
+  assert_int_equal(power_window_job(), FLEX_Never());
+  assert_int_equal(level.run_count, 2);
+}
+
+static void test_shared_resources(void **state) {
+  (void)state;
+  powerwindow_setup();
+
+  // Another driver has had the rail on for a second, so the session only
+  // waits for the rest of the warm-up and does not power cycle the rail.
+  MYRIOTA_ResourceHandle other;
+  assert_int_equal(MYRIOTA_ResourcePowerOutAcquire(&resources, &other, FLEX_POWER_OUT_24V), 0);
+  flex_fake.tick += 1000;
+  TestSensor level = {0};
+  MYRIOTA_PowerWindowJobInit(&level.job, &analog_24v, test_sensor_run, &level);
+  MYRIOTA_PowerWindowSchedule(&window, &level.job, 1000);
+  assert_int_equal(power_window_job(), FLEX_Never());
+  assert_int_equal(level.status, FLEX_SUCCESS);
+  assert_int_equal(flex_fake.power_out_count, 1);
+  assert_int_equal(flex_fake.analog_in_count, 1);
+  assert_int_equal(flex_fake.delay_ms, 500);
+  assert_true(flex_fake.is_power_out);
+  assert_false(flex_fake.is_analog_in);
+
+  // A session that needs another voltage is told the rail is busy.
+  TestSensor pump = {0};
+  MYRIOTA_PowerWindowJobInit(&pump.job, &serial_12v, test_sensor_run, &pump);
+  MYRIOTA_PowerWindowSchedule(&window, &pump.job, 1000);
+  assert_int_equal(power_window_job(), FLEX_Never());
+  assert_int_equal(pump.status, -FLEX_ERROR_EBUSY);
+  assert_int_equal(flex_fake.serial_count, 0);
+  assert_int_equal(flex_fake.power_out, FLEX_POWER_OUT_24V);
+
+  assert_int_equal(MYRIOTA_ResourceRelease(&other), 0);
+  assert_false(flex_fake.is_power_out);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_shared_session),
+    cmocka_unit_test(test_separate_sessions),
+    cmocka_unit_test(test_errors),
+    cmocka_unit_test(test_shared_resources),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+#endif /** MYRIOTA_POWERWINDOW_UNIT_TESTS */
@@ -0,0 +1,170 @@
+/// \file profiler.h Myriota Job Profiler
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYRIOTA_PROFILER_H
+#define MYRIOTA_PROFILER_H
+
+#include <stdint.h>
+#include <time.h>
+#include "flex.h"
+#include "flex_diag_conf.h"
+
+/** \defgroup Profiler Job Profiler
+ * @brief Measure how late jobs start and how long they run
+ *
+ * A profiled job is run by a wrapper, which records how many seconds after
+ * the time it was scheduled for the job starts, and how many milliseconds it
+ * runs for measured with FLEX_TickGet(). Both are kept in histograms with
+ * buckets of powers of two, and can be printed on the debug console or
+ * written to a string diagnostic.
+ *
+ * \code
+ * static time_t send_message(void) {
+ *   ...
+ *   return FLEX_HoursFromNow(6);
+ * }
+ *
+ * MYRIOTA_PROFILER_DEFINE(profiled_send_message, send_message);
+ *
+ * void FLEX_AppInit() {
+ *   MYRIOTA_ProfilerSchedule(&MYRIOTA_PROFILER_PROFILE(profiled_send_message), FLEX_ASAP());
+ * }
+ *
+ * ...
+ * MYRIOTA_ProfilerPrint(&MYRIOTA_PROFILER_PROFILE(profiled_send_message));
+ * \endcode
+ * \{
+ */
+
+/** The number of buckets of a histogram, where bucket 0 counts values of 0
+ * and bucket `i` counts values from 2^(i-1) to 2^i - 1, except the last
+ * bucket which counts all larger values too. */
+#define MYRIOTA_PROFILER_BUCKETS 16
+
+/** The `max_len` of the string diagnostic written by MYRIOTA_ProfilerDiagWrite(). */
+#define MYRIOTA_PROFILER_DIAG_LEN 240
+
+/** The profile of a job. Treat the members as private. */
+typedef struct {
+  /** \cond INTERNAL_HIDDEN */
+  const char *name;
+  FLEX_ScheduledJob function;
+  FLEX_ScheduledJob job;
+  time_t scheduled;
+  uint32_t run_count;
+  uint32_t total_ms;
+  uint32_t max_ms;
+  uint32_t max_late_s;
+  uint16_t duration_ms[MYRIOTA_PROFILER_BUCKETS];
+  uint16_t late_s[MYRIOTA_PROFILER_BUCKETS];
+  /** \endcond */
+} MYRIOTA_Profile;
+
+/** Statistics of a profiled job. */
+typedef struct {
+  /** The number of runs. */
+  uint32_t run_count;
+  /** The total time in milliseconds of the runs, saturating at UINT32_MAX. */
+  uint32_t total_ms;
+  /** The longest run in milliseconds. */
+  uint32_t max_ms;
+  /** The latest start in seconds after the time the job was scheduled for. */
+  uint32_t max_late_s;
+  /** The histogram of the run times in milliseconds, saturating at UINT16_MAX. */
+  uint16_t duration_ms[MYRIOTA_PROFILER_BUCKETS];
+  /** The histogram of the starts in seconds after the time the job was
+   * scheduled for, saturating at UINT16_MAX. */
+  uint16_t late_s[MYRIOTA_PROFILER_BUCKETS];
+} MYRIOTA_ProfilerStats;
+
+/** The profile of the wrapper defined by MYRIOTA_PROFILER_DEFINE(). */
+#define MYRIOTA_PROFILER_PROFILE(wrapper) wrapper##_profile
+
+/**
+ * Defines a FlexSense job `wrapper` that profiles the job `profiled`, and its
+ * profile. Schedule the wrapper in place of the function, with
+ * MYRIOTA_ProfilerSchedule() so that its lateness is measured from the start.
+ */
+#define MYRIOTA_PROFILER_DEFINE(wrapper, profiled)                  \
+  static time_t wrapper(void);                                      \
+  static MYRIOTA_Profile MYRIOTA_PROFILER_PROFILE(wrapper) = {      \
+    .name = #profiled,                                              \
+    .function = (profiled),                                         \
+    .job = (wrapper),                                               \
+  };                                                                \
+  static time_t wrapper(void) {                                     \
+    return MYRIOTA_ProfilerRun(&MYRIOTA_PROFILER_PROFILE(wrapper)); \
+  }
+
+/**
+ * Schedule the wrapper of a profiled job with FLEX_JobSchedule().
+ *
+ * \param[in,out] profile The profile of the job.
+ * \param[in] time The time to run the job.
+ * \return FLEX_SUCCESS (0) if succeeded and < 0 if FLEX_JobSchedule() failed.
+ */
+int MYRIOTA_ProfilerSchedule(MYRIOTA_Profile *const profile, const time_t time);
+
+/**
+ * Run a profiled job and record how late it started and how long it ran,
+ * which is called by the wrapper.
+ *
+ * \param[in,out] profile The profile of the job.
+ * \return the time the job returned.
+ */
+time_t MYRIOTA_ProfilerRun(MYRIOTA_Profile *const profile);
+
+/**
+ * Get the statistics of a profiled job.
+ *
+ * \param[in] profile The profile of the job.
+ * \param[out] stats The statistics.
+ */
+void MYRIOTA_ProfilerStatsGet(const MYRIOTA_Profile *const profile,
+  MYRIOTA_ProfilerStats *const stats);
+
+/**
+ * Clear the statistics of a profiled job.
+ *
+ * \param[in,out] profile The profile of the job.
+ */
+void MYRIOTA_ProfilerReset(MYRIOTA_Profile *const profile);
+
+/**
+ * Print the statistics of a profiled job on the debug console, e.g.
+ * "send_message: runs 4 total_ms 2120 max_ms 1500 max_late_s 3 ms 0,0,0,0,0,0,1,2,0,0,0,1
+ * late 3,0,1", where the histograms stop at the last bucket that is not empty.
+ *
+ * \param[in] profile The profile of the job.
+ */
+void MYRIOTA_ProfilerPrint(const MYRIOTA_Profile *const profile);
+
+/**
+ * Write the statistics of a profiled job to a string diagnostic, in the format
+ * of MYRIOTA_ProfilerPrint() without the name, with FLEX_DiagConfValueWrite().
+ *
+ * The diagnostic must be added with FLEX_DIAG_CONF_TABLE_STR_ADD() and a
+ * `max_len` of MYRIOTA_PROFILER_DIAG_LEN.
+ *
+ * \param[in] profile The profile of the job.
+ * \param[in] id The id of the diagnostic.
+ * \return FLEX_SUCCESS (0) if succeeded and < 0 if FLEX_DiagConfValueWrite() failed.
+ */
+int MYRIOTA_ProfilerDiagWrite(const MYRIOTA_Profile *const profile, const FLEX_DiagConfID id);
+
+/**
+ * \}
+ */
+
+#endif /* MYRIOTA_PROFILER_H */
@@ -0,0 +1,231 @@
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myriota/profiler.h"
+#include <stdio.h>
+#include <string.h>
+#include "flex_errors.h"
+
+// NOTE: you can provide your own assert
+#ifndef PROFILER_ASSERT
+#define PROFILER_ASSERT(cond)                        \
+  do {                                               \
+    if (!(cond)) {                                   \
+      printf("Assert @%s:%d\n", __FILE__, __LINE__); \
+      while (1) {                                    \
+      }                                              \
+    }                                                \
+  } while (0)
+#endif
+
+// Counts a value in the bucket of its number of significant bits.
+static void profiler_histogram_add(uint16_t *const histogram, const uint32_t value) {
+  const unsigned bits = (value == 0) ? 0 : 32 - __builtin_clz(value);
+  const unsigned bucket = (bits < MYRIOTA_PROFILER_BUCKETS) ? bits : MYRIOTA_PROFILER_BUCKETS - 1;
+  if (histogram[bucket] < UINT16_MAX) {
+    ++histogram[bucket];
+  }
+}
+
+// Appends the buckets of a histogram up to the last that is not empty, e.g. "3,0,1".
+static size_t profiler_histogram_format(char *const text, const size_t size, size_t length,
+  const uint16_t *const histogram) {
+  int last = MYRIOTA_PROFILER_BUCKETS - 1;
+  while (last > 0 && histogram[last] == 0) {
+    --last;
+  }
+  for (int i = 0; i <= last && length < size; ++i) {
+    length += snprintf(text + length, size - length, (i == 0) ? "%u" : ",%u", histogram[i]);
+  }
+  return length;
+}
+
+static void profiler_format(const MYRIOTA_Profile *const profile, char *const text,
+  const size_t size) {
+  size_t length = snprintf(text, size, "runs %lu total_ms %lu max_ms %lu max_late_s %lu ms ",
+    (unsigned long)profile->run_count, (unsigned long)profile->total_ms,
+    (unsigned long)profile->max_ms, (unsigned long)profile->max_late_s);
+  length = profiler_histogram_format(text, size, length, profile->duration_ms);
+  if (length < size) {
+    length += snprintf(text + length, size - length, " late ");
+  }
+  profiler_histogram_format(text, size, length, profile->late_s);
+}
+
+int MYRIOTA_ProfilerSchedule(MYRIOTA_Profile *const profile, const time_t time) {
+  PROFILER_ASSERT(profile != NULL);
+  // A time that has passed, e.g. FLEX_ASAP(), is late from now.
+  const time_t now = FLEX_TimeGet();
+  profile->scheduled = (time > now) ? time : now;
+  return FLEX_JobSchedule(profile->job, time);
+}
+
+time_t MYRIOTA_ProfilerRun(MYRIOTA_Profile *const profile) {
+  PROFILER_ASSERT(profile != NULL);
+  const time_t start = FLEX_TimeGet();
+  const uint32_t start_tick = FLEX_TickGet();
+  const time_t next = profile->function();
+  const uint32_t duration_ms = FLEX_TickGet() - start_tick;
+  const uint32_t late_s = (start > profile->scheduled) ? start - profile->scheduled : 0;
+
+  ++profile->run_count;
+  profile->total_ms =
+    (profile->total_ms > UINT32_MAX - duration_ms) ? UINT32_MAX : profile->total_ms + duration_ms;
+  profile->max_ms = (duration_ms > profile->max_ms) ? duration_ms : profile->max_ms;
+  profile->max_late_s = (late_s > profile->max_late_s) ? late_s : profile->max_late_s;
+  profiler_histogram_add(profile->duration_ms, duration_ms);
+  profiler_histogram_add(profile->late_s, late_s);
+
+  const time_t now = FLEX_TimeGet();
+  profile->scheduled = (next > now) ? next : now;
+  return next;
+}
+
+void MYRIOTA_ProfilerStatsGet(const MYRIOTA_Profile *const profile,
+  MYRIOTA_ProfilerStats *const stats) {
+  PROFILER_ASSERT(profile != NULL);
+  PROFILER_ASSERT(stats != NULL);
+  stats->run_count = profile->run_count;
+  stats->total_ms = profile->total_ms;
+  stats->max_ms = profile->max_ms;
+  stats->max_late_s = profile->max_late_s;
+  memcpy(stats->duration_ms, profile->duration_ms, sizeof(stats->duration_ms));
+  memcpy(stats->late_s, profile->late_s, sizeof(stats->late_s));
+}
+
+void MYRIOTA_ProfilerReset(MYRIOTA_Profile *const profile) {
+  PROFILER_ASSERT(profile != NULL);
+  profile->run_count = 0;
+  profile->total_ms = 0;
+  profile->max_ms = 0;
+  profile->max_late_s = 0;
+  memset(profile->duration_ms, 0, sizeof(profile->duration_ms));
+  memset(profile->late_s, 0, sizeof(profile->late_s));
+}
+
+void MYRIOTA_ProfilerPrint(const MYRIOTA_Profile *const profile) {
+  PROFILER_ASSERT(profile != NULL);
+  char text[MYRIOTA_PROFILER_DIAG_LEN];
+  profiler_format(profile, text, sizeof(text));
+  printf("%s: %s\n", profile->name, text);
+}
+
+int MYRIOTA_ProfilerDiagWrite(const MYRIOTA_Profile *const profile, const FLEX_DiagConfID id) {
+  PROFILER_ASSERT(profile != NULL);
+  char text[MYRIOTA_PROFILER_DIAG_LEN];
+  profiler_format(profile, text, sizeof(text));
+  return FLEX_DiagConfValueWrite(id, text);
+}
+
+#ifdef MYRIOTA_PROFILER_UNIT_TESTS
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+/*
+ * `cmocka.h` must be included after standard the above library headers.
+ * NOTE: This comment has dual purpose:
+ * 1. Document the ordering requirement.
+ * 2. Prevent `clang-format` from reordering the headers.
+ */
+#include <cmocka.h>
+#include "myriota/flex_fake.h"
+
+static uint32_t test_job_duration_ms;
+
+static time_t test_job(void) {
+  flex_fake.tick += test_job_duration_ms;
+  return flex_fake.time + 600;
+}
+
+MYRIOTA_PROFILER_DEFINE(profiled_test_job, test_job);
+
+static void test_profile(void **state) {
+  (void)state;
+  MYRIOTA_FlexFakeReset();
+  flex_fake.time = 1000;
+  flex_fake.tick = UINT32_MAX - 10;
+  MYRIOTA_Profile *const profile = &MYRIOTA_PROFILER_PROFILE(profiled_test_job);
+  assert_int_equal(MYRIOTA_ProfilerSchedule(profile, FLEX_ASAP()), 0);
+  assert_ptr_equal(flex_fake.job, profiled_test_job);
+  assert_int_equal(flex_fake.job_time, FLEX_ASAP());
+
+  // Runs on time for 0 ms, 3 s late for 1500 ms across the tick wrapping, then 1 s late for 5 ms.
+  test_job_duration_ms = 0;
+  assert_int_equal(profiled_test_job(), 1600);
+  flex_fake.time = 1603;
+  test_job_duration_ms = 1500;
+  assert_int_equal(profiled_test_job(), 2203);
+  flex_fake.time = 2204;
+  test_job_duration_ms = 5;
+  profiled_test_job();
+
+  MYRIOTA_ProfilerStats stats;
+  MYRIOTA_ProfilerStatsGet(profile, &stats);
+  assert_int_equal(stats.run_count, 3);
+  assert_int_equal(stats.total_ms, 1505);
+  assert_int_equal(stats.max_ms, 1500);
+  assert_int_equal(stats.max_late_s, 3);
+  assert_int_equal(stats.duration_ms[0], 1);
+  assert_int_equal(stats.duration_ms[3], 1);
+  assert_int_equal(stats.duration_ms[11], 1);
+  assert_int_equal(stats.late_s[0], 1);
+  assert_int_equal(stats.late_s[1], 1);
+  assert_int_equal(stats.late_s[2], 1);
+
+  assert_int_equal(MYRIOTA_ProfilerDiagWrite(profile, FLEX_DIAG_CONF_ID_USER_3), 0);
+  assert_int_equal(flex_fake.diag_id, FLEX_DIAG_CONF_ID_USER_3);
+  assert_string_equal(flex_fake.diag,
+    "runs 3 total_ms 1505 max_ms 1500 max_late_s 3 ms 1,0,0,1,0,0,0,0,0,0,0,1 late 1,1,1");
+  MYRIOTA_FlexFakeConsoleBegin();
+  MYRIOTA_ProfilerPrint(profile);
+  MYRIOTA_FlexFakeConsoleEnd();
+  assert_string_equal(flex_fake.console,
+    "test_job: runs 3 total_ms 1505 max_ms 1500 max_late_s 3 "
+    "ms 1,0,0,1,0,0,0,0,0,0,0,1 late 1,1,1\n");
+
+  MYRIOTA_ProfilerReset(profile);
+  assert_int_equal(MYRIOTA_ProfilerDiagWrite(profile, FLEX_DIAG_CONF_ID_USER_3), 0);
+  assert_string_equal(flex_fake.diag, "runs 0 total_ms 0 max_ms 0 max_late_s 0 ms 0 late 0");
+}
+
+static void test_saturation(void **state) {
+  (void)state;
+  MYRIOTA_FlexFakeReset();
+  MYRIOTA_Profile *const profile = &MYRIOTA_PROFILER_PROFILE(profiled_test_job);
+  MYRIOTA_ProfilerReset(profile);
+  MYRIOTA_ProfilerSchedule(profile, 0);
+
+  // Long runs fall in the last bucket, and the counts and total saturate.
+  test_job_duration_ms = UINT32_MAX / 2;
+  for (int i = 0; i < UINT16_MAX + 2; ++i) {
+    profiled_test_job();
+    flex_fake.time += 600;
+  }
+  MYRIOTA_ProfilerStats stats;
+  MYRIOTA_ProfilerStatsGet(profile, &stats);
+  assert_int_equal(stats.run_count, UINT16_MAX + 2);
+  assert_int_equal(stats.total_ms, UINT32_MAX);
+  assert_int_equal(stats.duration_ms[MYRIOTA_PROFILER_BUCKETS - 1], UINT16_MAX);
+  assert_int_equal(stats.late_s[0], UINT16_MAX);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_profile),
+    cmocka_unit_test(test_saturation),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+#endif /** MYRIOTA_PROFILER_UNIT_TESTS */
@@ -0,0 +1,231 @@
+/// \file resource.h Myriota Resource Manager
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYRIOTA_RESOURCE_H
+#define MYRIOTA_RESOURCE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "flex.h"
+
+/** \defgroup Resource Resource Manager
+ * @brief Share the power output and peripherals between drivers
+ *
+ * The FlexSense interfaces are initialised with a single configuration, and
+ * nothing stops two drivers from initialising and de-initialising one
+ * underneath each other, so each driver power cycles the sensor and waits for
+ * it to warm up. A resource manager counts the users of each interface:
+ *
+ * - The first user to acquire an interface initialises it, and the last to
+ *   release it de-initialises it.
+ * - Acquiring an interface with a different configuration from its current
+ *   users fails with -FLEX_ERROR_EBUSY.
+ * - MYRIOTA_ResourceWarmUp() only waits for the part of the warm-up that has
+ *   not passed since the interface was initialised, so a second user of a
+ *   stable power output does not wait again.
+ * - The time each interface is on is accumulated for energy accounting.
+ *
+ * \code
+ * static MYRIOTA_ResourceManager resources;
+ *
+ * static int read_level(uint32_t *const level) {
+ *   MYRIOTA_ResourceHandle power, analog;
+ *   int result = MYRIOTA_ResourcePowerOutAcquire(&resources, &power, FLEX_POWER_OUT_24V);
+ *   if (result < 0) {
+ *     return result;
+ *   }
+ *   result = MYRIOTA_ResourceAnalogInAcquire(&resources, &analog, FLEX_ANALOG_IN_CURRENT);
+ *   if (result == FLEX_SUCCESS) {
+ *     MYRIOTA_ResourceWarmUp(&power, 1500);
+ *     result = FLEX_AnalogInputReadCurrent(level);
+ *     MYRIOTA_ResourceRelease(&analog);
+ *   }
+ *   MYRIOTA_ResourceRelease(&power);
+ *   return result;
+ * }
+ * \endcode
+ * \{
+ */
+
+/** The interfaces managed by a resource manager. */
+typedef enum {
+  MYRIOTA_RESOURCE_POWER_OUT,
+  MYRIOTA_RESOURCE_ANALOG_IN,
+  MYRIOTA_RESOURCE_SERIAL,
+  MYRIOTA_RESOURCE_PULSE_COUNTER,
+  MYRIOTA_RESOURCE_COUNT,
+} MYRIOTA_Resource;
+
+/** Statistics of an interface. */
+typedef struct {
+  /** The number of times the interface was acquired. */
+  uint32_t acquire_count;
+  /** The number of times the interface was initialised. */
+  uint32_t init_count;
+  /** The number of acquisitions that failed because of a different configuration. */
+  uint32_t conflict_count;
+  /** The total time in milliseconds the interface was on, including now. */
+  uint64_t on_ms;
+} MYRIOTA_ResourceStats;
+
+/** \cond INTERNAL_HIDDEN */
+typedef union {
+  FLEX_PowerOut power_out;
+  FLEX_AnalogInputMode analog_in;
+  FLEX_SerialExOptions serial;
+  struct {
+    uint32_t limit;
+    uint32_t options;
+  } pulse_counter;
+} MYRIOTA_ResourceConfig;
+
+typedef struct {
+  uint8_t user_count;
+  uint32_t init_tick;
+  MYRIOTA_ResourceConfig config;
+  MYRIOTA_ResourceStats stats;
+} MYRIOTA_ResourceState;
+/** \endcond */
+
+/** A resource manager. Treat the members as private. */
+typedef struct {
+  /** \cond INTERNAL_HIDDEN */
+  MYRIOTA_ResourceState resources[MYRIOTA_RESOURCE_COUNT];
+  /** \endcond */
+} MYRIOTA_ResourceManager;
+
+/** A handle of an acquired interface. Treat the members as private. */
+typedef struct {
+  /** \cond INTERNAL_HIDDEN */
+  MYRIOTA_ResourceManager *manager;
+  MYRIOTA_Resource resource;
+  bool is_acquired;
+  /** \endcond */
+} MYRIOTA_ResourceHandle;
+
+/**
+ * Initializes a resource manager, where no interface is acquired.
+ *
+ * \param[out] manager The resource manager to initialize.
+ */
+void MYRIOTA_ResourceInit(MYRIOTA_ResourceManager *const manager);
+
+/**
+ * Acquire the power output at a voltage, initialising it with
+ * FLEX_PowerOutInit() if it is off.
+ *
+ * \param[in,out] manager The resource manager.
+ * \param[out] handle The handle of the power output, if succeeded.
+ * \param[in] voltage The voltage of the power output.
+ * \return FLEX_SUCCESS (0) if succeeded and < 0 if failed.
+ * \retval -FLEX_ERROR_EBUSY: the power output is on at another voltage.
+ * Errors of FLEX_PowerOutInit() are returned.
+ */
+int MYRIOTA_ResourcePowerOutAcquire(MYRIOTA_ResourceManager *const manager,
+  MYRIOTA_ResourceHandle *const handle, const FLEX_PowerOut voltage);
+
+/**
+ * Acquire the analog input in a mode, initialising it with
+ * FLEX_AnalogInputInit() if it is off.
+ *
+ * \param[in,out] manager The resource manager.
+ * \param[out] handle The handle of the analog input, if succeeded.
+ * \param[in] mode The mode of the analog input.
+ * \return FLEX_SUCCESS (0) if succeeded and < 0 if failed.
+ * \retval -FLEX_ERROR_EBUSY: the analog input is on in another mode.
+ * Errors of FLEX_AnalogInputInit() are returned.
+ */
+int MYRIOTA_ResourceAnalogInAcquire(MYRIOTA_ResourceManager *const manager,
+  MYRIOTA_ResourceHandle *const handle, const FLEX_AnalogInputMode mode);
+
+/**
+ * Acquire the serial interface with options, initialising it with
+ * FLEX_SerialInitEx() if it is off.
+ *
+ * \param[in,out] manager The resource manager.
+ * \param[out] handle The handle of the serial interface, if succeeded.
+ * \param[in] options The options of the serial interface.
+ * \return FLEX_SUCCESS (0) if succeeded and < 0 if failed.
+ * \retval -FLEX_ERROR_EBUSY: the serial interface is on with other options.
+ * Errors of FLEX_SerialInitEx() are returned.
+ */
+int MYRIOTA_ResourceSerialAcquire(MYRIOTA_ResourceManager *const manager,
+  MYRIOTA_ResourceHandle *const handle, const FLEX_SerialExOptions options);
+
+/**
+ * Acquire the pulse counter, initialising it with FLEX_PulseCounterInit() if
+ * it is off.
+ *
+ * \param[in,out] manager The resource manager.
+ * \param[out] handle The handle of the pulse counter, if succeeded.
+ * \param[in] limit The limit of the pulse counter.
+ * \param[in] options The FLEX_PulseCounterOption flags of the pulse counter.
+ * \return FLEX_SUCCESS (0) if succeeded and < 0 if failed.
+ * \retval -FLEX_ERROR_EBUSY: the pulse counter is on with another limit or options.
+ * Errors of FLEX_PulseCounterInit() are returned.
+ */
+int MYRIOTA_ResourcePulseCounterAcquire(MYRIOTA_ResourceManager *const manager,
+  MYRIOTA_ResourceHandle *const handle, const uint32_t limit, const uint32_t options);
+
+/**
+ * Release an interface, de-initialising it if this was its last user. A
+ * handle that is not acquired is ignored.
+ *
+ * \param[in,out] handle The handle of the interface.
+ * \return FLEX_SUCCESS (0) if succeeded and < 0 if de-initialising the
+ * interface failed, in which case it is still released.
+ */
+int MYRIOTA_ResourceRelease(MYRIOTA_ResourceHandle *const handle);
+
+/**
+ * Returns the time in milliseconds since the interface of a handle was initialised.
+ *
+ * \param[in] handle The handle of an acquired interface.
+ */
+uint32_t MYRIOTA_ResourceOnMs(const MYRIOTA_ResourceHandle *const handle);
+
+/**
+ * Wait with FLEX_DelayMs() until the interface of a handle has been on for a
+ * warm-up time, which does not wait if it has been on for longer already.
+ *
+ * \param[in] handle The handle of an acquired interface.
+ * \param[in] warm_up_ms The warm-up time in milliseconds.
+ */
+void MYRIOTA_ResourceWarmUp(const MYRIOTA_ResourceHandle *const handle, const uint32_t warm_up_ms);
+
+/**
+ * Returns true if two configurations of the serial interface are the same, in
+ * which case a user of one can share the serial interface with a user of the other.
+ *
+ * \param[in] a The options of the serial interface.
+ * \param[in] b The other options of the serial interface.
+ */
+bool MYRIOTA_ResourceSerialEqual(const FLEX_SerialExOptions *const a,
+  const FLEX_SerialExOptions *const b);
+
+/**
+ * Get the statistics of an interface.
+ *
+ * \param[in] manager The resource manager.
+ * \param[in] resource The interface.
+ * \param[out] stats The statistics.
+ */
+void MYRIOTA_ResourceStatsGet(const MYRIOTA_ResourceManager *const manager,
+  const MYRIOTA_Resource resource, MYRIOTA_ResourceStats *const stats);
+
+/**
+ * \}
+ */
+
+#endif /* MYRIOTA_RESOURCE_H */
@@ -0,0 +1,365 @@
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myriota/resource.h"
+#include <string.h>
+#include "flex_errors.h"
+
+// NOTE: you can provide your own assert
+#ifndef RESOURCE_ASSERT
+#include <stdio.h>
+#define RESOURCE_ASSERT(cond)                        \
+  do {                                               \
+    if (!(cond)) {                                   \
+      printf("Assert @%s:%d\n", __FILE__, __LINE__); \
+      while (1) {                                    \
+      }                                              \
+    }                                                \
+  } while (0)
+#endif
+
+static bool resource_config_equal(const MYRIOTA_Resource resource,
+  const MYRIOTA_ResourceConfig *const a, const MYRIOTA_ResourceConfig *const b) {
+  switch (resource) {
+    case MYRIOTA_RESOURCE_POWER_OUT:
+      return a->power_out == b->power_out;
+    case MYRIOTA_RESOURCE_ANALOG_IN:
+      return a->analog_in == b->analog_in;
+    case MYRIOTA_RESOURCE_SERIAL:
+      return MYRIOTA_ResourceSerialEqual(&a->serial, &b->serial);
+    default:
+      return a->pulse_counter.limit == b->pulse_counter.limit &&
+             a->pulse_counter.options == b->pulse_counter.options;
+  }
+}
+
+static int resource_init(const MYRIOTA_Resource resource,
+  const MYRIOTA_ResourceConfig *const config) {
+  switch (resource) {
+    case MYRIOTA_RESOURCE_POWER_OUT:
+      return FLEX_PowerOutInit(config->power_out);
+    case MYRIOTA_RESOURCE_ANALOG_IN:
+      return FLEX_AnalogInputInit(config->analog_in);
+    case MYRIOTA_RESOURCE_SERIAL:
+      return FLEX_SerialInitEx(config->serial);
+    default:
+      return FLEX_PulseCounterInit(config->pulse_counter.limit, config->pulse_counter.options);
+  }
+}
+
+static int resource_deinit(const MYRIOTA_Resource resource) {
+  switch (resource) {
+    case MYRIOTA_RESOURCE_POWER_OUT:
+      return FLEX_PowerOutDeinit();
+    case MYRIOTA_RESOURCE_ANALOG_IN:
+      return FLEX_AnalogInputDeinit();
+    case MYRIOTA_RESOURCE_SERIAL:
+      return FLEX_SerialDeinit();
+    default:
+      FLEX_PulseCounterDeinit();
+      return FLEX_SUCCESS;
+  }
+}
+
+// The milliseconds since a tick, which is correct across the wrap of the tick.
+static uint32_t resource_since(const uint32_t tick) {
+  return (uint32_t)(FLEX_TickGet() - tick);
+}
+
+static int resource_acquire(MYRIOTA_ResourceManager *const manager,
+  MYRIOTA_ResourceHandle *const handle, const MYRIOTA_Resource resource,
+  const MYRIOTA_ResourceConfig *const config) {
+  RESOURCE_ASSERT(manager != NULL && handle != NULL);
+  MYRIOTA_ResourceState *const state = &manager->resources[resource];
+  handle->is_acquired = false;
+  if (state->user_count > 0) {
+    if (!resource_config_equal(resource, &state->config, config)) {
+      ++state->stats.conflict_count;
+      return -FLEX_ERROR_EBUSY;
+    }
+    RESOURCE_ASSERT(state->user_count < UINT8_MAX);
+  } else {
+    const int result = resource_init(resource, config);
+    if (result < 0) {
+      return result;
+    }
+    state->config = *config;
+    state->init_tick = FLEX_TickGet();
+    ++state->stats.init_count;
+  }
+  ++state->user_count;
+  ++state->stats.acquire_count;
+  handle->manager = manager;
+  handle->resource = resource;
+  handle->is_acquired = true;
+  return FLEX_SUCCESS;
+}
+
+void MYRIOTA_ResourceInit(MYRIOTA_ResourceManager *const manager) {
+  RESOURCE_ASSERT(manager != NULL);
+  memset(manager, 0, sizeof(*manager));
+}
+
+int MYRIOTA_ResourcePowerOutAcquire(MYRIOTA_ResourceManager *const manager,
+  MYRIOTA_ResourceHandle *const handle, const FLEX_PowerOut voltage) {
+  const MYRIOTA_ResourceConfig config = {.power_out = voltage};
+  return resource_acquire(manager, handle, MYRIOTA_RESOURCE_POWER_OUT, &config);
+}
+
+int MYRIOTA_ResourceAnalogInAcquire(MYRIOTA_ResourceManager *const manager,
+  MYRIOTA_ResourceHandle *const handle, const FLEX_AnalogInputMode mode) {
+  const MYRIOTA_ResourceConfig config = {.analog_in = mode};
+  return resource_acquire(manager, handle, MYRIOTA_RESOURCE_ANALOG_IN, &config);
+}
+
+int MYRIOTA_ResourceSerialAcquire(MYRIOTA_ResourceManager *const manager,
+  MYRIOTA_ResourceHandle *const handle, const FLEX_SerialExOptions options) {
+  const MYRIOTA_ResourceConfig config = {.serial = options};
+  return resource_acquire(manager, handle, MYRIOTA_RESOURCE_SERIAL, &config);
+}
+
+int MYRIOTA_ResourcePulseCounterAcquire(MYRIOTA_ResourceManager *const manager,
+  MYRIOTA_ResourceHandle *const handle, const uint32_t limit, const uint32_t options) {
+  const MYRIOTA_ResourceConfig config = {.pulse_counter = {.limit = limit, .options = options}};
+  return resource_acquire(manager, handle, MYRIOTA_RESOURCE_PULSE_COUNTER, &config);
+}
+
+int MYRIOTA_ResourceRelease(MYRIOTA_ResourceHandle *const handle) {
+  RESOURCE_ASSERT(handle != NULL);
+  if (!handle->is_acquired) {
+    return FLEX_SUCCESS;
+  }
+  handle->is_acquired = false;
+  MYRIOTA_ResourceState *const state = &handle->manager->resources[handle->resource];
+  RESOURCE_ASSERT(state->user_count > 0);
+  if (--state->user_count > 0) {
+    return FLEX_SUCCESS;
+  }
+  state->stats.on_ms += resource_since(state->init_tick);
+  return resource_deinit(handle->resource);
+}
+
+uint32_t MYRIOTA_ResourceOnMs(const MYRIOTA_ResourceHandle *const handle) {
+  RESOURCE_ASSERT(handle != NULL && handle->is_acquired);
+  return resource_since(handle->manager->resources[handle->resource].init_tick);
+}
+
+void MYRIOTA_ResourceWarmUp(const MYRIOTA_ResourceHandle *const handle, const uint32_t warm_up_ms) {
+  const uint32_t on_ms = MYRIOTA_ResourceOnMs(handle);
+  if (on_ms < warm_up_ms) {
+    FLEX_DelayMs(warm_up_ms - on_ms);
+  }
+}
+
+bool MYRIOTA_ResourceSerialEqual(const FLEX_SerialExOptions *const a,
+  const FLEX_SerialExOptions *const b) {
+  RESOURCE_ASSERT(a != NULL && b != NULL);
+  return a->protocol == b->protocol && a->baud_rate == b->baud_rate && a->parity == b->parity &&
+         a->databits == b->databits && a->stopbits == b->stopbits;
+}
+
+void MYRIOTA_ResourceStatsGet(const MYRIOTA_ResourceManager *const manager,
+  const MYRIOTA_Resource resource, MYRIOTA_ResourceStats *const stats) {
+  RESOURCE_ASSERT(manager != NULL && resource < MYRIOTA_RESOURCE_COUNT && stats != NULL);
+  const MYRIOTA_ResourceState *const state = &manager->resources[resource];
+  *stats = state->stats;
+  if (state->user_count > 0) {
+    stats->on_ms += resource_since(state->init_tick);
+  }
+}
+
+#ifdef MYRIOTA_RESOURCE_UNIT_TESTS
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+/*
+ * `cmocka.h` must be included after standard the above library headers.
+ * NOTE: This comment has dual purpose:
+ * 1. Document the ordering requirement.
+ * 2. Prevent `clang-format` from reordering the headers.
+ */
+#include <cmocka.h>
+#include "myriota/flex_fake.h"
+
+static MYRIOTA_ResourceManager manager;
+
+static void resource_setup(void) {
+  MYRIOTA_FlexFakeReset();
+  flex_fake.tick = 1000;
+  MYRIOTA_ResourceInit(&manager);
+}
+
+static void test_power_out_shared(void **state) {
+  (void)state;
+  resource_setup();
+  MYRIOTA_ResourceHandle first, second;
+  assert_int_equal(MYRIOTA_ResourcePowerOutAcquire(&manager, &first, FLEX_POWER_OUT_24V), 0);
+  assert_true(flex_fake.is_power_out);
+  assert_int_equal(flex_fake.power_out, FLEX_POWER_OUT_24V);
+  MYRIOTA_ResourceWarmUp(&first, 1500);
+  assert_int_equal(flex_fake.delay_ms, 1500);
+
+  // A second user of the stable rail does not wait or power cycle it.
+  flex_fake.tick += 200;
+  assert_int_equal(MYRIOTA_ResourcePowerOutAcquire(&manager, &second, FLEX_POWER_OUT_24V), 0);
+  MYRIOTA_ResourceWarmUp(&second, 1500);
+  assert_int_equal(flex_fake.delay_ms, 1500);
+  assert_int_equal(flex_fake.power_out_count, 1);
+
+  assert_int_equal(MYRIOTA_ResourceRelease(&first), 0);
+  assert_true(flex_fake.is_power_out);
+  assert_int_equal(MYRIOTA_ResourceRelease(&second), 0);
+  assert_false(flex_fake.is_power_out);
+
+  // Releasing twice is ignored.
+  assert_int_equal(MYRIOTA_ResourceRelease(&second), 0);
+
+  MYRIOTA_ResourceStats stats;
+  MYRIOTA_ResourceStatsGet(&manager, MYRIOTA_RESOURCE_POWER_OUT, &stats);
+  assert_int_equal(stats.acquire_count, 2);
+  assert_int_equal(stats.init_count, 1);
+  assert_int_equal(stats.conflict_count, 0);
+  assert_int_equal(stats.on_ms, 1700);
+}
+
+static void test_power_out_partial_warm_up(void **state) {
+  (void)state;
+  resource_setup();
+  MYRIOTA_ResourceHandle first, second;
+  assert_int_equal(MYRIOTA_ResourcePowerOutAcquire(&manager, &first, FLEX_POWER_OUT_12V), 0);
+  flex_fake.tick += 600;
+  assert_int_equal(MYRIOTA_ResourcePowerOutAcquire(&manager, &second, FLEX_POWER_OUT_12V), 0);
+  MYRIOTA_ResourceWarmUp(&second, 1500);
+  assert_int_equal(flex_fake.delay_ms, 900);
+  assert_int_equal(MYRIOTA_ResourceOnMs(&first), 1500);
+  MYRIOTA_ResourceRelease(&second);
+  MYRIOTA_ResourceRelease(&first);
+}
+
+static void test_power_out_conflict(void **state) {
+  (void)state;
+  resource_setup();
+  MYRIOTA_ResourceHandle first, second;
+  assert_int_equal(MYRIOTA_ResourcePowerOutAcquire(&manager, &first, FLEX_POWER_OUT_24V), 0);
+  assert_int_equal(MYRIOTA_ResourcePowerOutAcquire(&manager, &second, FLEX_POWER_OUT_12V),
+    -FLEX_ERROR_EBUSY);
+  assert_int_equal(flex_fake.power_out, FLEX_POWER_OUT_24V);
+
+  // The handle of a failed acquisition does not release the rail.
+  assert_int_equal(MYRIOTA_ResourceRelease(&second), 0);
+  assert_true(flex_fake.is_power_out);
+  MYRIOTA_ResourceRelease(&first);
+
+  // The rail can be acquired at another voltage once it is off.
+  assert_int_equal(MYRIOTA_ResourcePowerOutAcquire(&manager, &second, FLEX_POWER_OUT_12V), 0);
+  assert_int_equal(flex_fake.power_out, FLEX_POWER_OUT_12V);
+  MYRIOTA_ResourceRelease(&second);
+
+  MYRIOTA_ResourceStats stats;
+  MYRIOTA_ResourceStatsGet(&manager, MYRIOTA_RESOURCE_POWER_OUT, &stats);
+  assert_int_equal(stats.acquire_count, 2);
+  assert_int_equal(stats.init_count, 2);
+  assert_int_equal(stats.conflict_count, 1);
+}
+
+static void test_init_failure(void **state) {
+  (void)state;
+  resource_setup();
+  MYRIOTA_ResourceHandle handle;
+  flex_fake.power_out_result = -FLEX_ERROR_EALREADY;
+  assert_int_equal(MYRIOTA_ResourcePowerOutAcquire(&manager, &handle, FLEX_POWER_OUT_5V),
+    -FLEX_ERROR_EALREADY);
+  assert_int_equal(MYRIOTA_ResourceRelease(&handle), 0);
+
+  flex_fake.power_out_result = 0;
+  assert_int_equal(MYRIOTA_ResourcePowerOutAcquire(&manager, &handle, FLEX_POWER_OUT_5V), 0);
+  assert_true(flex_fake.is_power_out);
+  MYRIOTA_ResourceRelease(&handle);
+
+  MYRIOTA_ResourceStats stats;
+  MYRIOTA_ResourceStatsGet(&manager, MYRIOTA_RESOURCE_POWER_OUT, &stats);
+  assert_int_equal(stats.acquire_count, 1);
+  assert_int_equal(stats.init_count, 1);
+}
+
+static void test_peripherals(void **state) {
+  (void)state;
+  resource_setup();
+  MYRIOTA_ResourceHandle analog, other_analog, serial, other_serial, pulse, other_pulse;
+  const FLEX_SerialExOptions rs485 = {.protocol = FLEX_SERIAL_PROTOCOL_RS485, .baud_rate = 9600};
+  const FLEX_SerialExOptions fast = {.protocol = FLEX_SERIAL_PROTOCOL_RS485, .baud_rate = 19200};
+
+  assert_int_equal(MYRIOTA_ResourceAnalogInAcquire(&manager, &analog, FLEX_ANALOG_IN_CURRENT), 0);
+  assert_true(flex_fake.is_analog_in);
+  assert_int_equal(MYRIOTA_ResourceAnalogInAcquire(&manager, &other_analog, FLEX_ANALOG_IN_VOLTAGE),
+    -FLEX_ERROR_EBUSY);
+  assert_true(flex_fake.is_analog_in);
+
+  assert_int_equal(MYRIOTA_ResourceSerialAcquire(&manager, &serial, rs485), 0);
+  assert_int_equal(flex_fake.serial.baud_rate, 9600);
+  assert_int_equal(MYRIOTA_ResourceSerialAcquire(&manager, &other_serial, fast), -FLEX_ERROR_EBUSY);
+  assert_int_equal(MYRIOTA_ResourceSerialAcquire(&manager, &other_serial, rs485), 0);
+  assert_true(MYRIOTA_ResourceSerialEqual(&rs485, &rs485));
+  assert_false(MYRIOTA_ResourceSerialEqual(&rs485, &fast));
+
+  assert_int_equal(MYRIOTA_ResourcePulseCounterAcquire(&manager, &pulse, 10, 0), 0);
+  assert_int_equal(flex_fake.pulse_limit, 10);
+  assert_int_equal(MYRIOTA_ResourcePulseCounterAcquire(&manager, &other_pulse, 20, 0),
+    -FLEX_ERROR_EBUSY);
+
+  flex_fake.tick += 250;
+  MYRIOTA_ResourceStats stats;
+  MYRIOTA_ResourceStatsGet(&manager, MYRIOTA_RESOURCE_SERIAL, &stats);
+  assert_int_equal(stats.on_ms, 250);
+  assert_int_equal(stats.acquire_count, 2);
+
+  MYRIOTA_ResourceRelease(&serial);
+  assert_true(flex_fake.is_serial);
+  MYRIOTA_ResourceRelease(&other_serial);
+  assert_false(flex_fake.is_serial);
+  MYRIOTA_ResourceRelease(&pulse);
+  assert_false(flex_fake.is_pulse_counter);
+  MYRIOTA_ResourceRelease(&analog);
+  assert_false(flex_fake.is_analog_in);
+}
+
+static void test_tick_wrap(void **state) {
+  (void)state;
+  resource_setup();
+  MYRIOTA_ResourceHandle handle;
+  flex_fake.tick = UINT32_MAX - 499;
+  assert_int_equal(MYRIOTA_ResourcePowerOutAcquire(&manager, &handle, FLEX_POWER_OUT_24V), 0);
+  flex_fake.tick += 1000;
+  MYRIOTA_ResourceWarmUp(&handle, 1500);
+  assert_int_equal(flex_fake.delay_ms, 500);
+  MYRIOTA_ResourceRelease(&handle);
+
+  MYRIOTA_ResourceStats stats;
+  MYRIOTA_ResourceStatsGet(&manager, MYRIOTA_RESOURCE_POWER_OUT, &stats);
+  assert_int_equal(stats.on_ms, 1500);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_power_out_shared),
+    cmocka_unit_test(test_power_out_partial_warm_up),
+    cmocka_unit_test(test_power_out_conflict),
+    cmocka_unit_test(test_init_failure),
+    cmocka_unit_test(test_peripherals),
+    cmocka_unit_test(test_tick_wrap),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+#endif /** MYRIOTA_RESOURCE_UNIT_TESTS */
@@ -0,0 +1,132 @@
+/// \file serial.h Myriota Buffered Serial Library
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYRIOTA_SERIAL_H
+#define MYRIOTA_SERIAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "flex.h"
+
+/** \defgroup Serial Buffered Serial Library
+ * @brief Ring buffered wrapper for the FlexSense Serial interface
+ *
+ * The FlexSense Serial driver only buffers 50 received bytes. This library
+ * drains the driver in bulk into a larger ring buffer and provides reads that
+ * complete on a byte count, a delimiter or an inter-byte gap, bounded by an
+ * overall deadline. While waiting for data the library delays for a fraction
+ * of the time the driver takes to fill at the configured baud rate instead of
+ * polling it continuously.
+ * \{
+ */
+
+/** The size of the receive ring buffer in bytes, must be a power of two. */
+#ifndef MYRIOTA_SERIAL_RING_SIZE
+#define MYRIOTA_SERIAL_RING_SIZE 256
+#endif
+
+/** Value of MYRIOTA_SerialReadOptions::delimiter when no delimiter is used. */
+#define MYRIOTA_SERIAL_NO_DELIMITER (-1)
+
+/** Completion conditions for MYRIOTA_SerialRead(). The read completes on the
+ * first condition met, or when the buffer is full. */
+typedef struct {
+  /** The overall time in milliseconds to wait for the read to complete. */
+  uint32_t timeout_ms;
+  /** Complete after this many bytes, where 0 uses the size of the buffer. */
+  size_t count;
+  /** Complete after this byte has been read (it is included in the result),
+   * or MYRIOTA_SERIAL_NO_DELIMITER. */
+  int delimiter;
+  /** Complete when at least one byte has been read and no further byte has
+   * arrived for this many milliseconds, where 0 disables the gap condition. */
+  uint32_t gap_ms;
+} MYRIOTA_SerialReadOptions;
+
+/** A buffered serial interface. Treat the members as private. */
+typedef struct {
+  /** \cond INTERNAL_HIDDEN */
+  bool initialized;
+  uint32_t baud_rate;
+  uint16_t head;
+  uint16_t tail;
+  uint32_t last_rx_tick;
+  uint8_t ring[MYRIOTA_SERIAL_RING_SIZE];
+  /** \endcond */
+} MYRIOTA_Serial;
+
+/**
+ * Initializes the Serial interface and clears the receive buffer.
+ *
+ * \param[out] serial The buffered serial interface to initialize.
+ * \param[in] options The Serial interface configuration.
+ * \return FLEX_SUCCESS (0) if succeeded and < 0 if failed.
+ */
+int MYRIOTA_SerialInit(MYRIOTA_Serial *const serial, const FLEX_SerialExOptions options);
+
+/**
+ * De-initializes the Serial interface, discarding any buffered bytes.
+ *
+ * \param[in,out] serial The buffered serial interface to de-initialize.
+ */
+void MYRIOTA_SerialDeinit(MYRIOTA_Serial *const serial);
+
+/**
+ * Write bytes to the Serial interface.
+ *
+ * \param[in,out] serial The buffered serial interface to write to.
+ * \param[in] buffer The bytes to write.
+ * \param[in] count The number of bytes to write.
+ * \return the number of bytes written on success, else < 0 on error.
+ */
+ssize_t MYRIOTA_SerialWrite(MYRIOTA_Serial *const serial, const uint8_t *const buffer,
+  const size_t count);
+
+/**
+ * Move all bytes received by the Serial driver into the receive buffer
+ * without waiting.
+ *
+ * \param[in,out] serial The buffered serial interface to poll.
+ * \return the number of bytes buffered on success, else < 0 on error.
+ */
+int MYRIOTA_SerialPoll(MYRIOTA_Serial *const serial);
+
+/**
+ * Read bytes until one of the completion conditions is met or the timeout expires.
+ *
+ * \param[in,out] serial The buffered serial interface to read from.
+ * \param[out] buffer The buffer to fill with the bytes read.
+ * \param[in] size The size of the buffer in bytes.
+ * \param[in] options The completion conditions of the read.
+ * \return the number of bytes read, which is 0 if the timeout expired before
+ * any byte was received, else < 0 on error.
+ */
+ssize_t MYRIOTA_SerialRead(MYRIOTA_Serial *const serial, uint8_t *const buffer, const size_t size,
+  const MYRIOTA_SerialReadOptions *const options);
+
+/**
+ * Discard all buffered bytes and any bytes waiting in the Serial driver.
+ *
+ * \param[in,out] serial The buffered serial interface to flush.
+ */
+void MYRIOTA_SerialFlushInput(MYRIOTA_Serial *const serial);
+
+/**
+ * \}
+ */
+
+#endif /* MYRIOTA_SERIAL_H */
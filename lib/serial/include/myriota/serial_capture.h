@@ -0,0 +1,164 @@
+/// \file serial_capture.h Myriota Serial Traffic Capture
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYRIOTA_SERIAL_CAPTURE_H
+#define MYRIOTA_SERIAL_CAPTURE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "myriota/modbus.h"
+
+/** \defgroup Serial_Capture Serial Traffic Capture
+ * @brief Record timestamped serial traffic for offline replay
+ *
+ * A capture records each chunk written to or read from a serial interface,
+ * with the time since the previous chunk from FLEX_TickGet(), in a RAM ring
+ * buffer. When the ring is full the oldest chunks are discarded. The log can
+ * be printed to the debug console with MYRIOTA_SerialCaptureDump() and fed
+ * back into the Modbus library on the host with MYRIOTA_SerialReplayInterface().
+ *
+ * \code
+ * static MYRIOTA_SerialCapture capture;
+ * MYRIOTA_SerialCaptureInit(&capture, MYRIOTA_SerialModbusInterface(&serial_context));
+ * const MYRIOTA_ModbusInitOptions options = {
+ *   .framing_mode = MODBUS_FRAMING_MODE_RTU,
+ *   .serial_interface = MYRIOTA_SerialCaptureInterface(&capture),
+ * };
+ * \endcode
+ *
+ * The log starts with a header of the magic "MSC", a version byte, the tick of
+ * the start of the log and the number of discarded chunks, both as
+ * little-endian uint32_t. Each chunk follows as a varint of
+ * `(delta_ms << 2) | kind`, see MYRIOTA_SerialCaptureKind, then for data
+ * chunks a varint length and the bytes, or for errors a varint of the negated
+ * error code.
+ * \{
+ */
+
+/** The size of the capture ring buffer in bytes, must be a power of two no
+ * larger than 32768. */
+#ifndef MYRIOTA_SERIAL_CAPTURE_SIZE
+#define MYRIOTA_SERIAL_CAPTURE_SIZE 1024
+#endif
+
+/** The size of the header at the start of a capture log in bytes. */
+#define MYRIOTA_SERIAL_CAPTURE_HEADER_SIZE 12
+
+/** The kind of a captured chunk. */
+typedef enum {
+  /** Bytes written to the interface. */
+  MYRIOTA_SERIAL_CAPTURE_TX = 0,
+  /** Bytes read from the interface. */
+  MYRIOTA_SERIAL_CAPTURE_RX = 1,
+  /** A read that failed, e.g. timed out, with its error code. */
+  MYRIOTA_SERIAL_CAPTURE_RX_ERROR = 2,
+} MYRIOTA_SerialCaptureKind;
+
+/** A serial traffic capture. Treat the members as private. */
+typedef struct {
+  /** \cond INTERNAL_HIDDEN */
+  MYRIOTA_ModbusSerialInterface inner;
+  uint32_t start_tick;
+  uint32_t last_tick;
+  uint32_t dropped;
+  uint16_t head;
+  uint16_t tail;
+  bool paused;
+  uint8_t ring[MYRIOTA_SERIAL_CAPTURE_SIZE];
+  /** \endcond */
+} MYRIOTA_SerialCapture;
+
+/**
+ * Initializes an empty capture.
+ *
+ * \param[out] capture The capture to initialize.
+ * \param[in] inner The interface to capture the traffic of, which may be zero
+ * initialised when only MYRIOTA_SerialCaptureRecord() is used.
+ */
+void MYRIOTA_SerialCaptureInit(MYRIOTA_SerialCapture *const capture,
+  const MYRIOTA_ModbusSerialInterface inner);
+
+/**
+ * Get a serial interface that forwards to the captured interface and records
+ * its traffic.
+ *
+ * \param[in] capture The capture, which must remain valid for the lifetime of
+ * the Modbus driver.
+ * \return the capturing Modbus serial interface.
+ */
+MYRIOTA_ModbusSerialInterface MYRIOTA_SerialCaptureInterface(MYRIOTA_SerialCapture *const capture);
+
+/**
+ * Record a chunk of traffic, e.g. around calls to MYRIOTA_SerialRead() and
+ * MYRIOTA_SerialWrite() when the Modbus library is not used.
+ *
+ * \param[in,out] capture The capture to record to.
+ * \param[in] kind The kind of chunk.
+ * \param[in] buffer The bytes of the chunk, unused for MYRIOTA_SERIAL_CAPTURE_RX_ERROR.
+ * \param[in] count The number of bytes, or the negative error code for
+ * MYRIOTA_SERIAL_CAPTURE_RX_ERROR.
+ */
+void MYRIOTA_SerialCaptureRecord(MYRIOTA_SerialCapture *const capture,
+  const MYRIOTA_SerialCaptureKind kind, const uint8_t *const buffer, const ssize_t count);
+
+/**
+ * Stop or resume recording, e.g. to freeze the log once a fault is seen.
+ *
+ * \param[in,out] capture The capture.
+ * \param[in] paused true to stop recording, false to resume.
+ */
+void MYRIOTA_SerialCapturePause(MYRIOTA_SerialCapture *const capture, const bool paused);
+
+/**
+ * Discard all recorded chunks.
+ *
+ * \param[in,out] capture The capture to clear.
+ */
+void MYRIOTA_SerialCaptureClear(MYRIOTA_SerialCapture *const capture);
+
+/**
+ * Returns the size of the capture log in bytes, including the header.
+ *
+ * \param[in] capture The capture.
+ */
+size_t MYRIOTA_SerialCaptureSize(const MYRIOTA_SerialCapture *const capture);
+
+/**
+ * Copy the capture log into a buffer.
+ *
+ * \param[in] capture The capture.
+ * \param[out] buffer The buffer to copy the log to.
+ * \param[in] size The size of the buffer in bytes.
+ * \return the number of bytes copied on success, else < 0 on error.
+ * \retval -FLEX_ERROR_ENOBUFS: the buffer is smaller than MYRIOTA_SerialCaptureSize().
+ */
+ssize_t MYRIOTA_SerialCaptureRead(const MYRIOTA_SerialCapture *const capture,
+  uint8_t *const buffer, const size_t size);
+
+/**
+ * Print the capture log to the debug console as lines of hexadecimal, which
+ * can be converted back to binary with `xxd -r -p`.
+ *
+ * \param[in] capture The capture to print.
+ */
+void MYRIOTA_SerialCaptureDump(const MYRIOTA_SerialCapture *const capture);
+
+/**
+ * \}
+ */
+
+#endif /* MYRIOTA_SERIAL_CAPTURE_H */
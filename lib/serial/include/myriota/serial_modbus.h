@@ -0,0 +1,67 @@
+/// \file serial_modbus.h Myriota Buffered Serial Modbus Interface
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYRIOTA_SERIAL_MODBUS_H
+#define MYRIOTA_SERIAL_MODBUS_H
+
+#include "myriota/modbus.h"
+#include "myriota/serial.h"
+
+/** \addtogroup Serial
+ * \{
+ */
+
+/** Context of the buffered serial Modbus interface. */
+typedef struct {
+  /** The Serial interface configuration used when the Modbus driver is enabled. */
+  FLEX_SerialExOptions options;
+  /** The time in milliseconds to wait for a response to start. */
+  uint32_t response_timeout_ms;
+  /** The silent interval in milliseconds that ends a response frame, where 0
+   * uses 3.5 character times at the configured baud rate. */
+  uint32_t frame_gap_ms;
+  /** \cond INTERNAL_HIDDEN */
+  MYRIOTA_Serial serial;
+  /** \endcond */
+} MYRIOTA_SerialModbusContext;
+
+/**
+ * Get a Modbus serial interface that uses the buffered serial library.
+ *
+ * Responses are read in bulk and complete once the line has been silent for
+ * the frame gap, rather than waiting for the whole response timeout.
+ *
+ * \code
+ * static MYRIOTA_SerialModbusContext serial_context = {
+ *   .options = {.protocol = FLEX_SERIAL_PROTOCOL_RS485, .baud_rate = 9600},
+ *   .response_timeout_ms = 1000,
+ * };
+ * const MYRIOTA_ModbusInitOptions options = {
+ *   .framing_mode = MODBUS_FRAMING_MODE_RTU,
+ *   .serial_interface = MYRIOTA_SerialModbusInterface(&serial_context),
+ * };
+ * \endcode
+ *
+ * \param[in] context The context for the interface, which must remain valid
+ * for the lifetime of the Modbus driver.
+ * \return the Modbus serial interface.
+ */
+MYRIOTA_ModbusSerialInterface MYRIOTA_SerialModbusInterface(
+  MYRIOTA_SerialModbusContext *const context);
+
+/**
+ * \}
+ */
+
+#endif /* MYRIOTA_SERIAL_MODBUS_H */
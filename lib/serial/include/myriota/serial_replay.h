@@ -0,0 +1,131 @@
+/// \file serial_replay.h Myriota Serial Traffic Replay
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYRIOTA_SERIAL_REPLAY_H
+#define MYRIOTA_SERIAL_REPLAY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "myriota/modbus.h"
+
+/** \defgroup Serial_Replay Serial Traffic Replay
+ * @brief Feed a capture log back into the Modbus library
+ *
+ * A replay is a serial interface that answers reads with the chunks recorded
+ * by MYRIOTA_SerialCapture, so that parsers can be regression tested and
+ * benchmarked against real traffic. It does not call any FlexSense functions
+ * and can be built for the host. Writes are compared with the recorded writes
+ * and mismatches are counted.
+ *
+ * \code
+ * MYRIOTA_SerialReplay replay;
+ * MYRIOTA_SerialReplayInit(&replay, log, log_size, NULL);  // As fast as possible
+ * const MYRIOTA_ModbusInitOptions options = {
+ *   .framing_mode = MODBUS_FRAMING_MODE_RTU,
+ *   .serial_interface = MYRIOTA_SerialReplayInterface(&replay),
+ * };
+ * \endcode
+ * \{
+ */
+
+/**
+ * Delay function used to reproduce the recorded timing.
+ *
+ * \param[in] ms The time to delay in milliseconds.
+ */
+typedef void (*MYRIOTA_SerialReplayDelayFn_t)(const uint32_t ms);
+
+/** Statistics of a replay. */
+typedef struct {
+  /** The number of recorded writes replayed. */
+  uint32_t tx_count;
+  /** The number of writes that differed from the recorded write. */
+  uint32_t tx_mismatch_count;
+  /** The number of recorded reads replayed, including failed reads. */
+  uint32_t rx_count;
+} MYRIOTA_SerialReplayStats;
+
+/** A replay of a capture log. Treat the members as private. */
+typedef struct {
+  /** \cond INTERNAL_HIDDEN */
+  const uint8_t *log;
+  size_t size;
+  MYRIOTA_SerialReplayDelayFn_t delay_ms;
+  size_t position;
+  const uint8_t *rx;
+  size_t rx_remaining;
+  MYRIOTA_SerialReplayStats stats;
+  /** \endcond */
+} MYRIOTA_SerialReplay;
+
+/**
+ * Initializes a replay from the start of a capture log.
+ *
+ * \param[out] replay The replay to initialize.
+ * \param[in] log The capture log, e.g. from MYRIOTA_SerialCaptureRead(), which
+ * must remain valid for the lifetime of the replay.
+ * \param[in] size The size of the log in bytes.
+ * \param[in] delay_ms Called with the recorded time between chunks, or NULL to
+ * replay as fast as possible.
+ * \return FLEX_SUCCESS (0) if succeeded and < 0 if failed.
+ * \retval -FLEX_ERROR_EBADMSG: the log does not start with a valid header.
+ */
+int MYRIOTA_SerialReplayInit(MYRIOTA_SerialReplay *const replay, const uint8_t *const log,
+  const size_t size, const MYRIOTA_SerialReplayDelayFn_t delay_ms);
+
+/**
+ * Get a serial interface that replays the capture log.
+ *
+ * Each write skips to the next recorded write. Each read returns the rest of
+ * a partially read chunk, else the next recorded read if it comes before the
+ * next write, else fails with -FLEX_ERROR_ETIMEDOUT.
+ *
+ * \param[in] replay The replay, which must remain valid for the lifetime of
+ * the Modbus driver.
+ * \return the replaying Modbus serial interface.
+ */
+MYRIOTA_ModbusSerialInterface MYRIOTA_SerialReplayInterface(MYRIOTA_SerialReplay *const replay);
+
+/**
+ * Restart a replay from the start of the log and clear its statistics.
+ *
+ * \param[in,out] replay The replay to rewind.
+ */
+void MYRIOTA_SerialReplayRewind(MYRIOTA_SerialReplay *const replay);
+
+/**
+ * Check whether all recorded chunks have been replayed.
+ *
+ * \param[in] replay The replay.
+ * \return true if the end of the log has been reached.
+ */
+bool MYRIOTA_SerialReplayDone(const MYRIOTA_SerialReplay *const replay);
+
+/**
+ * Get the statistics of a replay.
+ *
+ * \param[in] replay The replay.
+ * \param[out] stats The statistics.
+ */
+void MYRIOTA_SerialReplayStatsGet(const MYRIOTA_SerialReplay *const replay,
+  MYRIOTA_SerialReplayStats *const stats);
+
+/**
+ * \}
+ */
+
+#endif /* MYRIOTA_SERIAL_REPLAY_H */
@@ -0,0 +1,179 @@
+/// \file serial_tokenizer.h Myriota Serial Record Tokenizer
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYRIOTA_SERIAL_TOKENIZER_H
+#define MYRIOTA_SERIAL_TOKENIZER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "myriota/serial.h"
+
+/** \defgroup Serial_Tokenizer Serial Record Tokenizer
+ * @brief Zero-copy parsing of delimited ASCII records (e.g. NMEA or CSV lines)
+ *
+ * Records are located in place in the receive ring buffer of a MYRIOTA_Serial
+ * and split into fields that point straight into the ring, so no bytes are
+ * copied. A record or field that wraps around the end of the ring is described
+ * by two pieces, see MYRIOTA_SerialSlice.
+ *
+ * \code
+ * MYRIOTA_SerialTokenizer tokenizer;
+ * MYRIOTA_SerialTokenizerInit(&tokenizer, &serial, '\n');
+ *
+ * MYRIOTA_SerialRecord record;
+ * while (MYRIOTA_SerialTokenizerNext(&tokenizer, 1000, &record) > 0) {
+ *   if (MYRIOTA_SerialRecordChecksum(&record) != FLEX_SUCCESS) {
+ *     continue;
+ *   }
+ *   MYRIOTA_SerialSlice field;
+ *   while (MYRIOTA_SerialRecordField(&record, ',', &field)) {
+ *     // Use field.ptr/field.length, and field.wrap_ptr/field.wrap_length if wrapped.
+ *   }
+ * }
+ * \endcode
+ * \{
+ */
+
+/** A run of bytes in the receive ring buffer. The bytes are `ptr[0, length)`
+ * followed by `wrap_ptr[0, wrap_length)`, where `wrap_length` is only non-zero
+ * when the run wraps around the end of the ring. */
+typedef struct {
+  /** The first piece of the run. */
+  const uint8_t *ptr;
+  /** The length of the first piece. */
+  uint16_t length;
+  /** The second piece of the run, from the start of the ring. */
+  const uint8_t *wrap_ptr;
+  /** The length of the second piece. */
+  uint16_t wrap_length;
+} MYRIOTA_SerialSlice;
+
+/** A record located by MYRIOTA_SerialTokenizerNext(). */
+typedef struct {
+  /** The bytes of the record, excluding the delimiter and a trailing carriage return. */
+  MYRIOTA_SerialSlice slice;
+  /** \cond INTERNAL_HIDDEN */
+  uint16_t cursor;
+  bool done;
+  /** \endcond */
+} MYRIOTA_SerialRecord;
+
+/** Finds delimited records in a MYRIOTA_Serial. Treat the members as private. */
+typedef struct {
+  /** \cond INTERNAL_HIDDEN */
+  MYRIOTA_Serial *serial;
+  uint8_t delimiter;
+  uint16_t scanned;
+  uint16_t pending;
+  /** \endcond */
+} MYRIOTA_SerialTokenizer;
+
+/**
+ * Initializes a tokenizer.
+ *
+ * \param[out] tokenizer The tokenizer to initialize.
+ * \param[in] serial The buffered serial interface to find records in.
+ * \param[in] delimiter The byte that ends each record, e.g. '\\n'.
+ */
+void MYRIOTA_SerialTokenizerInit(MYRIOTA_SerialTokenizer *const tokenizer,
+  MYRIOTA_Serial *const serial, const uint8_t delimiter);
+
+/**
+ * Wait for the next complete record.
+ *
+ * \note The record points into the receive buffer and remains valid until the
+ * next call to this function, or until any other function reads from `serial`.
+ *
+ * \param[in,out] tokenizer The tokenizer.
+ * \param[in] timeout_ms The time in milliseconds to wait for a record.
+ * \param[out] record The record found.
+ * \return 1 if a record was found, 0 if the timeout expired, else < 0 on error.
+ * \retval -FLEX_ERROR_EMSGSIZE: the receive buffer filled without a delimiter,
+ * the buffered bytes are discarded.
+ */
+int MYRIOTA_SerialTokenizerNext(MYRIOTA_SerialTokenizer *const tokenizer,
+  const uint32_t timeout_ms, MYRIOTA_SerialRecord *const record);
+
+/**
+ * Verify and remove an NMEA style `*hh` checksum suffix, where `hh` is the
+ * hexadecimal XOR of the bytes between a leading '$' or '!' (if present) and the '*'.
+ *
+ * \param[in,out] record The record to verify, which is shortened to exclude
+ * the suffix on success.
+ * \return FLEX_SUCCESS (0) if the checksum matches.
+ * \retval -FLEX_ERROR_EBADMSG: the suffix is missing or the checksum does not match.
+ */
+int MYRIOTA_SerialRecordChecksum(MYRIOTA_SerialRecord *const record);
+
+/**
+ * Get the next field of a record.
+ *
+ * \param[in,out] record The record to get the field from.
+ * \param[in] separator The byte that separates fields, e.g. ','.
+ * \param[out] field The field, excluding the separator. Empty fields have a length of 0.
+ * \return true if a field was returned, false if there are no more fields.
+ */
+bool MYRIOTA_SerialRecordField(MYRIOTA_SerialRecord *const record, const uint8_t separator,
+  MYRIOTA_SerialSlice *const field);
+
+/**
+ * Returns the total length of a slice in bytes.
+ *
+ * \param[in] slice The slice.
+ */
+size_t MYRIOTA_SerialSliceLength(const MYRIOTA_SerialSlice *const slice);
+
+/**
+ * Compare a slice to a null terminated string.
+ *
+ * \param[in] slice The slice.
+ * \param[in] str The string to compare to.
+ * \return true if the slice has the same bytes as the string.
+ */
+bool MYRIOTA_SerialSliceEquals(const MYRIOTA_SerialSlice *const slice, const char *const str);
+
+/**
+ * Copy a slice into a buffer as a null terminated string, truncating it if needed.
+ *
+ * \param[in] slice The slice.
+ * \param[out] str The buffer to copy to.
+ * \param[in] size The size of the buffer, which must be at least 1.
+ * \return the number of bytes copied, excluding the terminator.
+ */
+size_t MYRIOTA_SerialSliceCopy(const MYRIOTA_SerialSlice *const slice, char *const str,
+  const size_t size);
+
+/**
+ * Parse a decimal number, e.g. "-12.345", as a fixed-point value with the
+ * given number of decimal places, e.g. -12345 for 3 decimal places. Further
+ * decimal places are rounded half away from zero. Leading and trailing spaces
+ * are ignored.
+ *
+ * \param[in] slice The slice to parse.
+ * \param[in] decimals The number of decimal places of the result.
+ * \param[out] value The parsed value.
+ * \return FLEX_SUCCESS (0) if succeeded and < 0 if failed.
+ * \retval -FLEX_ERROR_EINVAL: the slice is not a decimal number.
+ * \retval -FLEX_ERROR_ERANGE: the value does not fit in an int32_t.
+ */
+int MYRIOTA_SerialSliceToFixed(const MYRIOTA_SerialSlice *const slice, const uint8_t decimals,
+  int32_t *const value);
+
+/**
+ * \}
+ */
+
+#endif /* MYRIOTA_SERIAL_TOKENIZER_H */
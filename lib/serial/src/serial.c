@@ -0,0 +1,306 @@
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myriota/serial.h"
+#include <string.h>
+#include "serial_private.h"
+
+_Static_assert((MYRIOTA_SERIAL_RING_SIZE & (MYRIOTA_SERIAL_RING_SIZE - 1)) == 0,
+  "MYRIOTA_SERIAL_RING_SIZE must be a power of two");
+_Static_assert(MYRIOTA_SERIAL_RING_SIZE <= 32768, "MYRIOTA_SERIAL_RING_SIZE is too large");
+
+// Size of the receive buffer in the FlexSense Serial driver, see FLEX_SerialRead.
+#define SERIAL_DRIVER_BUFFER_SIZE 50
+// Start bit, 8 data bits and a stop bit.
+#define SERIAL_BITS_PER_BYTE 10
+
+// How long to wait between polls of the driver when no data is available.
+// Waiting for half the time it takes to fill the driver's buffer at the
+// configured baud rate avoids both spinning and overflowing the driver.
+uint32_t serial_poll_interval_ms(const MYRIOTA_Serial *const serial) {
+  const uint32_t fill_ms =
+    (SERIAL_DRIVER_BUFFER_SIZE * SERIAL_BITS_PER_BYTE * 1000) / serial->baud_rate;
+  return (fill_ms / 2 > 0) ? fill_ms / 2 : 1;
+}
+
+// Copies up to `max` bytes out of the ring buffer, stopping after the
+// delimiter if one is found. Returns the number of bytes copied.
+static size_t serial_ring_take(MYRIOTA_Serial *const serial, uint8_t *const buffer,
+  const size_t max, const int delimiter, bool *const found) {
+  size_t taken = 0;
+  while (taken < max && serial_ring_used(serial) > 0 && !*found) {
+    const uint16_t offset = serial->tail & SERIAL_RING_MASK;
+    size_t chunk = MYRIOTA_SERIAL_RING_SIZE - offset;
+    chunk = (chunk > serial_ring_used(serial)) ? serial_ring_used(serial) : chunk;
+    chunk = (chunk > max - taken) ? max - taken : chunk;
+
+    const uint8_t *const src = &serial->ring[offset];
+    if (delimiter != MYRIOTA_SERIAL_NO_DELIMITER) {
+      const uint8_t *const match = memchr(src, delimiter, chunk);
+      if (match != NULL) {
+        chunk = match - src + 1;
+        *found = true;
+      }
+    }
+
+    memcpy(&buffer[taken], src, chunk);
+    serial->tail += chunk;
+    taken += chunk;
+  }
+  return taken;
+}
+
+int MYRIOTA_SerialInit(MYRIOTA_Serial *const serial, const FLEX_SerialExOptions options) {
+  SERIAL_ASSERT(serial != NULL);
+  SERIAL_ASSERT(options.baud_rate > 0);
+
+  const int result = FLEX_SerialInitEx(options);
+  if (result != FLEX_SUCCESS) {
+    return result;
+  }
+
+  serial->initialized = true;
+  serial->baud_rate = options.baud_rate;
+  serial->head = 0;
+  serial->tail = 0;
+  serial->last_rx_tick = FLEX_TickGet();
+  return FLEX_SUCCESS;
+}
+
+void MYRIOTA_SerialDeinit(MYRIOTA_Serial *const serial) {
+  SERIAL_ASSERT(serial != NULL);
+  if (serial->initialized) {
+    FLEX_SerialDeinit();
+    serial->initialized = false;
+  }
+  serial->head = 0;
+  serial->tail = 0;
+}
+
+ssize_t MYRIOTA_SerialWrite(MYRIOTA_Serial *const serial, const uint8_t *const buffer,
+  const size_t count) {
+  SERIAL_ASSERT(serial != NULL);
+  if (!serial->initialized) {
+    return -FLEX_ERROR_NOT_INIT;
+  }
+
+  const int result = FLEX_SerialWrite(buffer, count);
+  if (result != FLEX_SUCCESS) {
+    return result;
+  }
+  return count;
+}
+
+int MYRIOTA_SerialPoll(MYRIOTA_Serial *const serial) {
+  SERIAL_ASSERT(serial != NULL);
+  if (!serial->initialized) {
+    return -FLEX_ERROR_NOT_INIT;
+  }
+
+  // Read straight into the free space of the ring, in at most two contiguous
+  // pieces per wrap, until the driver has nothing left or the ring is full.
+  while (serial_ring_used(serial) < MYRIOTA_SERIAL_RING_SIZE) {
+    const uint16_t offset = serial->head & SERIAL_RING_MASK;
+    const uint16_t space = MYRIOTA_SERIAL_RING_SIZE - serial_ring_used(serial);
+    const uint16_t contiguous = MYRIOTA_SERIAL_RING_SIZE - offset;
+    const int nbytes =
+      FLEX_SerialRead(&serial->ring[offset], (space < contiguous) ? space : contiguous);
+    if (nbytes < 0) {
+      return nbytes;
+    }
+    if (nbytes == 0) {
+      break;
+    }
+    serial->head += nbytes;
+    serial->last_rx_tick = FLEX_TickGet();
+  }
+
+  return serial_ring_used(serial);
+}
+
+ssize_t MYRIOTA_SerialRead(MYRIOTA_Serial *const serial, uint8_t *const buffer, const size_t size,
+  const MYRIOTA_SerialReadOptions *const options) {
+  SERIAL_ASSERT(serial != NULL);
+  SERIAL_ASSERT(buffer != NULL);
+  SERIAL_ASSERT(options != NULL);
+
+  const size_t target = (options->count > 0 && options->count < size) ? options->count : size;
+  const uint32_t start_tick = FLEX_TickGet();
+  bool found_delimiter = false;
+  size_t nbytes = 0;
+  while (true) {
+    const int poll_result = MYRIOTA_SerialPoll(serial);
+    if (poll_result < 0) {
+      return poll_result;
+    }
+
+    const size_t taken = serial_ring_take(serial, &buffer[nbytes], target - nbytes,
+      options->delimiter, &found_delimiter);
+    nbytes += taken;
+    if (found_delimiter || nbytes >= target) {
+      return nbytes;
+    }
+
+    const uint32_t now = FLEX_TickGet();
+    // Bytes buffered before this read may have arrived long ago, so the gap is
+    // measured from when they are taken too, rather than ending the frame now.
+    if (taken > 0) {
+      serial->last_rx_tick = now;
+    }
+    const uint32_t elapsed_ms = now - start_tick;
+    if (elapsed_ms >= options->timeout_ms) {
+      return nbytes;
+    }
+
+    uint32_t wait_ms = min_u32(serial_poll_interval_ms(serial), options->timeout_ms - elapsed_ms);
+    if (options->gap_ms > 0 && nbytes > 0) {
+      const uint32_t silent_ms = now - serial->last_rx_tick;
+      if (silent_ms >= options->gap_ms) {
+        return nbytes;
+      }
+      wait_ms = min_u32(wait_ms, options->gap_ms - silent_ms);
+    }
+    FLEX_DelayMs(wait_ms);
+  }
+}
+
+void MYRIOTA_SerialFlushInput(MYRIOTA_Serial *const serial) {
+  SERIAL_ASSERT(serial != NULL);
+  serial->tail = serial->head;
+  if (serial->initialized) {
+    uint8_t discard[SERIAL_DRIVER_BUFFER_SIZE];
+    while (FLEX_SerialRead(discard, sizeof(discard)) > 0) {
+    }
+  }
+}
+
+#ifdef MYRIOTA_SERIAL_UNIT_TESTS
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+/*
+ * `cmocka.h` must be included after standard the above library headers.
+ * NOTE: This comment has dual purpose:
+ * 1. Document the ordering requirement.
+ * 2. Prevent `clang-format` from reordering the headers.
+ */
+#include <cmocka.h>
+#include "myriota/flex_fake.h"
+
+static void fake_setup(MYRIOTA_Serial *const serial, const uint8_t *const rx,
+  const uint32_t *const rx_tick, const size_t rx_size) {
+  MYRIOTA_FlexFakeReset();
+  flex_fake.rx = rx;
+  flex_fake.rx_tick = rx_tick;
+  flex_fake.rx_size = rx_size;
+  flex_fake.rx_read_max = SERIAL_DRIVER_BUFFER_SIZE;
+  const FLEX_SerialExOptions options = {.protocol = FLEX_SERIAL_PROTOCOL_RS232,
+    .baud_rate = 9600};
+  assert_int_equal(MYRIOTA_SerialInit(serial, options), FLEX_SUCCESS);
+}
+
+static void test_delimiter_keeps_remaining_bytes(void **state) {
+  (void)state;
+  static const uint8_t rx[] = "$GPA,1*00\r\n$GPB,2*00\r\n";
+  static uint32_t rx_tick[sizeof(rx)] = {0};
+  MYRIOTA_Serial serial;
+  fake_setup(&serial, rx, rx_tick, sizeof(rx) - 1);
+
+  const MYRIOTA_SerialReadOptions options = {.timeout_ms = 100, .delimiter = '\n'};
+  uint8_t line[32] = {0};
+  assert_int_equal(MYRIOTA_SerialRead(&serial, line, sizeof(line), &options), 11);
+  assert_memory_equal(line, "$GPA,1*00\r\n", 11);
+  assert_int_equal(MYRIOTA_SerialRead(&serial, line, sizeof(line), &options), 11);
+  assert_memory_equal(line, "$GPB,2*00\r\n", 11);
+  // Both lines were drained from the driver in a single bulk read.
+  assert_int_equal(flex_fake.read_count, 3);
+}
+
+static void test_gap_completes_frame(void **state) {
+  (void)state;
+  static const uint8_t rx[] = {1, 2, 3, 4, 5, 6, 7, 8};
+  static const uint32_t rx_tick[] = {10, 10, 12, 14, 14, 100, 100, 100};
+  MYRIOTA_Serial serial;
+  fake_setup(&serial, rx, rx_tick, sizeof(rx));
+
+  const MYRIOTA_SerialReadOptions options = {.timeout_ms = 1000,
+    .delimiter = MYRIOTA_SERIAL_NO_DELIMITER,
+    .gap_ms = 20};
+  uint8_t frame[32] = {0};
+  assert_int_equal(MYRIOTA_SerialRead(&serial, frame, sizeof(frame), &options), 5);
+  assert_in_range(flex_fake.tick, 34, 60);
+  // Waits are bounded by the poll interval instead of spinning on the driver.
+  assert_true(flex_fake.delay_count < 10);
+}
+
+static void test_gap_across_reads(void **state) {
+  (void)state;
+  static const uint8_t rx[] = {1, 2, 3, 4, 5, 6, 7};
+  static const uint32_t rx_tick[] = {10, 10, 12, 14, 14, 75, 75};
+  MYRIOTA_Serial serial;
+  fake_setup(&serial, rx, rx_tick, sizeof(rx));
+
+  // The first read takes part of the frame and leaves the rest buffered.
+  flex_fake.tick = 14;
+  const MYRIOTA_SerialReadOptions first = {.timeout_ms = 1000,
+    .count = 3,
+    .delimiter = MYRIOTA_SERIAL_NO_DELIMITER};
+  uint8_t frame[32] = {0};
+  assert_int_equal(MYRIOTA_SerialRead(&serial, frame, sizeof(frame), &first), 3);
+
+  // Later than the gap, the next read takes the buffered bytes and still
+  // waits for the gap before the frame is complete.
+  flex_fake.tick = 64;
+  const MYRIOTA_SerialReadOptions rest = {.timeout_ms = 1000,
+    .delimiter = MYRIOTA_SERIAL_NO_DELIMITER,
+    .gap_ms = 20};
+  assert_int_equal(MYRIOTA_SerialRead(&serial, frame, sizeof(frame), &rest), 4);
+  const uint8_t expected[] = {4, 5, 6, 7};
+  assert_memory_equal(frame, expected, sizeof(expected));
+  assert_in_range(flex_fake.tick, 95, 120);
+}
+
+static void test_count_and_timeout(void **state) {
+  (void)state;
+  static const uint8_t rx[] = {1, 2, 3};
+  static const uint32_t rx_tick[] = {0, 0, 0};
+  MYRIOTA_Serial serial;
+  fake_setup(&serial, rx, rx_tick, sizeof(rx));
+
+  const MYRIOTA_SerialReadOptions options = {.timeout_ms = 50,
+    .count = 2,
+    .delimiter = MYRIOTA_SERIAL_NO_DELIMITER};
+  uint8_t bytes[8] = {0};
+  assert_int_equal(MYRIOTA_SerialRead(&serial, bytes, sizeof(bytes), &options), 2);
+  assert_int_equal(MYRIOTA_SerialRead(&serial, bytes, sizeof(bytes), &options), 1);
+  assert_int_equal(bytes[0], 3);
+  assert_int_equal(flex_fake.tick, 50);
+  assert_int_equal(MYRIOTA_SerialRead(&serial, bytes, sizeof(bytes), &options), 0);
+
+  MYRIOTA_SerialDeinit(&serial);
+  assert_int_equal(MYRIOTA_SerialRead(&serial, bytes, sizeof(bytes), &options),
+    -FLEX_ERROR_NOT_INIT);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_delimiter_keeps_remaining_bytes),
+    cmocka_unit_test(test_gap_completes_frame),
+    cmocka_unit_test(test_gap_across_reads),
+    cmocka_unit_test(test_count_and_timeout),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+#endif /** MYRIOTA_SERIAL_UNIT_TESTS */
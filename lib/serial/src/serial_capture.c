@@ -0,0 +1,412 @@
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myriota/serial_capture.h"
+#include <stdio.h>
+#include <string.h>
+#include "serial_private.h"
+
+#if (MYRIOTA_SERIAL_CAPTURE_SIZE & (MYRIOTA_SERIAL_CAPTURE_SIZE - 1)) != 0 || \
+  MYRIOTA_SERIAL_CAPTURE_SIZE > 32768
+#error "MYRIOTA_SERIAL_CAPTURE_SIZE must be a power of two no larger than 32768"
+#endif
+
+#define CAPTURE_MASK (MYRIOTA_SERIAL_CAPTURE_SIZE - 1)
+#define CAPTURE_VERSION 1
+#define CAPTURE_KIND_BITS 2
+#define CAPTURE_KIND_MASK ((1 << CAPTURE_KIND_BITS) - 1)
+#define CAPTURE_VARINT_MAX_SIZE 5
+#define CAPTURE_DUMP_LINE_SIZE 32
+
+static inline uint16_t capture_used(const MYRIOTA_SerialCapture *const capture) {
+  return (uint16_t)(capture->head - capture->tail);
+}
+
+static void capture_put(MYRIOTA_SerialCapture *const capture, const uint8_t *const bytes,
+  const size_t count) {
+  const uint16_t offset = capture->head & CAPTURE_MASK;
+  const size_t first = min_u32(count, MYRIOTA_SERIAL_CAPTURE_SIZE - offset);
+  memcpy(&capture->ring[offset], bytes, first);
+  memcpy(capture->ring, &bytes[first], count - first);
+  capture->head += count;
+}
+
+static uint32_t capture_varint_decode(const MYRIOTA_SerialCapture *const capture,
+  uint16_t *const position) {
+  uint32_t value = 0;
+  for (unsigned shift = 0;; shift += 7) {
+    const uint8_t byte = capture->ring[(*position)++ & CAPTURE_MASK];
+    value |= (uint32_t)(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      return value;
+    }
+  }
+}
+
+// Discard the oldest chunk, moving the start of the log to its time.
+static void capture_drop_oldest(MYRIOTA_SerialCapture *const capture) {
+  uint16_t position = capture->tail;
+  const uint32_t tag = capture_varint_decode(capture, &position);
+  const uint32_t value = capture_varint_decode(capture, &position);
+  if ((tag & CAPTURE_KIND_MASK) != MYRIOTA_SERIAL_CAPTURE_RX_ERROR) {
+    position += value;
+  }
+  capture->tail = position;
+  capture->start_tick += tag >> CAPTURE_KIND_BITS;
+  ++capture->dropped;
+}
+
+static void capture_header(const MYRIOTA_SerialCapture *const capture,
+  uint8_t header[MYRIOTA_SERIAL_CAPTURE_HEADER_SIZE]) {
+  header[0] = 'M';
+  header[1] = 'S';
+  header[2] = 'C';
+  header[3] = CAPTURE_VERSION;
+  for (int i = 0; i < 4; ++i) {
+    header[4 + i] = capture->start_tick >> (8 * i);
+    header[8 + i] = capture->dropped >> (8 * i);
+  }
+}
+
+static int capture_init(void *const ctx) {
+  MYRIOTA_SerialCapture *const capture = ctx;
+  return capture->inner.init ? capture->inner.init(capture->inner.ctx) : 0;
+}
+
+static void capture_deinit(void *const ctx) {
+  MYRIOTA_SerialCapture *const capture = ctx;
+  if (capture->inner.deinit) {
+    capture->inner.deinit(capture->inner.ctx);
+  }
+}
+
+static ssize_t capture_read(void *const ctx, uint8_t *const buffer, const size_t count) {
+  MYRIOTA_SerialCapture *const capture = ctx;
+  const ssize_t result = capture->inner.read(capture->inner.ctx, buffer, count);
+  MYRIOTA_SerialCaptureRecord(capture,
+    (result < 0) ? MYRIOTA_SERIAL_CAPTURE_RX_ERROR : MYRIOTA_SERIAL_CAPTURE_RX, buffer, result);
+  return result;
+}
+
+static ssize_t capture_write(void *const ctx, const uint8_t *const buffer, const size_t count) {
+  MYRIOTA_SerialCapture *const capture = ctx;
+  const ssize_t result = capture->inner.write(capture->inner.ctx, buffer, count);
+  if (result >= 0) {
+    MYRIOTA_SerialCaptureRecord(capture, MYRIOTA_SERIAL_CAPTURE_TX, buffer, result);
+  }
+  return result;
+}
+
+void MYRIOTA_SerialCaptureInit(MYRIOTA_SerialCapture *const capture,
+  const MYRIOTA_ModbusSerialInterface inner) {
+  SERIAL_ASSERT(capture != NULL);
+  capture->inner = inner;
+  capture->paused = false;
+  MYRIOTA_SerialCaptureClear(capture);
+}
+
+MYRIOTA_ModbusSerialInterface MYRIOTA_SerialCaptureInterface(
+  MYRIOTA_SerialCapture *const capture) {
+  SERIAL_ASSERT(capture != NULL);
+  SERIAL_ASSERT(capture->inner.read != NULL && capture->inner.write != NULL);
+  const MYRIOTA_ModbusSerialInterface interface = {
+    .ctx = capture,
+    .init = capture_init,
+    .deinit = capture_deinit,
+    .read = capture_read,
+    .write = capture_write,
+  };
+  return interface;
+}
+
+void MYRIOTA_SerialCaptureRecord(MYRIOTA_SerialCapture *const capture,
+  const MYRIOTA_SerialCaptureKind kind, const uint8_t *const buffer, const ssize_t count) {
+  SERIAL_ASSERT(capture != NULL);
+  SERIAL_ASSERT(kind == MYRIOTA_SERIAL_CAPTURE_RX_ERROR ? count < 0 : count >= 0);
+  if (capture->paused) {
+    return;
+  }
+
+  const uint32_t now = FLEX_TickGet();
+  const uint32_t delta_ms = min_u32(now - capture->last_tick, UINT32_MAX >> CAPTURE_KIND_BITS);
+  const bool error = kind == MYRIOTA_SERIAL_CAPTURE_RX_ERROR;
+  const size_t data_size = error ? 0 : count;
+
+  uint8_t header[2 * CAPTURE_VARINT_MAX_SIZE];
+  size_t header_size = serial_varint_encode((delta_ms << CAPTURE_KIND_BITS) | kind, header);
+  header_size += serial_varint_encode(error ? -count : count, &header[header_size]);
+  const size_t needed = header_size + data_size;
+  if (needed > MYRIOTA_SERIAL_CAPTURE_SIZE) {
+    ++capture->dropped;
+    return;
+  }
+
+  while ((size_t)(MYRIOTA_SERIAL_CAPTURE_SIZE - capture_used(capture)) < needed) {
+    capture_drop_oldest(capture);
+  }
+  capture_put(capture, header, header_size);
+  capture_put(capture, buffer, data_size);
+  capture->last_tick = now;
+}
+
+void MYRIOTA_SerialCapturePause(MYRIOTA_SerialCapture *const capture, const bool paused) {
+  SERIAL_ASSERT(capture != NULL);
+  capture->paused = paused;
+}
+
+void MYRIOTA_SerialCaptureClear(MYRIOTA_SerialCapture *const capture) {
+  SERIAL_ASSERT(capture != NULL);
+  capture->start_tick = FLEX_TickGet();
+  capture->last_tick = capture->start_tick;
+  capture->dropped = 0;
+  capture->head = 0;
+  capture->tail = 0;
+}
+
+size_t MYRIOTA_SerialCaptureSize(const MYRIOTA_SerialCapture *const capture) {
+  SERIAL_ASSERT(capture != NULL);
+  return MYRIOTA_SERIAL_CAPTURE_HEADER_SIZE + capture_used(capture);
+}
+
+ssize_t MYRIOTA_SerialCaptureRead(const MYRIOTA_SerialCapture *const capture,
+  uint8_t *const buffer, const size_t size) {
+  SERIAL_ASSERT(capture != NULL);
+  SERIAL_ASSERT(buffer != NULL);
+  const size_t log_size = MYRIOTA_SerialCaptureSize(capture);
+  if (size < log_size) {
+    return -FLEX_ERROR_ENOBUFS;
+  }
+
+  capture_header(capture, buffer);
+  const uint16_t used = capture_used(capture);
+  const uint16_t offset = capture->tail & CAPTURE_MASK;
+  const size_t first = min_u32(used, MYRIOTA_SERIAL_CAPTURE_SIZE - offset);
+  memcpy(&buffer[MYRIOTA_SERIAL_CAPTURE_HEADER_SIZE], &capture->ring[offset], first);
+  memcpy(&buffer[MYRIOTA_SERIAL_CAPTURE_HEADER_SIZE + first], capture->ring, used - first);
+  return log_size;
+}
+
+void MYRIOTA_SerialCaptureDump(const MYRIOTA_SerialCapture *const capture) {
+  SERIAL_ASSERT(capture != NULL);
+  uint8_t header[MYRIOTA_SERIAL_CAPTURE_HEADER_SIZE];
+  capture_header(capture, header);
+
+  const size_t log_size = MYRIOTA_SerialCaptureSize(capture);
+  for (size_t i = 0; i < log_size; ++i) {
+    const uint8_t byte = (i < sizeof(header)) ?
+                           header[i] :
+                           capture->ring[(capture->tail + i - sizeof(header)) & CAPTURE_MASK];
+    printf("%02x", byte);
+    if ((i + 1) % CAPTURE_DUMP_LINE_SIZE == 0 || i + 1 == log_size) {
+      printf("\n");
+    }
+  }
+}
+
+#ifdef MYRIOTA_SERIAL_CAPTURE_UNIT_TESTS
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+/*
+ * `cmocka.h` must be included after standard the above library headers.
+ * NOTE: This comment has dual purpose:
+ * 1. Document the ordering requirement.
+ * 2. Prevent `clang-format` from reordering the headers.
+ */
+#include <cmocka.h>
+#include "myriota/flex_fake.h"
+#include "myriota/serial_replay.h"
+
+#define FAKE_SLAVE 0x01
+
+// A minimal RTU slave that answers holding register reads.
+static struct {
+  uint32_t delayed_ms;
+  bool timeout;
+  uint8_t response[256];
+  size_t response_size;
+} fake;
+
+static void fake_delay_ms(const uint32_t ms) {
+  fake.delayed_ms += ms;
+}
+
+static uint16_t fake_crc16(const uint8_t *const buffer, const size_t size) {
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < size; ++i) {
+    crc ^= buffer[i];
+    for (int bit = 0; bit < 8; ++bit) {
+      crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+    }
+  }
+  return crc;
+}
+
+static ssize_t fake_write(void *const ctx, const uint8_t *const buffer, const size_t count) {
+  (void)ctx;
+  assert_int_equal(buffer[1], 0x03);
+  const uint16_t addr = (buffer[2] << 8) | buffer[3];
+  const uint16_t quantity = (buffer[4] << 8) | buffer[5];
+  uint8_t *const rsp = fake.response;
+  size_t size = 0;
+  rsp[size++] = FAKE_SLAVE;
+  rsp[size++] = 0x03;
+  rsp[size++] = quantity * 2;
+  for (size_t i = 0; i < quantity; ++i) {
+    rsp[size++] = 0;
+    rsp[size++] = addr + i;
+  }
+  const uint16_t crc = fake_crc16(rsp, size);
+  rsp[size++] = crc & 0xFF;
+  rsp[size++] = crc >> 8;
+  fake.response_size = size;
+  flex_fake.tick += 5;
+  return count;
+}
+
+static ssize_t fake_read(void *const ctx, uint8_t *const buffer, const size_t count) {
+  (void)ctx;
+  flex_fake.tick += 20;
+  if (fake.timeout) {
+    return -FLEX_ERROR_ETIMEDOUT;
+  }
+  assert_true(fake.response_size <= count);
+  memcpy(buffer, fake.response, fake.response_size);
+  return fake.response_size;
+}
+
+static MYRIOTA_ModbusHandle modbus_setup(const MYRIOTA_ModbusSerialInterface interface) {
+  const MYRIOTA_ModbusInitOptions options = {
+    .framing_mode = MODBUS_FRAMING_MODE_RTU,
+    .serial_interface = interface,
+  };
+  const MYRIOTA_ModbusHandle handle = MYRIOTA_ModbusInit(options);
+  assert_int_equal(MYRIOTA_ModbusEnable(handle), MODBUS_SUCCESS);
+  return handle;
+}
+
+static void test_capture_and_replay(void **state) {
+  (void)state;
+  MYRIOTA_FlexFakeReset();
+  memset(&fake, 0, sizeof(fake));
+  flex_fake.tick = 1000;
+  static MYRIOTA_SerialCapture capture;
+  const MYRIOTA_ModbusSerialInterface inner = {.read = fake_read, .write = fake_write};
+  MYRIOTA_SerialCaptureInit(&capture, inner);
+
+  MYRIOTA_ModbusHandle handle = modbus_setup(MYRIOTA_SerialCaptureInterface(&capture));
+  uint8_t bytes[8];
+  for (int i = 0; i < 3; ++i) {
+    flex_fake.tick += 100;
+    assert_int_equal(MYRIOTA_ModbusReadHoldingRegisters(handle, FAKE_SLAVE, i, 4, bytes),
+      MODBUS_SUCCESS);
+  }
+  fake.timeout = true;
+  assert_int_not_equal(MYRIOTA_ModbusReadHoldingRegisters(handle, FAKE_SLAVE, 9, 4, bytes),
+    MODBUS_SUCCESS);
+  MYRIOTA_ModbusDeinit(handle);
+
+  uint8_t log[MYRIOTA_SERIAL_CAPTURE_HEADER_SIZE + MYRIOTA_SERIAL_CAPTURE_SIZE];
+  const ssize_t log_size = MYRIOTA_SerialCaptureRead(&capture, log, sizeof(log));
+  assert_int_equal(log_size, MYRIOTA_SerialCaptureSize(&capture));
+  assert_int_equal(MYRIOTA_SerialCaptureRead(&capture, log, log_size - 1), -FLEX_ERROR_ENOBUFS);
+
+  // The dump prints the log in hex, CAPTURE_DUMP_LINE_SIZE bytes to a line.
+  MYRIOTA_FlexFakeConsoleBegin();
+  MYRIOTA_SerialCaptureDump(&capture);
+  MYRIOTA_FlexFakeConsoleEnd();
+  char dump[sizeof(flex_fake.console)] = "";
+  size_t dump_length = 0;
+  for (ssize_t i = 0; i < log_size; ++i) {
+    dump_length += snprintf(&dump[dump_length], sizeof(dump) - dump_length, "%02x", log[i]);
+    if ((i + 1) % CAPTURE_DUMP_LINE_SIZE == 0 || i + 1 == log_size) {
+      dump_length += snprintf(&dump[dump_length], sizeof(dump) - dump_length, "\n");
+    }
+  }
+  assert_true(dump_length < sizeof(dump));
+  assert_string_equal(flex_fake.console, dump);
+
+  MYRIOTA_SerialReplay replay;
+  assert_int_equal(MYRIOTA_SerialReplayInit(&replay, log, log_size, fake_delay_ms), FLEX_SUCCESS);
+  handle = modbus_setup(MYRIOTA_SerialReplayInterface(&replay));
+  for (int i = 0; i < 3; ++i) {
+    memset(bytes, 0xFF, sizeof(bytes));
+    assert_int_equal(MYRIOTA_ModbusReadHoldingRegisters(handle, FAKE_SLAVE, i, 4, bytes),
+      MODBUS_SUCCESS);
+    assert_int_equal(bytes[1], i);
+    assert_int_equal(bytes[7], i + 3);
+  }
+  assert_int_not_equal(MYRIOTA_ModbusReadHoldingRegisters(handle, FAKE_SLAVE, 9, 4, bytes),
+    MODBUS_SUCCESS);
+  assert_true(MYRIOTA_SerialReplayDone(&replay));
+  assert_int_equal(fake.delayed_ms, flex_fake.tick - 1000);
+
+  MYRIOTA_SerialReplayStats stats;
+  MYRIOTA_SerialReplayStatsGet(&replay, &stats);
+  assert_int_equal(stats.tx_count, 4);
+  assert_int_equal(stats.tx_mismatch_count, 0);
+  assert_int_equal(stats.rx_count, 4);
+
+  // A different request is counted as a mismatch but still gets the recorded response.
+  MYRIOTA_SerialReplayRewind(&replay);
+  assert_int_equal(MYRIOTA_ModbusReadHoldingRegisters(handle, FAKE_SLAVE, 7, 4, bytes),
+    MODBUS_SUCCESS);
+  assert_int_equal(bytes[1], 0);
+  MYRIOTA_SerialReplayStatsGet(&replay, &stats);
+  assert_int_equal(stats.tx_mismatch_count, 1);
+  MYRIOTA_ModbusDeinit(handle);
+}
+
+static void test_ring_drops_oldest(void **state) {
+  (void)state;
+  MYRIOTA_FlexFakeReset();
+  memset(&fake, 0, sizeof(fake));
+  static MYRIOTA_SerialCapture capture;
+  MYRIOTA_SerialCaptureInit(&capture, (MYRIOTA_ModbusSerialInterface){0});
+
+  uint8_t chunk[100];
+  for (int i = 0; i < 100; ++i) {
+    flex_fake.tick += 10;
+    memset(chunk, i, sizeof(chunk));
+    MYRIOTA_SerialCaptureRecord(&capture, MYRIOTA_SERIAL_CAPTURE_RX, chunk, sizeof(chunk));
+  }
+  uint8_t big[MYRIOTA_SERIAL_CAPTURE_SIZE];
+  MYRIOTA_SerialCaptureRecord(&capture, MYRIOTA_SERIAL_CAPTURE_TX, big, sizeof(big));
+
+  // Each chunk takes 102 bytes, so only the newest fit in the ring.
+  const uint32_t kept = MYRIOTA_SERIAL_CAPTURE_SIZE / 102;
+  uint8_t log[MYRIOTA_SERIAL_CAPTURE_HEADER_SIZE + MYRIOTA_SERIAL_CAPTURE_SIZE];
+  const ssize_t log_size = MYRIOTA_SerialCaptureRead(&capture, log, sizeof(log));
+  assert_int_equal(log_size, MYRIOTA_SERIAL_CAPTURE_HEADER_SIZE + kept * 102);
+  const uint32_t start_tick = log[4] | (log[5] << 8) | (log[6] << 16) | ((uint32_t)log[7] << 24);
+  assert_int_equal(start_tick, (100 - kept) * 10);
+  assert_int_equal(log[8], 100 - kept + 1);
+  assert_int_equal(log[MYRIOTA_SERIAL_CAPTURE_HEADER_SIZE + 2], 100 - kept);
+
+  MYRIOTA_SerialCapturePause(&capture, true);
+  MYRIOTA_SerialCaptureRecord(&capture, MYRIOTA_SERIAL_CAPTURE_RX, chunk, 1);
+  assert_int_equal(MYRIOTA_SerialCaptureSize(&capture), log_size);
+  MYRIOTA_SerialCaptureClear(&capture);
+  assert_int_equal(MYRIOTA_SerialCaptureSize(&capture), MYRIOTA_SERIAL_CAPTURE_HEADER_SIZE);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_capture_and_replay),
+    cmocka_unit_test(test_ring_drops_oldest),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+#endif /** MYRIOTA_SERIAL_CAPTURE_UNIT_TESTS */
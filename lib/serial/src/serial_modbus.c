@@ -0,0 +1,72 @@
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myriota/serial_modbus.h"
+
+// RTU frames end after a silent interval of 3.5 characters of 11 bits.
+#define SERIAL_MODBUS_FRAME_GAP_BITS 39
+// The driver is polled with millisecond resolution, so never wait less.
+#define SERIAL_MODBUS_FRAME_GAP_MIN_MS 2
+
+static uint32_t serial_modbus_frame_gap_ms(const MYRIOTA_SerialModbusContext *const context) {
+  if (context->frame_gap_ms > 0) {
+    return context->frame_gap_ms;
+  }
+  const uint32_t gap_ms =
+    (SERIAL_MODBUS_FRAME_GAP_BITS * 1000 + context->options.baud_rate - 1) /
+    context->options.baud_rate;
+  return (gap_ms < SERIAL_MODBUS_FRAME_GAP_MIN_MS) ? SERIAL_MODBUS_FRAME_GAP_MIN_MS : gap_ms;
+}
+
+static int serial_modbus_init(void *const ctx) {
+  MYRIOTA_SerialModbusContext *const context = ctx;
+  return MYRIOTA_SerialInit(&context->serial, context->options);
+}
+
+// De-initialise the Serial interface for the lowest idle power consumption.
+static void serial_modbus_deinit(void *const ctx) {
+  MYRIOTA_SerialModbusContext *const context = ctx;
+  MYRIOTA_SerialDeinit(&context->serial);
+}
+
+static ssize_t serial_modbus_read(void *const ctx, uint8_t *const buffer, const size_t count) {
+  MYRIOTA_SerialModbusContext *const context = ctx;
+  const MYRIOTA_SerialReadOptions options = {
+    .timeout_ms = context->response_timeout_ms,
+    .delimiter = MYRIOTA_SERIAL_NO_DELIMITER,
+    .gap_ms = serial_modbus_frame_gap_ms(context),
+  };
+  const ssize_t result = MYRIOTA_SerialRead(&context->serial, buffer, count, &options);
+  return (result == 0) ? -FLEX_ERROR_ETIMEDOUT : result;
+}
+
+static ssize_t serial_modbus_write(void *const ctx, const uint8_t *const buffer,
+  const size_t count) {
+  MYRIOTA_SerialModbusContext *const context = ctx;
+  // Drop anything left over from a previous transaction so it is not
+  // mistaken for the start of the response.
+  MYRIOTA_SerialFlushInput(&context->serial);
+  return MYRIOTA_SerialWrite(&context->serial, buffer, count);
+}
+
+MYRIOTA_ModbusSerialInterface MYRIOTA_SerialModbusInterface(
+  MYRIOTA_SerialModbusContext *const context) {
+  const MYRIOTA_ModbusSerialInterface interface = {
+    .ctx = context,
+    .init = serial_modbus_init,
+    .deinit = serial_modbus_deinit,
+    .read = serial_modbus_read,
+    .write = serial_modbus_write,
+  };
+  return interface;
+}
@@ -0,0 +1,58 @@
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Internal helpers shared by the serial library source files.
+
+#ifndef MYRIOTA_SERIAL_PRIVATE_H
+#define MYRIOTA_SERIAL_PRIVATE_H
+
+#include "myriota/serial.h"
+
+// NOTE: you can provide your own assert
+#ifndef SERIAL_ASSERT
+#include <stdio.h>
+#define SERIAL_ASSERT(cond)                          \
+  do {                                               \
+    if (!(cond)) {                                   \
+      printf("Assert @%s:%d\n", __FILE__, __LINE__); \
+      while (1) {                                    \
+      }                                              \
+    }                                                \
+  } while (0)
+#endif
+
+#define SERIAL_RING_MASK (MYRIOTA_SERIAL_RING_SIZE - 1)
+
+static inline uint16_t serial_ring_used(const MYRIOTA_Serial *const serial) {
+  return (uint16_t)(serial->head - serial->tail);
+}
+
+static inline uint32_t min_u32(const uint32_t a, const uint32_t b) {
+  return (a < b) ? a : b;
+}
+
+// Writes `value` as a little-endian base 128 varint and returns its size in bytes.
+static inline size_t serial_varint_encode(uint32_t value, uint8_t *const out) {
+  size_t size = 0;
+  while (value >= 0x80) {
+    out[size++] = (value & 0x7F) | 0x80;
+    value >>= 7;
+  }
+  out[size++] = value;
+  return size;
+}
+
+// How long to wait between polls of the driver when no data is available.
+uint32_t serial_poll_interval_ms(const MYRIOTA_Serial *const serial);
+
+#endif /* MYRIOTA_SERIAL_PRIVATE_H */
@@ -0,0 +1,187 @@
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myriota/serial_replay.h"
+#include <string.h>
+#include "myriota/serial_capture.h"
+#include "serial_private.h"
+
+#define REPLAY_VERSION 1
+#define REPLAY_KIND_BITS 2
+#define REPLAY_KIND_MASK ((1 << REPLAY_KIND_BITS) - 1)
+
+// A chunk decoded from the log.
+typedef struct {
+  MYRIOTA_SerialCaptureKind kind;
+  uint32_t delta_ms;
+  const uint8_t *data;
+  size_t length;
+  int error;
+  size_t next;
+} replay_chunk;
+
+static bool replay_varint_decode(const MYRIOTA_SerialReplay *const replay, size_t *const position,
+  uint32_t *const value) {
+  *value = 0;
+  for (unsigned shift = 0; shift < 32 && *position < replay->size; shift += 7) {
+    const uint8_t byte = replay->log[(*position)++];
+    *value |= (uint32_t)(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Decode the chunk at the current position, returns false at the end of the
+// log or if the rest of the log is malformed.
+static bool replay_peek(const MYRIOTA_SerialReplay *const replay, replay_chunk *const chunk) {
+  size_t position = replay->position;
+  uint32_t tag;
+  uint32_t value;
+  if (!replay_varint_decode(replay, &position, &tag) ||
+      !replay_varint_decode(replay, &position, &value)) {
+    return false;
+  }
+
+  chunk->kind = tag & REPLAY_KIND_MASK;
+  chunk->delta_ms = tag >> REPLAY_KIND_BITS;
+  chunk->data = &replay->log[position];
+  chunk->length = 0;
+  chunk->error = 0;
+  switch (chunk->kind) {
+    case MYRIOTA_SERIAL_CAPTURE_TX:
+    case MYRIOTA_SERIAL_CAPTURE_RX:
+      if (value > replay->size - position) {
+        return false;
+      }
+      chunk->length = value;
+      break;
+    case MYRIOTA_SERIAL_CAPTURE_RX_ERROR:
+      chunk->error = -(int)value;
+      break;
+    default:
+      return false;
+  }
+  chunk->next = position + chunk->length;
+  return true;
+}
+
+static void replay_advance(MYRIOTA_SerialReplay *const replay, const replay_chunk *const chunk) {
+  if (replay->delay_ms != NULL && chunk->delta_ms > 0) {
+    replay->delay_ms(chunk->delta_ms);
+  }
+  replay->position = chunk->next;
+}
+
+static int replay_init(void *const ctx) {
+  (void)ctx;
+  return 0;
+}
+
+static void replay_deinit(void *const ctx) {
+  (void)ctx;
+}
+
+static ssize_t replay_read(void *const ctx, uint8_t *const buffer, const size_t count) {
+  MYRIOTA_SerialReplay *const replay = ctx;
+  if (replay->rx_remaining == 0) {
+    replay_chunk chunk;
+    if (!replay_peek(replay, &chunk) || chunk.kind == MYRIOTA_SERIAL_CAPTURE_TX) {
+      return -FLEX_ERROR_ETIMEDOUT;
+    }
+    replay_advance(replay, &chunk);
+    ++replay->stats.rx_count;
+    if (chunk.kind == MYRIOTA_SERIAL_CAPTURE_RX_ERROR) {
+      return chunk.error;
+    }
+    replay->rx = chunk.data;
+    replay->rx_remaining = chunk.length;
+  }
+
+  const size_t length = (count < replay->rx_remaining) ? count : replay->rx_remaining;
+  memcpy(buffer, replay->rx, length);
+  replay->rx += length;
+  replay->rx_remaining -= length;
+  return length;
+}
+
+static ssize_t replay_write(void *const ctx, const uint8_t *const buffer, const size_t count) {
+  MYRIOTA_SerialReplay *const replay = ctx;
+  replay->rx_remaining = 0;
+
+  // Reads the parser did not make are skipped, along with their time.
+  replay_chunk chunk;
+  while (replay_peek(replay, &chunk)) {
+    replay_advance(replay, &chunk);
+    if (chunk.kind == MYRIOTA_SERIAL_CAPTURE_TX) {
+      ++replay->stats.tx_count;
+      if (chunk.length != count || memcmp(chunk.data, buffer, count) != 0) {
+        ++replay->stats.tx_mismatch_count;
+      }
+      return count;
+    }
+  }
+
+  ++replay->stats.tx_mismatch_count;
+  return count;
+}
+
+int MYRIOTA_SerialReplayInit(MYRIOTA_SerialReplay *const replay, const uint8_t *const log,
+  const size_t size, const MYRIOTA_SerialReplayDelayFn_t delay_ms) {
+  SERIAL_ASSERT(replay != NULL);
+  SERIAL_ASSERT(log != NULL);
+  if (size < MYRIOTA_SERIAL_CAPTURE_HEADER_SIZE || memcmp(log, "MSC", 3) != 0 ||
+      log[3] != REPLAY_VERSION) {
+    return -FLEX_ERROR_EBADMSG;
+  }
+
+  replay->log = log;
+  replay->size = size;
+  replay->delay_ms = delay_ms;
+  MYRIOTA_SerialReplayRewind(replay);
+  return FLEX_SUCCESS;
+}
+
+MYRIOTA_ModbusSerialInterface MYRIOTA_SerialReplayInterface(MYRIOTA_SerialReplay *const replay) {
+  SERIAL_ASSERT(replay != NULL);
+  const MYRIOTA_ModbusSerialInterface interface = {
+    .ctx = replay,
+    .init = replay_init,
+    .deinit = replay_deinit,
+    .read = replay_read,
+    .write = replay_write,
+  };
+  return interface;
+}
+
+void MYRIOTA_SerialReplayRewind(MYRIOTA_SerialReplay *const replay) {
+  SERIAL_ASSERT(replay != NULL);
+  replay->position = MYRIOTA_SERIAL_CAPTURE_HEADER_SIZE;
+  replay->rx = NULL;
+  replay->rx_remaining = 0;
+  memset(&replay->stats, 0, sizeof(replay->stats));
+}
+
+bool MYRIOTA_SerialReplayDone(const MYRIOTA_SerialReplay *const replay) {
+  SERIAL_ASSERT(replay != NULL);
+  replay_chunk chunk;
+  return replay->rx_remaining == 0 && !replay_peek(replay, &chunk);
+}
+
+void MYRIOTA_SerialReplayStatsGet(const MYRIOTA_SerialReplay *const replay,
+  MYRIOTA_SerialReplayStats *const stats) {
+  SERIAL_ASSERT(replay != NULL);
+  SERIAL_ASSERT(stats != NULL);
+  *stats = replay->stats;
+}
@@ -0,0 +1,436 @@
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myriota/serial_tokenizer.h"
+#include <string.h>
+#include "serial_private.h"
+
+#define TOKENIZER_CHECKSUM_SUFFIX_SIZE 3  // "*hh"
+
+static MYRIOTA_SerialSlice slice_make(const uint8_t *const ring, const uint16_t start,
+  const uint16_t length) {
+  const uint16_t offset = start & SERIAL_RING_MASK;
+  const uint16_t contiguous = MYRIOTA_SERIAL_RING_SIZE - offset;
+  const uint16_t first = (length < contiguous) ? length : contiguous;
+  const MYRIOTA_SerialSlice slice = {
+    .ptr = &ring[offset],
+    .length = first,
+    .wrap_ptr = ring,
+    .wrap_length = length - first,
+  };
+  return slice;
+}
+
+static inline uint8_t slice_at(const MYRIOTA_SerialSlice *const slice, const size_t index) {
+  return (index < slice->length) ? slice->ptr[index] : slice->wrap_ptr[index - slice->length];
+}
+
+static MYRIOTA_SerialSlice slice_sub(const MYRIOTA_SerialSlice *const slice, const size_t offset,
+  const size_t length) {
+  MYRIOTA_SerialSlice sub = {0};
+  if (offset >= slice->length) {
+    sub.ptr = &slice->wrap_ptr[offset - slice->length];
+    sub.length = length;
+    sub.wrap_ptr = sub.ptr;
+    return sub;
+  }
+  const size_t available = slice->length - offset;
+  sub.ptr = &slice->ptr[offset];
+  sub.length = (length < available) ? length : available;
+  sub.wrap_ptr = slice->wrap_ptr;
+  sub.wrap_length = length - sub.length;
+  return sub;
+}
+
+// Returns the index of the first `byte` at or after `from`, else the slice length.
+static size_t slice_find(const MYRIOTA_SerialSlice *const slice, const size_t from,
+  const uint8_t byte) {
+  if (from < slice->length) {
+    const uint8_t *const match = memchr(&slice->ptr[from], byte, slice->length - from);
+    if (match != NULL) {
+      return match - slice->ptr;
+    }
+  }
+  const size_t wrap_from = (from > slice->length) ? from - slice->length : 0;
+  if (wrap_from < slice->wrap_length) {
+    const uint8_t *const match =
+      memchr(&slice->wrap_ptr[wrap_from], byte, slice->wrap_length - wrap_from);
+    if (match != NULL) {
+      return slice->length + (match - slice->wrap_ptr);
+    }
+  }
+  return MYRIOTA_SerialSliceLength(slice);
+}
+
+static int hex_value(const uint8_t c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  return -1;
+}
+
+void MYRIOTA_SerialTokenizerInit(MYRIOTA_SerialTokenizer *const tokenizer,
+  MYRIOTA_Serial *const serial, const uint8_t delimiter) {
+  SERIAL_ASSERT(tokenizer != NULL);
+  SERIAL_ASSERT(serial != NULL);
+  tokenizer->serial = serial;
+  tokenizer->delimiter = delimiter;
+  tokenizer->scanned = serial->tail;
+  tokenizer->pending = 0;
+}
+
+int MYRIOTA_SerialTokenizerNext(MYRIOTA_SerialTokenizer *const tokenizer,
+  const uint32_t timeout_ms, MYRIOTA_SerialRecord *const record) {
+  SERIAL_ASSERT(tokenizer != NULL);
+  SERIAL_ASSERT(record != NULL);
+  MYRIOTA_Serial *const serial = tokenizer->serial;
+
+  // Release the previous record, unless the bytes have since been consumed by
+  // another read.
+  if (tokenizer->pending <= serial_ring_used(serial)) {
+    serial->tail += tokenizer->pending;
+  }
+  tokenizer->pending = 0;
+  if ((uint16_t)(tokenizer->scanned - serial->tail) > serial_ring_used(serial)) {
+    tokenizer->scanned = serial->tail;
+  }
+
+  const uint32_t start_tick = FLEX_TickGet();
+  while (true) {
+    const int poll_result = MYRIOTA_SerialPoll(serial);
+    if (poll_result < 0) {
+      return poll_result;
+    }
+
+    // Only scan the bytes that have arrived since the last call.
+    while (tokenizer->scanned != serial->head) {
+      const uint16_t offset = tokenizer->scanned & SERIAL_RING_MASK;
+      const uint16_t unscanned = serial->head - tokenizer->scanned;
+      const uint16_t contiguous = MYRIOTA_SERIAL_RING_SIZE - offset;
+      const uint16_t chunk = (unscanned < contiguous) ? unscanned : contiguous;
+      const uint8_t *const match = memchr(&serial->ring[offset], tokenizer->delimiter, chunk);
+      if (match == NULL) {
+        tokenizer->scanned += chunk;
+        continue;
+      }
+
+      const uint16_t end = tokenizer->scanned + (match - &serial->ring[offset]);
+      uint16_t length = end - serial->tail;
+      tokenizer->scanned = end + 1;
+      tokenizer->pending = length + 1;
+
+      record->slice = slice_make(serial->ring, serial->tail, length);
+      if (length > 0 && tokenizer->delimiter != '\r' &&
+          slice_at(&record->slice, length - 1) == '\r') {
+        record->slice = slice_sub(&record->slice, 0, --length);
+      }
+      record->cursor = 0;
+      record->done = false;
+      return 1;
+    }
+
+    if (serial_ring_used(serial) == MYRIOTA_SERIAL_RING_SIZE) {
+      serial->tail = serial->head;
+      tokenizer->scanned = serial->head;
+      return -FLEX_ERROR_EMSGSIZE;
+    }
+
+    const uint32_t elapsed_ms = FLEX_TickGet() - start_tick;
+    if (elapsed_ms >= timeout_ms) {
+      return 0;
+    }
+    FLEX_DelayMs(min_u32(serial_poll_interval_ms(serial), timeout_ms - elapsed_ms));
+  }
+}
+
+int MYRIOTA_SerialRecordChecksum(MYRIOTA_SerialRecord *const record) {
+  SERIAL_ASSERT(record != NULL);
+  const MYRIOTA_SerialSlice *const slice = &record->slice;
+  const size_t length = MYRIOTA_SerialSliceLength(slice);
+  if (length < TOKENIZER_CHECKSUM_SUFFIX_SIZE) {
+    return -FLEX_ERROR_EBADMSG;
+  }
+
+  const size_t star = length - TOKENIZER_CHECKSUM_SUFFIX_SIZE;
+  const int hi = hex_value(slice_at(slice, star + 1));
+  const int lo = hex_value(slice_at(slice, star + 2));
+  if (slice_at(slice, star) != '*' || hi < 0 || lo < 0) {
+    return -FLEX_ERROR_EBADMSG;
+  }
+
+  const uint8_t first = slice_at(slice, 0);
+  uint8_t checksum = 0;
+  for (size_t i = (first == '$' || first == '!') ? 1 : 0; i < star; ++i) {
+    checksum ^= slice_at(slice, i);
+  }
+  if (checksum != ((hi << 4) | lo)) {
+    return -FLEX_ERROR_EBADMSG;
+  }
+
+  record->slice = slice_sub(slice, 0, star);
+  return FLEX_SUCCESS;
+}
+
+bool MYRIOTA_SerialRecordField(MYRIOTA_SerialRecord *const record, const uint8_t separator,
+  MYRIOTA_SerialSlice *const field) {
+  SERIAL_ASSERT(record != NULL);
+  SERIAL_ASSERT(field != NULL);
+  if (record->done) {
+    return false;
+  }
+
+  const size_t end = slice_find(&record->slice, record->cursor, separator);
+  *field = slice_sub(&record->slice, record->cursor, end - record->cursor);
+  if (end >= MYRIOTA_SerialSliceLength(&record->slice)) {
+    record->done = true;
+  } else {
+    record->cursor = end + 1;
+  }
+  return true;
+}
+
+size_t MYRIOTA_SerialSliceLength(const MYRIOTA_SerialSlice *const slice) {
+  SERIAL_ASSERT(slice != NULL);
+  return (size_t)slice->length + slice->wrap_length;
+}
+
+bool MYRIOTA_SerialSliceEquals(const MYRIOTA_SerialSlice *const slice, const char *const str) {
+  SERIAL_ASSERT(slice != NULL);
+  SERIAL_ASSERT(str != NULL);
+  const size_t length = strlen(str);
+  return length == MYRIOTA_SerialSliceLength(slice) &&
+         memcmp(slice->ptr, str, slice->length) == 0 &&
+         memcmp(slice->wrap_ptr, &str[slice->length], slice->wrap_length) == 0;
+}
+
+size_t MYRIOTA_SerialSliceCopy(const MYRIOTA_SerialSlice *const slice, char *const str,
+  const size_t size) {
+  SERIAL_ASSERT(slice != NULL);
+  SERIAL_ASSERT(str != NULL && size > 0);
+  const size_t length = MYRIOTA_SerialSliceLength(slice);
+  const size_t count = (length < size - 1) ? length : size - 1;
+  const size_t first = (count < slice->length) ? count : slice->length;
+  memcpy(str, slice->ptr, first);
+  memcpy(&str[first], slice->wrap_ptr, count - first);
+  str[count] = '\0';
+  return count;
+}
+
+int MYRIOTA_SerialSliceToFixed(const MYRIOTA_SerialSlice *const slice, const uint8_t decimals,
+  int32_t *const value) {
+  SERIAL_ASSERT(slice != NULL);
+  SERIAL_ASSERT(value != NULL);
+
+  size_t begin = 0;
+  size_t end = MYRIOTA_SerialSliceLength(slice);
+  while (begin < end && slice_at(slice, begin) == ' ') {
+    ++begin;
+  }
+  while (end > begin && slice_at(slice, end - 1) == ' ') {
+    --end;
+  }
+
+  bool negative = false;
+  if (begin < end && (slice_at(slice, begin) == '-' || slice_at(slice, begin) == '+')) {
+    negative = slice_at(slice, begin) == '-';
+    ++begin;
+  }
+
+  // Accumulate the magnitude, which may be one more than INT32_MAX when negative.
+  const uint32_t limit = negative ? (uint32_t)INT32_MAX + 1 : (uint32_t)INT32_MAX;
+  uint32_t magnitude = 0;
+  size_t digits = 0;
+  uint8_t fraction_digits = 0;
+  bool point = false;
+  bool round_up = false;
+  bool rounded = false;
+  for (size_t i = begin; i < end; ++i) {
+    const uint8_t c = slice_at(slice, i);
+    if (c == '.' && !point) {
+      point = true;
+      continue;
+    }
+    if (c < '0' || c > '9') {
+      return -FLEX_ERROR_EINVAL;
+    }
+    ++digits;
+    const uint32_t digit = c - '0';
+    if (point && fraction_digits >= decimals) {
+      // Only the first extra decimal place decides the rounding.
+      if (!rounded) {
+        round_up = digit >= 5;
+        rounded = true;
+      }
+      continue;
+    }
+    if (magnitude > (limit - digit) / 10) {
+      return -FLEX_ERROR_ERANGE;
+    }
+    magnitude = magnitude * 10 + digit;
+    fraction_digits += point ? 1 : 0;
+  }
+  if (digits == 0) {
+    return -FLEX_ERROR_EINVAL;
+  }
+
+  for (; fraction_digits < decimals; ++fraction_digits) {
+    if (magnitude > limit / 10) {
+      return -FLEX_ERROR_ERANGE;
+    }
+    magnitude *= 10;
+  }
+  if (round_up) {
+    if (magnitude >= limit) {
+      return -FLEX_ERROR_ERANGE;
+    }
+    ++magnitude;
+  }
+
+  *value = negative ? (int32_t)(0 - (int64_t)magnitude) : (int32_t)magnitude;
+  return FLEX_SUCCESS;
+}
+
+#ifdef MYRIOTA_SERIAL_TOKENIZER_UNIT_TESTS
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+/*
+ * `cmocka.h` must be included after standard the above library headers.
+ * NOTE: This comment has dual purpose:
+ * 1. Document the ordering requirement.
+ * 2. Prevent `clang-format` from reordering the headers.
+ */
+#include <cmocka.h>
+#include "myriota/flex_fake.h"
+
+static void fake_setup(MYRIOTA_Serial *const serial, const char *const rx) {
+  MYRIOTA_FlexFakeReset();
+  flex_fake.rx = (const uint8_t *)rx;
+  flex_fake.rx_size = strlen(rx);
+  const FLEX_SerialExOptions options = {.protocol = FLEX_SERIAL_PROTOCOL_RS232,
+    .baud_rate = 115200};
+  assert_int_equal(MYRIOTA_SerialInit(serial, options), FLEX_SUCCESS);
+}
+
+static MYRIOTA_SerialSlice slice_of(const char *const str) {
+  const MYRIOTA_SerialSlice slice = {.ptr = (const uint8_t *)str, .length = strlen(str)};
+  return slice;
+}
+
+static void test_records_wrap_around_ring(void **state) {
+  (void)state;
+  // Each record is 26 bytes, so records straddle the end of the 256 byte ring.
+  static char rx[26 * 30 + 1];
+  size_t rx_length = 0;
+  for (int i = 0; i < 30; ++i) {
+    char line[32];
+    const int n = snprintf(line, sizeof(line), "$XXTST,%03d,-%02d.5,ABCD*", i, i);
+    uint8_t checksum = 0;
+    for (int j = 1; j < n - 1; ++j) {
+      checksum ^= line[j];
+    }
+    rx_length += snprintf(&rx[rx_length], sizeof(rx) - rx_length, "%s%02X\r\n", line, checksum);
+  }
+  MYRIOTA_Serial serial;
+  fake_setup(&serial, rx);
+  MYRIOTA_SerialTokenizer tokenizer;
+  MYRIOTA_SerialTokenizerInit(&tokenizer, &serial, '\n');
+
+  bool wrapped = false;
+  for (int i = 0; i < 30; ++i) {
+    MYRIOTA_SerialRecord record;
+    assert_int_equal(MYRIOTA_SerialTokenizerNext(&tokenizer, 10, &record), 1);
+    wrapped = wrapped || record.slice.wrap_length > 0;
+    assert_int_equal(MYRIOTA_SerialRecordChecksum(&record), FLEX_SUCCESS);
+
+    MYRIOTA_SerialSlice field;
+    int32_t value = 0;
+    assert_true(MYRIOTA_SerialRecordField(&record, ',', &field));
+    assert_true(MYRIOTA_SerialSliceEquals(&field, "$XXTST"));
+    assert_true(MYRIOTA_SerialRecordField(&record, ',', &field));
+    assert_int_equal(MYRIOTA_SerialSliceToFixed(&field, 0, &value), FLEX_SUCCESS);
+    assert_int_equal(value, i);
+    assert_true(MYRIOTA_SerialRecordField(&record, ',', &field));
+    assert_int_equal(MYRIOTA_SerialSliceToFixed(&field, 1, &value), FLEX_SUCCESS);
+    assert_int_equal(value, -(i * 10 + 5));
+    assert_true(MYRIOTA_SerialRecordField(&record, ',', &field));
+    char copy[8];
+    assert_int_equal(MYRIOTA_SerialSliceCopy(&field, copy, sizeof(copy)), 4);
+    assert_string_equal(copy, "ABCD");
+    assert_false(MYRIOTA_SerialRecordField(&record, ',', &field));
+  }
+  assert_true(wrapped);
+
+  MYRIOTA_SerialRecord record;
+  assert_int_equal(MYRIOTA_SerialTokenizerNext(&tokenizer, 10, &record), 0);
+}
+
+static void test_bad_checksum_and_overflow(void **state) {
+  (void)state;
+  static char rx[MYRIOTA_SERIAL_RING_SIZE + 16];
+  memset(rx, 'x', sizeof(rx) - 1);
+  memcpy(rx, "$A,1*00\n", 8);
+  MYRIOTA_Serial serial;
+  fake_setup(&serial, rx);
+  MYRIOTA_SerialTokenizer tokenizer;
+  MYRIOTA_SerialTokenizerInit(&tokenizer, &serial, '\n');
+
+  MYRIOTA_SerialRecord record;
+  assert_int_equal(MYRIOTA_SerialTokenizerNext(&tokenizer, 10, &record), 1);
+  assert_int_equal(MYRIOTA_SerialRecordChecksum(&record), -FLEX_ERROR_EBADMSG);
+  assert_int_equal(MYRIOTA_SerialTokenizerNext(&tokenizer, 10, &record), -FLEX_ERROR_EMSGSIZE);
+}
+
+static void test_fixed_point(void **state) {
+  (void)state;
+  int32_t value = 0;
+  MYRIOTA_SerialSlice slice = slice_of(" 12.3456 ");
+  assert_int_equal(MYRIOTA_SerialSliceToFixed(&slice, 3, &value), FLEX_SUCCESS);
+  assert_int_equal(value, 12346);
+  slice = slice_of("-0.04");
+  assert_int_equal(MYRIOTA_SerialSliceToFixed(&slice, 1, &value), FLEX_SUCCESS);
+  assert_int_equal(value, 0);
+  slice = slice_of("7");
+  assert_int_equal(MYRIOTA_SerialSliceToFixed(&slice, 2, &value), FLEX_SUCCESS);
+  assert_int_equal(value, 700);
+  slice = slice_of("-2147483648");
+  assert_int_equal(MYRIOTA_SerialSliceToFixed(&slice, 0, &value), FLEX_SUCCESS);
+  assert_int_equal(value, INT32_MIN);
+  slice = slice_of("2147483648");
+  assert_int_equal(MYRIOTA_SerialSliceToFixed(&slice, 0, &value), -FLEX_ERROR_ERANGE);
+  slice = slice_of("21474836.47");
+  assert_int_equal(MYRIOTA_SerialSliceToFixed(&slice, 3, &value), -FLEX_ERROR_ERANGE);
+  slice = slice_of("1.2.3");
+  assert_int_equal(MYRIOTA_SerialSliceToFixed(&slice, 3, &value), -FLEX_ERROR_EINVAL);
+  slice = slice_of("");
+  assert_int_equal(MYRIOTA_SerialSliceToFixed(&slice, 3, &value), -FLEX_ERROR_EINVAL);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_records_wrap_around_ring),
+    cmocka_unit_test(test_bad_checksum_and_overflow),
+    cmocka_unit_test(test_fixed_point),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+#endif /** MYRIOTA_SERIAL_TOKENIZER_UNIT_TESTS */
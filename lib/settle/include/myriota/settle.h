@@ -0,0 +1,156 @@
+/// \file settle.h Myriota Analog Settle Detection
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYRIOTA_SETTLE_H
+#define MYRIOTA_SETTLE_H
+
+#include <stdint.h>
+#include "flex.h"
+#include "myriota/resource.h"
+
+/** \defgroup Settle Analog Settle Detection
+ * @brief Read an analog sensor as soon as it has settled after power up
+ *
+ * A fixed warm-up delay must cover the slowest sensor, so sensors that settle
+ * quicker are powered for longer than they need. Settle detection samples the
+ * analog input at a short interval from when the sensor is powered, and
+ * returns the mean of the last samples once their slope and standard deviation
+ * are within bounds, or when a hard maximum time is reached. The power output
+ * and the analog input are acquired from a resource manager for the reading,
+ * and the time is measured from when the power output came on, so a sensor
+ * that another driver has powered already is read sooner.
+ *
+ * The typical settle time of each sensor is learned, and the next reading
+ * waits for most of it before it starts sampling, which saves the reads of the
+ * analog input while the sensor is still rising.
+ *
+ * \code
+ * static MYRIOTA_ResourceManager resources;
+ * static MYRIOTA_Settle level_settle;
+ *
+ * static int read_level(uint32_t *const level) {
+ *   return MYRIOTA_SettleRead(&level_settle, level);
+ * }
+ *
+ * void FLEX_AppInit() {
+ *   const MYRIOTA_SettleOptions options = {
+ *     .power_out = FLEX_POWER_OUT_24V,
+ *     .mode = FLEX_ANALOG_IN_CURRENT,
+ *     .interval_ms = 50,
+ *     .window = 5,
+ *     .max_slope = 200,
+ *     .max_stddev = 20,
+ *     .max_ms = 1500,
+ *   };
+ *   MYRIOTA_ResourceInit(&resources);
+ *   MYRIOTA_SettleInit(&level_settle, &options, &resources);
+ * }
+ * \endcode
+ * \{
+ */
+
+/** The largest number of samples of the settle window. */
+#define MYRIOTA_SETTLE_WINDOW_MAX 16
+
+/** Configuration of settle detection. The units of the readings are
+ * microamps in current mode and millivolts in voltage mode. */
+typedef struct {
+  /** The voltage of the power output the sensor is powered from. */
+  FLEX_PowerOut power_out;
+  /** The mode of the analog input, which selects the read function. */
+  FLEX_AnalogInputMode mode;
+  /** The interval in milliseconds between samples. */
+  uint32_t interval_ms;
+  /** The number of samples the slope and standard deviation are computed
+   * over, from 2 to MYRIOTA_SETTLE_WINDOW_MAX. */
+  uint8_t window;
+  /** The largest slope of a settled reading in units per second. */
+  uint32_t max_slope;
+  /** The largest standard deviation of a settled reading in units. */
+  uint32_t max_stddev;
+  /** The shortest time in milliseconds before a reading can settle, for
+   * sensors that are flat while they start. */
+  uint32_t min_ms;
+  /** The longest time in milliseconds to wait for the reading to settle. */
+  uint32_t max_ms;
+} MYRIOTA_SettleOptions;
+
+/** Statistics of settle detection. */
+typedef struct {
+  /** The number of readings. */
+  uint32_t read_count;
+  /** The number of readings that reached `max_ms` without settling, which
+   * are not learned from. */
+  uint32_t timeout_count;
+  /** The number of samples read from the analog input. */
+  uint32_t sample_count;
+  /** The time in milliseconds the last reading took. */
+  uint32_t last_ms;
+  /** The learned typical time in milliseconds from power up until the sensor is flat. */
+  uint32_t typical_ms;
+  /** The total time in milliseconds of the readings, saturating at UINT32_MAX. */
+  uint32_t total_ms;
+} MYRIOTA_SettleStats;
+
+/** The settle detection of a sensor. Treat the members as private. */
+typedef struct {
+  /** \cond INTERNAL_HIDDEN */
+  MYRIOTA_SettleOptions options;
+  MYRIOTA_SettleStats stats;
+  MYRIOTA_ResourceManager *resources;
+  /** \endcond */
+} MYRIOTA_Settle;
+
+/**
+ * Initializes the settle detection of a sensor, which has not learned its
+ * settle time.
+ *
+ * \param[out] settle The settle detection to initialize.
+ * \param[in] options The configuration, which is copied.
+ * \param[in,out] resources The resource manager the power output and the
+ * analog input are acquired from, which must stay valid while the settle
+ * detection is used.
+ */
+void MYRIOTA_SettleInit(MYRIOTA_Settle *const settle, const MYRIOTA_SettleOptions *const options,
+  MYRIOTA_ResourceManager *const resources);
+
+/**
+ * Read a sensor once it has settled. Acquires the power output and the analog
+ * input in the configuration of the options for the reading, and delays with
+ * FLEX_DelayMs() between samples.
+ *
+ * \param[in,out] settle The settle detection of the sensor.
+ * \param[out] reading The mean of the last samples, if succeeded or timed out.
+ * \return FLEX_SUCCESS (0) if the reading settled and < 0 if failed.
+ * \retval -FLEX_ERROR_ETIMEDOUT: the reading did not settle within `max_ms`,
+ * in which case the mean of the last samples is still returned.
+ * \retval -FLEX_ERROR_EBUSY: another user of the resource manager has the
+ * power output or the analog input on in another configuration.
+ * Errors of initialising and reading the interfaces are returned.
+ */
+int MYRIOTA_SettleRead(MYRIOTA_Settle *const settle, uint32_t *const reading);
+
+/**
+ * Get the statistics of the settle detection of a sensor.
+ *
+ * \param[in] settle The settle detection of the sensor.
+ * \param[out] stats The statistics.
+ */
+void MYRIOTA_SettleStatsGet(const MYRIOTA_Settle *const settle, MYRIOTA_SettleStats *const stats);
+
+/**
+ * \}
+ */
+
+#endif /* MYRIOTA_SETTLE_H */
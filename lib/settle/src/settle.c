@@ -0,0 +1,421 @@
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myriota/settle.h"
+#include <stdbool.h>
+#include <string.h>
+#include "flex_errors.h"
+
+// NOTE: you can provide your own assert
+#ifndef SETTLE_ASSERT
+#include <stdio.h>
+#define SETTLE_ASSERT(cond)                          \
+  do {                                               \
+    if (!(cond)) {                                   \
+      printf("Assert @%s:%d\n", __FILE__, __LINE__); \
+      while (1) {                                    \
+      }                                              \
+    }                                                \
+  } while (0)
+#endif
+
+// The samples of the settle window, oldest first.
+typedef struct {
+  uint32_t samples[MYRIOTA_SETTLE_WINDOW_MAX];
+  uint8_t count;
+} SettleWindow;
+
+static void settle_push(SettleWindow *const window, const uint8_t size, const uint32_t sample) {
+  if (window->count == size) {
+    memmove(window->samples, window->samples + 1, (size - 1) * sizeof(window->samples[0]));
+    --window->count;
+  }
+  window->samples[window->count++] = sample;
+}
+
+static float settle_mean(const SettleWindow *const window) {
+  float sum = 0.0f;
+  for (uint8_t i = 0; i < window->count; ++i) {
+    sum += window->samples[i];
+  }
+  return sum / window->count;
+}
+
+// Returns true if the least squares slope and the standard deviation of the
+// samples are within the bounds of the options.
+static bool settle_is_settled(const MYRIOTA_SettleOptions *const options,
+  const SettleWindow *const window, const float mean) {
+  const float n = window->count;
+  const float index_mean = (n - 1.0f) / 2.0f;
+  float covariance = 0.0f, index_variance = 0.0f, variance = 0.0f;
+  for (uint8_t i = 0; i < window->count; ++i) {
+    const float dx = i - index_mean, dy = window->samples[i] - mean;
+    covariance += dx * dy;
+    index_variance += dx * dx;
+    variance += dy * dy;
+  }
+  const float slope = covariance / index_variance * 1000.0f / options->interval_ms;
+  const float max_stddev = options->max_stddev;
+  return (slope < 0.0f ? -slope : slope) <= options->max_slope &&
+         variance / n <= max_stddev * max_stddev;
+}
+
+static int settle_sample(const MYRIOTA_SettleOptions *const options, uint32_t *const sample) {
+  return (options->mode == FLEX_ANALOG_IN_CURRENT) ? FLEX_AnalogInputReadCurrent(sample)
+                                                   : FLEX_AnalogInputReadVoltage(sample);
+}
+
+// The time to start sampling, at three quarters of the typical settle time,
+// which lets the learned time come down as well as up.
+static uint32_t settle_start_ms(const MYRIOTA_Settle *const settle) {
+  const uint32_t seed_ms = settle->stats.typical_ms / 4 * 3;
+  return (seed_ms < settle->options.max_ms) ? seed_ms : settle->options.max_ms;
+}
+
+// Learns the time of the first sample of the last window, from which the
+// sensor was flat.
+static void settle_learn(MYRIOTA_Settle *const settle, const uint32_t elapsed_ms) {
+  const MYRIOTA_SettleOptions *const options = &settle->options;
+  const uint32_t span_ms = (options->window - 1) * options->interval_ms;
+  const uint32_t settle_ms = (elapsed_ms > span_ms) ? elapsed_ms - span_ms : 0;
+  MYRIOTA_SettleStats *const stats = &settle->stats;
+  if (stats->read_count == stats->timeout_count) {
+    stats->typical_ms = settle_ms;
+  } else {
+    // An exponential moving average, which follows a sensor that ages or a
+    // change of temperature over a few readings.
+    const int32_t error_ms = (int32_t)settle_ms - (int32_t)stats->typical_ms;
+    stats->typical_ms = (int32_t)stats->typical_ms + error_ms / 4;
+  }
+}
+
+// Records the time a reading took.
+static void settle_record(MYRIOTA_Settle *const settle, const uint32_t elapsed_ms) {
+  MYRIOTA_SettleStats *const stats = &settle->stats;
+  ++stats->read_count;
+  stats->last_ms = elapsed_ms;
+  stats->total_ms =
+    (stats->total_ms > UINT32_MAX - elapsed_ms) ? UINT32_MAX : stats->total_ms + elapsed_ms;
+}
+
+// Samples the sensor until it settles, where the sensor was powered at the start tick.
+static int settle_read(MYRIOTA_Settle *const settle, const uint32_t start_tick,
+  uint32_t *const reading) {
+  const MYRIOTA_SettleOptions *const options = &settle->options;
+  SettleWindow window = {.count = 0};
+
+  // The rail may have been on for a while if another driver had it on.
+  const uint32_t on_ms = FLEX_TickGet() - start_tick;
+  const uint32_t first_ms = settle_start_ms(settle);
+  if (on_ms < first_ms) {
+    FLEX_DelayMs(first_ms - on_ms);
+  }
+  while (true) {
+    uint32_t sample;
+    const int result = settle_sample(options, &sample);
+    if (result < 0) {
+      return result;
+    }
+    ++settle->stats.sample_count;
+    settle_push(&window, options->window, sample);
+
+    const uint32_t elapsed_ms = FLEX_TickGet() - start_tick;
+    const float mean = settle_mean(&window);
+    *reading = (uint32_t)(mean + 0.5f);
+    if (window.count == options->window && elapsed_ms >= options->min_ms &&
+        settle_is_settled(options, &window, mean)) {
+      settle_learn(settle, elapsed_ms);
+      settle_record(settle, elapsed_ms);
+      return FLEX_SUCCESS;
+    }
+    // A reading that did not settle says nothing about when the sensor is flat.
+    if (elapsed_ms >= options->max_ms) {
+      settle_record(settle, elapsed_ms);
+      ++settle->stats.timeout_count;
+      return -FLEX_ERROR_ETIMEDOUT;
+    }
+    FLEX_DelayMs(options->interval_ms);
+  }
+}
+
+void MYRIOTA_SettleInit(MYRIOTA_Settle *const settle, const MYRIOTA_SettleOptions *const options,
+  MYRIOTA_ResourceManager *const resources) {
+  SETTLE_ASSERT(settle != NULL && options != NULL && resources != NULL);
+  SETTLE_ASSERT(options->window >= 2 && options->window <= MYRIOTA_SETTLE_WINDOW_MAX);
+  SETTLE_ASSERT(options->interval_ms > 0);
+  memset(settle, 0, sizeof(*settle));
+  settle->options = *options;
+  settle->resources = resources;
+}
+
+int MYRIOTA_SettleRead(MYRIOTA_Settle *const settle, uint32_t *const reading) {
+  SETTLE_ASSERT(settle != NULL && reading != NULL);
+  const MYRIOTA_SettleOptions *const options = &settle->options;
+  MYRIOTA_ResourceHandle power, analog;
+  int result = MYRIOTA_ResourcePowerOutAcquire(settle->resources, &power, options->power_out);
+  if (result < 0) {
+    return result;
+  }
+  result = MYRIOTA_ResourceAnalogInAcquire(settle->resources, &analog, options->mode);
+  if (result == FLEX_SUCCESS) {
+    result = settle_read(settle, FLEX_TickGet() - MYRIOTA_ResourceOnMs(&power), reading);
+    MYRIOTA_ResourceRelease(&analog);
+  }
+  MYRIOTA_ResourceRelease(&power);
+  return result;
+}
+
+void MYRIOTA_SettleStatsGet(const MYRIOTA_Settle *const settle, MYRIOTA_SettleStats *const stats) {
+  SETTLE_ASSERT(settle != NULL && stats != NULL);
+  *stats = settle->stats;
+}
+
+#ifdef MYRIOTA_SETTLE_UNIT_TESTS
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+/*
+ * `cmocka.h` must be included after standard the above library headers.
+ * NOTE: This comment has dual purpose:
+ * 1. Document the ordering requirement.
+ * 2. Prevent `clang-format` from reordering the headers.
+ */
+#include <cmocka.h>
+#include "myriota/flex_fake.h"
+
+// A sensor that ramps linearly from `start` to `end` over `ramp_ms` after it
+// is powered at `power_tick`.
+static struct {
+  uint32_t power_tick;
+  uint32_t start;
+  uint32_t end;
+  uint32_t ramp_ms;
+  uint32_t noise;
+} sensor;
+
+static uint32_t sensor_read(void) {
+  const uint32_t on_ms = flex_fake.tick - sensor.power_tick;
+  uint32_t value = sensor.end;
+  if (on_ms < sensor.ramp_ms) {
+    value = sensor.start + (uint64_t)(sensor.end - sensor.start) * on_ms / sensor.ramp_ms;
+  }
+  // Alternate the noise between samples.
+  return ((flex_fake.current_count + flex_fake.voltage_count) % 2) ? value + sensor.noise :
+                                                                       value - sensor.noise;
+}
+
+static MYRIOTA_ResourceManager resources;
+
+static const MYRIOTA_SettleOptions current_options = {
+  .power_out = FLEX_POWER_OUT_24V,
+  .mode = FLEX_ANALOG_IN_CURRENT,
+  .interval_ms = 50,
+  .window = 5,
+  .max_slope = 200,
+  .max_stddev = 20,
+  .max_ms = 1500,
+};
+
+static void settle_setup(MYRIOTA_Settle *const settle, const uint32_t ramp_ms) {
+  MYRIOTA_FlexFakeReset();
+  flex_fake.tick = 5000;
+  flex_fake.analog_read = sensor_read;
+  memset(&sensor, 0, sizeof(sensor));
+  sensor.start = 4000;
+  sensor.end = 12000;
+  sensor.ramp_ms = ramp_ms;
+  MYRIOTA_ResourceInit(&resources);
+  MYRIOTA_SettleInit(settle, &current_options, &resources);
+}
+
+// Powers the fake sensor one period later and reads it.
+static int settle_cycle(MYRIOTA_Settle *const settle, uint32_t *const reading) {
+  flex_fake.tick += 3600 * 1000;
+  sensor.power_tick = flex_fake.tick;
+  flex_fake.current_count = 0;
+  return MYRIOTA_SettleRead(settle, reading);
+}
+
+static void test_settles_early(void **state) {
+  (void)state;
+  MYRIOTA_Settle settle;
+  settle_setup(&settle, 300);
+  uint32_t reading;
+  assert_int_equal(settle_cycle(&settle, &reading), 0);
+  assert_int_equal(reading, 12000);
+
+  // The window is flat from the end of the ramp.
+  MYRIOTA_SettleStats stats;
+  MYRIOTA_SettleStatsGet(&settle, &stats);
+  assert_int_equal(stats.read_count, 1);
+  assert_int_equal(stats.timeout_count, 0);
+  assert_int_equal(stats.last_ms, 500);
+  assert_int_equal(stats.typical_ms, 300);
+  assert_int_equal(flex_fake.current_count, 11);
+  assert_int_equal(flex_fake.power_out, FLEX_POWER_OUT_24V);
+  assert_false(flex_fake.is_power_out || flex_fake.is_analog_in);
+}
+
+static void test_learns_settle_time(void **state) {
+  (void)state;
+  MYRIOTA_Settle settle;
+  settle_setup(&settle, 300);
+  uint32_t reading;
+  assert_int_equal(settle_cycle(&settle, &reading), 0);
+  const int first_count = flex_fake.current_count;
+
+  // The next readings start sampling later, and take no longer to settle.
+  for (int i = 0; i < 8; ++i) {
+    assert_int_equal(settle_cycle(&settle, &reading), 0);
+    assert_in_range(reading, 11990, 12000);
+    assert_true(flex_fake.current_count < first_count);
+  }
+  MYRIOTA_SettleStats stats;
+  MYRIOTA_SettleStatsGet(&settle, &stats);
+  assert_int_equal(stats.read_count, 9);
+  assert_in_range(stats.last_ms, 450, 550);
+  assert_in_range(stats.typical_ms, 300, 350);
+
+  // A sensor that becomes slower is followed up.
+  sensor.ramp_ms = 900;
+  assert_int_equal(settle_cycle(&settle, &reading), 0);
+  assert_in_range(reading, 11990, 12000);
+  MYRIOTA_SettleStatsGet(&settle, &stats);
+  assert_in_range(stats.last_ms, 1100, 1150);
+  assert_true(stats.typical_ms > 400);
+}
+
+static void test_timeout(void **state) {
+  (void)state;
+  MYRIOTA_Settle settle;
+  settle_setup(&settle, 10000);
+  uint32_t reading = 0;
+  assert_int_equal(settle_cycle(&settle, &reading), -FLEX_ERROR_ETIMEDOUT);
+  assert_in_range(reading, sensor.start, sensor.end);
+
+  MYRIOTA_SettleStats stats;
+  MYRIOTA_SettleStatsGet(&settle, &stats);
+  assert_int_equal(stats.timeout_count, 1);
+  assert_int_equal(stats.last_ms, 1500);
+  assert_int_equal(stats.typical_ms, 0);
+
+  // Timeouts do not raise the learned time of a sensor that settles.
+  sensor.ramp_ms = 300;
+  assert_int_equal(settle_cycle(&settle, &reading), 0);
+  MYRIOTA_SettleStatsGet(&settle, &stats);
+  assert_int_equal(stats.typical_ms, 300);
+  sensor.ramp_ms = 10000;
+  assert_int_equal(settle_cycle(&settle, &reading), -FLEX_ERROR_ETIMEDOUT);
+  MYRIOTA_SettleStatsGet(&settle, &stats);
+  assert_int_equal(stats.read_count, 3);
+  assert_int_equal(stats.timeout_count, 2);
+  assert_int_equal(stats.typical_ms, 300);
+}
+
+static void test_noise(void **state) {
+  (void)state;
+  MYRIOTA_Settle settle;
+  uint32_t reading;
+
+  // Noise within the standard deviation settles on the mean.
+  settle_setup(&settle, 300);
+  sensor.noise = 10;
+  assert_int_equal(settle_cycle(&settle, &reading), 0);
+  assert_in_range(reading, 11990, 12010);
+
+  settle_setup(&settle, 300);
+  sensor.noise = 50;
+  assert_int_equal(settle_cycle(&settle, &reading), -FLEX_ERROR_ETIMEDOUT);
+}
+
+static void test_min_ms_and_voltage(void **state) {
+  (void)state;
+  MYRIOTA_Settle settle;
+  settle_setup(&settle, 0);
+  MYRIOTA_SettleOptions options = current_options;
+  options.mode = FLEX_ANALOG_IN_VOLTAGE;
+  options.min_ms = 400;
+  MYRIOTA_SettleInit(&settle, &options, &resources);
+  uint32_t reading;
+  assert_int_equal(settle_cycle(&settle, &reading), 0);
+  assert_int_equal(reading, 12000);
+  assert_int_equal(flex_fake.current_count, 0);
+  assert_int_equal(flex_fake.voltage_count, 9);
+
+  MYRIOTA_SettleStats stats;
+  MYRIOTA_SettleStatsGet(&settle, &stats);
+  assert_int_equal(stats.last_ms, 400);
+  assert_int_equal(stats.sample_count, 9);
+}
+
+static void test_read_error(void **state) {
+  (void)state;
+  MYRIOTA_Settle settle;
+  settle_setup(&settle, 300);
+  flex_fake.analog_read_result = -FLEX_ERROR_READ_FAIL;
+  uint32_t reading;
+  assert_int_equal(settle_cycle(&settle, &reading), -FLEX_ERROR_READ_FAIL);
+
+  MYRIOTA_SettleStats stats;
+  MYRIOTA_SettleStatsGet(&settle, &stats);
+  assert_int_equal(stats.read_count, 0);
+  assert_false(flex_fake.is_power_out || flex_fake.is_analog_in);
+}
+
+static void test_shared_resources(void **state) {
+  (void)state;
+  MYRIOTA_Settle settle;
+  settle_setup(&settle, 300);
+
+  // The rail has been on for 400 ms for another driver, so the sensor is
+  // flat from the first sample and the rail stays on.
+  MYRIOTA_ResourceHandle other;
+  assert_int_equal(MYRIOTA_ResourcePowerOutAcquire(&resources, &other, FLEX_POWER_OUT_24V), 0);
+  sensor.power_tick = flex_fake.tick;
+  flex_fake.tick += 400;
+  uint32_t reading;
+  assert_int_equal(MYRIOTA_SettleRead(&settle, &reading), 0);
+  assert_int_equal(reading, 12000);
+  assert_int_equal(flex_fake.current_count, 5);
+  assert_int_equal(flex_fake.power_out_count, 1);
+  assert_true(flex_fake.is_power_out);
+  assert_false(flex_fake.is_analog_in);
+
+  MYRIOTA_SettleStats stats;
+  MYRIOTA_SettleStatsGet(&settle, &stats);
+  assert_int_equal(stats.last_ms, 600);
+  assert_int_equal(stats.typical_ms, 400);
+  assert_int_equal(MYRIOTA_ResourceRelease(&other), 0);
+
+  // A rail on at another voltage is busy.
+  assert_int_equal(MYRIOTA_ResourcePowerOutAcquire(&resources, &other, FLEX_POWER_OUT_12V), 0);
+  assert_int_equal(MYRIOTA_SettleRead(&settle, &reading), -FLEX_ERROR_EBUSY);
+  assert_int_equal(flex_fake.analog_in_count, 1);
+  assert_int_equal(MYRIOTA_ResourceRelease(&other), 0);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_settles_early),
+    cmocka_unit_test(test_learns_settle_time),
+    cmocka_unit_test(test_timeout),
+    cmocka_unit_test(test_noise),
+    cmocka_unit_test(test_min_ms_and_voltage),
+    cmocka_unit_test(test_read_error),
+    cmocka_unit_test(test_shared_resources),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+#endif /** MYRIOTA_SETTLE_UNIT_TESTS */
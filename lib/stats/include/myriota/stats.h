@@ -0,0 +1,151 @@
+/// \file stats.h Myriota Streaming Statistics
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYRIOTA_STATS_H
+#define MYRIOTA_STATS_H
+
+#include <stdint.h>
+
+/** \defgroup Stats Streaming Statistics
+ * @brief Summarise a stream of samples in fixed memory
+ *
+ * Reduces any number of samples to their count, minimum, maximum, mean,
+ * variance, median and 95th percentile, so that a signal can be sampled far
+ * more often than it is reported. The mean and variance are computed with
+ * Welford's method and the quantiles are estimated with the P² algorithm of
+ * Jain and Chlamtac, using five markers per quantile.
+ *
+ * Adding a sample and merging two summaries take constant time and no
+ * allocation, so per minute summaries can be rolled into hourly ones:
+ *
+ * \code
+ * static MYRIOTA_Stats minute, hour;
+ *
+ * static time_t sample_job(void) {
+ *   MYRIOTA_StatsAdd(&minute, read_current());
+ *   ...
+ * }
+ *
+ * static time_t minute_job(void) {
+ *   MYRIOTA_StatsMerge(&hour, &minute);
+ *   MYRIOTA_StatsInit(&minute);
+ *   ...
+ * }
+ * \endcode
+ *
+ * Samples are float by default. Define MYRIOTA_STATS_FIXED_POINT when building
+ * to use int32_t samples with MYRIOTA_STATS_FRACTION_BITS fraction bits and
+ * integer arithmetic only, e.g. on a part without a floating point unit.
+ * \{
+ */
+
+#ifdef MYRIOTA_STATS_FIXED_POINT
+/** The number of fraction bits of fixed-point samples. */
+#ifndef MYRIOTA_STATS_FRACTION_BITS
+#define MYRIOTA_STATS_FRACTION_BITS 0
+#endif
+/** A sample, in fixed-point with MYRIOTA_STATS_FRACTION_BITS fraction bits. */
+typedef int32_t MYRIOTA_StatsValue;
+/** \cond INTERNAL_HIDDEN */
+typedef int64_t MYRIOTA_StatsAccumulator;
+/** \endcond */
+#else
+/** A sample. */
+typedef float MYRIOTA_StatsValue;
+/** \cond INTERNAL_HIDDEN */
+typedef float MYRIOTA_StatsAccumulator;
+/** \endcond */
+#endif
+
+/** \cond INTERNAL_HIDDEN */
+#define MYRIOTA_STATS_MARKERS 5
+
+// The first samples until all markers are set, then the P² markers.
+typedef struct {
+  MYRIOTA_StatsValue height[MYRIOTA_STATS_MARKERS];
+  int32_t position[MYRIOTA_STATS_MARKERS];
+} MYRIOTA_StatsQuantile;
+/** \endcond */
+
+/** A streaming statistics summary. Treat the members as private. */
+typedef struct {
+  /** \cond INTERNAL_HIDDEN */
+  uint32_t count;
+  MYRIOTA_StatsValue min;
+  MYRIOTA_StatsValue max;
+  MYRIOTA_StatsAccumulator mean;
+  MYRIOTA_StatsAccumulator m2;
+  MYRIOTA_StatsQuantile median;
+  MYRIOTA_StatsQuantile p95;
+  /** \endcond */
+} MYRIOTA_Stats;
+
+/** The statistics of a summary, all 0 if it is empty. */
+typedef struct {
+  /** The number of samples. */
+  uint32_t count;
+  /** The smallest sample. */
+  MYRIOTA_StatsValue min;
+  /** The largest sample. */
+  MYRIOTA_StatsValue max;
+  /** The mean of the samples. */
+  MYRIOTA_StatsValue mean;
+  /** The sample variance, which is 0 for fewer than two samples. */
+  MYRIOTA_StatsValue variance;
+  /** The estimated median, exact for fewer than five samples. */
+  MYRIOTA_StatsValue median;
+  /** The estimated 95th percentile, exact for fewer than five samples. */
+  MYRIOTA_StatsValue p95;
+} MYRIOTA_StatsSummary;
+
+/**
+ * Initializes an empty summary.
+ *
+ * \param[out] stats The summary to initialize.
+ */
+void MYRIOTA_StatsInit(MYRIOTA_Stats *const stats);
+
+/**
+ * Add a sample to a summary.
+ *
+ * \param[in,out] stats The summary.
+ * \param[in] value The sample.
+ */
+void MYRIOTA_StatsAdd(MYRIOTA_Stats *const stats, const MYRIOTA_StatsValue value);
+
+/**
+ * Merge a summary into another, e.g. to roll per minute summaries into an
+ * hourly one. The count, minimum, maximum, mean and variance are as if every
+ * sample had been added to `stats`, while the quantiles are the count weighted
+ * combination of the two estimates.
+ *
+ * \param[in,out] stats The summary to merge into.
+ * \param[in] other The summary to merge, which is unchanged.
+ */
+void MYRIOTA_StatsMerge(MYRIOTA_Stats *const stats, const MYRIOTA_Stats *const other);
+
+/**
+ * Get the statistics of a summary.
+ *
+ * \param[in] stats The summary.
+ * \param[out] summary The statistics.
+ */
+void MYRIOTA_StatsSummaryGet(const MYRIOTA_Stats *const stats,
+  MYRIOTA_StatsSummary *const summary);
+
+/**
+ * \}
+ */
+
+#endif /* MYRIOTA_STATS_H */
@@ -0,0 +1,400 @@
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myriota/stats.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+// NOTE: you can provide your own assert
+#ifndef STATS_ASSERT
+#include <stdio.h>
+#define STATS_ASSERT(cond)                           \
+  do {                                               \
+    if (!(cond)) {                                   \
+      printf("Assert @%s:%d\n", __FILE__, __LINE__); \
+      while (1) {                                    \
+      }                                              \
+    }                                                \
+  } while (0)
+#endif
+
+// Quantiles and marker increments are in Q16.
+#define STATS_Q16_ONE 65536
+#define STATS_MEDIAN_Q16 (STATS_Q16_ONE / 2)
+#define STATS_P95_Q16 62259
+
+#ifdef MYRIOTA_STATS_FIXED_POINT
+// The mean carries guard bits below the fraction bits of the samples so that
+// rounding does not accumulate, and `m2` has twice the fraction bits plus the
+// guard bits, which limits differences between samples to about 2^23.
+#define STATS_GUARD_BITS 16
+#define STATS_GUARD_ONE ((int64_t)1 << STATS_GUARD_BITS)
+
+static inline MYRIOTA_StatsAccumulator stats_widen(const MYRIOTA_StatsValue value) {
+  return (MYRIOTA_StatsAccumulator)value * STATS_GUARD_ONE;
+}
+
+static inline MYRIOTA_StatsValue stats_narrow(const MYRIOTA_StatsAccumulator value) {
+  return (value + STATS_GUARD_ONE / 2) >> STATS_GUARD_BITS;
+}
+
+static inline MYRIOTA_StatsAccumulator stats_product(const MYRIOTA_StatsAccumulator a,
+  const MYRIOTA_StatsAccumulator b) {
+  return (a >> (STATS_GUARD_BITS / 2)) * (b >> (STATS_GUARD_BITS / 2));
+}
+
+// Returns value * numerator / denominator without overflowing for large counts.
+static inline MYRIOTA_StatsAccumulator stats_scale(const MYRIOTA_StatsAccumulator value,
+  const uint32_t numerator, const uint32_t denominator) {
+  return (value / denominator) * numerator +
+         (value % denominator) * (int64_t)numerator / denominator;
+}
+
+static inline MYRIOTA_StatsValue stats_variance(const MYRIOTA_StatsAccumulator m2,
+  const uint32_t count) {
+  const int64_t variance = (m2 / (count - 1)) >> (MYRIOTA_STATS_FRACTION_BITS + STATS_GUARD_BITS);
+  return (variance > INT32_MAX) ? INT32_MAX : variance;
+}
+#else
+static inline MYRIOTA_StatsAccumulator stats_widen(const MYRIOTA_StatsValue value) {
+  return value;
+}
+
+static inline MYRIOTA_StatsValue stats_narrow(const MYRIOTA_StatsAccumulator value) {
+  return value;
+}
+
+static inline MYRIOTA_StatsAccumulator stats_product(const MYRIOTA_StatsAccumulator a,
+  const MYRIOTA_StatsAccumulator b) {
+  return a * b;
+}
+
+static inline MYRIOTA_StatsAccumulator stats_scale(const MYRIOTA_StatsAccumulator value,
+  const uint32_t numerator, const uint32_t denominator) {
+  return value * ((float)numerator / denominator);
+}
+
+static inline MYRIOTA_StatsValue stats_variance(const MYRIOTA_StatsAccumulator m2,
+  const uint32_t count) {
+  return m2 / (count - 1);
+}
+#endif
+
+static void stats_sort(MYRIOTA_StatsValue *const values, const size_t count) {
+  for (size_t i = 1; i < count; ++i) {
+    const MYRIOTA_StatsValue value = values[i];
+    size_t j = i;
+    for (; j > 0 && values[j - 1] > value; --j) {
+      values[j] = values[j - 1];
+    }
+    values[j] = value;
+  }
+}
+
+// The desired position of a marker in Q16 after `count` samples.
+static int64_t p2_desired(const uint32_t p_q16, const int marker, const uint32_t count) {
+  static const uint8_t halves[MYRIOTA_STATS_MARKERS] = {0, 1, 2, 1, 0};
+  static const uint8_t offsets[MYRIOTA_STATS_MARKERS] = {0, 0, 0, 1, 2};
+  const int64_t increment = ((int64_t)p_q16 * halves[marker] + STATS_Q16_ONE * offsets[marker]) / 2;
+  return STATS_Q16_ONE + (int64_t)(count - 1) * increment;
+}
+
+static MYRIOTA_StatsValue p2_parabolic(const MYRIOTA_StatsQuantile *const quantile,
+  const int i, const int d) {
+  const MYRIOTA_StatsValue *const q = quantile->height;
+  const int32_t *const n = quantile->position;
+  const MYRIOTA_StatsAccumulator up =
+    (MYRIOTA_StatsAccumulator)(n[i] - n[i - 1] + d) * ((MYRIOTA_StatsAccumulator)q[i + 1] - q[i]) /
+    (n[i + 1] - n[i]);
+  const MYRIOTA_StatsAccumulator down =
+    (MYRIOTA_StatsAccumulator)(n[i + 1] - n[i] - d) * ((MYRIOTA_StatsAccumulator)q[i] - q[i - 1]) /
+    (n[i] - n[i - 1]);
+  return q[i] + (MYRIOTA_StatsAccumulator)d * (up + down) / (n[i + 1] - n[i - 1]);
+}
+
+static MYRIOTA_StatsValue p2_linear(const MYRIOTA_StatsQuantile *const quantile, const int i,
+  const int d) {
+  const MYRIOTA_StatsValue *const q = quantile->height;
+  const int32_t *const n = quantile->position;
+  return q[i] + (MYRIOTA_StatsAccumulator)d * ((MYRIOTA_StatsAccumulator)q[i + d] - q[i]) /
+                  (n[i + d] - n[i]);
+}
+
+// Adds the `count`th sample to a quantile estimate.
+static void p2_add(MYRIOTA_StatsQuantile *const quantile, const uint32_t p_q16,
+  const MYRIOTA_StatsValue value, const uint32_t count) {
+  MYRIOTA_StatsValue *const q = quantile->height;
+  int32_t *const n = quantile->position;
+  if (count <= MYRIOTA_STATS_MARKERS) {
+    q[count - 1] = value;
+    if (count == MYRIOTA_STATS_MARKERS) {
+      stats_sort(q, MYRIOTA_STATS_MARKERS);
+      for (int i = 0; i < MYRIOTA_STATS_MARKERS; ++i) {
+        n[i] = i + 1;
+      }
+    }
+    return;
+  }
+
+  int cell;
+  if (value < q[0]) {
+    q[0] = value;
+    cell = 0;
+  } else if (value >= q[4]) {
+    q[4] = value;
+    cell = 3;
+  } else {
+    for (cell = 0; value >= q[cell + 1]; ++cell) {
+    }
+  }
+  for (int i = cell + 1; i < MYRIOTA_STATS_MARKERS; ++i) {
+    ++n[i];
+  }
+
+  for (int i = 1; i < MYRIOTA_STATS_MARKERS - 1; ++i) {
+    const int64_t d = p2_desired(p_q16, i, count) - (int64_t)n[i] * STATS_Q16_ONE;
+    if ((d >= STATS_Q16_ONE && n[i + 1] - n[i] > 1) ||
+        (d <= -STATS_Q16_ONE && n[i - 1] - n[i] < -1)) {
+      const int step = (d > 0) ? 1 : -1;
+      MYRIOTA_StatsValue height = p2_parabolic(quantile, i, step);
+      if (!(q[i - 1] < height && height < q[i + 1])) {
+        height = p2_linear(quantile, i, step);
+      }
+      q[i] = height;
+      n[i] += step;
+    }
+  }
+}
+
+static MYRIOTA_StatsValue p2_value(const MYRIOTA_StatsQuantile *const quantile,
+  const uint32_t p_q16, const uint32_t count) {
+  if (count == 0) {
+    return 0;
+  }
+  if (count >= MYRIOTA_STATS_MARKERS) {
+    return quantile->height[2];
+  }
+
+  // Exact while the first samples are held.
+  MYRIOTA_StatsValue sorted[MYRIOTA_STATS_MARKERS];
+  memcpy(sorted, quantile->height, count * sizeof(sorted[0]));
+  stats_sort(sorted, count);
+  return sorted[((uint64_t)p_q16 * (count - 1) + STATS_Q16_ONE / 2) / STATS_Q16_ONE];
+}
+
+// Merges the markers of two estimates of at least five samples each.
+static void p2_merge(MYRIOTA_StatsQuantile *const quantile,
+  const MYRIOTA_StatsQuantile *const other, const uint32_t count, const uint32_t other_count) {
+  const uint32_t total = count + other_count;
+  for (int i = 0; i < MYRIOTA_STATS_MARKERS; ++i) {
+    quantile->height[i] += stats_scale(
+      (MYRIOTA_StatsAccumulator)other->height[i] - quantile->height[i], other_count, total);
+    quantile->position[i] += other->position[i];
+  }
+  quantile->height[0] = (other->height[0] < quantile->height[0]) ? other->height[0] :
+                                                                   quantile->height[0];
+  quantile->height[4] = (other->height[4] > quantile->height[4]) ? other->height[4] :
+                                                                   quantile->height[4];
+
+  // Keep the positions strictly increasing between the first and last sample.
+  int32_t *const n = quantile->position;
+  n[0] = 1;
+  n[4] = total;
+  for (int i = 1; i < MYRIOTA_STATS_MARKERS - 1; ++i) {
+    if (n[i] <= n[i - 1]) {
+      n[i] = n[i - 1] + 1;
+    }
+  }
+  for (int i = MYRIOTA_STATS_MARKERS - 2; i > 0; --i) {
+    if (n[i] >= n[i + 1]) {
+      n[i] = n[i + 1] - 1;
+    }
+  }
+}
+
+void MYRIOTA_StatsInit(MYRIOTA_Stats *const stats) {
+  STATS_ASSERT(stats != NULL);
+  memset(stats, 0, sizeof(*stats));
+}
+
+void MYRIOTA_StatsAdd(MYRIOTA_Stats *const stats, const MYRIOTA_StatsValue value) {
+  STATS_ASSERT(stats != NULL);
+  STATS_ASSERT(stats->count < UINT32_MAX);
+  ++stats->count;
+  if (stats->count == 1 || value < stats->min) {
+    stats->min = value;
+  }
+  if (stats->count == 1 || value > stats->max) {
+    stats->max = value;
+  }
+
+  const MYRIOTA_StatsAccumulator sample = stats_widen(value);
+  const MYRIOTA_StatsAccumulator delta = sample - stats->mean;
+  stats->mean += delta / stats->count;
+  stats->m2 += stats_product(delta, sample - stats->mean);
+
+  p2_add(&stats->median, STATS_MEDIAN_Q16, value, stats->count);
+  p2_add(&stats->p95, STATS_P95_Q16, value, stats->count);
+}
+
+void MYRIOTA_StatsMerge(MYRIOTA_Stats *const stats, const MYRIOTA_Stats *const other) {
+  STATS_ASSERT(stats != NULL);
+  STATS_ASSERT(other != NULL);
+
+  // While a summary holds its first samples, they are added one by one.
+  if (other->count < MYRIOTA_STATS_MARKERS) {
+    for (uint32_t i = 0; i < other->count; ++i) {
+      MYRIOTA_StatsAdd(stats, other->median.height[i]);
+    }
+    return;
+  }
+  if (stats->count < MYRIOTA_STATS_MARKERS) {
+    const MYRIOTA_Stats first = *stats;
+    *stats = *other;
+    MYRIOTA_StatsMerge(stats, &first);
+    return;
+  }
+
+  STATS_ASSERT(stats->count <= UINT32_MAX - other->count);
+  const uint32_t total = stats->count + other->count;
+  const MYRIOTA_StatsAccumulator delta = other->mean - stats->mean;
+  stats->mean += stats_scale(delta, other->count, total);
+  stats->m2 += other->m2 + stats_product(stats_scale(delta, stats->count, total), delta) *
+                             (MYRIOTA_StatsAccumulator)other->count;
+  stats->min = (other->min < stats->min) ? other->min : stats->min;
+  stats->max = (other->max > stats->max) ? other->max : stats->max;
+
+  p2_merge(&stats->median, &other->median, stats->count, other->count);
+  p2_merge(&stats->p95, &other->p95, stats->count, other->count);
+  stats->count = total;
+}
+
+void MYRIOTA_StatsSummaryGet(const MYRIOTA_Stats *const stats,
+  MYRIOTA_StatsSummary *const summary) {
+  STATS_ASSERT(stats != NULL);
+  STATS_ASSERT(summary != NULL);
+  memset(summary, 0, sizeof(*summary));
+  summary->count = stats->count;
+  if (stats->count == 0) {
+    return;
+  }
+  summary->min = stats->min;
+  summary->max = stats->max;
+  summary->mean = stats_narrow(stats->mean);
+  summary->variance = (stats->count > 1) ? stats_variance(stats->m2, stats->count) : 0;
+  summary->median = p2_value(&stats->median, STATS_MEDIAN_Q16, stats->count);
+  summary->p95 = p2_value(&stats->p95, STATS_P95_Q16, stats->count);
+}
+
+#ifdef MYRIOTA_STATS_UNIT_TESTS
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+/*
+ * `cmocka.h` must be included after standard the above library headers.
+ * NOTE: This comment has dual purpose:
+ * 1. Document the ordering requirement.
+ * 2. Prevent `clang-format` from reordering the headers.
+ */
+#include <cmocka.h>
+
+#define SAMPLE_COUNT 3600
+
+// Returns 1..SAMPLE_COUNT in a pseudo random order.
+static MYRIOTA_StatsValue sample(const uint32_t index) {
+  return (index * 1847 % SAMPLE_COUNT) + 1;
+}
+
+static void assert_near(const MYRIOTA_StatsValue value, const double expected,
+  const double tolerance) {
+  if (value < expected - tolerance || value > expected + tolerance) {
+    fail_msg("%f is not within %f of %f", (double)value, tolerance, expected);
+  }
+}
+
+static void test_empty_and_small(void **state) {
+  (void)state;
+  MYRIOTA_Stats stats;
+  MYRIOTA_StatsSummary summary;
+  MYRIOTA_StatsInit(&stats);
+  MYRIOTA_StatsSummaryGet(&stats, &summary);
+  assert_int_equal(summary.count, 0);
+  assert_true(summary.max == 0 && summary.median == 0);
+
+  const MYRIOTA_StatsValue values[] = {7, 3, 9};
+  for (size_t i = 0; i < 3; ++i) {
+    MYRIOTA_StatsAdd(&stats, values[i]);
+  }
+  MYRIOTA_StatsSummaryGet(&stats, &summary);
+  assert_int_equal(summary.count, 3);
+  assert_true(summary.min == 3 && summary.max == 9);
+  assert_true(summary.median == 7 && summary.p95 == 9);
+  assert_near(summary.mean, 19.0 / 3, 0.5);
+  assert_near(summary.variance, 28.0 / 3, 0.5);
+}
+
+static void test_uniform(void **state) {
+  (void)state;
+  MYRIOTA_Stats stats;
+  MYRIOTA_StatsInit(&stats);
+  for (uint32_t i = 0; i < SAMPLE_COUNT; ++i) {
+    MYRIOTA_StatsAdd(&stats, sample(i));
+  }
+
+  MYRIOTA_StatsSummary summary;
+  MYRIOTA_StatsSummaryGet(&stats, &summary);
+  assert_int_equal(summary.count, SAMPLE_COUNT);
+  assert_true(summary.min == 1 && summary.max == SAMPLE_COUNT);
+  assert_near(summary.mean, (SAMPLE_COUNT + 1) / 2.0, 1);
+  assert_near(summary.variance, SAMPLE_COUNT * (SAMPLE_COUNT + 1.0) / 12, 0.01 * 1080000);
+  assert_near(summary.median, SAMPLE_COUNT / 2.0, 0.02 * SAMPLE_COUNT);
+  assert_near(summary.p95, SAMPLE_COUNT * 0.95, 0.02 * SAMPLE_COUNT);
+}
+
+static void test_merge_minutes_into_hour(void **state) {
+  (void)state;
+  MYRIOTA_Stats hour;
+  MYRIOTA_StatsInit(&hour);
+  for (uint32_t minute = 0; minute < 60; ++minute) {
+    MYRIOTA_Stats stats;
+    MYRIOTA_StatsInit(&stats);
+    // Include a minute of too few samples for the quantile markers.
+    const uint32_t count = (minute == 30) ? 3 : SAMPLE_COUNT / 60;
+    for (uint32_t i = 0; i < count; ++i) {
+      MYRIOTA_StatsAdd(&stats, sample(minute * (SAMPLE_COUNT / 60) + i));
+    }
+    MYRIOTA_StatsMerge(&hour, &stats);
+  }
+
+  MYRIOTA_StatsSummary summary;
+  MYRIOTA_StatsSummaryGet(&hour, &summary);
+  assert_int_equal(summary.count, SAMPLE_COUNT - 57);
+  assert_true(summary.min == 1 && summary.max == SAMPLE_COUNT);
+  assert_near(summary.mean, (SAMPLE_COUNT + 1) / 2.0, 0.01 * SAMPLE_COUNT);
+  assert_near(summary.variance, SAMPLE_COUNT * (SAMPLE_COUNT + 1.0) / 12, 0.02 * 1080000);
+  assert_near(summary.median, SAMPLE_COUNT / 2.0, 0.05 * SAMPLE_COUNT);
+  assert_near(summary.p95, SAMPLE_COUNT * 0.95, 0.05 * SAMPLE_COUNT);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_empty_and_small),
+    cmocka_unit_test(test_uniform),
+    cmocka_unit_test(test_merge_minutes_into_hour),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+#endif /** MYRIOTA_STATS_UNIT_TESTS */
@@ -0,0 +1,196 @@
+/// \file suppress.h Myriota Unchanged Message Suppression
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYRIOTA_SUPPRESS_H
+#define MYRIOTA_SUPPRESS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "flex_diag_conf.h"
+
+/** \defgroup Suppress Unchanged Message Suppression
+ * @brief Skip or shrink messages whose content has not changed
+ *
+ * Sensors on quiet sites report the same values for days, but each job still
+ * schedules a full message. MYRIOTA_SuppressSchedule() is used in place of
+ * FLEX_MessageSchedule() and compares each payload with the last one sent:
+ *
+ * - Bytes of the payload outside the `fields` must match exactly, which is
+ *   checked with a hash of the last sent payload.
+ * - Each of the `fields` must be within its `tolerance` of the value last
+ *   sent, so that noise on a reading does not count as a change.
+ *
+ * An unchanged payload is not sent, or is replaced by a heartbeat of
+ * `heartbeat_size` bytes. A full payload is sent at least every
+ * `max_silence_s` seconds, so the receiver can tell a quiet site from a
+ * silent one.
+ *
+ * \code
+ * static MYRIOTA_Suppressor suppressor;
+ * static const MYRIOTA_SuppressField fields[] = {
+ *   {offsetof(Message, level), MYRIOTA_SUPPRESS_UINT16, 5},
+ * };
+ * const MYRIOTA_SuppressOptions options = {
+ *   .fields = fields,
+ *   .field_count = 1,
+ *   .heartbeat_size = 1,
+ *   .max_silence_s = 24 * 3600,
+ * };
+ * MYRIOTA_SuppressInit(&suppressor, &options);
+ *
+ * MYRIOTA_SuppressSchedule(&suppressor, (const uint8_t *)&message, sizeof(message));
+ * \endcode
+ * \{
+ */
+
+/** The largest number of fields compared with a tolerance. */
+#ifndef MYRIOTA_SUPPRESS_FIELDS_MAX
+#define MYRIOTA_SUPPRESS_FIELDS_MAX 8
+#endif
+
+/** The largest heartbeat size. */
+#define MYRIOTA_SUPPRESS_HEARTBEAT_SIZE_MAX 2
+
+/** The `max_len` of the string diagnostic written by MYRIOTA_SuppressDiagWrite(). */
+#define MYRIOTA_SUPPRESS_DIAG_LEN 64
+
+/** The type of a field compared with a tolerance, stored little-endian. */
+typedef enum {
+  MYRIOTA_SUPPRESS_INT8,
+  MYRIOTA_SUPPRESS_UINT8,
+  MYRIOTA_SUPPRESS_INT16,
+  MYRIOTA_SUPPRESS_UINT16,
+  MYRIOTA_SUPPRESS_INT32,
+  MYRIOTA_SUPPRESS_UINT32,
+  MYRIOTA_SUPPRESS_FLOAT,
+} MYRIOTA_SuppressFieldType;
+
+/** A payload field that is unchanged while within a tolerance of the value last sent. */
+typedef struct {
+  /** The byte offset of the field in the payload. */
+  uint8_t offset;
+  /** The type of the field. */
+  MYRIOTA_SuppressFieldType type;
+  /** The largest difference from the value last sent that is unchanged. */
+  float tolerance;
+} MYRIOTA_SuppressField;
+
+/** The outcome of MYRIOTA_SuppressSchedule(). */
+typedef enum {
+  /** The payload was scheduled. */
+  MYRIOTA_SUPPRESS_SENT = 0,
+  /** The payload was unchanged and a heartbeat was scheduled instead. */
+  MYRIOTA_SUPPRESS_HEARTBEAT = 1,
+  /** The payload was unchanged and nothing was scheduled. */
+  MYRIOTA_SUPPRESS_SUPPRESSED = 2,
+} MYRIOTA_SuppressResult;
+
+/** Configuration of a suppressor. */
+typedef struct {
+  /** The fields compared with a tolerance, which may be NULL if `field_count`
+   * is 0. The array must remain valid while the suppressor is used. */
+  const MYRIOTA_SuppressField *fields;
+  /** The number of fields, at most MYRIOTA_SUPPRESS_FIELDS_MAX. */
+  uint8_t field_count;
+  /** The size of the heartbeat sent in place of an unchanged payload, up to
+   * MYRIOTA_SUPPRESS_HEARTBEAT_SIZE_MAX, or 0 to send nothing. The first byte
+   * is the number of unchanged payloads since the last one sent, saturating at
+   * 255, and the second byte is the low byte of the hash of that payload. Use
+   * payloads larger than the heartbeat so that the receiver can tell them apart. */
+  uint8_t heartbeat_size;
+  /** The longest time in seconds without sending a full payload, or 0 for no limit. */
+  uint32_t max_silence_s;
+} MYRIOTA_SuppressOptions;
+
+/** Statistics of a suppressor. */
+typedef struct {
+  /** The number of payloads scheduled. */
+  uint32_t sent_count;
+  /** The number of heartbeats scheduled in place of unchanged payloads. */
+  uint32_t heartbeat_count;
+  /** The number of unchanged payloads not scheduled. */
+  uint32_t suppressed_count;
+} MYRIOTA_SuppressStats;
+
+/** A suppressor. Treat the members as private. */
+typedef struct {
+  /** \cond INTERNAL_HIDDEN */
+  MYRIOTA_SuppressOptions options;
+  bool has_sent;
+  time_t sent_time;
+  uint32_t hash;
+  uint8_t unchanged_count;
+  union {
+    int64_t integer;
+    float real;
+  } values[MYRIOTA_SUPPRESS_FIELDS_MAX];
+  MYRIOTA_SuppressStats stats;
+  /** \endcond */
+} MYRIOTA_Suppressor;
+
+/**
+ * Initializes a suppressor, which sends the first payload.
+ *
+ * \param[out] suppressor The suppressor to initialize.
+ * \param[in] options The configuration of the suppressor.
+ */
+void MYRIOTA_SuppressInit(MYRIOTA_Suppressor *const suppressor,
+  const MYRIOTA_SuppressOptions *const options);
+
+/**
+ * Schedule a payload with FLEX_MessageSchedule() if it has changed since the
+ * last payload sent, or if `max_silence_s` has passed since then, else send a
+ * heartbeat or nothing.
+ *
+ * \param[in,out] suppressor The suppressor.
+ * \param[in] payload The payload, which must contain all the fields.
+ * \param[in] size The size of the payload.
+ * \return the MYRIOTA_SuppressResult on success, else < 0 on error.
+ * \retval -FLEX_ERROR_EINVAL: a field is outside the payload.
+ * Errors of FLEX_MessageSchedule() are returned, in which case the payload is
+ * compared with the last payload that was sent the next time.
+ */
+int MYRIOTA_SuppressSchedule(MYRIOTA_Suppressor *const suppressor, const uint8_t *const payload,
+  const size_t size);
+
+/**
+ * Get the statistics of a suppressor.
+ *
+ * \param[in] suppressor The suppressor.
+ * \param[out] stats The statistics.
+ */
+void MYRIOTA_SuppressStatsGet(const MYRIOTA_Suppressor *const suppressor,
+  MYRIOTA_SuppressStats *const stats);
+
+/**
+ * Write the statistics of a suppressor to a string diagnostic, e.g.
+ * "sent 12 heartbeat 30 suppressed 0", with FLEX_DiagConfValueWrite().
+ *
+ * The diagnostic must be added with FLEX_DIAG_CONF_TABLE_STR_ADD() and a
+ * `max_len` of MYRIOTA_SUPPRESS_DIAG_LEN.
+ *
+ * \param[in] suppressor The suppressor.
+ * \param[in] id The id of the diagnostic.
+ * \return FLEX_SUCCESS (0) if succeeded and < 0 if FLEX_DiagConfValueWrite() failed.
+ */
+int MYRIOTA_SuppressDiagWrite(const MYRIOTA_Suppressor *const suppressor,
+  const FLEX_DiagConfID id);
+
+/**
+ * \}
+ */
+
+#endif /* MYRIOTA_SUPPRESS_H */
@@ -0,0 +1,341 @@
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myriota/suppress.h"
+#include <stdio.h>
+#include <string.h>
+#include "flex.h"
+#include "flex_errors.h"
+
+// NOTE: you can provide your own assert
+#ifndef SUPPRESS_ASSERT
+#define SUPPRESS_ASSERT(cond)                        \
+  do {                                               \
+    if (!(cond)) {                                   \
+      printf("Assert @%s:%d\n", __FILE__, __LINE__); \
+      while (1) {                                    \
+      }                                              \
+    }                                                \
+  } while (0)
+#endif
+
+#define SUPPRESS_FNV_OFFSET 2166136261U
+#define SUPPRESS_FNV_PRIME 16777619U
+
+static const uint8_t suppress_field_sizes[] = {
+  [MYRIOTA_SUPPRESS_INT8] = 1,
+  [MYRIOTA_SUPPRESS_UINT8] = 1,
+  [MYRIOTA_SUPPRESS_INT16] = 2,
+  [MYRIOTA_SUPPRESS_UINT16] = 2,
+  [MYRIOTA_SUPPRESS_INT32] = 4,
+  [MYRIOTA_SUPPRESS_UINT32] = 4,
+  [MYRIOTA_SUPPRESS_FLOAT] = 4,
+};
+
+static bool suppress_is_field_byte(const MYRIOTA_Suppressor *const suppressor,
+  const size_t index) {
+  for (uint8_t i = 0; i < suppressor->options.field_count; ++i) {
+    const MYRIOTA_SuppressField *const field = &suppressor->options.fields[i];
+    if (index >= field->offset && index < field->offset + suppress_field_sizes[field->type]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// FNV-1a hash of the size and the bytes of a payload that are not fields.
+static uint32_t suppress_hash(const MYRIOTA_Suppressor *const suppressor,
+  const uint8_t *const payload, const size_t size) {
+  uint32_t hash = (SUPPRESS_FNV_OFFSET ^ (uint32_t)size) * SUPPRESS_FNV_PRIME;
+  for (size_t i = 0; i < size; ++i) {
+    if (!suppress_is_field_byte(suppressor, i)) {
+      hash = (hash ^ payload[i]) * SUPPRESS_FNV_PRIME;
+    }
+  }
+  return hash;
+}
+
+// Reads a little-endian field of a payload as an integer, or a real for a float field.
+static void suppress_field_read(const MYRIOTA_Suppressor *const suppressor, const uint8_t index,
+  const uint8_t *const payload, int64_t *const integer, float *const real) {
+  const MYRIOTA_SuppressField *const field = &suppressor->options.fields[index];
+  uint32_t raw = 0;
+  for (uint8_t i = 0; i < suppress_field_sizes[field->type]; ++i) {
+    raw |= (uint32_t)payload[field->offset + i] << (8 * i);
+  }
+  switch (field->type) {
+    case MYRIOTA_SUPPRESS_INT8:
+      *integer = (int8_t)raw;
+      break;
+    case MYRIOTA_SUPPRESS_INT16:
+      *integer = (int16_t)raw;
+      break;
+    case MYRIOTA_SUPPRESS_INT32:
+      *integer = (int32_t)raw;
+      break;
+    case MYRIOTA_SUPPRESS_FLOAT:
+      memcpy(real, &raw, sizeof(*real));
+      break;
+    default:
+      *integer = raw;
+      break;
+  }
+}
+
+static bool suppress_is_unchanged(const MYRIOTA_Suppressor *const suppressor,
+  const uint32_t hash, const uint8_t *const payload) {
+  if (!suppressor->has_sent || hash != suppressor->hash) {
+    return false;
+  }
+  for (uint8_t i = 0; i < suppressor->options.field_count; ++i) {
+    const float tolerance = suppressor->options.fields[i].tolerance;
+    int64_t integer = 0;
+    float real = 0;
+    suppress_field_read(suppressor, i, payload, &integer, &real);
+    if (suppressor->options.fields[i].type == MYRIOTA_SUPPRESS_FLOAT) {
+      // A NaN compares as changed.
+      const float difference = real - suppressor->values[i].real;
+      if (!(difference <= tolerance && -difference <= tolerance)) {
+        return false;
+      }
+    } else {
+      const int64_t difference = integer - suppressor->values[i].integer;
+      if ((float)((difference < 0) ? -difference : difference) > tolerance) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void MYRIOTA_SuppressInit(MYRIOTA_Suppressor *const suppressor,
+  const MYRIOTA_SuppressOptions *const options) {
+  SUPPRESS_ASSERT(suppressor != NULL);
+  SUPPRESS_ASSERT(options != NULL);
+  SUPPRESS_ASSERT(options->field_count <= MYRIOTA_SUPPRESS_FIELDS_MAX);
+  SUPPRESS_ASSERT(options->field_count == 0 || options->fields != NULL);
+  SUPPRESS_ASSERT(options->heartbeat_size <= MYRIOTA_SUPPRESS_HEARTBEAT_SIZE_MAX);
+  memset(suppressor, 0, sizeof(*suppressor));
+  suppressor->options = *options;
+}
+
+int MYRIOTA_SuppressSchedule(MYRIOTA_Suppressor *const suppressor, const uint8_t *const payload,
+  const size_t size) {
+  SUPPRESS_ASSERT(suppressor != NULL);
+  SUPPRESS_ASSERT(payload != NULL);
+  for (uint8_t i = 0; i < suppressor->options.field_count; ++i) {
+    const MYRIOTA_SuppressField *const field = &suppressor->options.fields[i];
+    if (field->offset + suppress_field_sizes[field->type] > size) {
+      return -FLEX_ERROR_EINVAL;
+    }
+  }
+
+  const time_t now = FLEX_TimeGet();
+  const uint32_t hash = suppress_hash(suppressor, payload, size);
+  const uint32_t max_silence_s = suppressor->options.max_silence_s;
+  const bool is_silent_too_long =
+    max_silence_s != 0 && now - suppressor->sent_time >= (time_t)max_silence_s;
+  if (!is_silent_too_long && suppress_is_unchanged(suppressor, hash, payload)) {
+    const bool is_counted = suppressor->unchanged_count < UINT8_MAX;
+    if (is_counted) {
+      ++suppressor->unchanged_count;
+    }
+    if (suppressor->options.heartbeat_size == 0) {
+      ++suppressor->stats.suppressed_count;
+      return MYRIOTA_SUPPRESS_SUPPRESSED;
+    }
+    const uint8_t heartbeat[MYRIOTA_SUPPRESS_HEARTBEAT_SIZE_MAX] = {
+      suppressor->unchanged_count,
+      (uint8_t)suppressor->hash,
+    };
+    const int result = FLEX_MessageSchedule(heartbeat, suppressor->options.heartbeat_size);
+    if (result < 0) {
+      if (is_counted) {
+        --suppressor->unchanged_count;
+      }
+      return result;
+    }
+    ++suppressor->stats.heartbeat_count;
+    return MYRIOTA_SUPPRESS_HEARTBEAT;
+  }
+
+  const int result = FLEX_MessageSchedule(payload, size);
+  if (result < 0) {
+    return result;
+  }
+  suppressor->has_sent = true;
+  suppressor->sent_time = now;
+  suppressor->hash = hash;
+  suppressor->unchanged_count = 0;
+  for (uint8_t i = 0; i < suppressor->options.field_count; ++i) {
+    suppress_field_read(suppressor, i, payload, &suppressor->values[i].integer,
+      &suppressor->values[i].real);
+  }
+  ++suppressor->stats.sent_count;
+  return MYRIOTA_SUPPRESS_SENT;
+}
+
+void MYRIOTA_SuppressStatsGet(const MYRIOTA_Suppressor *const suppressor,
+  MYRIOTA_SuppressStats *const stats) {
+  SUPPRESS_ASSERT(suppressor != NULL);
+  SUPPRESS_ASSERT(stats != NULL);
+  *stats = suppressor->stats;
+}
+
+int MYRIOTA_SuppressDiagWrite(const MYRIOTA_Suppressor *const suppressor,
+  const FLEX_DiagConfID id) {
+  SUPPRESS_ASSERT(suppressor != NULL);
+  char text[MYRIOTA_SUPPRESS_DIAG_LEN];
+  snprintf(text, sizeof(text), "sent %lu heartbeat %lu suppressed %lu",
+    (unsigned long)suppressor->stats.sent_count,
+    (unsigned long)suppressor->stats.heartbeat_count,
+    (unsigned long)suppressor->stats.suppressed_count);
+  return FLEX_DiagConfValueWrite(id, text);
+}
+
+#ifdef MYRIOTA_SUPPRESS_UNIT_TESTS
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+/*
+ * `cmocka.h` must be included after standard the above library headers.
+ * NOTE: This comment has dual purpose:
+ * 1. Document the ordering requirement.
+ * 2. Prevent `clang-format` from reordering the headers.
+ */
+#include <cmocka.h>
+#include "myriota/flex_fake.h"
+
+// A status byte, then a little-endian int16 level and a float temperature.
+static const MYRIOTA_SuppressField test_fields[] = {
+  {1, MYRIOTA_SUPPRESS_INT16, 5},
+  {3, MYRIOTA_SUPPRESS_FLOAT, 0.5f},
+};
+
+static void test_payload(uint8_t *const payload, const uint8_t status, const int16_t level,
+  const float temperature) {
+  payload[0] = status;
+  payload[1] = (uint16_t)level & 0xFF;
+  payload[2] = (uint16_t)level >> 8;
+  memcpy(&payload[3], &temperature, sizeof(temperature));
+}
+
+static void test_tolerance(void **state) {
+  (void)state;
+  MYRIOTA_FlexFakeReset();
+  MYRIOTA_Suppressor suppressor;
+  const MYRIOTA_SuppressOptions options = {.fields = test_fields, .field_count = 2};
+  MYRIOTA_SuppressInit(&suppressor, &options);
+
+  uint8_t payload[7];
+  test_payload(payload, 1, -100, 20.0f);
+  assert_int_equal(MYRIOTA_SuppressSchedule(&suppressor, payload, 7), MYRIOTA_SUPPRESS_SENT);
+  assert_int_equal(flex_fake.message_sizes[0], 7);
+  assert_memory_equal(flex_fake.messages[0], payload, 7);
+
+  // Within the tolerances of the values sent, so no drift is accumulated.
+  test_payload(payload, 1, -96, 20.4f);
+  assert_int_equal(MYRIOTA_SuppressSchedule(&suppressor, payload, 7),
+    MYRIOTA_SUPPRESS_SUPPRESSED);
+  test_payload(payload, 1, -105, 19.6f);
+  assert_int_equal(MYRIOTA_SuppressSchedule(&suppressor, payload, 7),
+    MYRIOTA_SUPPRESS_SUPPRESSED);
+  assert_int_equal(flex_fake.message_count, 1);
+
+  test_payload(payload, 1, -94, 20.0f);
+  assert_int_equal(MYRIOTA_SuppressSchedule(&suppressor, payload, 7), MYRIOTA_SUPPRESS_SENT);
+  test_payload(payload, 1, -94, 20.6f);
+  assert_int_equal(MYRIOTA_SuppressSchedule(&suppressor, payload, 7), MYRIOTA_SUPPRESS_SENT);
+  test_payload(payload, 2, -94, 20.6f);
+  assert_int_equal(MYRIOTA_SuppressSchedule(&suppressor, payload, 7), MYRIOTA_SUPPRESS_SENT);
+  assert_int_equal(MYRIOTA_SuppressSchedule(&suppressor, payload, 6), -FLEX_ERROR_EINVAL);
+  assert_int_equal(flex_fake.message_count, 4);
+
+  MYRIOTA_SuppressStats stats;
+  MYRIOTA_SuppressStatsGet(&suppressor, &stats);
+  assert_int_equal(stats.sent_count, 4);
+  assert_int_equal(stats.suppressed_count, 2);
+  assert_int_equal(MYRIOTA_SuppressDiagWrite(&suppressor, FLEX_DIAG_CONF_ID_USER_3), 0);
+  assert_int_equal(flex_fake.diag_id, FLEX_DIAG_CONF_ID_USER_3);
+  assert_string_equal(flex_fake.diag, "sent 4 heartbeat 0 suppressed 2");
+}
+
+static void test_heartbeat(void **state) {
+  (void)state;
+  MYRIOTA_FlexFakeReset();
+  MYRIOTA_Suppressor suppressor;
+  const MYRIOTA_SuppressOptions options = {.heartbeat_size = 2, .max_silence_s = 3600};
+  MYRIOTA_SuppressInit(&suppressor, &options);
+
+  const uint8_t payload[] = {1, 2, 3, 4};
+  assert_int_equal(MYRIOTA_SuppressSchedule(&suppressor, payload, 4), MYRIOTA_SUPPRESS_SENT);
+  flex_fake.time = 1800;
+  assert_int_equal(MYRIOTA_SuppressSchedule(&suppressor, payload, 4),
+    MYRIOTA_SUPPRESS_HEARTBEAT);
+  assert_int_equal(flex_fake.message_sizes[1], 2);
+  assert_int_equal(flex_fake.messages[1][0], 1);
+  assert_int_equal(flex_fake.messages[1][1], (uint8_t)suppressor.hash);
+
+  // A failed heartbeat is not counted.
+  flex_fake.message_result = -FLEX_ERROR_ENOSPC;
+  assert_int_equal(MYRIOTA_SuppressSchedule(&suppressor, payload, 4), -FLEX_ERROR_ENOSPC);
+  flex_fake.message_result = 0;
+  assert_int_equal(MYRIOTA_SuppressSchedule(&suppressor, payload, 4),
+    MYRIOTA_SUPPRESS_HEARTBEAT);
+  assert_int_equal(flex_fake.messages[2][0], 2);
+
+  // The payload is sent again after the maximum silence.
+  flex_fake.time = 3600;
+  assert_int_equal(MYRIOTA_SuppressSchedule(&suppressor, payload, 4), MYRIOTA_SUPPRESS_SENT);
+  assert_int_equal(flex_fake.message_sizes[3], 4);
+  flex_fake.time = 3601;
+  assert_int_equal(MYRIOTA_SuppressSchedule(&suppressor, payload, 4),
+    MYRIOTA_SUPPRESS_HEARTBEAT);
+  assert_int_equal(flex_fake.messages[4][0], 1);
+}
+
+static void test_heartbeat_saturation(void **state) {
+  (void)state;
+  MYRIOTA_FlexFakeReset();
+  MYRIOTA_Suppressor suppressor;
+  const MYRIOTA_SuppressOptions options = {.heartbeat_size = 2};
+  MYRIOTA_SuppressInit(&suppressor, &options);
+
+  const uint8_t payload[] = {1, 2, 3, 4};
+  assert_int_equal(MYRIOTA_SuppressSchedule(&suppressor, payload, 4), MYRIOTA_SUPPRESS_SENT);
+  suppressor.unchanged_count = UINT8_MAX - 1;
+  assert_int_equal(MYRIOTA_SuppressSchedule(&suppressor, payload, 4),
+    MYRIOTA_SUPPRESS_HEARTBEAT);
+  assert_int_equal(flex_fake.messages[1][0], UINT8_MAX);
+
+  // The count stays saturated, including after a failed heartbeat.
+  flex_fake.message_result = -FLEX_ERROR_ENOSPC;
+  assert_int_equal(MYRIOTA_SuppressSchedule(&suppressor, payload, 4), -FLEX_ERROR_ENOSPC);
+  assert_int_equal(suppressor.unchanged_count, UINT8_MAX);
+  flex_fake.message_result = 0;
+  assert_int_equal(MYRIOTA_SuppressSchedule(&suppressor, payload, 4),
+    MYRIOTA_SUPPRESS_HEARTBEAT);
+  assert_int_equal(flex_fake.messages[2][0], UINT8_MAX);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_tolerance),
+    cmocka_unit_test(test_heartbeat),
+    cmocka_unit_test(test_heartbeat_saturation),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+#endif /** MYRIOTA_SUPPRESS_UNIT_TESTS */
@@ -0,0 +1,168 @@
+/// \file timerwheel.h Myriota Timer Wheel
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYRIOTA_TIMERWHEEL_H
+#define MYRIOTA_TIMERWHEEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include "flex.h"
+
+/** \defgroup TimerWheel Timer Wheel
+ * @brief Run any number of virtual jobs from a single FlexSense job
+ *
+ * FLEX_JobSchedule() fails with -FLEX_ERROR_ENOMEM once the maximum number of
+ * jobs is reached. A timer wheel runs any number of virtual jobs, such as
+ * per-sensor polls, watchdog checks and summary rollups, from one FlexSense
+ * job that is scheduled for the earliest virtual job, so the device wakes no
+ * more often than the virtual jobs need.
+ *
+ * Virtual jobs are allocated by the application, so there is no limit on
+ * their number, and are kept in a hierarchical timer wheel of 4 levels of 32
+ * slots at a resolution of one second. Scheduling and cancelling a virtual
+ * job takes constant time. Virtual jobs more than about 12 days away are kept
+ * in an overflow list until they come within range.
+ *
+ * \code
+ * static MYRIOTA_TimerWheel wheel;
+ * static MYRIOTA_TimerWheelJob sensor_jobs[SENSOR_COUNT];
+ *
+ * static time_t wheel_job(void) {
+ *   return MYRIOTA_TimerWheelPoll(&wheel);
+ * }
+ *
+ * static time_t sensor_poll(void *const context) {
+ *   const Sensor *const sensor = context;
+ *   ...
+ *   return FLEX_SecondsFromNow(sensor->period_s);
+ * }
+ *
+ * void FLEX_AppInit() {
+ *   MYRIOTA_TimerWheelInit(&wheel, wheel_job);
+ *   for (int i = 0; i < SENSOR_COUNT; ++i) {
+ *     MYRIOTA_TimerWheelJobInit(&sensor_jobs[i], sensor_poll, &sensors[i]);
+ *     MYRIOTA_TimerWheelSchedule(&wheel, &sensor_jobs[i], FLEX_ASAP());
+ *   }
+ * }
+ * \endcode
+ * \{
+ */
+
+/** The number of levels of the wheel. */
+#define MYRIOTA_TIMERWHEEL_LEVELS 4
+
+/** The number of slots per level, and the ratio of the resolutions of consecutive levels. */
+#define MYRIOTA_TIMERWHEEL_SLOTS 32
+
+/**
+ * A virtual job function, called by MYRIOTA_TimerWheelPoll().
+ *
+ * \param[in] context The context given to MYRIOTA_TimerWheelJobInit().
+ * \return the time at which the job should next run, or FLEX_Never() to stop it,
+ * which replaces any time the function scheduled its own job for.
+ */
+typedef time_t (*MYRIOTA_TimerWheelHandler)(void *const context);
+
+/** A virtual job. Treat the members as private. */
+typedef struct MYRIOTA_TimerWheelJob {
+  /** \cond INTERNAL_HIDDEN */
+  struct MYRIOTA_TimerWheelJob *next;
+  struct MYRIOTA_TimerWheelJob **pprev;
+  time_t time;
+  uint8_t slot;
+  MYRIOTA_TimerWheelHandler handler;
+  void *context;
+  /** \endcond */
+} MYRIOTA_TimerWheelJob;
+
+/** A timer wheel. Treat the members as private. */
+typedef struct {
+  /** \cond INTERNAL_HIDDEN */
+  FLEX_ScheduledJob job;
+  bool is_polling;
+  bool is_scheduled;
+  time_t scheduled;
+  time_t current;
+  uint32_t occupied[MYRIOTA_TIMERWHEEL_LEVELS];
+  MYRIOTA_TimerWheelJob *slots[MYRIOTA_TIMERWHEEL_LEVELS][MYRIOTA_TIMERWHEEL_SLOTS];
+  MYRIOTA_TimerWheelJob *overflow;
+  MYRIOTA_TimerWheelJob *due;
+  /** \endcond */
+} MYRIOTA_TimerWheel;
+
+/**
+ * Initializes an empty timer wheel.
+ *
+ * \param[out] wheel The wheel to initialize.
+ * \param[in] job The FlexSense job that returns MYRIOTA_TimerWheelPoll() of
+ * this wheel, which the wheel schedules with FLEX_JobSchedule().
+ */
+void MYRIOTA_TimerWheelInit(MYRIOTA_TimerWheel *const wheel, const FLEX_ScheduledJob job);
+
+/**
+ * Initializes a virtual job, which is not scheduled.
+ *
+ * \param[out] job The virtual job to initialize.
+ * \param[in] handler The function to run.
+ * \param[in] context The argument of the function.
+ */
+void MYRIOTA_TimerWheelJobInit(MYRIOTA_TimerWheelJob *const job,
+  const MYRIOTA_TimerWheelHandler handler, void *const context);
+
+/**
+ * Schedule or reschedule a virtual job, and the FlexSense job of the wheel if
+ * the virtual job is due before it.
+ *
+ * \param[in,out] wheel The wheel.
+ * \param[in,out] job The virtual job, which must stay valid while scheduled.
+ * \param[in] time The time to run the job, where a time that has passed runs
+ * it as soon as possible, or FLEX_Never() to cancel it.
+ * \return FLEX_SUCCESS (0) if succeeded and < 0 if FLEX_JobSchedule() failed,
+ * in which case the virtual job is still scheduled and runs the next time the
+ * wheel is polled.
+ */
+int MYRIOTA_TimerWheelSchedule(MYRIOTA_TimerWheel *const wheel,
+  MYRIOTA_TimerWheelJob *const job, const time_t time);
+
+/**
+ * Cancel a virtual job if it is scheduled.
+ *
+ * \param[in,out] wheel The wheel.
+ * \param[in,out] job The virtual job.
+ */
+void MYRIOTA_TimerWheelCancel(MYRIOTA_TimerWheel *const wheel, MYRIOTA_TimerWheelJob *const job);
+
+/**
+ * Returns true if a virtual job is scheduled.
+ *
+ * \param[in] job The virtual job.
+ */
+bool MYRIOTA_TimerWheelIsScheduled(const MYRIOTA_TimerWheelJob *const job);
+
+/**
+ * Run the virtual jobs that are due, from the FlexSense job of the wheel.
+ *
+ * Virtual jobs may schedule and cancel any virtual job of the wheel.
+ *
+ * \param[in,out] wheel The wheel.
+ * \return the time of the earliest virtual job, or FLEX_Never() if there are none.
+ */
+time_t MYRIOTA_TimerWheelPoll(MYRIOTA_TimerWheel *const wheel);
+
+/**
+ * \}
+ */
+
+#endif /* MYRIOTA_TIMERWHEEL_H */
@@ -0,0 +1,552 @@
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myriota/timerwheel.h"
+#include <string.h>
+#include "flex_errors.h"
+
+// NOTE: you can provide your own assert
+#ifndef TIMERWHEEL_ASSERT
+#include <stdio.h>
+#define TIMERWHEEL_ASSERT(cond)                      \
+  do {                                               \
+    if (!(cond)) {                                   \
+      printf("Assert @%s:%d\n", __FILE__, __LINE__); \
+      while (1) {                                    \
+      }                                              \
+    }                                                \
+  } while (0)
+#endif
+
+#define TIMERWHEEL_SLOT_BITS 5
+// The slot of a job in the due or overflow list.
+#define TIMERWHEEL_SLOT_NONE 0xFF
+
+_Static_assert(MYRIOTA_TIMERWHEEL_SLOTS == 1 << TIMERWHEEL_SLOT_BITS,
+  "MYRIOTA_TIMERWHEEL_SLOTS must match TIMERWHEEL_SLOT_BITS");
+
+// The index of a time at a level, which counts units of 32^level seconds.
+static inline uint64_t timerwheel_tick(const time_t time, const uint8_t level) {
+  return (uint64_t)time >> (TIMERWHEEL_SLOT_BITS * level);
+}
+
+static void timerwheel_link(MYRIOTA_TimerWheelJob **const head, MYRIOTA_TimerWheelJob *const job,
+  const uint8_t slot) {
+  job->next = *head;
+  if (job->next != NULL) {
+    job->next->pprev = &job->next;
+  }
+  job->pprev = head;
+  job->slot = slot;
+  *head = job;
+}
+
+static void timerwheel_unlink(MYRIOTA_TimerWheel *const wheel, MYRIOTA_TimerWheelJob *const job) {
+  *job->pprev = job->next;
+  if (job->next != NULL) {
+    job->next->pprev = job->pprev;
+  }
+  job->next = NULL;
+  job->pprev = NULL;
+  if (job->slot != TIMERWHEEL_SLOT_NONE) {
+    const uint8_t level = job->slot / MYRIOTA_TIMERWHEEL_SLOTS;
+    const uint8_t index = job->slot % MYRIOTA_TIMERWHEEL_SLOTS;
+    if (wheel->slots[level][index] == NULL) {
+      wheel->occupied[level] &= ~(1UL << index);
+    }
+  }
+}
+
+// Adds a job to the lowest level whose slots reach its time from the current
+// time, so that it is at most 31 slots ahead, or to the due list if it is due.
+static void timerwheel_insert(MYRIOTA_TimerWheel *const wheel, MYRIOTA_TimerWheelJob *const job) {
+  if (job->time <= wheel->current) {
+    timerwheel_link(&wheel->due, job, TIMERWHEEL_SLOT_NONE);
+    return;
+  }
+  for (uint8_t level = 0; level < MYRIOTA_TIMERWHEEL_LEVELS; ++level) {
+    const uint64_t tick = timerwheel_tick(job->time, level);
+    if (tick - timerwheel_tick(wheel->current, level) < MYRIOTA_TIMERWHEEL_SLOTS) {
+      const uint8_t index = tick % MYRIOTA_TIMERWHEEL_SLOTS;
+      timerwheel_link(&wheel->slots[level][index], job,
+        level * MYRIOTA_TIMERWHEEL_SLOTS + index);
+      wheel->occupied[level] |= 1UL << index;
+      return;
+    }
+  }
+  timerwheel_link(&wheel->overflow, job, TIMERWHEEL_SLOT_NONE);
+}
+
+// Reinserts the jobs of a list relative to the current time.
+static void timerwheel_cascade(MYRIOTA_TimerWheel *const wheel, MYRIOTA_TimerWheelJob **const head,
+  const uint8_t slot) {
+  MYRIOTA_TimerWheelJob *job = *head;
+  *head = NULL;
+  if (slot != TIMERWHEEL_SLOT_NONE) {
+    const uint8_t index = slot % MYRIOTA_TIMERWHEEL_SLOTS;
+    wheel->occupied[slot / MYRIOTA_TIMERWHEEL_SLOTS] &= ~(1UL << index);
+  }
+  while (job != NULL) {
+    MYRIOTA_TimerWheelJob *const next = job->next;
+    timerwheel_insert(wheel, job);
+    job = next;
+  }
+}
+
+// Moves the current time to `now`, cascading every slot whose time has come
+// from the highest level down, so that due jobs end up in the due list.
+static void timerwheel_advance(MYRIOTA_TimerWheel *const wheel, const time_t now) {
+  const time_t previous = wheel->current;
+  wheel->current = now;
+  for (int level = MYRIOTA_TIMERWHEEL_LEVELS - 1; level >= 0; --level) {
+    const uint64_t first = timerwheel_tick(previous, level);
+    for (uint64_t tick = first; tick < first + MYRIOTA_TIMERWHEEL_SLOTS; ++tick) {
+      // The start of the slot, which is a later time if the tick wrapped.
+      if ((time_t)(tick << (TIMERWHEEL_SLOT_BITS * level)) > now) {
+        break;
+      }
+      const uint8_t index = tick % MYRIOTA_TIMERWHEEL_SLOTS;
+      if (wheel->occupied[level] & (1UL << index)) {
+        timerwheel_cascade(wheel, &wheel->slots[level][index],
+          level * MYRIOTA_TIMERWHEEL_SLOTS + index);
+      }
+    }
+  }
+  if (wheel->overflow != NULL && now != previous) {
+    timerwheel_cascade(wheel, &wheel->overflow, TIMERWHEEL_SLOT_NONE);
+  }
+}
+
+static time_t timerwheel_list_earliest(const MYRIOTA_TimerWheelJob *job) {
+  time_t earliest = job->time;
+  for (job = job->next; job != NULL; job = job->next) {
+    earliest = (job->time < earliest) ? job->time : earliest;
+  }
+  return earliest;
+}
+
+// Finds the time of the earliest job, which is in the first occupied slot
+// after the current time of one of the levels, or in the overflow list.
+static bool timerwheel_earliest(const MYRIOTA_TimerWheel *const wheel, time_t *const earliest) {
+  if (wheel->due != NULL) {
+    *earliest = wheel->current;
+    return true;
+  }
+  bool found = false;
+  for (uint8_t level = 0; level < MYRIOTA_TIMERWHEEL_LEVELS; ++level) {
+    const uint32_t occupied = wheel->occupied[level];
+    if (occupied == 0) {
+      continue;
+    }
+    const uint64_t tick = timerwheel_tick(wheel->current, level);
+    const uint8_t shift = tick % MYRIOTA_TIMERWHEEL_SLOTS;
+    const uint32_t rotated = (shift == 0) ? occupied : (occupied >> shift) |
+                                                         (occupied << (32 - shift));
+    const uint8_t index = (shift + __builtin_ctz(rotated)) % MYRIOTA_TIMERWHEEL_SLOTS;
+    const time_t time = timerwheel_list_earliest(wheel->slots[level][index]);
+    if (!found || time < *earliest) {
+      *earliest = time;
+      found = true;
+    }
+  }
+  if (wheel->overflow != NULL) {
+    const time_t time = timerwheel_list_earliest(wheel->overflow);
+    if (!found || time < *earliest) {
+      *earliest = time;
+      found = true;
+    }
+  }
+  return found;
+}
+
+void MYRIOTA_TimerWheelInit(MYRIOTA_TimerWheel *const wheel, const FLEX_ScheduledJob job) {
+  TIMERWHEEL_ASSERT(wheel != NULL);
+  TIMERWHEEL_ASSERT(job != NULL);
+  memset(wheel, 0, sizeof(*wheel));
+  wheel->job = job;
+  wheel->current = FLEX_TimeGet();
+}
+
+void MYRIOTA_TimerWheelJobInit(MYRIOTA_TimerWheelJob *const job,
+  const MYRIOTA_TimerWheelHandler handler, void *const context) {
+  TIMERWHEEL_ASSERT(job != NULL);
+  TIMERWHEEL_ASSERT(handler != NULL);
+  memset(job, 0, sizeof(*job));
+  job->handler = handler;
+  job->context = context;
+}
+
+int MYRIOTA_TimerWheelSchedule(MYRIOTA_TimerWheel *const wheel,
+  MYRIOTA_TimerWheelJob *const job, const time_t time) {
+  TIMERWHEEL_ASSERT(wheel != NULL);
+  TIMERWHEEL_ASSERT(job != NULL);
+  MYRIOTA_TimerWheelCancel(wheel, job);
+  if (time == FLEX_Never()) {
+    return FLEX_SUCCESS;
+  }
+  job->time = time;
+  timerwheel_insert(wheel, job);
+
+  // MYRIOTA_TimerWheelPoll() returns the earliest time when it finishes.
+  const time_t run_time = (time > wheel->current) ? time : wheel->current;
+  if (wheel->is_polling || (wheel->is_scheduled && wheel->scheduled <= run_time)) {
+    return FLEX_SUCCESS;
+  }
+  const int result = FLEX_JobSchedule(wheel->job, run_time);
+  if (result < 0) {
+    return result;
+  }
+  wheel->is_scheduled = true;
+  wheel->scheduled = run_time;
+  return FLEX_SUCCESS;
+}
+
+void MYRIOTA_TimerWheelCancel(MYRIOTA_TimerWheel *const wheel, MYRIOTA_TimerWheelJob *const job) {
+  TIMERWHEEL_ASSERT(wheel != NULL);
+  TIMERWHEEL_ASSERT(job != NULL);
+  // The FlexSense job is left scheduled, as running it early is harmless.
+  if (job->pprev != NULL) {
+    timerwheel_unlink(wheel, job);
+  }
+}
+
+bool MYRIOTA_TimerWheelIsScheduled(const MYRIOTA_TimerWheelJob *const job) {
+  TIMERWHEEL_ASSERT(job != NULL);
+  return job->pprev != NULL;
+}
+
+time_t MYRIOTA_TimerWheelPoll(MYRIOTA_TimerWheel *const wheel) {
+  TIMERWHEEL_ASSERT(wheel != NULL);
+  const time_t now = FLEX_TimeGet();
+  wheel->is_polling = true;
+  if (now > wheel->current) {
+    timerwheel_advance(wheel, now);
+  }
+
+  // Jobs scheduled again for a time that has passed run in the next poll.
+  MYRIOTA_TimerWheelJob *due = wheel->due;
+  wheel->due = NULL;
+  if (due != NULL) {
+    due->pprev = &due;
+  }
+  while (due != NULL) {
+    MYRIOTA_TimerWheelJob *const job = due;
+    timerwheel_unlink(wheel, job);
+    const time_t time = job->handler(job->context);
+    MYRIOTA_TimerWheelSchedule(wheel, job, time);
+  }
+  wheel->is_polling = false;
+
+  wheel->is_scheduled = timerwheel_earliest(wheel, &wheel->scheduled);
+  return wheel->is_scheduled ? wheel->scheduled : FLEX_Never();
+}
+
+#ifdef MYRIOTA_TIMERWHEEL_UNIT_TESTS
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+/*
+ * `cmocka.h` must be included after standard the above library headers.
+ * NOTE: This comment has dual purpose:
+ * 1. Document the ordering requirement.
+ * 2. Prevent `clang-format` from reordering the headers.
+ */
+#include <cmocka.h>
+#include "myriota/flex_fake.h"
+
+static MYRIOTA_TimerWheel wheel;
+
+static time_t wheel_job(void) {
+  return MYRIOTA_TimerWheelPoll(&wheel);
+}
+
+typedef struct {
+  MYRIOTA_TimerWheelJob job;
+  time_t period;
+  time_t next;
+  int run_count;
+} TestTask;
+
+static time_t test_task_run(void *const context) {
+  TestTask *const task = context;
+  assert_int_equal(flex_fake.time, task->next);
+  ++task->run_count;
+  task->next += task->period;
+  return task->next;
+}
+
+// Runs the FlexSense job at the times it returns until `end`, returning the number of runs.
+static int run_until(const time_t end) {
+  int runs = 0;
+  time_t next = flex_fake.job_time;
+  while (next != FLEX_Never() && next <= end) {
+    flex_fake.time = next;
+    next = wheel_job();
+    ++runs;
+  }
+  flex_fake.time = end;
+  return runs;
+}
+
+static void test_periodic_jobs(void **state) {
+  (void)state;
+  MYRIOTA_FlexFakeReset();
+  flex_fake.time = 1700000000;
+  MYRIOTA_TimerWheelInit(&wheel, wheel_job);
+
+  // Periods from a second to beyond the range of the wheel.
+  static const time_t periods[] = {1, 7, 31, 32, 33, 1000, 1025, 3600, 86400, 1500000};
+  enum { COUNT = sizeof(periods) / sizeof(periods[0]) };
+  static TestTask tasks[COUNT];
+  for (int i = 0; i < COUNT; ++i) {
+    tasks[i] = (TestTask){.period = periods[i], .next = flex_fake.time + periods[i] + i};
+    MYRIOTA_TimerWheelJobInit(&tasks[i].job, test_task_run, &tasks[i]);
+    assert_int_equal(MYRIOTA_TimerWheelSchedule(&wheel, &tasks[i].job, tasks[i].next), 0);
+  }
+  assert_ptr_equal(flex_fake.job, wheel_job);
+  assert_int_equal(flex_fake.job_time, flex_fake.time + 1);
+
+  const time_t start = flex_fake.time;
+  const time_t duration = 40 * 86400;
+  run_until(start + duration);
+  for (int i = 0; i < COUNT; ++i) {
+    assert_int_equal(tasks[i].run_count, (duration - i) / periods[i]);
+  }
+}
+
+static void test_wakes_only_when_due(void **state) {
+  (void)state;
+  MYRIOTA_FlexFakeReset();
+  flex_fake.time = 1000;
+  MYRIOTA_TimerWheelInit(&wheel, wheel_job);
+
+  TestTask hourly = {.period = 3600, .next = 1000 + 3600};
+  TestTask daily = {.period = 86400, .next = 1000 + 86400};
+  MYRIOTA_TimerWheelJobInit(&hourly.job, test_task_run, &hourly);
+  MYRIOTA_TimerWheelJobInit(&daily.job, test_task_run, &daily);
+  MYRIOTA_TimerWheelSchedule(&wheel, &daily.job, daily.next);
+  MYRIOTA_TimerWheelSchedule(&wheel, &hourly.job, hourly.next);
+  assert_int_equal(flex_fake.schedule_count, 2);
+  assert_int_equal(flex_fake.job_time, 1000 + 3600);
+
+  // The FlexSense job runs once per hour, including the hour of the daily job.
+  assert_int_equal(run_until(1000 + 86400), 24);
+  assert_int_equal(hourly.run_count, 24);
+  assert_int_equal(daily.run_count, 1);
+}
+
+static MYRIOTA_TimerWheelJob test_pair[2];
+static int test_pair_run_count;
+
+// Cancels the other job of the pair.
+static time_t test_cancel_other(void *const context) {
+  ++test_pair_run_count;
+  MYRIOTA_TimerWheelCancel(&wheel, &test_pair[(uintptr_t)context ^ 1]);
+  return FLEX_Never();
+}
+
+static void test_cancel(void **state) {
+  (void)state;
+  MYRIOTA_FlexFakeReset();
+  flex_fake.time = 1000;
+  MYRIOTA_TimerWheelInit(&wheel, wheel_job);
+
+  TestTask task = {.period = 10, .next = 1010};
+  MYRIOTA_TimerWheelJobInit(&task.job, test_task_run, &task);
+  MYRIOTA_TimerWheelSchedule(&wheel, &task.job, 1010);
+  assert_true(MYRIOTA_TimerWheelIsScheduled(&task.job));
+  MYRIOTA_TimerWheelCancel(&wheel, &task.job);
+  assert_false(MYRIOTA_TimerWheelIsScheduled(&task.job));
+  flex_fake.time = 1010;
+  assert_int_equal(wheel_job(), FLEX_Never());
+
+  // A job cancels another that is due at the same time.
+  for (uintptr_t i = 0; i < 2; ++i) {
+    MYRIOTA_TimerWheelJobInit(&test_pair[i], test_cancel_other, (void *)i);
+    MYRIOTA_TimerWheelSchedule(&wheel, &test_pair[i], 2000);
+  }
+  flex_fake.time = 2000;
+  assert_int_equal(wheel_job(), FLEX_Never());
+  assert_int_equal(test_pair_run_count, 1);
+  assert_false(MYRIOTA_TimerWheelIsScheduled(&test_pair[0]));
+  assert_false(MYRIOTA_TimerWheelIsScheduled(&test_pair[1]));
+
+  // A job scheduled in the past runs as soon as possible, and errors are returned.
+  flex_fake.schedule_result = -FLEX_ERROR_ENOMEM;
+  assert_int_equal(MYRIOTA_TimerWheelSchedule(&wheel, &task.job, 5), -FLEX_ERROR_ENOMEM);
+  flex_fake.schedule_result = 0;
+  task.next = 2000;
+  assert_int_equal(wheel_job(), 2010);
+  assert_int_equal(task.run_count, 1);
+}
+
+// A brute force model of the wheel, where each job has the time it is due.
+enum { MODEL_JOBS = 48 };
+static struct {
+  uint32_t random;
+  time_t polled;
+  time_t due[MODEL_JOBS];
+  bool eligible[MODEL_JOBS];
+  int run_count;
+  MYRIOTA_TimerWheelJob jobs[MODEL_JOBS];
+} model;
+
+// xorshift32, so the test is repeatable.
+static uint32_t model_random(const uint32_t limit) {
+  model.random ^= model.random << 13;
+  model.random ^= model.random >> 17;
+  model.random ^= model.random << 5;
+  return model.random % limit;
+}
+
+// A random time from the past to beyond the range of the wheel, or FLEX_Never().
+static time_t model_time(void) {
+  switch (model_random(6)) {
+    case 0:
+      return FLEX_Never();
+    case 1:
+      return flex_fake.time - (time_t)model_random(100);
+    case 2:
+      return flex_fake.time + (time_t)model_random(64);
+    case 3:
+      return flex_fake.time + (time_t)model_random(32 * 32 * 32);
+    default:
+      return flex_fake.time + (time_t)model_random(40 * 86400);
+  }
+}
+
+static void model_schedule(const int index, const time_t time) {
+  model.due[index] = time;
+  model.eligible[index] = false;
+  MYRIOTA_TimerWheelSchedule(&wheel, &model.jobs[index], time);
+}
+
+static void model_cancel(const int index) {
+  model.due[index] = FLEX_Never();
+  model.eligible[index] = false;
+  MYRIOTA_TimerWheelCancel(&wheel, &model.jobs[index]);
+}
+
+// The time the wheel should next run, as jobs that have passed run at the next poll.
+static time_t model_earliest(void) {
+  time_t earliest = FLEX_Never();
+  for (int i = 0; i < MODEL_JOBS; ++i) {
+    if (model.due[i] == FLEX_Never()) {
+      continue;
+    }
+    const time_t time = (model.due[i] > model.polled) ? model.due[i] : model.polled;
+    earliest = (earliest == FLEX_Never() || time < earliest) ? time : earliest;
+  }
+  return earliest;
+}
+
+// Runs only when due and not rescheduled since, and schedules or cancels other jobs.
+static time_t model_job_run(void *const context) {
+  const int index = (int)(uintptr_t)context;
+  assert_true(model.eligible[index]);
+  assert_true(model.due[index] <= flex_fake.time);
+  model.eligible[index] = false;
+  model.due[index] = FLEX_Never();
+  ++model.run_count;
+  const int other = (int)model_random(MODEL_JOBS);
+  switch (model_random(4)) {
+    case 0:
+      model_schedule(other, model_time());
+      break;
+    case 1:
+      model_cancel(other);
+      break;
+  }
+  const time_t time = model_time();
+  model.due[index] = time;
+  return time;
+}
+
+static void model_poll(void) {
+  for (int i = 0; i < MODEL_JOBS; ++i) {
+    model.eligible[i] = model.due[i] != FLEX_Never() && model.due[i] <= flex_fake.time;
+  }
+  model.polled = flex_fake.time;
+  flex_fake.job_time = wheel_job();
+  for (int i = 0; i < MODEL_JOBS; ++i) {
+    assert_false(model.eligible[i]);
+    assert_int_equal(MYRIOTA_TimerWheelIsScheduled(&model.jobs[i]),
+      model.due[i] != FLEX_Never());
+  }
+  assert_int_equal(flex_fake.job_time, model_earliest());
+}
+
+static void test_random_against_model(void **state) {
+  (void)state;
+  for (uint32_t seed = 1; seed <= 20; ++seed) {
+    MYRIOTA_FlexFakeReset();
+    memset(&model, 0, sizeof(model));
+    model.random = seed;
+    flex_fake.time = 1700000000 + (time_t)model_random(86400);
+    flex_fake.job_time = FLEX_Never();
+    model.polled = flex_fake.time;
+    MYRIOTA_TimerWheelInit(&wheel, wheel_job);
+    for (int i = 0; i < MODEL_JOBS; ++i) {
+      model.due[i] = FLEX_Never();
+      MYRIOTA_TimerWheelJobInit(&model.jobs[i], model_job_run, (void *)(uintptr_t)i);
+    }
+
+    for (int step = 0; step < 2000; ++step) {
+      switch (model_random(8)) {
+        case 0:
+        case 1:
+        case 2:
+          model_schedule((int)model_random(MODEL_JOBS), model_time());
+          break;
+        case 3:
+          model_cancel((int)model_random(MODEL_JOBS));
+          break;
+        case 4:
+          // Running the FlexSense job early is harmless.
+          model_poll();
+          break;
+        default: {
+          // The FlexSense job is never scheduled after the earliest job, so
+          // running it at the times it returns does not miss a job.
+          const time_t earliest = model_earliest();
+          if (earliest != FLEX_Never()) {
+            assert_true(flex_fake.job_time != FLEX_Never() && flex_fake.job_time <= earliest);
+          }
+          const time_t end = flex_fake.time + (time_t)model_random(2 * 32 * 32 * 32);
+          while (flex_fake.job_time != FLEX_Never() && flex_fake.job_time <= end) {
+            if (flex_fake.job_time > flex_fake.time) {
+              flex_fake.time = flex_fake.job_time;
+            }
+            model_poll();
+          }
+          flex_fake.time = end;
+          break;
+        }
+      }
+    }
+    assert_true(model.run_count > 0);
+  }
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_periodic_jobs),
+    cmocka_unit_test(test_wakes_only_when_due),
+    cmocka_unit_test(test_cancel),
+    cmocka_unit_test(test_random_against_model),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+#endif /** MYRIOTA_TIMERWHEEL_UNIT_TESTS */
@@ -0,0 +1,189 @@
+/// \file timeseries.h Myriota Time Series Compression
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYRIOTA_TIMESERIES_H
+#define MYRIOTA_TIMESERIES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** \defgroup TimeSeries Time Series Compression
+ * @brief Pack many timestamped samples into a single message
+ *
+ * A streaming encoder for series of (time, value) samples in the style of
+ * Facebook's Gorilla. Timestamps are encoded as the difference between
+ * consecutive intervals (delta-of-delta), so samples taken on a regular
+ * schedule cost a single bit. Integer and fixed-point values are encoded as
+ * the zigzag difference from the previous value in one of a few bit-packed
+ * size classes, and float values as the XOR with the previous value.
+ *
+ * Samples are appended until the next one would exceed the byte budget of the
+ * message, at which point the encoder reports that it is full and the number
+ * of samples it holds. The encoded series can be decoded with
+ * MYRIOTA_TimeSeriesDecoderNext() or `scripts/timeseries_decode.py`.
+ *
+ * \code
+ * uint8_t payload[20];
+ * MYRIOTA_TimeSeriesEncoder encoder;
+ * MYRIOTA_TimeSeriesEncoderInit(&encoder, MYRIOTA_TIMESERIES_INTEGER, payload, sizeof(payload));
+ * while (MYRIOTA_TimeSeriesAppend(&encoder, time, temperature) == FLEX_SUCCESS) {
+ *   ...
+ * }
+ * FLEX_MessageSchedule(payload, MYRIOTA_TimeSeriesSize(&encoder));
+ * \endcode
+ *
+ * The encoding is a stream of bits, filled from the least significant bit of
+ * each byte, and starts with a 2 bit mode and a 14 bit sample count, followed
+ * by the first sample as raw 32 bit time and value. See the README for the
+ * encoding of the following samples.
+ * \{
+ */
+
+/** The maximum number of samples in an encoded series. */
+#define MYRIOTA_TIMESERIES_MAX_COUNT 16383
+
+/** The type of the values of a series. */
+typedef enum {
+  /** int32_t values, including fixed-point values, encoded as differences. */
+  MYRIOTA_TIMESERIES_INTEGER = 0,
+  /** float values, encoded as the XOR with the previous value. */
+  MYRIOTA_TIMESERIES_FLOAT = 1,
+} MYRIOTA_TimeSeriesMode;
+
+/** The state shared by the encoder and decoder. Treat the members as private. */
+typedef struct {
+  /** \cond INTERNAL_HIDDEN */
+  uint32_t time;
+  uint32_t interval;
+  uint32_t value;
+  uint8_t leading;
+  uint8_t meaningful;
+  /** \endcond */
+} MYRIOTA_TimeSeriesState;
+
+/** A time series encoder. Treat the members as private. */
+typedef struct {
+  /** \cond INTERNAL_HIDDEN */
+  uint8_t *buffer;
+  size_t size;
+  MYRIOTA_TimeSeriesMode mode;
+  size_t bit_count;
+  uint16_t count;
+  MYRIOTA_TimeSeriesState state;
+  /** \endcond */
+} MYRIOTA_TimeSeriesEncoder;
+
+/** A time series decoder. Treat the members as private. */
+typedef struct {
+  /** \cond INTERNAL_HIDDEN */
+  const uint8_t *buffer;
+  size_t size;
+  MYRIOTA_TimeSeriesMode mode;
+  size_t bit_position;
+  uint16_t count;
+  uint16_t index;
+  MYRIOTA_TimeSeriesState state;
+  /** \endcond */
+} MYRIOTA_TimeSeriesDecoder;
+
+/**
+ * Initializes an encoder for an empty series.
+ *
+ * \param[out] encoder The encoder to initialize.
+ * \param[in] mode The type of the values.
+ * \param[out] buffer The buffer to encode the series into.
+ * \param[in] size The byte budget of the series, which must be at least 10 bytes.
+ */
+void MYRIOTA_TimeSeriesEncoderInit(MYRIOTA_TimeSeriesEncoder *const encoder,
+  const MYRIOTA_TimeSeriesMode mode, uint8_t *const buffer, const size_t size);
+
+/**
+ * Append an integer or fixed-point sample to a series in MYRIOTA_TIMESERIES_INTEGER mode.
+ *
+ * \param[in,out] encoder The encoder.
+ * \param[in] time The time of the sample, e.g. the epoch time from FLEX_TimeGet().
+ * \param[in] value The value of the sample.
+ * \return FLEX_SUCCESS (0) if the sample was appended and < 0 if failed.
+ * \retval -FLEX_ERROR_ENOBUFS: the sample does not fit in the byte budget, the
+ * series is unchanged.
+ */
+int MYRIOTA_TimeSeriesAppend(MYRIOTA_TimeSeriesEncoder *const encoder, const uint32_t time,
+  const int32_t value);
+
+/**
+ * Append a float sample to a series in MYRIOTA_TIMESERIES_FLOAT mode.
+ *
+ * \param[in,out] encoder The encoder.
+ * \param[in] time The time of the sample, e.g. the epoch time from FLEX_TimeGet().
+ * \param[in] value The value of the sample.
+ * \return FLEX_SUCCESS (0) if the sample was appended and < 0 if failed.
+ * \retval -FLEX_ERROR_ENOBUFS: the sample does not fit in the byte budget, the
+ * series is unchanged.
+ */
+int MYRIOTA_TimeSeriesAppendFloat(MYRIOTA_TimeSeriesEncoder *const encoder, const uint32_t time,
+  const float value);
+
+/**
+ * Returns the number of samples in a series.
+ *
+ * \param[in] encoder The encoder.
+ */
+size_t MYRIOTA_TimeSeriesCount(const MYRIOTA_TimeSeriesEncoder *const encoder);
+
+/**
+ * Returns the size of the encoded series in bytes.
+ *
+ * \param[in] encoder The encoder.
+ */
+size_t MYRIOTA_TimeSeriesSize(const MYRIOTA_TimeSeriesEncoder *const encoder);
+
+/**
+ * Initializes a decoder for an encoded series.
+ *
+ * \param[out] decoder The decoder to initialize.
+ * \param[in] buffer The encoded series.
+ * \param[in] size The size of the encoded series in bytes.
+ * \return FLEX_SUCCESS (0) if succeeded and < 0 if failed.
+ * \retval -FLEX_ERROR_EBADMSG: the header is malformed.
+ */
+int MYRIOTA_TimeSeriesDecoderInit(MYRIOTA_TimeSeriesDecoder *const decoder,
+  const uint8_t *const buffer, const size_t size);
+
+/**
+ * Returns the type of the values of a decoded series.
+ *
+ * \param[in] decoder The decoder.
+ */
+MYRIOTA_TimeSeriesMode MYRIOTA_TimeSeriesDecoderMode(
+  const MYRIOTA_TimeSeriesDecoder *const decoder);
+
+/**
+ * Decode the next sample of a series.
+ *
+ * \param[in,out] decoder The decoder.
+ * \param[out] time The time of the sample.
+ * \param[out] value The value of the sample. In MYRIOTA_TIMESERIES_FLOAT mode
+ * this holds the bits of the float, which can be copied into a float with memcpy().
+ * \return 1 if a sample was decoded, 0 at the end of the series, else < 0 on error.
+ * \retval -FLEX_ERROR_EBADMSG: the series is truncated.
+ */
+int MYRIOTA_TimeSeriesDecoderNext(MYRIOTA_TimeSeriesDecoder *const decoder,
+  uint32_t *const time, int32_t *const value);
+
+/**
+ * \}
+ */
+
+#endif /* MYRIOTA_TIMESERIES_H */
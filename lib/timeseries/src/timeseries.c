@@ -0,0 +1,489 @@
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myriota/timeseries.h"
+#include <string.h>
+#include "flex_errors.h"
+
+// NOTE: you can provide your own assert
+#ifndef TIMESERIES_ASSERT
+#include <stdio.h>
+#define TIMESERIES_ASSERT(cond)                      \
+  do {                                               \
+    if (!(cond)) {                                   \
+      printf("Assert @%s:%d\n", __FILE__, __LINE__); \
+      while (1) {                                    \
+      }                                              \
+    }                                                \
+  } while (0)
+#endif
+
+#define TIMESERIES_MODE_BITS 2
+#define TIMESERIES_COUNT_BITS 14
+#define TIMESERIES_HEADER_BITS (TIMESERIES_MODE_BITS + TIMESERIES_COUNT_BITS)
+#define TIMESERIES_FIRST_SAMPLE_BITS 64
+#define TIMESERIES_CLASS_COUNT 5
+#define TIMESERIES_XOR_LEADING_BITS 5
+#define TIMESERIES_XOR_LENGTH_BITS 5
+// The most bit fields a sample is encoded as, see timeseries_append().
+#define TIMESERIES_MAX_FIELDS 6
+
+// Differences are encoded as a unary size class prefix, 0, 10, 110, 1110 or
+// 1111, written first bit first, followed by the zigzag difference in the
+// payload width of the class.
+static const uint8_t timeseries_prefix[TIMESERIES_CLASS_COUNT] = {0x0, 0x1, 0x3, 0x7, 0xF};
+static const uint8_t timeseries_prefix_bits[TIMESERIES_CLASS_COUNT] = {1, 2, 3, 4, 4};
+static const uint8_t timeseries_interval_bits[TIMESERIES_CLASS_COUNT] = {0, 7, 12, 20, 32};
+static const uint8_t timeseries_value_bits[TIMESERIES_CLASS_COUNT] = {0, 4, 8, 16, 32};
+
+typedef struct {
+  uint32_t value;
+  uint8_t bits;
+} timeseries_field;
+
+static inline uint32_t zigzag_encode(const uint32_t value) {
+  return (value << 1) ^ (uint32_t)((int32_t)value >> 31);
+}
+
+static inline uint32_t zigzag_decode(const uint32_t value) {
+  return (value >> 1) ^ (0 - (value & 1));
+}
+
+static void timeseries_bits_write(uint8_t *const buffer, size_t *const position, uint32_t value,
+  uint8_t bits) {
+  while (bits > 0) {
+    const size_t offset = *position % 8;
+    const uint8_t count = (bits < 8 - offset) ? bits : 8 - offset;
+    const uint8_t mask = ((1u << count) - 1) << offset;
+    uint8_t *const byte = &buffer[*position / 8];
+    *byte = (*byte & ~mask) | ((value << offset) & mask);
+    value >>= count;
+    bits -= count;
+    *position += count;
+  }
+}
+
+static bool timeseries_bits_read(const MYRIOTA_TimeSeriesDecoder *const decoder,
+  size_t *const position, uint8_t bits, uint32_t *const value) {
+  if (*position + bits > decoder->size * 8) {
+    return false;
+  }
+  *value = 0;
+  for (uint8_t shift = 0; bits > 0;) {
+    const size_t offset = *position % 8;
+    const uint8_t count = (bits < 8 - offset) ? bits : 8 - offset;
+    const uint32_t chunk = (decoder->buffer[*position / 8] >> offset) & ((1u << count) - 1);
+    *value |= chunk << shift;
+    shift += count;
+    bits -= count;
+    *position += count;
+  }
+  return true;
+}
+
+// Appends the prefix and payload of a zigzag difference, returns the number of fields.
+static size_t timeseries_difference_encode(const uint32_t difference,
+  const uint8_t *const payload_bits, timeseries_field *const fields) {
+  const uint32_t zigzag = zigzag_encode(difference);
+  size_t size_class = 0;
+  while (size_class < TIMESERIES_CLASS_COUNT - 1 &&
+         (uint64_t)zigzag >> payload_bits[size_class] != 0) {
+    ++size_class;
+  }
+  fields[0].value = timeseries_prefix[size_class];
+  fields[0].bits = timeseries_prefix_bits[size_class];
+  fields[1].value = zigzag;
+  fields[1].bits = payload_bits[size_class];
+  return 2;
+}
+
+static bool timeseries_difference_decode(const MYRIOTA_TimeSeriesDecoder *const decoder,
+  size_t *const position, const uint8_t *const payload_bits, uint32_t *const difference) {
+  size_t size_class = 0;
+  uint32_t bit;
+  while (size_class < TIMESERIES_CLASS_COUNT - 1) {
+    if (!timeseries_bits_read(decoder, position, 1, &bit)) {
+      return false;
+    }
+    if (bit == 0) {
+      break;
+    }
+    ++size_class;
+  }
+  uint32_t zigzag;
+  if (!timeseries_bits_read(decoder, position, payload_bits[size_class], &zigzag)) {
+    return false;
+  }
+  *difference = zigzag_decode(zigzag);
+  return true;
+}
+
+// Encodes the XOR of a float with the previous float, updating the window of
+// meaningful bits in `state`. Returns the number of fields.
+static size_t timeseries_xor_encode(MYRIOTA_TimeSeriesState *const state, const uint32_t bits,
+  timeseries_field *const fields) {
+  const uint32_t xored = bits ^ state->value;
+  if (xored == 0) {
+    fields[0] = (timeseries_field){0x0, 1};
+    return 1;
+  }
+
+  const uint8_t leading = __builtin_clz(xored);
+  const uint8_t trailing = __builtin_ctz(xored);
+  if (state->meaningful > 0 && leading >= state->leading &&
+      trailing >= 32 - state->leading - state->meaningful) {
+    fields[0] = (timeseries_field){0x1, 2};
+    fields[1].value = xored >> (32 - state->leading - state->meaningful);
+    fields[1].bits = state->meaningful;
+    return 2;
+  }
+
+  state->leading = leading;
+  state->meaningful = 32 - leading - trailing;
+  fields[0] = (timeseries_field){0x3, 2};
+  fields[1] = (timeseries_field){leading, TIMESERIES_XOR_LEADING_BITS};
+  fields[2] = (timeseries_field){state->meaningful - 1, TIMESERIES_XOR_LENGTH_BITS};
+  fields[3] = (timeseries_field){xored >> trailing, state->meaningful};
+  return 4;
+}
+
+static bool timeseries_xor_decode(const MYRIOTA_TimeSeriesDecoder *const decoder,
+  size_t *const position, MYRIOTA_TimeSeriesState *const state, uint32_t *const bits) {
+  uint32_t control;
+  if (!timeseries_bits_read(decoder, position, 1, &control)) {
+    return false;
+  }
+  if (control == 0) {
+    *bits = state->value;
+    return true;
+  }
+
+  if (!timeseries_bits_read(decoder, position, 1, &control)) {
+    return false;
+  }
+  if (control == 1) {
+    uint32_t leading;
+    uint32_t length;
+    if (!timeseries_bits_read(decoder, position, TIMESERIES_XOR_LEADING_BITS, &leading) ||
+        !timeseries_bits_read(decoder, position, TIMESERIES_XOR_LENGTH_BITS, &length) ||
+        leading + length + 1 > 32) {
+      return false;
+    }
+    state->leading = leading;
+    state->meaningful = length + 1;
+  } else if (state->meaningful == 0) {
+    return false;
+  }
+
+  uint32_t xored;
+  if (!timeseries_bits_read(decoder, position, state->meaningful, &xored)) {
+    return false;
+  }
+  *bits = state->value ^ (xored << (32 - state->leading - state->meaningful));
+  return true;
+}
+
+static int timeseries_append(MYRIOTA_TimeSeriesEncoder *const encoder, const uint32_t time,
+  const uint32_t value) {
+  TIMESERIES_ASSERT(encoder != NULL);
+  if (encoder->count == MYRIOTA_TIMESERIES_MAX_COUNT) {
+    return -FLEX_ERROR_ENOBUFS;
+  }
+
+  // Encode into a list of fields first so a sample that does not fit leaves
+  // the series unchanged.
+  MYRIOTA_TimeSeriesState state = encoder->state;
+  timeseries_field fields[TIMESERIES_MAX_FIELDS];
+  size_t field_count = 0;
+  if (encoder->count == 0) {
+    fields[field_count++] = (timeseries_field){time, 32};
+    fields[field_count++] = (timeseries_field){value, 32};
+    state.interval = 0;
+  } else {
+    const uint32_t interval = time - state.time;
+    field_count +=
+      timeseries_difference_encode(interval - state.interval, timeseries_interval_bits, fields);
+    state.interval = interval;
+    if (encoder->mode == MYRIOTA_TIMESERIES_INTEGER) {
+      field_count += timeseries_difference_encode(value - state.value, timeseries_value_bits,
+        &fields[field_count]);
+    } else {
+      field_count += timeseries_xor_encode(&state, value, &fields[field_count]);
+    }
+  }
+  state.time = time;
+  state.value = value;
+
+  size_t bits = 0;
+  for (size_t i = 0; i < field_count; ++i) {
+    bits += fields[i].bits;
+  }
+  if (encoder->bit_count + bits > encoder->size * 8) {
+    return -FLEX_ERROR_ENOBUFS;
+  }
+
+  for (size_t i = 0; i < field_count; ++i) {
+    timeseries_bits_write(encoder->buffer, &encoder->bit_count, fields[i].value, fields[i].bits);
+  }
+  encoder->state = state;
+  ++encoder->count;
+  size_t position = TIMESERIES_MODE_BITS;
+  timeseries_bits_write(encoder->buffer, &position, encoder->count, TIMESERIES_COUNT_BITS);
+  return FLEX_SUCCESS;
+}
+
+void MYRIOTA_TimeSeriesEncoderInit(MYRIOTA_TimeSeriesEncoder *const encoder,
+  const MYRIOTA_TimeSeriesMode mode, uint8_t *const buffer, const size_t size) {
+  TIMESERIES_ASSERT(encoder != NULL);
+  TIMESERIES_ASSERT(buffer != NULL);
+  TIMESERIES_ASSERT(size * 8 >= TIMESERIES_HEADER_BITS + TIMESERIES_FIRST_SAMPLE_BITS);
+  memset(encoder, 0, sizeof(*encoder));
+  encoder->buffer = buffer;
+  encoder->size = size;
+  encoder->mode = mode;
+  timeseries_bits_write(buffer, &encoder->bit_count, mode, TIMESERIES_MODE_BITS);
+  timeseries_bits_write(buffer, &encoder->bit_count, 0, TIMESERIES_COUNT_BITS);
+}
+
+int MYRIOTA_TimeSeriesAppend(MYRIOTA_TimeSeriesEncoder *const encoder, const uint32_t time,
+  const int32_t value) {
+  TIMESERIES_ASSERT(encoder != NULL && encoder->mode == MYRIOTA_TIMESERIES_INTEGER);
+  return timeseries_append(encoder, time, value);
+}
+
+int MYRIOTA_TimeSeriesAppendFloat(MYRIOTA_TimeSeriesEncoder *const encoder, const uint32_t time,
+  const float value) {
+  TIMESERIES_ASSERT(encoder != NULL && encoder->mode == MYRIOTA_TIMESERIES_FLOAT);
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return timeseries_append(encoder, time, bits);
+}
+
+size_t MYRIOTA_TimeSeriesCount(const MYRIOTA_TimeSeriesEncoder *const encoder) {
+  TIMESERIES_ASSERT(encoder != NULL);
+  return encoder->count;
+}
+
+size_t MYRIOTA_TimeSeriesSize(const MYRIOTA_TimeSeriesEncoder *const encoder) {
+  TIMESERIES_ASSERT(encoder != NULL);
+  return (encoder->bit_count + 7) / 8;
+}
+
+int MYRIOTA_TimeSeriesDecoderInit(MYRIOTA_TimeSeriesDecoder *const decoder,
+  const uint8_t *const buffer, const size_t size) {
+  TIMESERIES_ASSERT(decoder != NULL);
+  TIMESERIES_ASSERT(buffer != NULL || size == 0);
+  memset(decoder, 0, sizeof(*decoder));
+  decoder->buffer = buffer;
+  decoder->size = size;
+
+  uint32_t mode;
+  uint32_t count;
+  if (!timeseries_bits_read(decoder, &decoder->bit_position, TIMESERIES_MODE_BITS, &mode) ||
+      !timeseries_bits_read(decoder, &decoder->bit_position, TIMESERIES_COUNT_BITS, &count) ||
+      mode > MYRIOTA_TIMESERIES_FLOAT) {
+    return -FLEX_ERROR_EBADMSG;
+  }
+  decoder->mode = mode;
+  decoder->count = count;
+  return FLEX_SUCCESS;
+}
+
+MYRIOTA_TimeSeriesMode MYRIOTA_TimeSeriesDecoderMode(
+  const MYRIOTA_TimeSeriesDecoder *const decoder) {
+  TIMESERIES_ASSERT(decoder != NULL);
+  return decoder->mode;
+}
+
+int MYRIOTA_TimeSeriesDecoderNext(MYRIOTA_TimeSeriesDecoder *const decoder,
+  uint32_t *const time, int32_t *const value) {
+  TIMESERIES_ASSERT(decoder != NULL);
+  TIMESERIES_ASSERT(time != NULL && value != NULL);
+  if (decoder->index == decoder->count) {
+    return 0;
+  }
+
+  size_t position = decoder->bit_position;
+  MYRIOTA_TimeSeriesState state = decoder->state;
+  uint32_t bits;
+  if (decoder->index == 0) {
+    if (!timeseries_bits_read(decoder, &position, 32, &state.time) ||
+        !timeseries_bits_read(decoder, &position, 32, &state.value)) {
+      return -FLEX_ERROR_EBADMSG;
+    }
+  } else {
+    uint32_t difference;
+    if (!timeseries_difference_decode(decoder, &position, timeseries_interval_bits,
+          &difference)) {
+      return -FLEX_ERROR_EBADMSG;
+    }
+    state.interval += difference;
+    state.time += state.interval;
+    if (decoder->mode == MYRIOTA_TIMESERIES_INTEGER) {
+      if (!timeseries_difference_decode(decoder, &position, timeseries_value_bits,
+            &difference)) {
+        return -FLEX_ERROR_EBADMSG;
+      }
+      state.value += difference;
+    } else {
+      if (!timeseries_xor_decode(decoder, &position, &state, &bits)) {
+        return -FLEX_ERROR_EBADMSG;
+      }
+      state.value = bits;
+    }
+  }
+
+  decoder->bit_position = position;
+  decoder->state = state;
+  ++decoder->index;
+  *time = state.time;
+  *value = (int32_t)state.value;
+  return 1;
+}
+
+#ifdef MYRIOTA_TIMESERIES_UNIT_TESTS
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+/*
+ * `cmocka.h` must be included after standard the above library headers.
+ * NOTE: This comment has dual purpose:
+ * 1. Document the ordering requirement.
+ * 2. Prevent `clang-format` from reordering the headers.
+ */
+#include <cmocka.h>
+
+#define TEST_START_TIME 1718000000
+
+static void test_integer_series_fills_budget(void **state) {
+  (void)state;
+  uint8_t payload[20];
+  MYRIOTA_TimeSeriesEncoder encoder;
+  MYRIOTA_TimeSeriesEncoderInit(&encoder, MYRIOTA_TIMESERIES_INTEGER, payload, sizeof(payload));
+
+  // A slowly varying temperature sampled every 15 minutes.
+  int32_t values[64];
+  uint32_t times[64];
+  size_t count = 0;
+  for (; count < 64; ++count) {
+    times[count] = TEST_START_TIME + count * 900;
+    values[count] = 212 + (int32_t)(count % 4);
+    if (MYRIOTA_TimeSeriesAppend(&encoder, times[count], values[count]) != FLEX_SUCCESS) {
+      break;
+    }
+  }
+  // The header and first sample take 10 bytes, the first interval 15 bits and
+  // the rest 7 bits each, where a raw time and value would take 8 bytes.
+  assert_int_equal(MYRIOTA_TimeSeriesCount(&encoder), count);
+  assert_int_equal(count, 10);
+  assert_true(MYRIOTA_TimeSeriesSize(&encoder) <= sizeof(payload));
+  assert_int_equal(MYRIOTA_TimeSeriesAppend(&encoder, times[count] + 900, 0),
+    -FLEX_ERROR_ENOBUFS);
+
+  MYRIOTA_TimeSeriesDecoder decoder;
+  assert_int_equal(MYRIOTA_TimeSeriesDecoderInit(&decoder, payload,
+                     MYRIOTA_TimeSeriesSize(&encoder)),
+    FLEX_SUCCESS);
+  assert_int_equal(MYRIOTA_TimeSeriesDecoderMode(&decoder), MYRIOTA_TIMESERIES_INTEGER);
+  for (size_t i = 0; i < count; ++i) {
+    uint32_t time;
+    int32_t value;
+    assert_int_equal(MYRIOTA_TimeSeriesDecoderNext(&decoder, &time, &value), 1);
+    assert_int_equal(time, times[i]);
+    assert_int_equal(value, values[i]);
+  }
+  uint32_t time;
+  int32_t value;
+  assert_int_equal(MYRIOTA_TimeSeriesDecoderNext(&decoder, &time, &value), 0);
+}
+
+static void test_extreme_differences(void **state) {
+  (void)state;
+  const uint32_t times[] = {0, UINT32_MAX, 5, 5, 1000000, 1000001};
+  const int32_t values[] = {INT32_MIN, INT32_MAX, 0, -8, 7, -300000};
+  uint8_t payload[64];
+  MYRIOTA_TimeSeriesEncoder encoder;
+  MYRIOTA_TimeSeriesEncoderInit(&encoder, MYRIOTA_TIMESERIES_INTEGER, payload, sizeof(payload));
+  for (size_t i = 0; i < 6; ++i) {
+    assert_int_equal(MYRIOTA_TimeSeriesAppend(&encoder, times[i], values[i]), FLEX_SUCCESS);
+  }
+
+  MYRIOTA_TimeSeriesDecoder decoder;
+  assert_int_equal(MYRIOTA_TimeSeriesDecoderInit(&decoder, payload,
+                     MYRIOTA_TimeSeriesSize(&encoder)),
+    FLEX_SUCCESS);
+  for (size_t i = 0; i < 6; ++i) {
+    uint32_t time;
+    int32_t value;
+    assert_int_equal(MYRIOTA_TimeSeriesDecoderNext(&decoder, &time, &value), 1);
+    assert_int_equal(time, times[i]);
+    assert_int_equal(value, values[i]);
+  }
+
+  // A truncated series is detected.
+  assert_int_equal(MYRIOTA_TimeSeriesDecoderInit(&decoder, payload,
+                     MYRIOTA_TimeSeriesSize(&encoder) - 1),
+    FLEX_SUCCESS);
+  uint32_t time;
+  int32_t value;
+  int result;
+  while ((result = MYRIOTA_TimeSeriesDecoderNext(&decoder, &time, &value)) == 1) {
+  }
+  assert_int_equal(result, -FLEX_ERROR_EBADMSG);
+}
+
+static void test_float_series(void **state) {
+  (void)state;
+  uint8_t payload[128];
+  MYRIOTA_TimeSeriesEncoder encoder;
+  MYRIOTA_TimeSeriesEncoderInit(&encoder, MYRIOTA_TIMESERIES_FLOAT, payload, sizeof(payload));
+  float values[32];
+  for (size_t i = 0; i < 32; ++i) {
+    values[i] = (i < 8) ? 1.5f : 1.5f + (float)(i % 4) * 0.25f;
+    if (i == 20) {
+      values[i] = -1234.5678f;
+    }
+    assert_int_equal(MYRIOTA_TimeSeriesAppendFloat(&encoder, TEST_START_TIME + i * 60, values[i]),
+      FLEX_SUCCESS);
+  }
+
+  // Repeated values cost 2 bits and the rest reuse the window of meaningful bits.
+  assert_true(MYRIOTA_TimeSeriesSize(&encoder) < 32 * 8 / 2);
+
+  MYRIOTA_TimeSeriesDecoder decoder;
+  assert_int_equal(MYRIOTA_TimeSeriesDecoderInit(&decoder, payload,
+                     MYRIOTA_TimeSeriesSize(&encoder)),
+    FLEX_SUCCESS);
+  assert_int_equal(MYRIOTA_TimeSeriesDecoderMode(&decoder), MYRIOTA_TIMESERIES_FLOAT);
+  for (size_t i = 0; i < 32; ++i) {
+    uint32_t time;
+    int32_t bits;
+    float value;
+    assert_int_equal(MYRIOTA_TimeSeriesDecoderNext(&decoder, &time, &bits), 1);
+    memcpy(&value, &bits, sizeof(value));
+    assert_int_equal(time, TEST_START_TIME + i * 60);
+    assert_memory_equal(&value, &values[i], sizeof(value));
+  }
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_integer_series_fills_budget),
+    cmocka_unit_test(test_extreme_differences),
+    cmocka_unit_test(test_float_series),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+#endif /** MYRIOTA_TIMESERIES_UNIT_TESTS */
@@ -0,0 +1,192 @@
+/// \file timestamp.h Myriota Timestamp Compression
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MYRIOTA_TIMESTAMP_H
+#define MYRIOTA_TIMESTAMP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/** \defgroup Timestamp Timestamp Compression
+ * @brief Encode the sample times of a message relative to a base epoch
+ *
+ * A full FLEX_TimeGet() timestamp takes 4 bytes, which adds up when a message
+ * carries several samples. This codec writes one 32 bit base epoch per message
+ * and encodes the time of each sample relative to it at a chosen resolution:
+ *
+ * | Mode | Bits per sample | Time |
+ * | ---- | --------------- | ---- |
+ * | explicit | `offset_bits` | the offset from the base in units of `resolution` |
+ * | implicit, on schedule | 1 | the previous sample time plus `period` |
+ * | implicit, exception | 1 + `offset_bits` | as explicit |
+ *
+ * The resolution is MYRIOTA_TIMESTAMP_SECONDS, MYRIOTA_TIMESTAMP_MINUTES or the
+ * period of the sampling job, in which case offsets are schedule slot indices.
+ * Times are rounded to the nearest unit.
+ *
+ * \code
+ * static MYRIOTA_TimestampEncoder encoder;
+ * const MYRIOTA_TimestampOptions options = {
+ *   .mode = MYRIOTA_TIMESTAMP_IMPLICIT,
+ *   .resolution = MYRIOTA_TIMESTAMP_MINUTES,
+ *   .period = SAMPLE_PERIOD_S,
+ *   .offset_bits = 10,
+ * };
+ * MYRIOTA_TimestampEncoderInit(&encoder, &options);
+ *
+ * size_t bits = MYRIOTA_TimestampEncodeBase(&encoder, FLEX_TimeGet(), payload,
+ *   sizeof(payload), 0);
+ * ...
+ * bits += MYRIOTA_TimestampEncode(&encoder, sample_time, payload, sizeof(payload), bits);
+ * \endcode
+ *
+ * Sample times are decoded with MYRIOTA_TimestampDecode() or
+ * `scripts/timestamp_decode.py`, which need the number of samples.
+ * \{
+ */
+
+/** A resolution of one second. */
+#define MYRIOTA_TIMESTAMP_SECONDS 1
+
+/** A resolution of one minute. */
+#define MYRIOTA_TIMESTAMP_MINUTES 60
+
+/** The number of bits of the base epoch. */
+#define MYRIOTA_TIMESTAMP_BASE_BITS 32
+
+/** The type of sample time encoding. */
+typedef enum {
+  /** Every sample time is an offset from the base. */
+  MYRIOTA_TIMESTAMP_EXPLICIT = 0,
+  /** Sample times one period after the previous sample, or at the base for the
+   * first sample, take one bit, and other times are exceptions with an offset. */
+  MYRIOTA_TIMESTAMP_IMPLICIT = 1,
+} MYRIOTA_TimestampMode;
+
+/** Configuration of a timestamp encoder or decoder, which must match. */
+typedef struct {
+  /** The type of sample time encoding. */
+  MYRIOTA_TimestampMode mode;
+  /** The unit of offsets in seconds, at least 1. */
+  uint32_t resolution;
+  /** The sample period in seconds in MYRIOTA_TIMESTAMP_IMPLICIT mode, which must
+   * be a multiple of `resolution`. Unused in MYRIOTA_TIMESTAMP_EXPLICIT mode. */
+  uint32_t period;
+  /** The number of bits of an offset, from 1 to 32, which bounds the time from
+   * the base to `resolution * (2^offset_bits - 1)` seconds. */
+  uint8_t offset_bits;
+} MYRIOTA_TimestampOptions;
+
+/** A timestamp encoder or decoder. Treat the members as private. */
+typedef struct {
+  /** \cond INTERNAL_HIDDEN */
+  MYRIOTA_TimestampOptions options;
+  bool has_base;
+  uint32_t base;
+  uint32_t next;
+  /** \endcond */
+} MYRIOTA_TimestampCodec;
+
+/** A timestamp encoder. Treat the members as private. */
+typedef MYRIOTA_TimestampCodec MYRIOTA_TimestampEncoder;
+
+/** A timestamp decoder. Treat the members as private. */
+typedef MYRIOTA_TimestampCodec MYRIOTA_TimestampDecoder;
+
+/**
+ * Initializes an encoder, which needs a base before it can encode sample times.
+ *
+ * \param[out] encoder The encoder to initialize.
+ * \param[in] options The configuration of the encoder.
+ */
+void MYRIOTA_TimestampEncoderInit(MYRIOTA_TimestampEncoder *const encoder,
+  const MYRIOTA_TimestampOptions *const options);
+
+/**
+ * Encode the base epoch of a message into a buffer at a bit offset, filling
+ * each byte from the least significant bit. Bits of the buffer before the
+ * offset are unchanged.
+ *
+ * \param[in,out] encoder The encoder.
+ * \param[in] base The base epoch, e.g. the time of the first sample.
+ * \param[out] buffer The buffer to encode the base into.
+ * \param[in] size The size of the buffer in bytes.
+ * \param[in] bit_offset The bit to encode the base from.
+ * \return the number of bits written on success, else < 0 on error.
+ * \retval -FLEX_ERROR_ENOBUFS: the buffer is too small, the encoder is unchanged.
+ */
+ssize_t MYRIOTA_TimestampEncodeBase(MYRIOTA_TimestampEncoder *const encoder, const uint32_t base,
+  uint8_t *const buffer, const size_t size, const size_t bit_offset);
+
+/**
+ * Encode the time of a sample relative to the last base.
+ *
+ * \param[in,out] encoder The encoder, which must have encoded a base.
+ * \param[in] time The time of the sample.
+ * \param[out] buffer The buffer to encode the time into.
+ * \param[in] size The size of the buffer in bytes.
+ * \param[in] bit_offset The bit to encode the time from.
+ * \return the number of bits written on success, else < 0 on error.
+ * \retval -FLEX_ERROR_ERANGE: the time is before the base or too far after it
+ * for `offset_bits`, start a new message with a new base.
+ * \retval -FLEX_ERROR_ENOBUFS: the buffer is too small, the encoder is unchanged.
+ */
+ssize_t MYRIOTA_TimestampEncode(MYRIOTA_TimestampEncoder *const encoder, const uint32_t time,
+  uint8_t *const buffer, const size_t size, const size_t bit_offset);
+
+/**
+ * Initializes a decoder, which needs a base before it can decode sample times.
+ *
+ * \param[out] decoder The decoder to initialize.
+ * \param[in] options The configuration of the encoder.
+ */
+void MYRIOTA_TimestampDecoderInit(MYRIOTA_TimestampDecoder *const decoder,
+  const MYRIOTA_TimestampOptions *const options);
+
+/**
+ * Decode the base epoch of a message from a buffer at a bit offset.
+ *
+ * \param[in,out] decoder The decoder.
+ * \param[in] buffer The encoded message.
+ * \param[in] size The size of the encoded message in bytes.
+ * \param[in] bit_offset The bit the base was encoded from.
+ * \param[out] base The base epoch.
+ * \return the number of bits read on success, else < 0 on error.
+ * \retval -FLEX_ERROR_EBADMSG: the message is truncated.
+ */
+ssize_t MYRIOTA_TimestampDecodeBase(MYRIOTA_TimestampDecoder *const decoder,
+  const uint8_t *const buffer, const size_t size, const size_t bit_offset, uint32_t *const base);
+
+/**
+ * Decode the time of a sample from a buffer at a bit offset.
+ *
+ * \param[in,out] decoder The decoder.
+ * \param[in] buffer The encoded message.
+ * \param[in] size The size of the encoded message in bytes.
+ * \param[in] bit_offset The bit the time was encoded from.
+ * \param[out] time The time of the sample, at the resolution of the encoder.
+ * \return the number of bits read on success, else < 0 on error.
+ * \retval -FLEX_ERROR_EBADMSG: the message is truncated.
+ * \retval -FLEX_ERROR_ENODATA: no base was decoded.
+ */
+ssize_t MYRIOTA_TimestampDecode(MYRIOTA_TimestampDecoder *const decoder,
+  const uint8_t *const buffer, const size_t size, const size_t bit_offset, uint32_t *const time);
+
+/**
+ * \}
+ */
+
+#endif /* MYRIOTA_TIMESTAMP_H */
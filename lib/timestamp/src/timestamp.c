@@ -0,0 +1,306 @@
+// Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+// SPDX-License-Identifier: BSD-3-Clause-Attribution
+//
+// This file is licensed under the BSD with attribution  (the "License"); you
+// may not use these files except in compliance with the License.
+//
+// You may obtain a copy of the License here:
+// LICENSE-BSD-3-Clause-Attribution.txt and at
+// https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+//
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "myriota/timestamp.h"
+#include <string.h>
+#include "flex_errors.h"
+
+// NOTE: you can provide your own assert
+#ifndef TIMESTAMP_ASSERT
+#include <stdio.h>
+#define TIMESTAMP_ASSERT(cond)                       \
+  do {                                               \
+    if (!(cond)) {                                   \
+      printf("Assert @%s:%d\n", __FILE__, __LINE__); \
+      while (1) {                                    \
+      }                                              \
+    }                                                \
+  } while (0)
+#endif
+
+static void timestamp_write(uint8_t *const buffer, size_t *const position, const uint32_t value,
+  const uint8_t bits) {
+  for (uint8_t i = 0; i < bits; ++i, ++*position) {
+    const uint8_t mask = 1U << (*position % 8);
+    if ((value >> i) & 1) {
+      buffer[*position / 8] |= mask;
+    } else {
+      buffer[*position / 8] &= ~mask;
+    }
+  }
+}
+
+static bool timestamp_read(const uint8_t *const buffer, const size_t size, size_t *const position,
+  const uint8_t bits, uint32_t *const value) {
+  if (*position + bits > size * 8) {
+    return false;
+  }
+  *value = 0;
+  for (uint8_t i = 0; i < bits; ++i, ++*position) {
+    *value |= (uint32_t)((buffer[*position / 8] >> (*position % 8)) & 1) << i;
+  }
+  return true;
+}
+
+static inline uint32_t timestamp_offset_max(const MYRIOTA_TimestampCodec *const codec) {
+  return UINT32_MAX >> (32 - codec->options.offset_bits);
+}
+
+// The number of units from the base to the next sample time in implicit mode.
+static inline uint32_t timestamp_period_units(const MYRIOTA_TimestampCodec *const codec) {
+  return codec->options.period / codec->options.resolution;
+}
+
+static void timestamp_codec_init(MYRIOTA_TimestampCodec *const codec,
+  const MYRIOTA_TimestampOptions *const options) {
+  TIMESTAMP_ASSERT(codec != NULL);
+  TIMESTAMP_ASSERT(options != NULL);
+  TIMESTAMP_ASSERT(options->resolution > 0);
+  TIMESTAMP_ASSERT(options->offset_bits >= 1 && options->offset_bits <= 32);
+  TIMESTAMP_ASSERT(options->mode == MYRIOTA_TIMESTAMP_EXPLICIT ||
+                   (options->period > 0 && options->period % options->resolution == 0));
+  memset(codec, 0, sizeof(*codec));
+  codec->options = *options;
+}
+
+void MYRIOTA_TimestampEncoderInit(MYRIOTA_TimestampEncoder *const encoder,
+  const MYRIOTA_TimestampOptions *const options) {
+  timestamp_codec_init(encoder, options);
+}
+
+void MYRIOTA_TimestampDecoderInit(MYRIOTA_TimestampDecoder *const decoder,
+  const MYRIOTA_TimestampOptions *const options) {
+  timestamp_codec_init(decoder, options);
+}
+
+ssize_t MYRIOTA_TimestampEncodeBase(MYRIOTA_TimestampEncoder *const encoder, const uint32_t base,
+  uint8_t *const buffer, const size_t size, const size_t bit_offset) {
+  TIMESTAMP_ASSERT(encoder != NULL);
+  TIMESTAMP_ASSERT(buffer != NULL);
+  if (bit_offset + MYRIOTA_TIMESTAMP_BASE_BITS > size * 8) {
+    return -FLEX_ERROR_ENOBUFS;
+  }
+  size_t position = bit_offset;
+  timestamp_write(buffer, &position, base, MYRIOTA_TIMESTAMP_BASE_BITS);
+  encoder->has_base = true;
+  encoder->base = base;
+  encoder->next = 0;
+  return MYRIOTA_TIMESTAMP_BASE_BITS;
+}
+
+ssize_t MYRIOTA_TimestampEncode(MYRIOTA_TimestampEncoder *const encoder, const uint32_t time,
+  uint8_t *const buffer, const size_t size, const size_t bit_offset) {
+  TIMESTAMP_ASSERT(encoder != NULL);
+  TIMESTAMP_ASSERT(buffer != NULL);
+  TIMESTAMP_ASSERT(encoder->has_base);
+  if (time < encoder->base) {
+    return -FLEX_ERROR_ERANGE;
+  }
+  const uint32_t resolution = encoder->options.resolution;
+  const uint64_t offset = ((uint64_t)time - encoder->base + resolution / 2) / resolution;
+  if (offset > timestamp_offset_max(encoder)) {
+    return -FLEX_ERROR_ERANGE;
+  }
+
+  const bool implicit = encoder->options.mode == MYRIOTA_TIMESTAMP_IMPLICIT;
+  const bool on_schedule = implicit && offset == encoder->next;
+  const size_t bits = (implicit ? 1 : 0) + (on_schedule ? 0 : encoder->options.offset_bits);
+  if (bit_offset + bits > size * 8) {
+    return -FLEX_ERROR_ENOBUFS;
+  }
+
+  size_t position = bit_offset;
+  if (implicit) {
+    timestamp_write(buffer, &position, on_schedule ? 0 : 1, 1);
+    encoder->next = offset + timestamp_period_units(encoder);
+  }
+  if (!on_schedule) {
+    timestamp_write(buffer, &position, offset, encoder->options.offset_bits);
+  }
+  return bits;
+}
+
+ssize_t MYRIOTA_TimestampDecodeBase(MYRIOTA_TimestampDecoder *const decoder,
+  const uint8_t *const buffer, const size_t size, const size_t bit_offset, uint32_t *const base) {
+  TIMESTAMP_ASSERT(decoder != NULL);
+  TIMESTAMP_ASSERT(buffer != NULL);
+  TIMESTAMP_ASSERT(base != NULL);
+  size_t position = bit_offset;
+  if (!timestamp_read(buffer, size, &position, MYRIOTA_TIMESTAMP_BASE_BITS, base)) {
+    return -FLEX_ERROR_EBADMSG;
+  }
+  decoder->has_base = true;
+  decoder->base = *base;
+  decoder->next = 0;
+  return MYRIOTA_TIMESTAMP_BASE_BITS;
+}
+
+ssize_t MYRIOTA_TimestampDecode(MYRIOTA_TimestampDecoder *const decoder,
+  const uint8_t *const buffer, const size_t size, const size_t bit_offset, uint32_t *const time) {
+  TIMESTAMP_ASSERT(decoder != NULL);
+  TIMESTAMP_ASSERT(buffer != NULL);
+  TIMESTAMP_ASSERT(time != NULL);
+  size_t position = bit_offset;
+  const bool implicit = decoder->options.mode == MYRIOTA_TIMESTAMP_IMPLICIT;
+  uint32_t exception = 1;
+  if (implicit && !timestamp_read(buffer, size, &position, 1, &exception)) {
+    return -FLEX_ERROR_EBADMSG;
+  }
+  uint32_t offset = decoder->next;
+  if (exception &&
+      !timestamp_read(buffer, size, &position, decoder->options.offset_bits, &offset)) {
+    return -FLEX_ERROR_EBADMSG;
+  }
+  if (!decoder->has_base) {
+    return -FLEX_ERROR_ENODATA;
+  }
+
+  if (implicit) {
+    decoder->next = offset + timestamp_period_units(decoder);
+  }
+  *time = decoder->base + offset * decoder->options.resolution;
+  return position - bit_offset;
+}
+
+#ifdef MYRIOTA_TIMESTAMP_UNIT_TESTS
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+/*
+ * `cmocka.h` must be included after standard the above library headers.
+ * NOTE: This comment has dual purpose:
+ * 1. Document the ordering requirement.
+ * 2. Prevent `clang-format` from reordering the headers.
+ */
+#include <cmocka.h>
+
+#define TEST_BASE 1700000000U
+
+// Encodes a base then sample times after a 3 bit field, decodes them and
+// returns the encoded bits.
+static size_t round_trip(const MYRIOTA_TimestampOptions *const options, const uint32_t *const times,
+  const size_t count, const uint32_t *const expected) {
+  uint8_t buffer[32];
+  memset(buffer, 0xFF, sizeof(buffer));
+  MYRIOTA_TimestampEncoder encoder;
+  MYRIOTA_TimestampEncoderInit(&encoder, options);
+  size_t bits = 3;
+  assert_int_equal(MYRIOTA_TimestampEncodeBase(&encoder, TEST_BASE, buffer, sizeof(buffer), bits),
+    MYRIOTA_TIMESTAMP_BASE_BITS);
+  bits += MYRIOTA_TIMESTAMP_BASE_BITS;
+  for (size_t i = 0; i < count; ++i) {
+    const ssize_t result =
+      MYRIOTA_TimestampEncode(&encoder, times[i], buffer, sizeof(buffer), bits);
+    assert_true(result > 0);
+    bits += result;
+  }
+  assert_int_equal(buffer[0] & 0x07, 0x07);
+
+  MYRIOTA_TimestampDecoder decoder;
+  MYRIOTA_TimestampDecoderInit(&decoder, options);
+  const size_t size = (bits + 7) / 8;
+  uint32_t time;
+  size_t position = 3;
+  assert_int_equal(MYRIOTA_TimestampDecodeBase(&decoder, buffer, size, position, &time),
+    MYRIOTA_TIMESTAMP_BASE_BITS);
+  assert_int_equal(time, TEST_BASE);
+  position += MYRIOTA_TIMESTAMP_BASE_BITS;
+  for (size_t i = 0; i < count; ++i) {
+    const ssize_t result = MYRIOTA_TimestampDecode(&decoder, buffer, size, position, &time);
+    assert_true(result > 0);
+    assert_int_equal(time, expected[i]);
+    position += result;
+  }
+  assert_int_equal(position, bits);
+  return bits - 3 - MYRIOTA_TIMESTAMP_BASE_BITS;
+}
+
+static void test_explicit(void **state) {
+  (void)state;
+  const MYRIOTA_TimestampOptions options = {
+    .mode = MYRIOTA_TIMESTAMP_EXPLICIT,
+    .resolution = MYRIOTA_TIMESTAMP_MINUTES,
+    .offset_bits = 6,
+  };
+  // Times are rounded to the nearest minute.
+  const uint32_t times[] = {TEST_BASE, TEST_BASE + 29, TEST_BASE + 30, TEST_BASE + 3599};
+  const uint32_t expected[] = {TEST_BASE, TEST_BASE, TEST_BASE + 60, TEST_BASE + 3600};
+  assert_int_equal(round_trip(&options, times, 4, expected), 4 * 6);
+}
+
+static void test_implicit(void **state) {
+  (void)state;
+  const MYRIOTA_TimestampOptions options = {
+    .mode = MYRIOTA_TIMESTAMP_IMPLICIT,
+    .resolution = 900,
+    .period = 900,
+    .offset_bits = 8,
+  };
+  // Samples on the schedule take one bit, and a missed slot is an exception.
+  const uint32_t times[] = {TEST_BASE, TEST_BASE + 900, TEST_BASE + 1810, TEST_BASE + 3600,
+    TEST_BASE + 4500};
+  const uint32_t expected[] = {TEST_BASE, TEST_BASE + 900, TEST_BASE + 1800, TEST_BASE + 3600,
+    TEST_BASE + 4500};
+  assert_int_equal(round_trip(&options, times, 5, expected), 3 + (1 + 8) + 1);
+}
+
+static void test_errors(void **state) {
+  (void)state;
+  const MYRIOTA_TimestampOptions options = {
+    .mode = MYRIOTA_TIMESTAMP_IMPLICIT,
+    .resolution = MYRIOTA_TIMESTAMP_SECONDS,
+    .period = 60,
+    .offset_bits = 4,
+  };
+  uint8_t buffer[5] = {0};
+  MYRIOTA_TimestampEncoder encoder;
+  MYRIOTA_TimestampEncoderInit(&encoder, &options);
+  assert_int_equal(MYRIOTA_TimestampEncodeBase(&encoder, TEST_BASE, buffer, 4, 1),
+    -FLEX_ERROR_ENOBUFS);
+  assert_int_equal(MYRIOTA_TimestampEncodeBase(&encoder, TEST_BASE, buffer, sizeof(buffer), 0),
+    MYRIOTA_TIMESTAMP_BASE_BITS);
+  assert_int_equal(MYRIOTA_TimestampEncode(&encoder, TEST_BASE - 1, buffer, sizeof(buffer), 32),
+    -FLEX_ERROR_ERANGE);
+  assert_int_equal(MYRIOTA_TimestampEncode(&encoder, TEST_BASE + 16, buffer, sizeof(buffer), 32),
+    -FLEX_ERROR_ERANGE);
+  assert_int_equal(MYRIOTA_TimestampEncode(&encoder, TEST_BASE + 15, buffer, sizeof(buffer), 36),
+    -FLEX_ERROR_ENOBUFS);
+  assert_int_equal(MYRIOTA_TimestampEncode(&encoder, TEST_BASE + 15, buffer, sizeof(buffer), 32),
+    5);
+
+  MYRIOTA_TimestampDecoder decoder;
+  MYRIOTA_TimestampDecoderInit(&decoder, &options);
+  uint32_t time;
+  assert_int_equal(MYRIOTA_TimestampDecode(&decoder, buffer, sizeof(buffer), 32, &time),
+    -FLEX_ERROR_ENODATA);
+  assert_int_equal(MYRIOTA_TimestampDecodeBase(&decoder, buffer, 3, 0, &time),
+    -FLEX_ERROR_EBADMSG);
+  assert_int_equal(MYRIOTA_TimestampDecodeBase(&decoder, buffer, sizeof(buffer), 0, &time),
+    MYRIOTA_TIMESTAMP_BASE_BITS);
+  assert_int_equal(MYRIOTA_TimestampDecode(&decoder, buffer, sizeof(buffer), 36, &time),
+    -FLEX_ERROR_EBADMSG);
+  assert_int_equal(MYRIOTA_TimestampDecode(&decoder, buffer, sizeof(buffer), 32, &time), 5);
+  assert_int_equal(time, TEST_BASE + 15);
+}
+
+int main(void) {
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_explicit),
+    cmocka_unit_test(test_implicit),
+    cmocka_unit_test(test_errors),
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+#endif /** MYRIOTA_TIMESTAMP_UNIT_TESTS */
@@ -0,0 +1,248 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+# Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+# SPDX-License-Identifier: BSD-3-Clause-Attribution
+#
+# This file is licensed under the BSD with attribution  (the "License"); you
+# may not use these files except in compliance with the License.
+#
+# You may obtain a copy of the License here:
+# LICENSE-BSD-3-Clause-Attribution.txt and at
+# https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+#
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Decoder for locations encoded by the Myriota relative location codec (lib/location).
+
+Relative locations carry the tag of their anchor, so each one is decoded
+against its own anchor. A location received before its anchor is held until
+the anchor arrives, and a location whose anchor was lost is not decoded.
+"""
+
+import sys
+
+UNCHANGED = "unchanged"
+NEAR = "near"
+FAR = "far"
+ANCHOR = "anchor"
+
+_ENCODINGS = (UNCHANGED, NEAR, FAR, ANCHOR)
+_TAG_BITS = 3
+_ANCHORS = 1 << _TAG_BITS
+_DELTA_BITS = {NEAR: 8, FAR: 12}
+_LATITUDE_MAX = 900000000
+_LONGITUDE_MAX = 1800000000
+
+
+def precision_m(metres):
+    """The precision in units of 1e-7 degrees, as MYRIOTA_LOCATION_PRECISION_M()."""
+    return metres * 90
+
+
+class _BitReader(object):
+    """Reads a stream of bits filled from the least significant bit of each byte."""
+
+    def __init__(self, data, position):
+        self._data = bytearray(data)
+        self._position = position
+
+    def read(self, bits):
+        if self._position + bits > len(self._data) * 8:
+            raise ValueError("Location is truncated")
+        value = 0
+        for shift in range(bits):
+            byte = self._data[(self._position + shift) // 8]
+            value |= ((byte >> ((self._position + shift) % 8)) & 1) << shift
+        self._position += bits
+        return value
+
+
+def _zigzag_decode(value):
+    return (value >> 1) ^ -(value & 1)
+
+
+def _quantize(value, precision):
+    """Rounds to the nearest multiple of the precision, half away from zero."""
+    magnitude = (abs(value) + precision // 2) // precision
+    return -magnitude if value < 0 else magnitude
+
+
+def _width(max_code):
+    return (max_code | 1).bit_length()
+
+
+class Location(object):
+    """A decoded location, where `latitude` and `longitude` are in degrees
+    multiplied by 1e7, or None if the anchor of the location was lost."""
+
+    def __init__(self, encoding, tag, latitude=None, longitude=None):
+        self.encoding = encoding
+        self.tag = tag
+        self.latitude = latitude
+        self.longitude = longitude
+
+
+class Decoder(object):
+    """Decodes locations with the options of the encoder on the device."""
+
+    def __init__(self, precision):
+        if precision < 1:
+            raise ValueError("Precision must be at least 1")
+        self.precision = precision
+        self._latitude_max = _quantize(_LATITUDE_MAX, precision)
+        self._longitude_max = _quantize(_LONGITUDE_MAX, precision)
+        self._latitude_bits = _width(2 * self._latitude_max)
+        self._longitude_bits = _width(2 * self._longitude_max - 1)
+        self._anchors = {}
+        self._latest = None
+
+    def _wrap(self, longitude):
+        """Wraps a quantised longitude into (-max, max]."""
+        span = 2 * self._longitude_max
+        while longitude > self._longitude_max:
+            longitude -= span
+        while longitude <= -self._longitude_max:
+            longitude += span
+        return longitude
+
+    def read(self, data, bit_offset=0):
+        """Reads a location, returning (encoding, tag, fields), where `fields`
+        are the quantised anchor or the zigzag decoded differences."""
+        reader = _BitReader(data, bit_offset)
+        ones = 0
+        while ones < 3 and reader.read(1):
+            ones += 1
+        encoding = _ENCODINGS[ones]
+        tag = reader.read(_TAG_BITS)
+        if encoding == ANCHOR:
+            latitude = reader.read(self._latitude_bits) - self._latitude_max
+            longitude = reader.read(self._longitude_bits) - self._longitude_max + 1
+            return encoding, tag, (latitude, longitude)
+        if encoding == UNCHANGED:
+            return encoding, tag, (0, 0)
+        bits = _DELTA_BITS[encoding]
+        return encoding, tag, (_zigzag_decode(reader.read(bits)), _zigzag_decode(reader.read(bits)))
+
+    def add_anchor(self, tag, fields):
+        """Keeps an anchor, returning the tags whose anchors are dropped.
+
+        The anchors of the latest tag and the three before it are kept. A newer
+        anchor drops the anchors that fall out of that window, which are older
+        anchors of the tags about to be reused, as MYRIOTA_LocationDecode().
+        """
+        dropped = []
+        ahead = 0 if self._latest is None else (tag - self._latest) % _ANCHORS
+        if self._latest is None or 0 < ahead <= _ANCHORS // 2:
+            for i in range(1, _ANCHORS // 2 + 1):
+                dropped.append((tag + i) % _ANCHORS)
+                self._anchors.pop((tag + i) % _ANCHORS, None)
+            self._latest = tag
+        self._anchors[tag] = fields
+        return dropped
+
+    def resolve(self, location, fields):
+        """Sets the location from its fields if its anchor is known."""
+        anchor = self._anchors.get(location.tag)
+        if anchor is None:
+            return False
+        latitude = anchor[0]
+        longitude = anchor[1]
+        if location.encoding != ANCHOR:
+            latitude += fields[0]
+            longitude = self._wrap(longitude + fields[1])
+        location.latitude = latitude * self.precision
+        location.longitude = longitude * self.precision
+        return True
+
+
+def decode(messages, precision, bit_offset=0):
+    """Decode the locations of messages in the order they were received.
+
+    Returns a Location for each message. A relative location received before
+    its anchor is decoded when the anchor arrives, and one whose anchor never
+    arrives is left undecoded.
+    """
+    decoder = Decoder(precision)
+    locations = []
+    pending = {}
+    for message in messages:
+        encoding, tag, fields = decoder.read(message, bit_offset)
+        location = Location(encoding, tag)
+        locations.append(location)
+        if encoding == ANCHOR:
+            # Locations waiting for an anchor that fell out of the window will
+            # not be decoded, as their tag is reused by newer anchors.
+            for dropped in decoder.add_anchor(tag, fields):
+                pending.pop(dropped, None)
+            decoder.resolve(location, fields)
+            for waiting, waiting_fields in pending.pop(tag, []):
+                decoder.resolve(waiting, waiting_fields)
+        elif not decoder.resolve(location, fields):
+            pending.setdefault(tag, []).append((location, fields))
+    return locations
+
+
+def main(argv=None):
+    """CLI entrypoint."""
+    import argparse
+
+    parser = argparse.ArgumentParser(
+        description="Decode relative locations to CSV lines of "
+        "index,encoding,tag,latitude,longitude in degrees, where the latitude and "
+        "longitude are empty if the anchor of the location was lost"
+    )
+    parser.add_argument(
+        "messages",
+        nargs="*",
+        help="Messages as hexadecimal strings in the order received, read one per "
+        "line from stdin if omitted",
+    )
+    parser.add_argument(
+        "-m",
+        "--precision-m",
+        type=int,
+        default=10,
+        help="The precision in metres given to MYRIOTA_LOCATION_PRECISION_M() on the device",
+    )
+    parser.add_argument(
+        "-p",
+        "--precision",
+        type=int,
+        help="The precision in units of 1e-7 degrees, instead of --precision-m",
+    )
+    parser.add_argument(
+        "-o",
+        "--offset",
+        type=int,
+        default=0,
+        help="The bit offset of the location in each message, e.g. the bits of the "
+        "fields before it",
+    )
+    args = parser.parse_args(argv)
+
+    lines = args.messages if args.messages else sys.stdin.read().split()
+    precision = args.precision if args.precision else precision_m(args.precision_m)
+    try:
+        messages = [bytearray.fromhex(line) for line in lines]
+        locations = decode(messages, precision, args.offset)
+    except ValueError as e:
+        sys.exit("Failed to decode location: %s" % e)
+
+    for index, location in enumerate(locations):
+        if location.latitude is None:
+            print("{},{},{},,".format(index, location.encoding, location.tag))
+        else:
+            print(
+                "{},{},{},{:.7f},{:.7f}".format(
+                    index,
+                    location.encoding,
+                    location.tag,
+                    location.latitude / 1e7,
+                    location.longitude / 1e7,
+                )
+            )
+
+
+if __name__ == "__main__":
+    main()
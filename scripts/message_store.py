@@ -17,9 +17,40 @@ import sys
 import myriota_auth
 import requests
 import json
+import struct
 
 _domain = "https://api.myriota.com/v1"
 
+# Payload field types, as struct format characters of the device struct members.
+_FIELD_TYPES = {
+    "int8": "b",
+    "uint8": "B",
+    "int16": "h",
+    "uint16": "H",
+    "int32": "i",
+    "uint32": "I",
+    "int64": "q",
+    "uint64": "Q",
+    "float": "f",
+    "double": "d",
+}
+_DECODE_CHUNK_ITEMS = 65536
+_READ_CHUNK_SIZE = 65536
+# The largest item read_items() buffers, in characters.
+_READ_ITEM_SIZE_MAX = 16 * 1024 * 1024
+_SYNC_SCHEMA = """
+CREATE TABLE IF NOT EXISTS messages (
+    module_id TEXT NOT NULL,
+    timestamp INTEGER NOT NULL,
+    item TEXT NOT NULL,
+    PRIMARY KEY (module_id, timestamp, item)
+);
+CREATE TABLE IF NOT EXISTS high_water_marks (
+    module_id TEXT PRIMARY KEY,
+    timestamp INTEGER NOT NULL
+);
+"""
+
 
 def do_query(idtoken, moduleid, range_from=None, limit=None):
     params = []
@@ -36,6 +67,235 @@ def do_query(idtoken, moduleid, range_from=None, limit=None):
     return response.json()["Items"]
 
 
+def _open_cache(path):
+    import sqlite3
+
+    connection = sqlite3.connect(path, timeout=60)
+    connection.execute("PRAGMA journal_mode=WAL")
+    connection.executescript(_SYNC_SCHEMA)
+    return connection
+
+
+def do_sync(idtoken, moduleid, cache, limit=100, range_from=0, query=do_query):
+    """Fetch the messages of a module received since the last sync into a cache.
+
+    Pages are fetched from the module's high-water mark, the latest timestamp in
+    the cache, until a page is not full. Each page and the new high-water mark
+    are committed together, so an interrupted sync resumes where it stopped.
+    `cache` is the path of an SQLite database, and `range_from` is the Unix epoch
+    millisecond to start from when the module has not been synced before.
+    Returns the number of new messages.
+    """
+    connection = _open_cache(cache)
+    try:
+        row = connection.execute(
+            "SELECT timestamp FROM high_water_marks WHERE module_id = ?", (moduleid,)
+        ).fetchone()
+        high_water = row[0] if row else range_from
+        # The query includes the messages at its start, so the cursor is the
+        # high-water mark and the number of messages at it that were fetched
+        # already, which the next page asks for on top of the limit and skips.
+        # Many messages at one timestamp then take more than one page.
+        skip = 0
+        count = 0
+        while True:
+            items = query(idtoken, moduleid, high_water, limit + skip)
+            timestamps = [int(item["Timestamp"]) for item in items]
+            with connection:
+                for timestamp, item in zip(timestamps[skip:], items[skip:]):
+                    cursor = connection.execute(
+                        "INSERT OR IGNORE INTO messages VALUES (?, ?, ?)",
+                        (moduleid, timestamp, json.dumps(item, sort_keys=True)),
+                    )
+                    count += cursor.rowcount
+                latest = max(timestamps + [high_water])
+                connection.execute(
+                    "INSERT OR REPLACE INTO high_water_marks VALUES (?, ?)",
+                    (moduleid, latest),
+                )
+            if len(items) < limit + skip:
+                return count
+            skip = timestamps.count(latest)
+            high_water = latest
+    finally:
+        connection.close()
+
+
+def parse_schema(schema):
+    """Parse a payload schema of comma separated name:type fields.
+
+    Types are the names of _FIELD_TYPES, "pad<N>", which needs no name, for N
+    ignored bytes and "bytes<N>" for N raw bytes. Fields are little-endian and packed, as in a
+    packed struct on the device. Returns (struct format, [(name, format character)]).
+    """
+    format = "<"
+    fields = []
+    for field in schema.split(","):
+        name, _, type_name = field.strip().partition(":")
+        type_name = type_name.strip() or name
+        if type_name.startswith("pad") and type_name[3:].isdigit():
+            format += type_name[3:] + "x"
+            continue
+        if type_name.startswith("bytes") and type_name[5:].isdigit():
+            character = type_name[5:] + "s"
+        elif type_name in _FIELD_TYPES:
+            character = _FIELD_TYPES[type_name]
+        else:
+            raise ValueError("Unknown type '%s' of field '%s'" % (type_name, name))
+        if not name:
+            raise ValueError("Missing field name in '%s'" % field)
+        format += character
+        fields.append((name.strip(), character))
+    return format, fields
+
+
+def _read_more(stream, buffer, position):
+    """Append the next chunk of a stream to the unread part of a buffer.
+
+    Returns (buffer, position, is_eof), where the read part is dropped.
+    """
+    more = stream.read(_READ_CHUNK_SIZE)
+    return buffer[position:] + more, 0, not more
+
+
+def read_items(stream, item_size_max=_READ_ITEM_SIZE_MAX):
+    """Yield the items of a JSON array export or of NDJSON, one at a time.
+
+    A JSON array is decoded incrementally, so memory does not grow with the
+    size of the export. Items are decoded in place in the buffer, which is only
+    compacted when it is refilled, and a ValueError is raised if no item is
+    complete within item_size_max characters, so malformed input is not read
+    into memory whole.
+    """
+    decoder = json.JSONDecoder()
+    buffer = stream.read(_READ_CHUNK_SIZE)
+    is_eof = not buffer
+    position = len(buffer) - len(buffer.lstrip())
+    is_array = buffer[position : position + 1] == "["
+    if is_array:
+        position += 1
+    while True:
+        # Skip separators, refilling the buffer when they reach its end.
+        while True:
+            while position < len(buffer) and buffer[position] in " \t\r\n,":
+                position += 1
+            if position < len(buffer) or is_eof:
+                break
+            buffer, position, is_eof = _read_more(stream, buffer, position)
+        if position >= len(buffer) or (is_array and buffer[position] == "]"):
+            return
+        try:
+            item, end = decoder.raw_decode(buffer, position)
+        except ValueError:
+            if is_eof:
+                raise
+            if len(buffer) - position > item_size_max:
+                raise ValueError(
+                    "No complete item within %d characters" % item_size_max
+                )
+            buffer, position, is_eof = _read_more(stream, buffer, position)
+            continue
+        # A scalar, such as a number, at the end of the buffer may continue in
+        # the next chunk.
+        if end == len(buffer) and not is_eof and not isinstance(item, (dict, list)):
+            buffer, position, is_eof = _read_more(stream, buffer, position)
+            continue
+        yield item
+        position = end
+
+
+def item_payloads(item, payload_field="Value", time_field="Timestamp"):
+    """Yield (timestamp, payload bytes) of a message store item.
+
+    The payload field is a hexadecimal string, or a JSON object, possibly
+    encoded as a string, with a list of "Packets" that each have one.
+    """
+    value = item.get(payload_field)
+    if isinstance(value, str) and value.lstrip().startswith("{"):
+        value = json.loads(value)
+    if isinstance(value, dict):
+        for packet in value.get("Packets", []):
+            for payload in item_payloads(packet, payload_field, time_field):
+                yield payload
+        return
+    if isinstance(value, str):
+        yield item.get(time_field), bytes(bytearray.fromhex(value))
+
+
+def do_decode(stream, schema, output, output_format="csv", offset=0, **fields):
+    """Decode the payloads of exported items in bulk with a schema.
+
+    Items are decoded in chunks with struct.iter_unpack, so memory is bounded
+    by the chunk size. CSV is written to the `output` stream. Columnar output
+    appends each field to `<output>/<name>.bin` as a little-endian array, which
+    numpy.fromfile() reads with the dtype in `<output>/schema.json`. Returns
+    (decoded, skipped), where skipped payloads are too short for the schema.
+    """
+    import csv
+    import os
+
+    format, schema_fields = parse_schema(schema)
+    size = struct.calcsize(format)
+    names = ["timestamp"] + [name for name, _ in schema_fields]
+    if output_format == "csv":
+        writer = csv.writer(output, lineterminator="\n")
+        writer.writerow(names)
+    else:
+        os.makedirs(output, exist_ok=True)
+        dtypes = {"timestamp": "<i8"}
+        for name, character in schema_fields:
+            if character.endswith("s"):
+                dtypes[name] = "|S" + character[:-1]
+            else:
+                kind = "f" if character in "fd" else ("u" if character.isupper() else "i")
+                dtypes[name] = "<%s%d" % (kind, struct.calcsize(character))
+        with open(os.path.join(output, "schema.json"), "w") as f:
+            json.dump({"fields": names, "dtypes": dtypes}, f, indent=2)
+        columns = [open(os.path.join(output, name + ".bin"), "wb") for name in names]
+
+    decoded = skipped = 0
+    times = []
+    blobs = []
+
+    def flush():
+        rows = struct.iter_unpack(format, b"".join(blobs))
+        if output_format == "csv":
+            for timestamp, row in zip(times, rows):
+                writer.writerow(
+                    (timestamp,) + tuple(v.hex() if isinstance(v, bytes) else v for v in row)
+                )
+        else:
+            values = list(zip(*rows))
+            columns[0].write(struct.pack("<%dq" % len(times), *[t or 0 for t in times]))
+            for column, (_, character), value in zip(columns[1:], schema_fields, values):
+                if character.endswith("s"):
+                    column.write(b"".join(value))
+                else:
+                    column.write(struct.pack("<%d%s" % (len(value), character), *value))
+        del times[:]
+        del blobs[:]
+
+    try:
+        for item in read_items(stream):
+            for timestamp, payload in item_payloads(item, **fields):
+                payload = payload[offset : offset + size]
+                if len(payload) < size:
+                    skipped += 1
+                    continue
+                times.append(timestamp)
+                blobs.append(payload)
+                decoded += 1
+                if len(blobs) == _DECODE_CHUNK_ITEMS:
+                    flush()
+        if blobs:
+            flush()
+    finally:
+        if output_format != "csv":
+            for column in columns:
+                column.close()
+    return decoded, skipped
+
+
 def main(argv=None, auth=myriota_auth.auth):
     """CLI entrypoint."""
     import argparse
@@ -69,10 +329,79 @@ def main(argv=None, auth=myriota_auth.auth):
         help="Maximum number of entries to return",
     )
 
+    sub_parser = subparsers.add_parser(
+        "decode",
+        help="Decode the payloads of exported messages with a payload schema",
+        description="Decode the payloads of exported messages, a JSON array such as "
+        "the output of query or one JSON item per line, with a payload schema to CSV or "
+        "columnar binary files",
+        formatter_class=argparse.ArgumentDefaultsHelpFormatter,
+    )
+    sub_parser.add_argument(
+        "schema",
+        help="Payload fields in order as comma separated name:type, where type is one "
+        "of %s, padN or bytesN, e.g. sequence:uint16,time:uint32,temperature:int16"
+        % ", ".join(_FIELD_TYPES),
+    )
+    sub_parser.add_argument(
+        "-i", "--input", help="Exported messages file, stdin if omitted"
+    )
+    sub_parser.add_argument(
+        "-o",
+        "--output",
+        help="Output file for csv, stdout if omitted, or output directory for columns",
+    )
+    sub_parser.add_argument(
+        "--format",
+        dest="output_format",
+        choices=["csv", "columns"],
+        default="csv",
+        help="Output format",
+    )
+    sub_parser.add_argument(
+        "--offset", type=int, default=0, help="Payload bytes to skip before the schema"
+    )
+    sub_parser.add_argument(
+        "--payload-field", default="Value", help="Item field holding the payload"
+    )
+    sub_parser.add_argument(
+        "--time-field", default="Timestamp", help="Item field holding the timestamp"
+    )
+
+    sub_parser = subparsers.add_parser(
+        "sync",
+        help="Fetch new messages of modules into a local cache",
+        description="Fetch the messages received since the last sync of each module "
+        "into an SQLite cache, with a page of limit new messages per request",
+        formatter_class=argparse.ArgumentDefaultsHelpFormatter,
+    )
+    sub_parser.add_argument("moduleids", nargs="+", help="Module Ids")
+    sub_parser.add_argument(
+        "-c", "--cache", default="message_store.db", help="Cache database file"
+    )
+    sub_parser.add_argument(
+        "-f",
+        "--from",
+        dest="range_from",
+        type=int,
+        default=0,
+        help="Unix epoch second to start from for modules not synced before",
+    )
+    sub_parser.add_argument(
+        "-l",
+        "--limit",
+        type=int,
+        default=100,
+        help="Number of new entries per request",
+    )
+    sub_parser.add_argument(
+        "-j", "--jobs", type=int, default=4, help="Modules to sync concurrently"
+    )
+
     args = parser.parse_args(argv)
 
     # Validate inputs
-    if args.limit <= 0:
+    if args.command in ("query", "sync") and args.limit <= 0:
         sys.exit("Invalid limit. Must be an integer which is greater than zero")
 
     if args.command == "query":
@@ -83,9 +412,70 @@ def main(argv=None, auth=myriota_auth.auth):
         except requests.exceptions.RequestException as e:
             raise SystemExit(e)
         return json.dumps(items, indent=2)
+    elif args.command == "sync":
+        from concurrent.futures import ThreadPoolExecutor
+
+        if args.jobs <= 0:
+            sys.exit("Invalid jobs. Must be an integer which is greater than zero")
+        # Create the cache before the workers open it concurrently.
+        _open_cache(args.cache).close()
+        idtoken = auth()["IdToken"]
+        with ThreadPoolExecutor(max_workers=args.jobs) as executor:
+            futures = {
+                moduleid: executor.submit(
+                    do_sync,
+                    idtoken,
+                    moduleid,
+                    args.cache,
+                    args.limit,
+                    args.range_from * 1000,
+                )
+                for moduleid in args.moduleids
+            }
+        counts = {}
+        for moduleid, future in futures.items():
+            try:
+                counts[moduleid] = future.result()
+            except requests.exceptions.RequestException as e:
+                sys.stderr.write("%s: %s\n" % (moduleid, e))
+                counts[moduleid] = None
+        return json.dumps(counts, indent=2)
+    elif args.command == "decode":
+        if args.output_format == "columns" and not args.output:
+            sys.exit("An output directory is required for columns")
+        try:
+            parse_schema(args.schema)
+        except ValueError as e:
+            sys.exit("Invalid schema: %s" % e)
+        stream = open(args.input) if args.input else sys.stdin
+        if args.output_format == "columns":
+            output = args.output
+        else:
+            output = open(args.output, "w", newline="") if args.output else sys.stdout
+        try:
+            decoded, skipped = do_decode(
+                stream,
+                args.schema,
+                output,
+                args.output_format,
+                args.offset,
+                payload_field=args.payload_field,
+                time_field=args.time_field,
+            )
+        except ValueError as e:
+            sys.exit("Invalid input: %s" % e)
+        finally:
+            if args.input:
+                stream.close()
+            if args.output and args.output_format == "csv":
+                output.close()
+        sys.stderr.write("Decoded %d payloads, skipped %d too short\n" % (decoded, skipped))
+        return None
     else:
         return "Invalid command"
 
 
 if __name__ == "__main__":
-    print(main())
+    result = main()
+    if result is not None:
+        print(result)
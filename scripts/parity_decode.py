@@ -0,0 +1,227 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+# Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+# SPDX-License-Identifier: BSD-3-Clause-Attribution
+#
+# This file is licensed under the BSD with attribution  (the "License"); you
+# may not use these files except in compliance with the License.
+#
+# You may obtain a copy of the License here:
+# LICENSE-BSD-3-Clause-Attribution.txt and at
+# https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+#
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Decoder for messages scheduled with the Myriota parity library (lib/parity).
+
+Strips the group header from each data message and recovers lost data
+messages from the parity messages of their group.
+"""
+
+import sys
+
+_INDEX_COUNT = 16
+_GF_POLYNOMIAL = 0x11D
+
+_GF_EXP = [0] * 512
+_GF_LOG = [0] * 256
+_value = 1
+for _power in range(255):
+    _GF_EXP[_power] = _value
+    _GF_LOG[_value] = _power
+    _value <<= 1
+    if _value & 0x100:
+        _value ^= _GF_POLYNOMIAL
+for _power in range(255, 512):
+    _GF_EXP[_power] = _GF_EXP[_power - 255]
+
+
+def _gf_multiply(a, b):
+    if a == 0 or b == 0:
+        return 0
+    return _GF_EXP[_GF_LOG[a] + _GF_LOG[b]]
+
+
+def _gf_inverse(a):
+    return _GF_EXP[255 - _GF_LOG[a]]
+
+
+def _coefficient(index, row):
+    """The weight of data message `index` in parity message `row`, 2^(index * row)."""
+    return _GF_EXP[(index * row) % 255]
+
+
+def _solve(matrix, vectors):
+    """Solve matrix * x = vectors over GF(256) by Gauss-Jordan elimination.
+
+    Each row of `vectors` is a bytearray. Returns the solution rows, or None if
+    the matrix is singular.
+    """
+    size = len(matrix)
+    matrix = [list(row) for row in matrix]
+    vectors = [bytearray(row) for row in vectors]
+    for column in range(size):
+        pivot = next((r for r in range(column, size) if matrix[r][column]), None)
+        if pivot is None:
+            return None
+        matrix[column], matrix[pivot] = matrix[pivot], matrix[column]
+        vectors[column], vectors[pivot] = vectors[pivot], vectors[column]
+
+        inverse = _gf_inverse(matrix[column][column])
+        matrix[column] = [_gf_multiply(inverse, value) for value in matrix[column]]
+        vectors[column] = bytearray(_gf_multiply(inverse, value) for value in vectors[column])
+        for row in range(size):
+            factor = matrix[row][column]
+            if row == column or factor == 0:
+                continue
+            matrix[row] = [
+                value ^ _gf_multiply(factor, pivot_value)
+                for value, pivot_value in zip(matrix[row], matrix[column])
+            ]
+            vectors[row] = bytearray(
+                value ^ _gf_multiply(factor, pivot_value)
+                for value, pivot_value in zip(vectors[row], vectors[column])
+            )
+    return vectors
+
+
+class Group(object):
+    """The received data and parity messages of one group."""
+
+    def __init__(self, sequence, parity_count):
+        self.sequence = sequence
+        self.parity_count = parity_count
+        self.messages = {}
+
+    def decode(self):
+        """Returns [(index, payload, recovered)] of the data messages in order.
+
+        Parity messages count down from index 15. Lost data messages that
+        cannot be recovered are omitted.
+        """
+        data = {}
+        parity = {}
+        for index, payload in self.messages.items():
+            row = _INDEX_COUNT - 1 - index
+            if row < self.parity_count:
+                parity[row] = payload
+            else:
+                data[index] = payload
+
+        recovered = {}
+        if parity:
+            # The first byte of a parity message is the number of data messages.
+            count = max(payload[0] for payload in parity.values())
+            missing = [index for index in range(count) if index not in data]
+            if missing and len(missing) <= len(parity):
+                recovered = self._recover(data, parity, missing)
+        messages = [(index, payload, False) for index, payload in data.items()]
+        messages += [(index, payload, True) for index, payload in recovered.items()]
+        return sorted(messages)
+
+    def _recover(self, data, parity, missing):
+        rows = sorted(parity)[: len(missing)]
+        width = max(len(parity[row]) - 1 for row in rows)
+        vectors = []
+        for row in rows:
+            vector = bytearray(parity[row][1:].ljust(width, b"\0"))
+            for index, payload in data.items():
+                coded = bytearray([len(payload)]) + bytearray(payload)
+                coefficient = _coefficient(index, row)
+                for i, value in enumerate(coded):
+                    vector[i] ^= _gf_multiply(coefficient, value)
+            vectors.append(vector)
+
+        matrix = [[_coefficient(index, row) for index in missing] for row in rows]
+        solution = _solve(matrix, vectors)
+        if solution is None:
+            return {}
+        recovered = {}
+        for index, coded in zip(missing, solution):
+            if coded[0] == 0 or coded[0] >= len(coded):
+                continue
+            recovered[index] = bytes(coded[1 : 1 + coded[0]])
+        return recovered
+
+
+def decode(messages, parity_count=1):
+    """Decode messages in the order they were received.
+
+    Returns [(group, index, payload, recovered)] of the data messages, where
+    `group` is the group sequence number from 0 to 15 and `recovered` is True
+    for a message rebuilt from parity.
+    """
+    results = []
+    groups = {}
+    order = []
+
+    def close(sequence):
+        group = groups.pop(sequence)
+        order.remove(sequence)
+        for index, payload, recovered in group.decode():
+            results.append((group.sequence, index, payload, recovered))
+
+    for message in messages:
+        message = bytes(message)
+        if len(message) < 2:
+            continue
+        sequence = message[0] >> 4
+        index = message[0] & 0x0F
+        payload = message[1:]
+
+        # A group is complete once a later group is half the sequence space ahead,
+        # or when its sequence number is reused.
+        for open_sequence in list(order):
+            if (sequence - open_sequence) % 16 == 8:
+                close(open_sequence)
+        group = groups.get(sequence)
+        if group is not None and index in group.messages:
+            close(sequence)
+            group = None
+        if group is None:
+            group = Group(sequence, parity_count)
+            groups[sequence] = group
+            order.append(sequence)
+        group.messages[index] = payload
+
+    for sequence in list(order):
+        close(sequence)
+    return results
+
+
+def main(argv=None):
+    """CLI entrypoint."""
+    import argparse
+
+    parser = argparse.ArgumentParser(
+        description="Decode parity coded messages, recovering lost messages, to CSV "
+        "lines of group,index,recovered,payload"
+    )
+    parser.add_argument(
+        "messages",
+        nargs="*",
+        help="Messages as hexadecimal strings in the order received, read one per "
+        "line from stdin if omitted",
+    )
+    parser.add_argument(
+        "-p",
+        "--parity-count",
+        type=int,
+        default=1,
+        help="The number of parity messages per group configured on the device",
+    )
+    args = parser.parse_args(argv)
+
+    lines = args.messages if args.messages else sys.stdin.read().split()
+    try:
+        messages = [bytearray.fromhex(line) for line in lines]
+    except ValueError as e:
+        sys.exit("Invalid message: %s" % e)
+
+    for group, index, payload, recovered in decode(messages, args.parity_count):
+        print("{},{},{},{}".format(group, index, int(recovered), payload.hex()))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,180 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+# Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+# SPDX-License-Identifier: BSD-3-Clause-Attribution
+#
+# This file is licensed under the BSD with attribution  (the "License"); you
+# may not use these files except in compliance with the License.
+#
+# You may obtain a copy of the License here:
+# LICENSE-BSD-3-Clause-Attribution.txt and at
+# https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+#
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Unit tests of message_store.py, run with `python -m unittest discover scripts`."""
+
+import io
+import json
+import os
+import shutil
+import sqlite3
+import sys
+import tempfile
+import threading
+import unittest
+from http.server import BaseHTTPRequestHandler, HTTPServer
+from urllib.parse import parse_qs, urlparse
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import message_store
+
+
+class ReadItemsTest(unittest.TestCase):
+    def setUp(self):
+        # Small chunks make items span several reads.
+        self.chunk_size = message_store._READ_CHUNK_SIZE
+        message_store._READ_CHUNK_SIZE = 7
+        self.items = [{"Timestamp": i, "Value": "ab" * (i % 5)} for i in range(50)]
+
+    def tearDown(self):
+        message_store._READ_CHUNK_SIZE = self.chunk_size
+
+    def read(self, text, **kwargs):
+        return list(message_store.read_items(io.StringIO(text), **kwargs))
+
+    def test_array(self):
+        self.assertEqual(self.read(json.dumps(self.items)), self.items)
+        self.assertEqual(self.read(" [ ] "), [])
+        self.assertEqual(self.read(""), [])
+
+    def test_ndjson(self):
+        text = "\n".join(json.dumps(item) for item in self.items) + "\n"
+        self.assertEqual(self.read(text), self.items)
+        self.assertEqual(self.read("12\n345\n"), [12, 345])
+
+    def test_malformed(self):
+        with self.assertRaises(ValueError):
+            self.read('[{"Timestamp": }]')
+        # An unterminated item raises once it exceeds the cap, before the rest
+        # of the stream is read.
+        stream = io.StringIO('[{"Value": "' + "ab" * 1000)
+        with self.assertRaisesRegex(ValueError, "within 100 characters"):
+            list(message_store.read_items(stream, item_size_max=100))
+        self.assertLess(stream.tell(), 200)
+
+
+class _MessageStore(HTTPServer):
+    """A local stand-in for the Message endpoint of the API.
+
+    Returns at most `limit` messages from the `from` timestamp, inclusive, in
+    the order of their timestamps.
+    """
+
+    def __init__(self):
+        super().__init__(("127.0.0.1", 0), _MessageStoreHandler)
+        self.messages = {}
+        self.requests = []
+
+    def add(self, moduleid, timestamp, value):
+        self.messages.setdefault(moduleid, []).append(
+            {"Timestamp": timestamp, "Value": value}
+        )
+        self.messages[moduleid].sort(key=lambda item: item["Timestamp"])
+
+
+class _MessageStoreHandler(BaseHTTPRequestHandler):
+    def do_GET(self):
+        url = urlparse(self.path)
+        params = parse_qs(url.query)
+        range_from = int(params.get("from", ["0"])[0])
+        limit = int(params["limit"][0])
+        moduleid = url.path.split("/")[-2]
+        self.server.requests.append((moduleid, range_from, limit))
+        items = [
+            item
+            for item in self.server.messages.get(moduleid, [])
+            if item["Timestamp"] >= range_from
+        ][:limit]
+        body = json.dumps({"Items": items}).encode()
+        self.send_response(200)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def log_message(self, format, *args):
+        pass
+
+
+class SyncTest(unittest.TestCase):
+    def setUp(self):
+        self.store = _MessageStore()
+        threading.Thread(target=self.store.serve_forever, daemon=True).start()
+        self.domain = message_store._domain
+        message_store._domain = "http://127.0.0.1:%d" % self.store.server_port
+        self.directory = tempfile.mkdtemp()
+        self.cache = os.path.join(self.directory, "cache.db")
+
+    def tearDown(self):
+        message_store._domain = self.domain
+        self.store.shutdown()
+        self.store.server_close()
+        shutil.rmtree(self.directory)
+
+    def sync(self, limit, moduleid="m1"):
+        return message_store.do_sync("token", moduleid, self.cache, limit)
+
+    def cached(self, moduleid="m1"):
+        with sqlite3.connect(self.cache) as connection:
+            rows = connection.execute(
+                "SELECT item FROM messages WHERE module_id = ? "
+                "ORDER BY timestamp, item",
+                (moduleid,),
+            ).fetchall()
+        return [json.loads(row[0])["Value"] for row in rows]
+
+    def test_pages(self):
+        for i in range(25):
+            self.store.add("m1", 1000 + i, "%02x" % i)
+        self.assertEqual(self.sync(limit=10), 25)
+        self.assertEqual(self.cached(), ["%02x" % i for i in range(25)])
+
+        # A later sync only fetches the new messages.
+        self.store.add("m1", 2000, "ff")
+        self.assertEqual(self.sync(limit=10), 1)
+        self.assertEqual(self.sync(limit=10), 0)
+        self.assertEqual(len(self.cached()), 26)
+
+    def test_limit_one(self):
+        for i in range(10):
+            self.store.add("m1", 1000, "%02x" % i)
+        self.store.add("m1", 1001, "aa")
+        self.assertEqual(self.sync(limit=1), 11)
+        self.assertEqual(len(self.cached()), 11)
+
+    def test_many_at_one_timestamp(self):
+        self.store.add("m1", 999, "00")
+        for i in range(30):
+            self.store.add("m1", 1000, "%02x" % (i + 1))
+        for i in range(5):
+            self.store.add("m1", 1001 + i, "%02x" % (i + 100))
+        self.assertEqual(self.sync(limit=7), 36)
+        self.assertEqual(len(self.cached()), 36)
+        # Each request asks for the limit on top of the messages at its start
+        # that were fetched already.
+        self.assertEqual(
+            [request[1:] for request in self.store.requests],
+            [(0, 7), (1000, 13), (1000, 20), (1000, 27), (1000, 34), (1004, 8)],
+        )
+
+        # A later sync starts from the high-water mark.
+        self.store.add("m1", 1005, "ee")
+        self.assertEqual(self.sync(limit=1), 1)
+        self.assertEqual(self.store.requests[-1][1], 1005)
+        self.assertEqual(self.cached()[-1], "ee")
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,138 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+# Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+# SPDX-License-Identifier: BSD-3-Clause-Attribution
+#
+# This file is licensed under the BSD with attribution  (the "License"); you
+# may not use these files except in compliance with the License.
+#
+# You may obtain a copy of the License here:
+# LICENSE-BSD-3-Clause-Attribution.txt and at
+# https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+#
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Decoder for messages encoded by the Myriota time series library (lib/timeseries)."""
+
+import struct
+import sys
+
+MODE_INTEGER = 0
+MODE_FLOAT = 1
+
+_PREFIX_BITS = 4
+_INTERVAL_BITS = (0, 7, 12, 20, 32)
+_VALUE_BITS = (0, 4, 8, 16, 32)
+_XOR_LEADING_BITS = 5
+_XOR_LENGTH_BITS = 5
+_MASK32 = 0xFFFFFFFF
+
+
+class _BitReader(object):
+    """Reads a stream of bits filled from the least significant bit of each byte."""
+
+    def __init__(self, data):
+        self._data = bytearray(data)
+        self._position = 0
+
+    def read(self, bits):
+        if self._position + bits > len(self._data) * 8:
+            raise ValueError("Series is truncated")
+        value = 0
+        for shift in range(bits):
+            byte = self._data[(self._position + shift) // 8]
+            value |= ((byte >> ((self._position + shift) % 8)) & 1) << shift
+        self._position += bits
+        return value
+
+
+def _zigzag_decode(value):
+    return (value >> 1) ^ (-(value & 1) & _MASK32)
+
+
+def _read_difference(reader, payload_bits):
+    size_class = 0
+    while size_class < _PREFIX_BITS and reader.read(1):
+        size_class += 1
+    return _zigzag_decode(reader.read(payload_bits[size_class]))
+
+
+def _to_int32(value):
+    return value - (1 << 32) if value & 0x80000000 else value
+
+
+def decode(data):
+    """Decode an encoded series, returning (mode, [(time, value), ...])."""
+    reader = _BitReader(data)
+    mode = reader.read(2)
+    count = reader.read(14)
+    if mode not in (MODE_INTEGER, MODE_FLOAT):
+        raise ValueError("Unknown mode %d" % mode)
+
+    samples = []
+    time = value = interval = leading = meaningful = 0
+    for index in range(count):
+        if index == 0:
+            time = reader.read(32)
+            value = reader.read(32)
+        else:
+            interval = (interval + _read_difference(reader, _INTERVAL_BITS)) & _MASK32
+            time = (time + interval) & _MASK32
+            if mode == MODE_INTEGER:
+                value = (value + _read_difference(reader, _VALUE_BITS)) & _MASK32
+            elif reader.read(1):
+                if reader.read(1):
+                    leading = reader.read(_XOR_LEADING_BITS)
+                    meaningful = reader.read(_XOR_LENGTH_BITS) + 1
+                    if leading + meaningful > 32:
+                        raise ValueError("Malformed float window")
+                elif meaningful == 0:
+                    raise ValueError("Float window used before it was set")
+                value ^= reader.read(meaningful) << (32 - leading - meaningful)
+
+        if mode == MODE_INTEGER:
+            samples.append((time, _to_int32(value)))
+        else:
+            samples.append((time, struct.unpack("<f", struct.pack("<I", value))[0]))
+    return mode, samples
+
+
+def main(argv=None):
+    """CLI entrypoint."""
+    import argparse
+
+    parser = argparse.ArgumentParser(
+        description="Decode a time series message to CSV lines of time,value"
+    )
+    parser.add_argument(
+        "message",
+        nargs="?",
+        help="The message as a hexadecimal string, read from stdin if omitted",
+    )
+    parser.add_argument(
+        "-b",
+        "--binary",
+        metavar="FILE",
+        help="Read the message from a binary file instead",
+    )
+    args = parser.parse_args(argv)
+
+    if args.binary:
+        with open(args.binary, "rb") as f:
+            data = f.read()
+    else:
+        text = args.message if args.message is not None else sys.stdin.read()
+        data = bytearray.fromhex("".join(text.split()))
+
+    try:
+        _, samples = decode(data)
+    except ValueError as e:
+        sys.exit("Failed to decode message: %s" % e)
+
+    for time, value in samples:
+        print("{},{}".format(time, repr(value)))
+
+
+if __name__ == "__main__":
+    main()
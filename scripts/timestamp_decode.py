@@ -0,0 +1,150 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+# Copyright (c) 2024, Myriota Pty Ltd, All Rights Reserved
+# SPDX-License-Identifier: BSD-3-Clause-Attribution
+#
+# This file is licensed under the BSD with attribution  (the "License"); you
+# may not use these files except in compliance with the License.
+#
+# You may obtain a copy of the License here:
+# LICENSE-BSD-3-Clause-Attribution.txt and at
+# https://spdx.org/licenses/BSD-3-Clause-Attribution.html
+#
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Decoder for sample times encoded by the Myriota timestamp library (lib/timestamp)."""
+
+import sys
+
+MODE_EXPLICIT = 0
+MODE_IMPLICIT = 1
+
+_BASE_BITS = 32
+_MASK32 = 0xFFFFFFFF
+
+
+class BitReader(object):
+    """Reads a stream of bits filled from the least significant bit of each byte."""
+
+    def __init__(self, data, position=0):
+        self._data = bytearray(data)
+        self.position = position
+
+    def read(self, bits):
+        if self.position + bits > len(self._data) * 8:
+            raise ValueError("Message is truncated")
+        value = 0
+        for shift in range(bits):
+            byte = self._data[(self.position + shift) // 8]
+            value |= ((byte >> ((self.position + shift) % 8)) & 1) << shift
+        self.position += bits
+        return value
+
+
+class TimestampDecoder(object):
+    """Decodes a base and sample times, which may be interleaved with other fields."""
+
+    def __init__(self, mode, resolution, offset_bits, period=0):
+        if resolution <= 0 or not 1 <= offset_bits <= 32:
+            raise ValueError("Invalid resolution or offset bits")
+        if mode == MODE_IMPLICIT and (period <= 0 or period % resolution):
+            raise ValueError("The period must be a multiple of the resolution")
+        self.mode = mode
+        self.resolution = resolution
+        self.offset_bits = offset_bits
+        self.period = period
+        self.base = None
+        self._next = 0
+
+    def decode_base(self, reader):
+        self.base = reader.read(_BASE_BITS)
+        self._next = 0
+        return self.base
+
+    def decode(self, reader):
+        offset = self._next
+        if self.mode == MODE_EXPLICIT or reader.read(1):
+            offset = reader.read(self.offset_bits)
+        if self.base is None:
+            raise ValueError("Sample time before a base")
+        if self.mode == MODE_IMPLICIT:
+            self._next = (offset + self.period // self.resolution) & _MASK32
+        return (self.base + offset * self.resolution) & _MASK32
+
+
+def decode(data, count, mode, resolution, offset_bits, period=0, bit_offset=0):
+    """Decode a base followed by `count` sample times, returning the times."""
+    reader = BitReader(data, bit_offset)
+    decoder = TimestampDecoder(mode, resolution, offset_bits, period)
+    decoder.decode_base(reader)
+    return [decoder.decode(reader) for _ in range(count)]
+
+
+def main(argv=None):
+    """CLI entrypoint."""
+    import argparse
+
+    parser = argparse.ArgumentParser(
+        description="Decode the base and sample times of a message, one time per line",
+        formatter_class=argparse.ArgumentDefaultsHelpFormatter,
+    )
+    parser.add_argument(
+        "message",
+        nargs="?",
+        help="The message as a hexadecimal string, read from stdin if omitted",
+    )
+    parser.add_argument(
+        "-n", "--count", type=int, required=True, help="The number of sample times"
+    )
+    parser.add_argument(
+        "-m",
+        "--mode",
+        choices=["explicit", "implicit"],
+        default="explicit",
+        help="The encoding of the sample times",
+    )
+    parser.add_argument(
+        "-r",
+        "--resolution",
+        type=int,
+        default=1,
+        help="The unit of offsets in seconds, e.g. 60 for minutes or the sample period",
+    )
+    parser.add_argument(
+        "-p", "--period", type=int, default=0, help="The sample period in seconds"
+    )
+    parser.add_argument(
+        "-b", "--offset-bits", type=int, required=True, help="The bits of an offset"
+    )
+    parser.add_argument(
+        "-o",
+        "--bit-offset",
+        type=int,
+        default=0,
+        help="The bit of the message the base starts at",
+    )
+    args = parser.parse_args(argv)
+
+    text = args.message if args.message is not None else sys.stdin.read()
+    try:
+        data = bytearray.fromhex("".join(text.split()))
+        mode = MODE_IMPLICIT if args.mode == "implicit" else MODE_EXPLICIT
+        times = decode(
+            data,
+            args.count,
+            mode,
+            args.resolution,
+            args.offset_bits,
+            args.period,
+            args.bit_offset,
+        )
+    except ValueError as e:
+        sys.exit("Failed to decode message: %s" % e)
+
+    for time in times:
+        print(time)
+
+
+if __name__ == "__main__":
+    main()